@@ -1,7 +1,9 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <string>
 #include <folly/Range.h>
 #include <folly/Synchronized.h>
 #include <folly/stats/TimeseriesHistogram.h>
@@ -47,6 +49,28 @@ class ThreadLocalStatsT {
     folly::Synchronized<folly::TimeseriesHistogram<int64_t>> histogram_;
   };
 
+  class TLCounter {
+   public:
+    TLCounter(ThreadLocalStatsT* /* container */, folly::StringPiece name)
+        : name_(name.str()) {}
+
+    void incrementValue(int64_t amount = 1) {
+      value_.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    int64_t value() const {
+      return value_.load(std::memory_order_relaxed);
+    }
+
+    const std::string& name() const {
+      return name_;
+    }
+
+   private:
+    std::string name_;
+    std::atomic<int64_t> value_{0};
+  };
+
   void aggregate() {}
 };
 
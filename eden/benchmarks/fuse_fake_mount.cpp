@@ -0,0 +1,565 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/*
+ * End-to-end benchmark of the FUSE request path, without a kernel mount or a
+ * real source control repository.
+ *
+ * Each scenario generates a synthetic repository in a FakeBackingStore,
+ * mounts it through a TestMount connected to a FakeFuse device, and then
+ * plays the part of the kernel: it sends FUSE requests over the device and
+ * waits for each reply, so every request goes through the real FuseChannel
+ * dispatch code.  Status and checkout are driven directly on the EdenMount.
+ *
+ * Results are written as JSON, with one entry per (scenario, operation) pair.
+ */
+#include <fcntl.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/dynamic.h>
+#include <folly/executors/ManualExecutor.h>
+#include <folly/init/Init.h>
+#include <folly/json.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "eden/fs/benchharness/Bench.h"
+#include "eden/fs/inodes/Differ.h"
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/testharness/FakeBackingStore.h"
+#include "eden/fs/testharness/FakeFuse.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+#include "eden/fs/testharness/TestUtil.h"
+
+using namespace facebook::eden;
+using namespace std::chrono_literals;
+using folly::ByteRange;
+using folly::StringPiece;
+
+DEFINE_string(
+    scenarios,
+    "deep,wide,small_files,large_files",
+    "Comma-separated list of synthetic repositories to benchmark");
+DEFINE_uint64(
+    iterations,
+    3,
+    "Number of passes each operation makes over the repository");
+DEFINE_uint64(
+    large_file_size,
+    16 * 1024 * 1024,
+    "Size in bytes of each file in the large_files scenario");
+DEFINE_uint64(files_created, 1000, "Number of files to create and rename");
+DEFINE_string(
+    output,
+    "",
+    "Write the JSON results to this file rather than to stdout");
+
+namespace {
+
+constexpr auto kTimeout = 10s;
+constexpr uint32_t kReadSize = 128 * 1024;
+constexpr size_t kWriteSize = 4096;
+
+/**
+ * A synthetic repository: the builder contains the working copy commit, and
+ * files lists every regular file in it.
+ */
+struct Repo {
+  FakeTreeBuilder builder;
+  std::vector<std::string> files;
+};
+
+void addFile(Repo& repo, std::string path, StringPiece contents) {
+  repo.builder.setFile(path, contents);
+  repo.files.push_back(std::move(path));
+}
+
+/** A single chain of 64 nested directories, with a few files at each level. */
+Repo makeDeepRepo() {
+  Repo repo;
+  std::string dir;
+  for (int depth = 0; depth < 64; ++depth) {
+    dir += folly::to<std::string>("level", depth, "/");
+    for (int i = 0; i < 4; ++i) {
+      addFile(repo, folly::to<std::string>(dir, "file", i), "deep file\n");
+    }
+  }
+  return repo;
+}
+
+/** One directory containing 10,000 files. */
+Repo makeWideRepo() {
+  Repo repo;
+  for (int i = 0; i < 10000; ++i) {
+    addFile(repo, folly::to<std::string>("wide/file", i), "wide file\n");
+  }
+  return repo;
+}
+
+/** 100 directories of 100 small files each. */
+Repo makeSmallFilesRepo() {
+  Repo repo;
+  std::string contents(64, 'x');
+  for (int d = 0; d < 100; ++d) {
+    for (int i = 0; i < 100; ++i) {
+      addFile(repo, folly::to<std::string>("dir", d, "/file", i), contents);
+    }
+  }
+  return repo;
+}
+
+/** A handful of very large files. */
+Repo makeLargeFilesRepo() {
+  Repo repo;
+  std::string contents(FLAGS_large_file_size, 'x');
+  for (int i = 0; i < 4; ++i) {
+    addFile(repo, folly::to<std::string>("large/file", i), contents);
+  }
+  return repo;
+}
+
+/**
+ * Latency samples for one operation, in nanoseconds.
+ */
+class Samples {
+ public:
+  void add(uint64_t ns) {
+    samples_.push_back(ns);
+  }
+
+  void addBytes(uint64_t bytes) {
+    bytes_ += bytes;
+  }
+
+  folly::dynamic summarize(
+      StringPiece scenario,
+      StringPiece operation,
+      uint64_t wallNs) {
+    std::sort(samples_.begin(), samples_.end());
+    auto count = samples_.size();
+    auto percentile = [&](double p) {
+      return count ? samples_[std::min(count - 1, size_t(p * count))] / 1000.0
+                   : 0.0;
+    };
+    auto total = std::accumulate(samples_.begin(), samples_.end(), 0.0);
+    auto seconds = wallNs / 1e9;
+
+    folly::dynamic result = folly::dynamic::object("scenario", scenario)(
+        "operation", operation)("count", count)(
+        "ops_per_sec", seconds > 0 ? count / seconds : 0.0)(
+        "avg_us", count ? total / count / 1000.0 : 0.0)(
+        "p50_us", percentile(0.5))("p90_us", percentile(0.9))(
+        "p99_us", percentile(0.99))("max_us", percentile(1.0));
+    if (bytes_) {
+      result["bytes_per_sec"] = seconds > 0 ? bytes_ / seconds : 0.0;
+    }
+    return result;
+  }
+
+ private:
+  std::vector<uint64_t> samples_;
+  uint64_t bytes_{0};
+};
+
+ByteRange toBytes(const std::string& str) {
+  return ByteRange{StringPiece{str}};
+}
+
+/**
+ * Plays the kernel side of a FUSE connection, one request at a time.
+ */
+class FuseClient {
+ public:
+  explicit FuseClient(FakeFuse& fuse) : fuse_{fuse} {}
+
+  /**
+   * Send a request, wait for its reply, and return the reply body.  The
+   * round trip time is added to samples if it is non-null.
+   */
+  std::vector<uint8_t> call(
+      uint32_t opcode,
+      uint64_t ino,
+      ByteRange arg,
+      Samples* samples = nullptr) {
+    auto start = getTime();
+    auto requestID = fuse_.sendRequest(opcode, ino, arg);
+    auto response = fuse_.recvResponse();
+    if (samples) {
+      samples->add(getTime() - start);
+    }
+    if (response.header.unique != requestID) {
+      throw std::runtime_error(folly::to<std::string>(
+          "received reply for request ",
+          response.header.unique,
+          " while waiting for ",
+          requestID));
+    }
+    if (response.header.error != 0) {
+      throw std::system_error(
+          -response.header.error,
+          std::generic_category(),
+          folly::to<std::string>("FUSE request ", opcode, " failed"));
+    }
+    return std::move(response.body);
+  }
+
+  template <typename ArgType>
+  std::vector<uint8_t> call(
+      uint32_t opcode,
+      uint64_t ino,
+      const ArgType& arg,
+      Samples* samples = nullptr) {
+    return call(
+        opcode,
+        ino,
+        ByteRange{reinterpret_cast<const uint8_t*>(&arg), sizeof(arg)},
+        samples);
+  }
+
+  template <typename T>
+  static T parse(const std::vector<uint8_t>& body) {
+    if (body.size() < sizeof(T)) {
+      throw std::runtime_error("short FUSE reply");
+    }
+    T result;
+    memcpy(&result, body.data(), sizeof(T));
+    return result;
+  }
+
+  uint64_t lookup(uint64_t parent, StringPiece name, Samples* samples) {
+    // The kernel sends names NUL-terminated.
+    auto arg = name.str();
+    arg.push_back('\0');
+    auto body = call(FUSE_LOOKUP, parent, toBytes(arg), samples);
+    return parse<fuse_entry_out>(body).nodeid;
+  }
+
+  uint64_t open(uint32_t opcode, uint64_t ino, uint32_t flags) {
+    fuse_open_in arg = {};
+    arg.flags = flags;
+    return parse<fuse_open_out>(call(opcode, ino, arg)).fh;
+  }
+
+  void release(uint32_t opcode, uint64_t ino, uint64_t fh) {
+    fuse_release_in arg = {};
+    arg.fh = fh;
+    call(opcode, ino, arg);
+  }
+
+ private:
+  FakeFuse& fuse_;
+};
+
+/**
+ * Mounts a Repo over a FakeFuse device and runs the benchmarks against it.
+ */
+class MountBenchmark {
+ public:
+  MountBenchmark(StringPiece name, Repo repo)
+      : name_{name.str()},
+        repo_{std::move(repo)},
+        mount_{repo_.builder},
+        fuse_{std::make_shared<FakeFuse>()},
+        client_{*fuse_} {
+    // TestMount runs its server thread pool on a ManualExecutor.  Drain it
+    // continuously in the background so that requests that hop onto the
+    // thread pool make progress.
+    drainer_ = std::thread([this] {
+      auto executor = mount_.getServerExecutor();
+      while (!done_.load()) {
+        executor->wait();
+        executor->run();
+      }
+    });
+
+    mount_.registerFakeFuse(fuse_);
+    auto initFuture = mount_.getEdenMount()->startFuse();
+    fuse_->sendInitRequest();
+    fuse_->recvResponse();
+    std::move(initFuture).get(kTimeout);
+  }
+
+  ~MountBenchmark() {
+    auto completion = mount_.getEdenMount()->getFuseCompletionFuture();
+    fuse_->close();
+    std::move(completion).get(kTimeout);
+
+    done_.store(true);
+    mount_.getServerExecutor()->add([] {});
+    drainer_.join();
+  }
+
+  void run(std::vector<folly::dynamic>& results) {
+    timed(results, "lookup", [&](Samples& s) { lookupAll(s); });
+    timed(results, "getattr", [&](Samples& s) { getattrAll(s); });
+    timed(results, "readdir", [&](Samples& s) { readdirAll(s); });
+    timed(results, "read", [&](Samples& s) { readAll(s); });
+    timed(results, "create", [&](Samples& s) { createFiles(s); });
+    timed(results, "write", [&](Samples& s) { writeFiles(s); });
+    timed(results, "rename", [&](Samples& s) { renameFiles(s); });
+    timed(results, "status", [&](Samples& s) { status(s); });
+    timed(results, "checkout", [&](Samples& s) { checkout(s); });
+  }
+
+ private:
+  template <typename Fn>
+  void timed(std::vector<folly::dynamic>& results, StringPiece op, Fn&& fn) {
+    Samples samples;
+    auto start = getTime();
+    fn(samples);
+    results.push_back(samples.summarize(name_, op, getTime() - start));
+    std::cerr << folly::toJson(results.back()) << std::endl;
+  }
+
+  /** Walk path one component at a time, as the kernel would. */
+  uint64_t resolve(StringPiece path, Samples* samples) {
+    uint64_t ino = FUSE_ROOT_ID;
+    std::vector<StringPiece> components;
+    folly::split('/', path, components);
+    for (auto component : components) {
+      ino = client_.lookup(ino, component, samples);
+    }
+    return ino;
+  }
+
+  void lookupAll(Samples& samples) {
+    for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+      for (const auto& path : repo_.files) {
+        fileInodes_[path] = resolve(path, &samples);
+      }
+    }
+    for (const auto& path : repo_.files) {
+      auto slash = path.rfind('/');
+      if (slash != std::string::npos) {
+        auto dir = path.substr(0, slash);
+        if (dirInodes_.find(dir) == dirInodes_.end()) {
+          dirInodes_[dir] = resolve(dir, nullptr);
+        }
+      }
+    }
+    dirInodes_[""] = FUSE_ROOT_ID;
+  }
+
+  void getattrAll(Samples& samples) {
+    fuse_getattr_in arg = {};
+    for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+      for (const auto& entry : fileInodes_) {
+        client_.call(FUSE_GETATTR, entry.second, arg, &samples);
+      }
+    }
+  }
+
+  /** Each sample is a complete opendir/readdir/releasedir sequence. */
+  void readdirAll(Samples& samples) {
+    for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+      for (const auto& entry : dirInodes_) {
+        auto ino = entry.second;
+        auto start = getTime();
+        auto fh = client_.open(FUSE_OPENDIR, ino, O_RDONLY);
+        uint64_t offset = 0;
+        while (true) {
+          fuse_read_in arg = {};
+          arg.fh = fh;
+          arg.offset = offset;
+          arg.size = kReadSize;
+          auto body = client_.call(FUSE_READDIR, ino, arg);
+          if (body.empty()) {
+            break;
+          }
+          size_t pos = 0;
+          while (pos + FUSE_NAME_OFFSET <= body.size()) {
+            auto* dirent = reinterpret_cast<const fuse_dirent*>(&body[pos]);
+            offset = dirent->off;
+            pos += FUSE_DIRENT_SIZE(dirent);
+          }
+        }
+        client_.release(FUSE_RELEASEDIR, ino, fh);
+        samples.add(getTime() - start);
+      }
+    }
+  }
+
+  /** Each sample is a single FUSE_READ request. */
+  void readAll(Samples& samples) {
+    for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+      for (const auto& entry : fileInodes_) {
+        auto ino = entry.second;
+        auto fh = client_.open(FUSE_OPEN, ino, O_RDONLY);
+        uint64_t offset = 0;
+        while (true) {
+          fuse_read_in arg = {};
+          arg.fh = fh;
+          arg.offset = offset;
+          arg.size = kReadSize;
+          auto body = client_.call(FUSE_READ, ino, arg, &samples);
+          offset += body.size();
+          samples.addBytes(body.size());
+          if (body.size() < kReadSize) {
+            break;
+          }
+        }
+        client_.release(FUSE_RELEASE, ino, fh);
+      }
+    }
+  }
+
+  void createFiles(Samples& samples) {
+    for (uint64_t i = 0; i < FLAGS_files_created; ++i) {
+      auto name = folly::to<std::string>("new_file", i);
+      std::string arg(sizeof(fuse_create_in), '\0');
+      fuse_create_in create = {};
+      create.flags = O_WRONLY | O_CREAT;
+      create.mode = S_IFREG | 0644;
+      memcpy(&arg[0], &create, sizeof(create));
+      arg.append(name);
+      arg.push_back('\0');
+
+      auto body =
+          client_.call(FUSE_CREATE, FUSE_ROOT_ID, toBytes(arg), &samples);
+      auto entry = FuseClient::parse<fuse_entry_out>(body);
+      std::vector<uint8_t> openBody(
+          body.begin() + sizeof(fuse_entry_out), body.end());
+      auto open = FuseClient::parse<fuse_open_out>(openBody);
+      createdFiles_.push_back({name, entry.nodeid, open.fh});
+    }
+  }
+
+  void writeFiles(Samples& samples) {
+    std::string data(kWriteSize, 'w');
+    for (const auto& file : createdFiles_) {
+      for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+        std::string arg(sizeof(fuse_write_in), '\0');
+        fuse_write_in write = {};
+        write.fh = file.fh;
+        write.offset = i * kWriteSize;
+        write.size = kWriteSize;
+        memcpy(&arg[0], &write, sizeof(write));
+        arg.append(data);
+        client_.call(FUSE_WRITE, file.ino, toBytes(arg), &samples);
+        samples.addBytes(kWriteSize);
+      }
+      client_.release(FUSE_RELEASE, file.ino, file.fh);
+    }
+  }
+
+  void renameFiles(Samples& samples) {
+    for (const auto& file : createdFiles_) {
+      std::string arg(sizeof(fuse_rename_in), '\0');
+      fuse_rename_in rename = {};
+      rename.newdir = FUSE_ROOT_ID;
+      memcpy(&arg[0], &rename, sizeof(rename));
+      arg.append(file.name);
+      arg.push_back('\0');
+      arg.append(file.name + ".renamed");
+      arg.push_back('\0');
+      client_.call(FUSE_RENAME, FUSE_ROOT_ID, toBytes(arg), &samples);
+    }
+  }
+
+  void status(Samples& samples) {
+    auto* mount = mount_.getEdenMount().get();
+    for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+      auto start = getTime();
+      diffMountForStatus(mount, mount->getParentCommits().parent1(), false)
+          .get(kTimeout);
+      samples.add(getTime() - start);
+    }
+  }
+
+  /**
+   * Alternate between the original commit and one where every tenth file has
+   * been modified.
+   */
+  void checkout(Samples& samples) {
+    auto backingStore = mount_.getBackingStore();
+    auto original = mount_.getEdenMount()->getParentCommits().parent1();
+
+    auto modified = repo_.builder.clone();
+    for (size_t i = 0; i < repo_.files.size(); i += 10) {
+      modified.replaceFile(repo_.files[i], "modified\n");
+    }
+    modified.finalize(backingStore, true);
+    auto commit = backingStore->putCommit("modified", modified);
+    commit->setReady();
+
+    for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+      for (auto hash : {makeTestHash("modified"), original}) {
+        auto start = getTime();
+        mount_.getEdenMount()->checkout(hash).get(kTimeout);
+        samples.add(getTime() - start);
+      }
+    }
+  }
+
+  struct CreatedFile {
+    std::string name;
+    uint64_t ino;
+    uint64_t fh;
+  };
+
+  std::string name_;
+  Repo repo_;
+  TestMount mount_;
+  std::shared_ptr<FakeFuse> fuse_;
+  FuseClient client_;
+  std::thread drainer_;
+  std::atomic<bool> done_{false};
+
+  std::unordered_map<std::string, uint64_t> fileInodes_;
+  std::unordered_map<std::string, uint64_t> dirInodes_;
+  std::vector<CreatedFile> createdFiles_;
+};
+
+Repo makeRepo(StringPiece scenario) {
+  if (scenario == "deep") {
+    return makeDeepRepo();
+  } else if (scenario == "wide") {
+    return makeWideRepo();
+  } else if (scenario == "small_files") {
+    return makeSmallFilesRepo();
+  } else if (scenario == "large_files") {
+    return makeLargeFilesRepo();
+  }
+  throw std::invalid_argument(
+      folly::to<std::string>("unknown scenario: ", scenario));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+
+  std::vector<StringPiece> scenarios;
+  folly::split(',', FLAGS_scenarios, scenarios, /*ignoreEmpty=*/true);
+
+  std::vector<folly::dynamic> results;
+  for (auto scenario : scenarios) {
+    MountBenchmark benchmark{scenario, makeRepo(scenario)};
+    benchmark.run(results);
+  }
+
+  folly::dynamic output = folly::dynamic::object(
+      "results", folly::dynamic(results.begin(), results.end()));
+  auto json = folly::toPrettyJson(output);
+  if (FLAGS_output.empty()) {
+    std::cout << json << std::endl;
+  } else if (!folly::writeFile(json, FLAGS_output.c_str())) {
+    perror("failed to write results");
+    return 1;
+  }
+  return 0;
+}
@@ -8,6 +8,7 @@
 # of patent rights can be found in the PATENTS file in the same directory.
 
 import argparse
+import os
 
 from . import cmd_util, subcmd as subcmd_mod
 from .subcmd import Subcmd
@@ -22,9 +23,20 @@ except ImportError:
 
 @trace_cmd("enable", "Enable tracing")
 class EnableTraceCmd(Subcmd):
+    def setup_parser(self, parser: argparse.ArgumentParser) -> None:
+        parser.add_argument(
+            "--buffer-size",
+            type=int,
+            default=None,
+            help="Keep at most this many trace points in memory, discarding the "
+            "oldest ones.  0 removes the limit.",
+        )
+
     def run(self, args: argparse.Namespace) -> int:
         instance = cmd_util.get_eden_instance(args)
         with instance.get_thrift_client() as client:
+            if args.buffer_size is not None:
+                client.setTraceBufferSize(args.buffer_size)
             client.enableTracing()
         return 0
 
@@ -38,6 +50,24 @@ class DisableTraceCmd(Subcmd):
         return 0
 
 
+@trace_cmd(
+    "export",
+    "Write the trace points buffered since the last export to a file in "
+    "Chrome trace format, viewable with chrome://tracing or the Perfetto UI",
+)
+class ExportTraceCmd(Subcmd):
+    def setup_parser(self, parser: argparse.ArgumentParser) -> None:
+        parser.add_argument("path", help="The file to write the trace to")
+
+    def run(self, args: argparse.Namespace) -> int:
+        instance = cmd_util.get_eden_instance(args)
+        path = os.path.abspath(args.path)
+        with instance.get_thrift_client() as client:
+            count = client.exportTracePoints(os.fsencode(path))
+        print(f"Wrote {count} trace points to {path}")
+        return 0
+
+
 @subcmd_mod.subcmd("trace", "Commands for managing eden tracing")
 class TraceCmd(Subcmd):
     parser: argparse.ArgumentParser
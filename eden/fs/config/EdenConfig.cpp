@@ -226,6 +226,30 @@ uint16_t EdenConfig::getMononokePort() const {
   return mononokePort_.getValue();
 }
 
+bool EdenConfig::getRocksDbBlobFiles() const {
+  return rocksDbBlobFiles_.getValue();
+}
+
+uint64_t EdenConfig::getRocksDbMinBlobFileValueSize() const {
+  return rocksDbMinBlobFileValueSize_.getValue();
+}
+
+const std::string& EdenConfig::getRocksDbBlobCompression() const {
+  return rocksDbBlobCompression_.getValue();
+}
+
+const std::string& EdenConfig::getRocksDbTreeCompression() const {
+  return rocksDbTreeCompression_.getValue();
+}
+
+const std::string& EdenConfig::getRocksDbMetadataCompression() const {
+  return rocksDbMetadataCompression_.getValue();
+}
+
+uint16_t EdenConfig::getRocksDbBloomBitsPerKey() const {
+  return rocksDbBloomBitsPerKey_.getValue();
+}
+
 void EdenConfig::setUserConfigPath(AbsolutePath userConfigPath) {
   userConfigPath_ = userConfigPath;
 }
@@ -262,6 +286,12 @@ void EdenConfig::setUseMononoke(bool useMononoke, ConfigSource configSource) {
   return useMononoke_.setValue(useMononoke, configSource);
 }
 
+void EdenConfig::setRocksDbBlobFiles(
+    bool blobFiles,
+    ConfigSource configSource) {
+  return rocksDbBlobFiles_.setValue(blobFiles, configSource);
+}
+
 bool hasConfigFileChanged(
     AbsolutePath configFileName,
     const struct stat* oldStat) {
@@ -507,6 +537,22 @@ operator()(
   return folly::makeExpected<std::string, std::string>(value.toString());
 }
 
+folly::Expected<std::string, std::string> RocksDbCompressionConverter::
+operator()(
+    folly::StringPiece value,
+    const std::map<std::string, std::string>& /* unused */) const {
+  for (auto name : {"auto", "none", "snappy", "zlib", "lz4", "zstd"}) {
+    if (value == name) {
+      return value.str();
+    }
+  }
+  return folly::makeUnexpected<string>(folly::to<std::string>(
+      "Unexpected value: '",
+      value,
+      "'. Expected one of \"auto\", \"none\", \"snappy\", \"zlib\", "
+      "\"lz4\" or \"zstd\""));
+}
+
 folly::Expected<bool, std::string> FieldConverter<bool>::operator()(
     folly::StringPiece value,
     const std::map<std::string, std::string>& /* unused */) const {
@@ -535,5 +581,20 @@ folly::Expected<uint16_t, std::string> FieldConverter<uint16_t>::operator()(
   }
 }
 
+folly::Expected<uint64_t, std::string> FieldConverter<uint64_t>::operator()(
+    folly::StringPiece value,
+    const std::map<std::string, std::string>& /* unused */) const {
+  auto aString = value.str();
+
+  try {
+    return folly::to<uint64_t>(aString);
+  } catch (const std::exception&) {
+    return folly::makeUnexpected<string>(folly::to<std::string>(
+        "Unexpected value: '",
+        value,
+        ". Expected a uint64_t compatible value"));
+  }
+}
+
 } // namespace eden
 } // namespace facebook
@@ -191,6 +191,33 @@ class FieldConverter<uint16_t> {
       const std::map<std::string, std::string>& convData) const;
 };
 
+template <>
+class FieldConverter<uint64_t> {
+ public:
+  /**
+   * Convert the passed string piece to a uint64_t.
+   * @param convData is a map of conversion data that can be used by conversions
+   * method (for example $HOME value.)
+   * @return the converted value or an error message.
+   */
+  folly::Expected<uint64_t, std::string> operator()(
+      folly::StringPiece value,
+      const std::map<std::string, std::string>& convData) const;
+};
+
+/**
+ * Converter for the RocksDB compression settings.  Accepts "auto", which keeps
+ * the compression RocksDB picks for itself, or one of "none", "snappy",
+ * "zlib", "lz4" and "zstd".  Whether a codec was compiled into RocksDB is only
+ * known to RocksDbLocalStore, which falls back to "auto" if it was not.
+ */
+class RocksDbCompressionConverter {
+ public:
+  folly::Expected<std::string, std::string> operator()(
+      folly::StringPiece value,
+      const std::map<std::string, std::string>& convData) const;
+};
+
 /**
  * A Configuration setting is a piece of application configuration that can be
  * constructed by parsing a string. It retains values for various ConfigSources:
@@ -220,7 +247,8 @@ class ConfigSetting : public ConfigSettingBase {
    * ConfigSetting.
    */
   void copyFrom(const ConfigSettingBase& rhs) override {
-    auto rhsConfigSetting = dynamic_cast<const ConfigSetting<T>*>(&rhs);
+    auto rhsConfigSetting =
+        dynamic_cast<const ConfigSetting<T, Converter>*>(&rhs);
     if (!rhsConfigSetting) {
       throw std::runtime_error("ConfigSetting copyFrom unknown type");
     }
@@ -395,6 +423,26 @@ class EdenConfig : public ConfigSettingManager {
   std::optional<std::string> getMononokeHostName() const;
   uint16_t getMononokePort() const;
 
+  /**
+   * Whether the RocksDB blob key space stores its values in separate blob
+   * files rather than in the LSM tree.  Default true.
+   */
+  bool getRocksDbBlobFiles() const;
+  /** Values smaller than this stay in the LSM tree.  Default 4KiB. */
+  uint64_t getRocksDbMinBlobFileValueSize() const;
+  /**
+   * RocksDB compression for file contents, trees, and small metadata records
+   * (blob metadata, proxy hashes and commit to tree mappings).  One of
+   * "auto", "none", "snappy", "zlib", "lz4" or "zstd".  The default, "auto",
+   * leaves the first two LSM levels uncompressed and uses LZ4 (or Snappy if
+   * LZ4 is not available) below that, as RocksDB does on its own.
+   */
+  const std::string& getRocksDbBlobCompression() const;
+  const std::string& getRocksDbTreeCompression() const;
+  const std::string& getRocksDbMetadataCompression() const;
+  /** Bloom filter bits per key for every RocksDB key space.  Default 10. */
+  uint16_t getRocksDbBloomBitsPerKey() const;
+
   void setUserConfigPath(AbsolutePath userConfigPath);
 
   void setSystemConfigDir(AbsolutePath systemConfigDir);
@@ -432,6 +480,10 @@ class EdenConfig : public ConfigSettingManager {
    */
   void setUseMononoke(bool useMononoke, ConfigSource configSource);
 
+  /** Set the RocksDB blob files flag for the provided source.
+   */
+  void setRocksDbBlobFiles(bool blobFiles, ConfigSource configSource);
+
   /**
    *  Register the configuration setting. The fullKey is used to parse values
    *  from the toml file. It is of the form: "core:userConfigPath"
@@ -498,6 +550,21 @@ class EdenConfig : public ConfigSettingManager {
   ConfigSetting<std::string> mononokeHostName_{"mononoke:hostname", "", this};
   ConfigSetting<uint16_t> mononokePort_{"mononoke:port", 443, this};
 
+  ConfigSetting<bool> rocksDbBlobFiles_{"rocksdb:blob-files", true, this};
+  ConfigSetting<uint64_t> rocksDbMinBlobFileValueSize_{
+      "rocksdb:min-blob-file-value-size",
+      4096,
+      this};
+  ConfigSetting<std::string, RocksDbCompressionConverter>
+      rocksDbBlobCompression_{"rocksdb:blob-compression", "auto", this};
+  ConfigSetting<std::string, RocksDbCompressionConverter>
+      rocksDbTreeCompression_{"rocksdb:tree-compression", "auto", this};
+  ConfigSetting<std::string, RocksDbCompressionConverter>
+      rocksDbMetadataCompression_{"rocksdb:metadata-compression", "auto", this};
+  ConfigSetting<uint16_t> rocksDbBloomBitsPerKey_{"rocksdb:bloom-bits-per-key",
+                                                  10,
+                                                  this};
+
   struct stat systemConfigFileStat_ = {};
   struct stat userConfigFileStat_ = {};
 };
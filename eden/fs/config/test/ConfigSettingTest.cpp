@@ -118,6 +118,23 @@ TEST(ConfigSettingTest, configSetInvalidStringValue) {
   EXPECT_EQ(testDir.getValue(), systemConfigDir);
 }
 
+TEST(ConfigSettingTest, rocksDbCompressionRejectsUnknownNames) {
+  ConfigSetting<std::string, facebook::eden::RocksDbCompressionConverter>
+      compression{"rocksdb:blob-compression"_sp, "auto", nullptr};
+  std::map<std::string, std::string> attrMap;
+
+  auto rslt = compression.setStringValue(
+      "zstd", attrMap, facebook::eden::SYSTEM_CONFIG_FILE);
+  EXPECT_EQ(rslt.hasError(), false);
+  EXPECT_EQ(compression.getValue(), "zstd");
+
+  rslt = compression.setStringValue(
+      "lz5", attrMap, facebook::eden::USER_CONFIG_FILE);
+  EXPECT_EQ(rslt.hasError(), true);
+  EXPECT_EQ(compression.getSource(), facebook::eden::SYSTEM_CONFIG_FILE);
+  EXPECT_EQ(compression.getValue(), "zstd");
+}
+
 TEST(ConfigSettingTest, configSetEnvSubTest) {
   AbsolutePath defaultDir{"/home/bob"};
   auto dirKey = "dirKey"_sp;
@@ -118,6 +118,10 @@ TEST_F(EdenConfigTest, defaultTest) {
   EXPECT_EQ(edenConfig->getEdenDir(), defaultEdenDirPath_);
   EXPECT_EQ(edenConfig->getClientCertificate(), defaultClientCertificatePath_);
   EXPECT_EQ(edenConfig->getUseMononoke(), defaultUseMononoke_);
+  EXPECT_TRUE(edenConfig->getRocksDbBlobFiles());
+  EXPECT_EQ(edenConfig->getRocksDbMinBlobFileValueSize(), 4096);
+  EXPECT_EQ(edenConfig->getRocksDbBlobCompression(), "auto");
+  EXPECT_EQ(edenConfig->getRocksDbMetadataCompression(), "auto");
 }
 
 TEST_F(EdenConfigTest, simpleSetGetTest) {
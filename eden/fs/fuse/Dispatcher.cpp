@@ -84,12 +84,23 @@ folly::Future<fuse_entry_out> Dispatcher::lookup(
   throwSystemErrorExplicit(ENOENT);
 }
 
+std::optional<fuse_entry_out> Dispatcher::lookupIfReady(
+    InodeNumber /*parent*/,
+    PathComponentPiece /*name*/) {
+  return std::nullopt;
+}
+
 void Dispatcher::forget(InodeNumber /*ino*/, unsigned long /*nlookup*/) {}
 
 folly::Future<Dispatcher::Attr> Dispatcher::getattr(InodeNumber /*ino*/) {
   throwSystemErrorExplicit(ENOENT);
 }
 
+std::optional<Dispatcher::Attr> Dispatcher::getattrIfReady(
+    InodeNumber /*ino*/) {
+  return std::nullopt;
+}
+
 folly::Future<Dispatcher::Attr> Dispatcher::setattr(
     InodeNumber /*ino*/,
     const fuse_setattr_in& /*attr*/
@@ -12,6 +12,7 @@
 #include <folly/Portability.h>
 #include <folly/Range.h>
 #include <sys/statvfs.h>
+#include <optional>
 #include "eden/fs/fuse/BufVec.h"
 #include "eden/fs/fuse/FileHandleMap.h"
 #include "eden/fs/fuse/FuseTypes.h"
@@ -83,6 +84,20 @@ class Dispatcher {
       InodeNumber parent,
       PathComponentPiece name);
 
+  /**
+   * Lookup a directory entry without blocking, if the answer is already
+   * available in memory.
+   *
+   * FuseChannel calls this before lookup(), and replies inline from the
+   * worker thread when it returns a value; no RequestContext or future chain
+   * is created for the request.  Returns std::nullopt if the entry would have
+   * to be loaded, in which case lookup() is called as usual.  A returned entry
+   * counts as a lookup for the purposes of forget().
+   */
+  virtual std::optional<fuse_entry_out> lookupIfReady(
+      InodeNumber parent,
+      PathComponentPiece name);
+
   /**
    * Forget about an inode
    *
@@ -129,6 +144,12 @@ class Dispatcher {
    */
   virtual folly::Future<Attr> getattr(InodeNumber ino);
 
+  /**
+   * Get file attributes without blocking, if they are already available in
+   * memory.  See lookupIfReady().
+   */
+  virtual std::optional<Attr> getattrIfReady(InodeNumber ino);
+
   /**
    * Set file attributes
    *
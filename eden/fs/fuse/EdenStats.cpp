@@ -38,6 +38,10 @@ EdenStats::Histogram EdenStats::createHistogram(const std::string& name) {
                    99};
 }
 
+EdenStats::Counter EdenStats::createCounter(const std::string& name) {
+  return Counter{this, name};
+}
+
 void EdenStats::recordLatency(
     HistogramPtr item,
     std::chrono::microseconds elapsed,
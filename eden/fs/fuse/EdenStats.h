@@ -38,6 +38,7 @@ class EdenStats : public facebook::stats::ThreadLocalStatsT<
                       facebook::stats::TLStatsThreadSafe> {
  public:
   using Histogram = TLHistogram;
+  using Counter = TLCounter;
 
   explicit EdenStats();
 
@@ -78,6 +79,28 @@ class EdenStats : public facebook::stats::ThreadLocalStatsT<
   Histogram poll{createHistogram("fuse.poll_us")};
   Histogram forgetmulti{createHistogram("fuse.forgetmulti_us")};
 
+  // Counters tracking the effectiveness of the TreePrefetcher.  An object is
+  // "used" if an inode load asks for it after it was prefetched, and
+  // "wasted" if it ages out of the prefetcher's tracking set first.
+  Counter prefetchTreesIssued{createCounter("prefetch.trees_issued")};
+  Counter prefetchBlobMetadataIssued{
+      createCounter("prefetch.blob_metadata_issued")};
+  Counter prefetchUsed{createCounter("prefetch.used")};
+  Counter prefetchWasted{createCounter("prefetch.wasted")};
+  Counter prefetchOverBudget{createCounter("prefetch.over_budget")};
+
+  // Counters tracking how getScmStatus requests were answered: straight
+  // from the cached result, by re-diffing only the paths the journal shows
+  // as changed, or with a full diff of the mount.
+  Counter statusCacheHit{createCounter("status_cache.hit")};
+  Counter statusCachePartial{createCounter("status_cache.partial")};
+  Counter statusCacheFull{createCounter("status_cache.full")};
+
+  // Counters tracking bulk loads of materialized inodes: the inodes started
+  // and the batches of overlay directory records read for them.
+  Counter materializedLoadInodes{createCounter("materialized_load.inodes")};
+  Counter materializedLoadBatches{createCounter("materialized_load.batches")};
+
   // Since we can potentially finish a request in a different
   // thread from the one used to initiate it, we use HistogramPtr
   // as a helper for referencing the pointer-to-member that we
@@ -98,6 +121,7 @@ class EdenStats : public facebook::stats::ThreadLocalStatsT<
 
  private:
   Histogram createHistogram(const std::string& name);
+  Counter createCounter(const std::string& name);
 };
 
 } // namespace eden
@@ -10,24 +10,44 @@
 #include "eden/fs/fuse/FuseChannel.h"
 
 #include <boost/cast.hpp>
+#include <folly/ScopeGuard.h>
 #include <folly/futures/helpers.h>
+#include <folly/hash/Hash.h>
 #include <folly/io/async/Request.h>
 #include <folly/logging/xlog.h>
 #include <folly/system/ThreadName.h>
+#include <gflags/gflags.h>
 #include <signal.h>
+#include <sys/eventfd.h>
 #include <type_traits>
 #include "eden/fs/fuse/DirHandle.h"
 #include "eden/fs/fuse/DirList.h"
 #include "eden/fs/fuse/Dispatcher.h"
+#include "eden/fs/fuse/EdenStats.h"
 #include "eden/fs/fuse/FileHandle.h"
 #include "eden/fs/fuse/RequestData.h"
+#include "eden/fs/tracing/Tracing.h"
 #include "eden/fs/utils/Bug.h"
+#include "eden/fs/utils/ClientPid.h"
+#include "eden/fs/utils/IoUring.h"
 #include "eden/fs/utils/Synchronized.h"
 #include "eden/fs/utils/SystemError.h"
+#include "eden/fs/utils/UnboundedQueueExecutor.h"
 
 using namespace folly;
 using std::string;
 
+DEFINE_int32(
+    fuse_io_uring_depth,
+    4,
+    "Number of reads each FUSE worker thread keeps outstanding when using "
+    "io_uring");
+DEFINE_bool(
+    fuse_inline_replies,
+    true,
+    "Answer FUSE_GETATTR and FUSE_LOOKUP requests for loaded inodes directly "
+    "from the FUSE worker thread");
+
 namespace facebook {
 namespace eden {
 
@@ -161,6 +181,90 @@ void installSignalHandler() {
       sigaction(SIGUSR2, &action, &oldAction), "failed to set SIGUSR2 handler");
 }
 
+#ifdef EDEN_HAVE_IO_URING
+/**
+ * A reply that has been queued on an io_uring but not yet written.  Its
+ * address is used as the request tag, and it keeps everything the iovecs
+ * point to alive until the write completes.
+ */
+struct PendingReply {
+  fuse_out_header header;
+  folly::fbvector<iovec> iov;
+  // Owns the payload, or holds a copy of it if the caller did not pass an
+  // owner.
+  std::shared_ptr<const void> payloadOwner;
+  std::string payloadCopy;
+  FuseChannel::ReplyErrorCallback onError;
+};
+
+/**
+ * Replies sent from a worker thread running processSessionIoUring() are
+ * queued on that thread's ring and submitted together the next time the
+ * thread goes back to the kernel for more requests.  Replies sent from any
+ * other thread are written synchronously as usual.
+ *
+ * Since a batched reply is written after sendRawReply() returns, write
+ * errors for it are passed to the reply's error callback rather than
+ * thrown to the caller.
+ */
+struct ReplyBatch {
+  const FuseChannel* channel;
+  IoUring* ring;
+  int fd;
+  size_t pending{0};
+};
+
+thread_local ReplyBatch* currentReplyBatch{nullptr};
+
+/**
+ * Call prepare() to queue a request on ring, submitting what is already
+ * queued to make room if necessary.
+ */
+template <typename Fn>
+void enqueue(IoUring& ring, Fn&& prepare) {
+  while (!prepare()) {
+    ring.submitAndWait(0);
+  }
+}
+
+void queueReply(
+    ReplyBatch& batch,
+    const iovec iov[],
+    size_t count,
+    std::shared_ptr<const void> payloadOwner,
+    FuseChannel::ReplyErrorCallback onError) {
+  auto reply = std::make_unique<PendingReply>();
+  memcpy(&reply->header, iov[0].iov_base, sizeof(reply->header));
+  reply->iov.reserve(count);
+  reply->iov.push_back(iovec{&reply->header, sizeof(reply->header)});
+  if (payloadOwner) {
+    reply->iov.insert(reply->iov.end(), iov + 1, iov + count);
+    reply->payloadOwner = std::move(payloadOwner);
+  } else if (count > 1) {
+    // Without an owner the payload may not outlive this call.  Such payloads
+    // are small fixed size structs, so copying them is cheap.
+    for (size_t i = 1; i < count; ++i) {
+      reply->payloadCopy.append(
+          static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    }
+    reply->iov.push_back(
+        iovec{&reply->payloadCopy[0], reply->payloadCopy.size()});
+  }
+  reply->onError = std::move(onError);
+
+  auto* ptr = reply.get();
+  enqueue(*batch.ring, [&] {
+    return batch.ring->prepareWritev(
+        batch.fd,
+        ptr->iov.data(),
+        ptr->iov.size(),
+        reinterpret_cast<uint64_t>(ptr));
+  });
+  reply.release();
+  ++batch.pending;
+}
+#endif // EDEN_HAVE_IO_URING
+
 } // namespace
 
 struct FuseChannel::HandlerEntry {
@@ -368,19 +472,22 @@ void FuseChannel::replyError(const fuse_in_header& request, int errorCode) {
 
 void FuseChannel::sendReply(
     const fuse_in_header& request,
-    folly::fbvector<iovec>&& vec) const {
+    folly::fbvector<iovec>&& vec,
+    ReplyErrorCallback onError) const {
   fuse_out_header out;
   out.unique = request.unique;
   out.error = 0;
 
   vec.insert(vec.begin(), make_iovec(out));
 
-  sendRawReply(vec.data(), vec.size());
+  sendRawReply(vec.data(), vec.size(), nullptr, std::move(onError));
 }
 
 void FuseChannel::sendReply(
     const fuse_in_header& request,
-    folly::ByteRange bytes) const {
+    folly::ByteRange bytes,
+    std::shared_ptr<const void> owner,
+    ReplyErrorCallback onError) const {
   fuse_out_header out;
   out.unique = request.unique;
   out.error = 0;
@@ -391,10 +498,41 @@ void FuseChannel::sendReply(
   iov[1].iov_base = const_cast<uint8_t*>(bytes.data());
   iov[1].iov_len = bytes.size();
 
-  sendRawReply(iov.data(), iov.size());
+  sendRawReply(iov.data(), iov.size(), std::move(owner), std::move(onError));
+}
+
+void FuseChannel::sendReply(const fuse_in_header& request, BufVec&& buf)
+    const {
+  fuse_out_header out;
+  out.unique = request.unique;
+  out.error = 0;
+
+  // The iovecs point into buffers that BufVec holds by pointer, so they stay
+  // valid when buf is moved into its owner.
+  auto vec = buf.getIov();
+  vec.insert(vec.begin(), make_iovec(out));
+
+  sendRawReply(
+      vec.data(), vec.size(), std::make_shared<const BufVec>(std::move(buf)));
+}
+
+std::system_error FuseChannel::replyWriteError(int err) const {
+  if (err == ENOENT) {
+    // Interrupted by a signal.  We don't need to log this,
+    // but will propagate it back to our caller.
+  } else if (!isFuseDeviceValid(state_.rlock()->stopReason)) {
+    XLOG(INFO) << "error writing to fuse device: session closed";
+  } else {
+    XLOG(WARNING) << "error writing to fuse device: " << folly::errnoStr(err);
+  }
+  return folly::makeSystemErrorExplicit(err, "error writing to fuse device");
 }
 
-void FuseChannel::sendRawReply(const iovec iov[], size_t count) const {
+void FuseChannel::sendRawReply(
+    const iovec iov[],
+    size_t count,
+    std::shared_ptr<const void> payloadOwner,
+    ReplyErrorCallback onError) const {
   // Ensure that the length is set correctly
   DCHECK_EQ(iov[0].iov_len, sizeof(fuse_out_header));
   const auto header = reinterpret_cast<fuse_out_header*>(iov[0].iov_base);
@@ -403,21 +541,26 @@ void FuseChannel::sendRawReply(const iovec iov[], size_t count) const {
     header->len += iov[i].iov_len;
   }
 
+#ifdef EDEN_HAVE_IO_URING
+  auto* batch = currentReplyBatch;
+  if (batch && batch->channel == this) {
+    queueReply(
+        *batch, iov, count, std::move(payloadOwner), std::move(onError));
+    return;
+  }
+#endif
+
   const auto res = writev(fuseDevice_.fd(), iov, count);
   const int err = errno;
   XLOG(DBG7) << "sendRawReply: unique=" << header->unique
              << " header->len=" << header->len << " wrote=" << res;
 
   if (res < 0) {
-    if (err == ENOENT) {
-      // Interrupted by a signal.  We don't need to log this,
-      // but will propagate it back to our caller.
-    } else if (!isFuseDeviceValid(state_.rlock()->stopReason)) {
-      XLOG(INFO) << "error writing to fuse device: session closed";
-    } else {
-      XLOG(WARNING) << "error writing to fuse device: " << folly::errnoStr(err);
+    auto error = replyWriteError(err);
+    if (onError) {
+      onError(error);
     }
-    throwSystemErrorExplicit(err, "error writing to fuse device");
+    throw error;
   }
 }
 
@@ -426,7 +569,8 @@ FuseChannel::FuseChannel(
     AbsolutePathPiece mountPath,
     size_t numThreads,
     Dispatcher* const dispatcher,
-    std::shared_ptr<ProcessNameCache> processNameCache)
+    std::shared_ptr<ProcessNameCache> processNameCache,
+    bool useIoUring)
     : bufferSize_(std::max(size_t(getpagesize()) + 0x1000, MIN_BUFSIZE)),
       numThreads_(numThreads),
       dispatcher_(dispatcher),
@@ -435,6 +579,25 @@ FuseChannel::FuseChannel(
       processAccessLog_(std::move(processNameCache)) {
   CHECK_GE(numThreads_, 1);
   installSignalHandler();
+
+  if (useIoUring) {
+#ifdef EDEN_HAVE_IO_URING
+    if (IoUring::isSupported()) {
+      // Each worker thread consumes one count from the semaphore when asked
+      // to stop.
+      auto fd = eventfd(0, EFD_CLOEXEC | EFD_SEMAPHORE);
+      folly::checkUnixError(fd, "failed to create FUSE stop eventfd");
+      stopEventFd_ = folly::File{fd, /*ownsFd=*/true};
+      useIoUring_ = true;
+    } else {
+      XLOG(WARN) << "io_uring is not supported by this kernel; using "
+                 << "blocking FUSE I/O for " << mountPath_;
+    }
+#else
+    XLOG(WARN) << "edenfs was built without io_uring support; using "
+               << "blocking FUSE I/O for " << mountPath_;
+#endif
+  }
 }
 
 FuseChannel::~FuseChannel() {}
@@ -511,16 +674,22 @@ void FuseChannel::destroy() {
   // If so, delay actual deletion of the FuseChannel object until the
   // last request completes.
   bool allDone = false;
+  bool releaseThreadsReference = false;
   {
     auto state = state_.wlock();
-    if (state->requests.empty()) {
+    if (state->drained) {
       allDone = true;
     } else {
       state->destroyPending = true;
+      // If the worker threads were never all started then the last of them
+      // to stop did not release their reference on outstandingRequests_.
+      releaseThreadsReference = state->stoppedThreads != numThreads_;
     }
   }
   if (allDone) {
     delete this;
+  } else if (releaseThreadsReference) {
+    releaseOutstandingRequest();
   }
 }
 
@@ -700,21 +869,22 @@ void FuseChannel::sendInvalidateEntry(
 }
 
 std::vector<fuse_in_header> FuseChannel::getOutstandingRequests() {
-  auto state = state_.wlock();
-  const auto& requests = state->requests;
   std::vector<fuse_in_header> outstandingCalls;
 
-  for (const auto& entry : requests) {
-    auto ctx = entry.second.lock();
-    if (ctx) {
-      // Get the fuse_in_header from the ctx and push a copy of it on the
-      // outstandingCalls collection
-      auto rdata = boost::polymorphic_downcast<RequestData*>(
-          ctx->getContextData(RequestData::kKey));
-      // rdata should never be null here and if it - it's most likely a bug
-      const fuse_in_header& fuseHeader = rdata->examineReq();
-      if (fuseHeader.opcode != 0) {
-        outstandingCalls.push_back(fuseHeader);
+  for (auto& shard : requestShards_) {
+    const auto requests = shard.requests.lock();
+    for (const auto& entry : *requests) {
+      auto ctx = entry.second.lock();
+      if (ctx) {
+        // Get the fuse_in_header from the ctx and push a copy of it on the
+        // outstandingCalls collection
+        auto rdata = boost::polymorphic_downcast<RequestData*>(
+            ctx->getContextData(RequestData::kKey));
+        // rdata should never be null here and if it - it's most likely a bug
+        const fuse_in_header& fuseHeader = rdata->examineReq();
+        if (fuseHeader.opcode != 0) {
+          outstandingCalls.push_back(fuseHeader);
+        }
       }
     }
   }
@@ -757,6 +927,17 @@ void FuseChannel::requestSessionExit(
       pthread_kill(thr.native_handle(), SIGUSR2);
     }
   }
+
+  // Worker threads running processSessionIoUring() wait on the eventfd
+  // instead, which does not have the race described above.
+  if (useIoUring_) {
+    uint64_t value = numThreads_;
+    auto res = write(stopEventFd_.fd(), &value, sizeof(value));
+    if (res != sizeof(value)) {
+      XLOG(ERR) << "failed to signal FUSE worker threads to stop: "
+                << folly::errnoStr(errno);
+    }
+  }
 }
 
 void FuseChannel::setThreadSigmask() {
@@ -800,9 +981,17 @@ void FuseChannel::initWorkerThread() noexcept {
 void FuseChannel::fuseWorkerThread() noexcept {
   setThreadName(to<std::string>("fuse", mountPath_.basename()));
   setThreadSigmask();
+  // Someone is waiting on every request we handle, so work this thread queues
+  // on the server thread pool jumps ahead of background work.
+  UnboundedQueueExecutor::setCurrentPriority(
+      UnboundedQueueExecutor::kInteractivePriority);
 
   try {
-    processSession();
+    if (useIoUring_) {
+      processSessionIoUring();
+    } else {
+      processSession();
+    }
   } catch (const std::exception& ex) {
     XLOG(ERR) << "unexpected error in FUSE worker thread: " << exceptionStr(ex);
     // Request that all other FUSE threads exit.
@@ -813,19 +1002,21 @@ void FuseChannel::fuseWorkerThread() noexcept {
   }
 
   // Record that we have shut down.
+  bool lastThread;
   {
     auto state = state_.wlock();
     ++state->stoppedThreads;
     DCHECK(!state->destroyPending) << "destroyPending cannot be set while "
                                       "worker threads are still running";
+    lastThread = state->stoppedThreads == numThreads_;
+  }
 
-    // If we are the last thread to stop and there are no more requests
-    // outstanding then invoke sessionComplete().  If we are the last thread
-    // but there are still outstanding requests we will invoke
-    // sessionComplete() when finishRequest() is called for the last request.
-    if (state->stoppedThreads == numThreads_ && state->requests.empty()) {
-      sessionComplete(std::move(state));
-    }
+  // If we are the last thread to stop then release the worker threads'
+  // reference on outstandingRequests_.  If there are no more requests
+  // outstanding this invokes sessionComplete(); otherwise finishRequest()
+  // will when the last request completes.
+  if (lastThread) {
+    releaseOutstandingRequest();
   }
 }
 
@@ -1037,216 +1228,444 @@ void FuseChannel::processSession() {
     // TODO: FUSE_SPLICE_READ allows using splice(2) here if we enable it.
     // We can look at turning this on once the main plumbing is complete.
     auto res = read(fuseDevice_.fd(), buf.data(), buf.size());
-    if (res < 0) {
-      int error = errno;
-      if (stop_.load(std::memory_order_relaxed)) {
-        break;
-      }
+    if (!handleRead(buf.data(), res, res < 0 ? errno : 0, myPid)) {
+      break;
+    }
+  }
+}
 
-      if (error == EINTR || error == EAGAIN) {
-        // If we got interrupted by a signal while reading the next
-        // fuse command, we will simply retry and read the next thing.
-        continue;
-      } else if (error == ENOENT) {
-        // According to comments in the libfuse code:
-        // ENOENT means the operation was interrupted; it's safe to restart
-        continue;
-      } else if (error == ENODEV) {
-        // ENODEV means the filesystem was unmounted
-        requestSessionExit(StopReason::UNMOUNTED);
-        break;
-      } else {
-        XLOG(WARNING) << "error reading from fuse channel: "
-                      << folly::errnoStr(error);
-        requestSessionExit(StopReason::FUSE_READ_ERROR);
-        break;
+void FuseChannel::processSessionIoUring() {
+#ifdef EDEN_HAVE_IO_URING
+  const size_t depth = std::max(FLAGS_fuse_io_uring_depth, 1);
+  // Reads are tagged with their buffer index.  Replies are tagged with the
+  // address of their PendingReply, which can never collide with these.
+  const uint64_t stopTag = depth;
+  const uint64_t cancelTag = depth + 1;
+
+  // The buffers are declared before the ring so that they outlive it: the
+  // kernel may write into them until the ring is closed.
+  std::vector<std::vector<char>> buffers(
+      depth, std::vector<char>(bufferSize_));
+  std::vector<iovec> bufferIovs(depth);
+  std::vector<bool> readPending(depth, false);
+  uint64_t stopValue = 0;
+  iovec stopIov;
+  stopIov.iov_base = &stopValue;
+  stopIov.iov_len = sizeof(stopValue);
+
+  // Leave room for the reads, their cancellations, and a batch of replies.
+  IoUring ring{static_cast<unsigned>(2 * depth + 64)};
+  ReplyBatch batch{this, &ring, fuseDevice_.fd()};
+  currentReplyBatch = &batch;
+  SCOPE_EXIT {
+    currentReplyBatch = nullptr;
+  };
+
+  auto myPid = getpid();
+  auto queueRead = [&](size_t index) {
+    bufferIovs[index].iov_base = buffers[index].data();
+    bufferIovs[index].iov_len = bufferSize_;
+    enqueue(ring, [&] {
+      return ring.prepareReadv(fuseDevice_.fd(), &bufferIovs[index], 1, index);
+    });
+    readPending[index] = true;
+  };
+  for (size_t i = 0; i < depth; ++i) {
+    queueRead(i);
+  }
+  enqueue(ring, [&] {
+    return ring.prepareReadv(stopEventFd_.fd(), &stopIov, 1, stopTag);
+  });
+
+  bool running = true;
+  auto onCompletion = [&](uint64_t tag, int32_t res) {
+    if (tag < depth) {
+      readPending[tag] = false;
+      if (running) {
+        running = handleRead(
+            buffers[tag].data(), res < 0 ? -1 : res, res < 0 ? -res : 0, myPid);
+        if (running && !stop_.load(std::memory_order_relaxed)) {
+          queueRead(tag);
+        }
+      } else if (res > 0) {
+        // The kernel handed us a request while we were shutting down.  It
+        // has already been removed from the FUSE device, so process it
+        // rather than dropping it.
+        handleRead(buffers[tag].data(), res, 0, myPid);
+      }
+    } else if (tag == stopTag) {
+      running = false;
+    } else if (tag != cancelTag) {
+      std::unique_ptr<PendingReply> reply{reinterpret_cast<PendingReply*>(tag)};
+      --batch.pending;
+      if (res < 0) {
+        auto error = replyWriteError(-res);
+        if (reply->onError) {
+          reply->onError(error);
+        }
       }
     }
+  };
+
+  // An exception from a completion (e.g. an unexpected second FUSE_INIT)
+  // must not skip the cleanup below: the kernel may still write into our
+  // buffers, and the requests and replies it holds would otherwise be lost.
+  std::exception_ptr error;
+  try {
+    while (running && !stop_.load(std::memory_order_relaxed)) {
+      ring.submitAndWait(1);
+      ring.reapCompletions(onCompletion);
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+  running = false;
 
-    const auto arg_size = static_cast<size_t>(res);
-    if (arg_size < sizeof(struct fuse_in_header)) {
-      if (arg_size == 0) {
-        // This code path is hit when a fake FUSE channel is closed in our unit
-        // tests.  On real FUSE channels we should get ENODEV to indicate that
-        // the FUSE channel was shut down.  However, in our unit tests that use
-        // fake FUSE connections we cannot send an ENODEV error, and so we just
-        // close the channel instead.
-        requestSessionExit(StopReason::UNMOUNTED);
-      } else {
-        // We got a partial FUSE header.  This shouldn't ever happen unless
-        // there is a bug in the FUSE kernel code.
-        XLOG(ERR) << "read truncated message from kernel fuse device: len="
-                  << arg_size;
-        requestSessionExit(StopReason::FUSE_TRUNCATED_REQUEST);
+  // Cancel our outstanding reads, then wait for them and for any queued
+  // replies to complete before releasing the buffers they refer to.
+  for (size_t i = 0; i < depth; ++i) {
+    if (readPending[i]) {
+      enqueue(ring, [&] { return ring.prepareCancel(i, cancelTag); });
+    }
+  }
+  auto anyReadPending = [&] {
+    return std::find(readPending.begin(), readPending.end(), true) !=
+        readPending.end();
+  };
+  while (anyReadPending() || batch.pending > 0) {
+    ring.submitAndWait(1);
+    ring.reapCompletions([&](uint64_t tag, int32_t res) {
+      try {
+        onCompletion(tag, res);
+      } catch (const std::exception& ex) {
+        XLOG(ERR) << "error handling FUSE request during shutdown: "
+                  << exceptionStr(ex);
       }
-      return;
+    });
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+#else
+  processSession();
+#endif
+}
+
+bool FuseChannel::handleRead(
+    const char* buf,
+    ssize_t res,
+    int error,
+    pid_t myPid) {
+  if (res < 0) {
+    if (stop_.load(std::memory_order_relaxed)) {
+      return false;
     }
 
-    const auto* header = reinterpret_cast<fuse_in_header*>(buf.data());
-    const uint8_t* arg = reinterpret_cast<const uint8_t*>(header + 1);
-
-    XLOG(DBG7) << "fuse request opcode=" << header->opcode
-               << " unique=" << header->unique << " len=" << header->len
-               << " nodeid=" << header->nodeid << " uid=" << header->uid
-               << " gid=" << header->gid << " pid=" << header->pid;
-
-    // Sanity check to ensure that the request wasn't from ourself.
-    //
-    // We should never make requests to ourself via normal filesytem
-    // operations going through the kernel.  Otherwise we risk deadlocks if the
-    // kernel calls us while holding an inode lock, and we then end up making a
-    // filesystem call that need the same inode lock.  We will then not be able
-    // to resolve this deadlock on kernel inode locks without rebooting the
-    // system.
-    if (UNLIKELY(static_cast<pid_t>(header->pid) == myPid)) {
-      replyError(*header, EIO);
-      XLOG(CRITICAL) << "Received FUSE request from our own pid: opcode="
-                     << header->opcode << " nodeid=" << header->nodeid
-                     << " pid=" << header->pid;
-      continue;
+    if (error == EINTR || error == EAGAIN) {
+      // If we got interrupted by a signal while reading the next
+      // fuse command, we will simply retry and read the next thing.
+      return true;
+    } else if (error == ENOENT) {
+      // According to comments in the libfuse code:
+      // ENOENT means the operation was interrupted; it's safe to restart
+      return true;
+    } else if (error == ENODEV) {
+      // ENODEV means the filesystem was unmounted
+      requestSessionExit(StopReason::UNMOUNTED);
+      return false;
+    } else {
+      XLOG(WARNING) << "error reading from fuse channel: "
+                    << folly::errnoStr(error);
+      requestSessionExit(StopReason::FUSE_READ_ERROR);
+      return false;
     }
+  }
 
-    processAccessLog_.recordAccess(header->pid);
+  const auto arg_size = static_cast<size_t>(res);
+  if (arg_size < sizeof(struct fuse_in_header)) {
+    if (arg_size == 0) {
+      // This code path is hit when a fake FUSE channel is closed in our unit
+      // tests.  On real FUSE channels we should get ENODEV to indicate that
+      // the FUSE channel was shut down.  However, in our unit tests that use
+      // fake FUSE connections we cannot send an ENODEV error, and so we just
+      // close the channel instead.
+      requestSessionExit(StopReason::UNMOUNTED);
+    } else {
+      // We got a partial FUSE header.  This shouldn't ever happen unless
+      // there is a bug in the FUSE kernel code.
+      XLOG(ERR) << "read truncated message from kernel fuse device: len="
+                << arg_size;
+      requestSessionExit(StopReason::FUSE_TRUNCATED_REQUEST);
+    }
+    return false;
+  }
 
-    switch (header->opcode) {
-      case FUSE_INIT:
-        replyError(*header, EPROTO);
-        throw std::runtime_error(
-            "received FUSE_INIT after we have been initialized!?");
-
-      case FUSE_GETLK:
-      case FUSE_SETLK:
-      case FUSE_SETLKW:
-        // Deliberately not handling locking; this causes
-        // the kernel to do it for us
-        replyError(*header, ENOSYS);
-        break;
+  const auto* header = reinterpret_cast<const fuse_in_header*>(buf);
+  const uint8_t* arg = reinterpret_cast<const uint8_t*>(header + 1);
+  return processRequest(header, arg, myPid);
+}
 
-      case FUSE_INTERRUPT: {
-        // no reply is required
-        XLOG(DBG7) << "FUSE_INTERRUPT";
-        const auto in = reinterpret_cast<const fuse_interrupt_in*>(arg);
+bool FuseChannel::processRequest(
+    const fuse_in_header* header,
+    const uint8_t* arg,
+    pid_t myPid) {
+  XLOG(DBG7) << "fuse request opcode=" << header->opcode
+             << " unique=" << header->unique << " len=" << header->len
+             << " nodeid=" << header->nodeid << " uid=" << header->uid
+             << " gid=" << header->gid << " pid=" << header->pid;
+
+  // Sanity check to ensure that the request wasn't from ourself.
+  //
+  // We should never make requests to ourself via normal filesytem
+  // operations going through the kernel.  Otherwise we risk deadlocks if the
+  // kernel calls us while holding an inode lock, and we then end up making a
+  // filesystem call that need the same inode lock.  We will then not be able
+  // to resolve this deadlock on kernel inode locks without rebooting the
+  // system.
+  if (UNLIKELY(static_cast<pid_t>(header->pid) == myPid)) {
+    replyError(*header, EIO);
+    XLOG(CRITICAL) << "Received FUSE request from our own pid: opcode="
+                   << header->opcode << " nodeid=" << header->nodeid
+                   << " pid=" << header->pid;
+    return true;
+  }
 
-        // Look up the fuse request; if we find it and the context
-        // is still alive, ctx will be set to it
-        std::shared_ptr<folly::RequestContext> ctx;
+  processAccessLog_.recordAccess(header->pid);
 
-        {
-          const auto state = state_.wlock();
-          const auto requestIter = state->requests.find(in->unique);
-          if (requestIter != state->requests.end()) {
-            ctx = requestIter->second.lock();
-          }
-        }
+  switch (header->opcode) {
+    case FUSE_INIT:
+      replyError(*header, EPROTO);
+      throw std::runtime_error(
+          "received FUSE_INIT after we have been initialized!?");
 
-        // If we found an existing request, temporarily activate that request
-        // context so that we can test whether the request is definitely a fuse
-        // request; if so, interrupt it.
-        if (ctx) {
-          const RequestContextScopeGuard guard(ctx);
-          if (RequestData::isFuseRequest()) {
-            RequestData::get().interrupt();
-          }
+    case FUSE_GETLK:
+    case FUSE_SETLK:
+    case FUSE_SETLKW:
+      // Deliberately not handling locking; this causes
+      // the kernel to do it for us
+      replyError(*header, ENOSYS);
+      break;
+
+    case FUSE_INTERRUPT: {
+      // no reply is required
+      XLOG(DBG7) << "FUSE_INTERRUPT";
+      const auto in = reinterpret_cast<const fuse_interrupt_in*>(arg);
+
+      // Look up the fuse request; if we find it and the context
+      // is still alive, ctx will be set to it
+      std::shared_ptr<folly::RequestContext> ctx;
+
+      {
+        const auto requests = getRequestShard(in->unique).requests.lock();
+        const auto requestIter = requests->find(in->unique);
+        if (requestIter != requests->end()) {
+          ctx = requestIter->second.lock();
         }
+      }
 
-        break;
+      // If we found an existing request, temporarily activate that request
+      // context so that we can test whether the request is definitely a fuse
+      // request; if so, interrupt it.
+      if (ctx) {
+        const RequestContextScopeGuard guard(ctx);
+        if (RequestData::isFuseRequest()) {
+          RequestData::get().interrupt();
+        }
       }
 
-      case FUSE_DESTROY:
-        XLOG(DBG7) << "FUSE_DESTROY";
-        dispatcher_->destroy();
-        break;
+      break;
+    }
 
-      case FUSE_NOTIFY_REPLY:
-        XLOG(DBG7) << "FUSE_NOTIFY_REPLY";
-        // Don't strictly need to do anything here, but may want to
-        // turn the kernel notifications in Futures and use this as
-        // a way to fulfil the promise
-        break;
+    case FUSE_DESTROY:
+      XLOG(DBG7) << "FUSE_DESTROY";
+      dispatcher_->destroy();
+      break;
+
+    case FUSE_NOTIFY_REPLY:
+      XLOG(DBG7) << "FUSE_NOTIFY_REPLY";
+      // Don't strictly need to do anything here, but may want to
+      // turn the kernel notifications in Futures and use this as
+      // a way to fulfil the promise
+      break;
 
-      case FUSE_IOCTL:
-        // Rather than the default ENOSYS, we need to return ENOTTY
-        // to indicate that the requested ioctl is not supported
-        replyError(*header, ENOTTY);
+    case FUSE_IOCTL:
+      // Rather than the default ENOSYS, we need to return ENOTTY
+      // to indicate that the requested ioctl is not supported
+      replyError(*header, ENOTTY);
+      break;
+
+    default: {
+      if (FLAGS_fuse_inline_replies && tryReplyInline(header, arg)) {
         break;
+      }
 
-      default: {
-        const auto handlerIter = handlerMap_.find(header->opcode);
-        if (handlerIter != handlerMap_.end()) {
-          // Start a new request and associate it with the current thread.
-          // It will be disassociated when we leave this scope, but will
-          // propagate across any futures that are spawned as part of this
-          // request.
-          RequestContextScopeGuard requestContextGuard;
-
-          auto& request = RequestData::create(this, *header, dispatcher_);
-          {
-            // Save a weak reference to this new request context.
-            // We'll need this to process FUSE_INTERRUPT requests.
-            auto state = state_.wlock();
-            state->requests.emplace(
-                header->unique,
-                std::weak_ptr<folly::RequestContext>(
-                    RequestContext::saveContext()));
-          }
-          const auto& entry = handlerIter->second;
-
-          // We cannot hold the state_ lock while invoking entry.
-          //
-          // This means that the call to .setRequestFuture() may be running
-          // concurrently with the handling of a FUSE_INTERRUPT for this
-          // request on another thread which will call .interrupt().
-          //
-          // These methods are internally synchronised to make this safe
-          // so we don't need to reacquire state_ lock after calling the
-          // handler.
-          request.setRequestFuture(folly::makeFutureWith([&] {
-            request.startRequest(dispatcher_->getStats(), entry.histogram);
-            return (this->*entry.handler)(&request.getReq(), arg);
-          }));
-          break;
+      const auto handlerIter = handlerMap_.find(header->opcode);
+      if (handlerIter != handlerMap_.end()) {
+        // Start a new request and associate it with the current thread.
+        // It will be disassociated when we leave this scope, but will
+        // propagate across any futures that are spawned as part of this
+        // request.
+        RequestContextScopeGuard requestContextGuard;
+
+        auto& request = RequestData::create(this, *header, dispatcher_);
+        // Let the layers below attribute their work to the client process.
+        ClientPidRequestData::set(header->pid);
+        {
+          // Save a weak reference to this new request context.
+          // We'll need this to process FUSE_INTERRUPT requests.
+          ++outstandingRequests_;
+          getRequestShard(header->unique)
+              .requests.lock()
+              ->emplace(
+                  header->unique,
+                  std::weak_ptr<folly::RequestContext>(
+                      RequestContext::saveContext()));
         }
+        const auto& entry = handlerIter->second;
+
+        // Trace the full lifetime of the request, including any work done
+        // asynchronously after the handler returns.
+        auto traceBlock = TraceBlock::withStaticName(
+            fuseOpcodeName(header->opcode).data());
+
+        // We cannot hold the request shard lock while invoking entry.
+        //
+        // This means that the call to .setRequestFuture() may be running
+        // concurrently with the handling of a FUSE_INTERRUPT for this
+        // request on another thread which will call .interrupt().
+        //
+        // These methods are internally synchronised to make this safe
+        // so we don't need to reacquire the lock after calling the
+        // handler.
+        request.setRequestFuture(
+            folly::makeFutureWith([&] {
+              request.startRequest(dispatcher_->getStats(), entry.histogram);
+              return (this->*entry.handler)(&request.getReq(), arg);
+            }).ensure([traceBlock = std::move(traceBlock)] {}));
+        break;
+      }
 
-        const auto opcode = header->opcode;
-        tryRlockCheckBeforeUpdate<folly::Unit>(
-            unhandledOpcodes_,
-            [&](const auto& unhandledOpcodes) -> std::optional<folly::Unit> {
-              if (unhandledOpcodes.find(opcode) != unhandledOpcodes.end()) {
-                return folly::unit;
-              }
-              return std::nullopt;
-            },
-            [&](auto& unhandledOpcodes) -> folly::Unit {
-              XLOG(ERR) << "unhandled fuse opcode " << opcode << "("
-                        << fuseOpcodeName(opcode) << ")";
-              unhandledOpcodes->insert(opcode);
+      const auto opcode = header->opcode;
+      tryRlockCheckBeforeUpdate<folly::Unit>(
+          unhandledOpcodes_,
+          [&](const auto& unhandledOpcodes) -> std::optional<folly::Unit> {
+            if (unhandledOpcodes.find(opcode) != unhandledOpcodes.end()) {
               return folly::unit;
-            });
+            }
+            return std::nullopt;
+          },
+          [&](auto& unhandledOpcodes) -> folly::Unit {
+            XLOG(ERR) << "unhandled fuse opcode " << opcode << "("
+                      << fuseOpcodeName(opcode) << ")";
+            unhandledOpcodes->insert(opcode);
+            return folly::unit;
+          });
+
+      try {
+        replyError(*header, ENOSYS);
+      } catch (const std::system_error& exc) {
+        XLOG(ERR) << "Failed to write error response to fuse: " << exc.what();
+        requestSessionExit(StopReason::FUSE_WRITE_ERROR);
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
+}
 
-        try {
-          replyError(*header, ENOSYS);
-        } catch (const std::system_error& exc) {
-          XLOG(ERR) << "Failed to write error response to fuse: " << exc.what();
-          requestSessionExit(StopReason::FUSE_WRITE_ERROR);
-          return;
+bool FuseChannel::tryReplyInline(
+    const fuse_in_header* header,
+    const uint8_t* arg) {
+  const auto startTime = std::chrono::steady_clock::now();
+  EdenStats::HistogramPtr histogram;
+  try {
+    switch (header->opcode) {
+      case FUSE_GETATTR: {
+        const auto attr =
+            dispatcher_->getattrIfReady(InodeNumber{header->nodeid});
+        if (!attr) {
+          return false;
+        }
+        XLOG(DBG7) << "FUSE_GETATTR inode=" << header->nodeid << " (inline)";
+        histogram = &EdenStats::getattr;
+        sendReply(*header, attr->asFuseAttr());
+        break;
+      }
+      case FUSE_LOOKUP: {
+        PathComponentPiece name{reinterpret_cast<const char*>(arg)};
+        const auto entry =
+            dispatcher_->lookupIfReady(InodeNumber{header->nodeid}, name);
+        if (!entry) {
+          return false;
         }
+        XLOG(DBG7) << "FUSE_LOOKUP parent=" << header->nodeid
+                   << " name=" << name << " (inline)";
+        histogram = &EdenStats::lookup;
+        sendReply(*header, *entry);
         break;
       }
+      default:
+        return false;
     }
+  } catch (const std::exception& ex) {
+    if (!histogram) {
+      // The Dispatcher failed before answering; let the normal path produce
+      // the reply, including any error.
+      XLOG(DBG4) << "inline " << fuseOpcodeName(header->opcode)
+                 << " failed, dispatching normally: " << exceptionStr(ex);
+      return false;
+    }
+    // replyWriteError() has already logged the failure to write the reply.
   }
+
+  const auto now = std::chrono::steady_clock::now();
+  dispatcher_->getStats()->get()->recordLatency(
+      histogram,
+      std::chrono::duration_cast<std::chrono::microseconds>(now - startTime),
+      std::chrono::duration_cast<std::chrono::seconds>(
+          now.time_since_epoch()));
+  return true;
+}
+
+FuseChannel::RequestShard& FuseChannel::getRequestShard(uint64_t unique) {
+  // The kernel allocates request IDs in steps of two, so mix the bits rather
+  // than using the low ones directly.
+  return requestShards_[folly::hash::twang_mix64(unique) % kNumRequestShards];
 }
 
 void FuseChannel::finishRequest(const fuse_in_header& header) {
   // Remove the current request from the map.
-  auto state = state_.wlock();
-  const bool erased = state->requests.erase(header.unique) > 0;
-  DCHECK(erased);
+  {
+    auto requests = getRequestShard(header.unique).requests.lock();
+    const bool erased = requests->erase(header.unique) > 0;
+    DCHECK(erased);
+  }
+
+  // We may be complete if this was the last request and there are no
+  // threads remaining.
+  releaseOutstandingRequest();
+}
+
+void FuseChannel::releaseOutstandingRequest() {
+  if (outstandingRequests_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    requestsDrained(state_.wlock());
+  }
+}
 
-  // We may be complete; check to see if all requests are
-  // done and whether there are any threads remaining.
-  if (state->requests.empty() && state->stoppedThreads == numThreads_) {
+void FuseChannel::requestsDrained(
+    folly::Synchronized<State>::LockedPtr state) {
+  state->drained = true;
+  if (state->stoppedThreads == numThreads_) {
     sessionComplete(std::move(state));
+    return;
   }
+
+  // destroy() was called before all of the worker threads were started, and
+  // the last outstanding request has now finished.
+  DCHECK(state->destroyPending);
+  state.unlock();
+  delete this;
 }
 
 void FuseChannel::sessionComplete(folly::Synchronized<State>::LockedPtr state) {
@@ -1289,7 +1708,7 @@ folly::Future<folly::Unit> FuseChannel::fuseRead(
   auto ino = InodeNumber{header->nodeid};
   return dispatcher_->read(ino, read->size, read->offset)
       .thenValue(
-          [](BufVec&& buf) { RequestData::get().sendReply(buf.getIov()); });
+          [](BufVec&& buf) { RequestData::get().sendReply(std::move(buf)); });
 }
 
 folly::Future<folly::Unit> FuseChannel::fuseWrite(
@@ -1501,13 +1920,11 @@ folly::Future<folly::Unit> FuseChannel::fuseOpen(
         fuse_open_out out = {};
         out.open_flags |= FOPEN_KEEP_CACHE;
         out.fh = dispatcher_->getFileHandles().recordHandle(std::move(fh), ino);
-        try {
-          RequestData::get().sendReply(out);
-        } catch (const std::system_error&) {
-          // Was interrupted, tidy up.
-          dispatcher_->getFileHandles().forgetGenericHandle(out.fh);
-          throw;
-        }
+        RequestData::get().sendReply(
+            out, [this, fh = out.fh](const std::system_error&) {
+              // Was interrupted, tidy up.
+              dispatcher_->getFileHandles().forgetGenericHandle(fh);
+            });
       });
 }
 
@@ -1661,13 +2078,11 @@ folly::Future<folly::Unit> FuseChannel::fuseOpenDir(
         fuse_open_out out = {};
         out.fh = dispatcher_->getFileHandles().recordHandle(std::move(dh), ino);
         XLOG(DBG7) << "OPENDIR fh=" << out.fh;
-        try {
-          RequestData::get().sendReply(out);
-        } catch (const std::system_error&) {
-          // Was interrupted, tidy up
-          dispatcher_->getFileHandles().forgetGenericHandle(out.fh);
-          throw;
-        }
+        RequestData::get().sendReply(
+            out, [this, fh = out.fh](const std::system_error&) {
+              // Was interrupted, tidy up
+              dispatcher_->getFileHandles().forgetGenericHandle(fh);
+            });
       });
 }
 
@@ -1679,8 +2094,9 @@ folly::Future<folly::Unit> FuseChannel::fuseReadDir(
   const auto dh = dispatcher_->getDirHandle(read->fh);
   return dh->readdir(DirList(read->size), read->offset)
       .thenValue([](DirList&& list) {
-        const auto buf = list.getBuf();
-        RequestData::get().sendReply(StringPiece(buf));
+        auto owner = std::make_shared<const DirList>(std::move(list));
+        RequestData::get().sendReply(
+            folly::ByteRange(owner->getBuf()), owner);
       });
 }
 
@@ -1741,13 +2157,11 @@ folly::Future<folly::Unit> FuseChannel::fuseCreate(
         vec.push_back(make_iovec(info.entry));
         vec.push_back(make_iovec(out));
 
-        try {
-          RequestData::get().sendReply(std::move(vec));
-        } catch (const std::system_error&) {
-          // Was interrupted, tidy up.
-          dispatcher_->getFileHandles().forgetGenericHandle(out.fh);
-          throw;
-        }
+        RequestData::get().sendReply(
+            std::move(vec), [this, fh = out.fh](const std::system_error&) {
+              // Was interrupted, tidy up.
+              dispatcher_->getFileHandles().forgetGenericHandle(fh);
+            });
       });
 }
 
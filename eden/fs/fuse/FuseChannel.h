@@ -9,21 +9,28 @@
  */
 #pragma once
 #include <folly/File.h>
+#include <folly/Function.h>
 #include <folly/Range.h>
 #include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
 #include <folly/futures/Promise.h>
+#include <folly/lang/Align.h>
 #include <stdlib.h>
+#include <sys/types.h>
 #include <sys/uio.h>
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <iosfwd>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <system_error>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "eden/fs/fuse/BufVec.h"
 #include "eden/fs/fuse/FuseTypes.h"
 #include "eden/fs/utils/PathFuncs.h"
 #include "eden/fs/utils/ProcessAccessLog.h"
@@ -92,13 +99,19 @@ class FuseChannel {
    * The caller is expected to follow up with a call to the
    * initialize() method to perform the handshake with the
    * kernel and set up the thread pool.
+   *
+   * If useIoUring is true and the kernel supports it, the worker threads
+   * read requests and send replies through io_uring rather than with
+   * blocking read() and writev() calls.  Otherwise this falls back to the
+   * blocking loop.
    */
   FuseChannel(
       folly::File&& fuseDevice,
       AbsolutePathPiece mountPath,
       size_t numThreads,
       Dispatcher* const dispatcher,
-      std::shared_ptr<ProcessNameCache> processNameCache);
+      std::shared_ptr<ProcessNameCache> processNameCache,
+      bool useIoUring = false);
 
   /**
    * Destroy the FuseChannel.
@@ -229,6 +242,12 @@ class FuseChannel {
    */
   void replyError(const fuse_in_header& request, int err);
 
+  /**
+   * Called with the error that sendRawReply() would throw when writing a
+   * reply fails.
+   */
+  using ReplyErrorCallback = folly::Function<void(const std::system_error&)>;
+
   /**
    * Sends a raw data packet to the kernel.
    * The data may be scattered across a number of discrete buffers;
@@ -238,9 +257,21 @@ class FuseChannel {
    * to compute the correct value to store into fuse_out_header::len.
    *
    * throws system_error if the write fails.  Writes can fail if the
-   * data we send to the kernel is invalid.
+   * data we send to the kernel is invalid.  onError, if set, is called with
+   * the error first.
+   *
+   * When called from a worker thread running the io_uring loop, the reply
+   * is queued on that thread's ring and written after this returns, so
+   * nothing is thrown; onError is called from the worker thread instead if
+   * the write fails.  The header is copied.  The rest of the iovecs are
+   * submitted as they are if payloadOwner is set, and it is kept alive until
+   * the write completes; otherwise the payload is copied.
    */
-  void sendRawReply(const iovec iov[], size_t count) const;
+  void sendRawReply(
+      const iovec iov[],
+      size_t count,
+      std::shared_ptr<const void> payloadOwner = nullptr,
+      ReplyErrorCallback onError = nullptr) const;
 
   /**
    * Sends a range of contiguous bytes as a reply to the kernel.
@@ -250,20 +281,39 @@ class FuseChannel {
    *
    * throws system_error if the write fails.  Writes can fail if the
    * data we send to the kernel is invalid.
+   *
+   * If owner is set it must keep bytes alive, so that a reply queued on an
+   * io_uring can be submitted without copying them.  onError is called if
+   * the write fails, including when it completes asynchronously.
    */
-  void sendReply(const fuse_in_header& request, folly::ByteRange bytes) const;
+  void sendReply(
+      const fuse_in_header& request,
+      folly::ByteRange bytes,
+      std::shared_ptr<const void> owner = nullptr,
+      ReplyErrorCallback onError = nullptr) const;
+
+  /**
+   * Sends the contents of buf as a reply to the kernel.  buf is kept alive
+   * until the reply has been written, so it is never copied.
+   *
+   * throws system_error if the write fails.  Writes can fail if the
+   * data we send to the kernel is invalid.
+   */
+  void sendReply(const fuse_in_header& request, BufVec&& buf) const;
 
   /**
    * Sends a reply to a kernel request, consisting of multiple parts.
    * The `vec` parameter holds an array of payload components and is moved
    * in to this method which then prepends a fuse_out_header and passes
-   * control along to sendRawReply().
+   * control along to sendRawReply(), along with onError.
    *
    * throws system_error if the write fails.  Writes can fail if the
    * data we send to the kernel is invalid.
    */
-  void sendReply(const fuse_in_header& request, folly::fbvector<iovec>&& vec)
-      const;
+  void sendReply(
+      const fuse_in_header& request,
+      folly::fbvector<iovec>&& vec,
+      ReplyErrorCallback onError = nullptr) const;
 
   /**
    * Sends a reply to the kernel.
@@ -274,11 +324,16 @@ class FuseChannel {
    * data we send to the kernel is invalid.
    */
   template <typename T>
-  void sendReply(const fuse_in_header& request, const T& payload) const {
+  void sendReply(
+      const fuse_in_header& request,
+      const T& payload,
+      ReplyErrorCallback onError = nullptr) const {
     sendReply(
         request,
         folly::ByteRange{reinterpret_cast<const uint8_t*>(&payload),
-                         sizeof(T)});
+                         sizeof(T)},
+        nullptr,
+        std::move(onError));
   }
 
   /**
@@ -307,7 +362,6 @@ class FuseChannel {
    * and therefore requires synchronization.
    */
   struct State {
-    std::unordered_map<uint64_t, std::weak_ptr<folly::RequestContext>> requests;
     std::vector<std::thread> workerThreads;
 
     /*
@@ -329,6 +383,12 @@ class FuseChannel {
      */
     bool destroyPending{false};
 
+    /**
+     * Set once the last outstanding request has finished after the worker
+     * threads stopped.  See outstandingRequests_.
+     */
+    bool drained{false};
+
     /**
      * If the FuseChannel is stopped or stopping, the reason why it is
      * stopping.  This is set to RUNNING while the FuseDevice is initializing
@@ -497,6 +557,22 @@ class FuseChannel {
    */
   void sessionComplete(folly::Synchronized<State>::LockedPtr state);
 
+  /**
+   * Called by whichever thread drops outstandingRequests_ to zero.  This
+   * completes the session, or destroys the FuseChannel if destroy() was
+   * called before all of the worker threads were started.
+   *
+   * Like sessionComplete(), this may destroy the FuseChannel before it
+   * returns.
+   */
+  void requestsDrained(folly::Synchronized<State>::LockedPtr state);
+
+  /**
+   * Release one reference on outstandingRequests_, calling requestsDrained()
+   * if it was the last one.  This may destroy the FuseChannel.
+   */
+  void releaseOutstandingRequest();
+
   static bool isFuseDeviceValid(StopReason reason) {
     // The FuseDevice may still be used if the FuseChannel was stopped due to a
     // takeover request or because the FuseChannel object was destroyed without
@@ -517,6 +593,50 @@ class FuseChannel {
    */
   void processSession();
 
+  /**
+   * The io_uring equivalent of processSession().
+   *
+   * Each thread keeps several reads outstanding on the FUSE device, and
+   * replies sent from the worker thread itself are queued on its ring and
+   * submitted together.  A read on stopEventFd_ wakes the loop when the
+   * session is asked to stop.
+   */
+  void processSessionIoUring();
+
+  /**
+   * Handle the result of reading one request from the FUSE device.
+   * res and error are the return value and errno of the read.
+   *
+   * Returns false if the calling worker thread should stop.
+   */
+  bool handleRead(const char* buf, ssize_t res, int error, pid_t myPid);
+
+  /**
+   * Dispatch a single request that was read from the FUSE device.
+   *
+   * Returns false if the calling worker thread should stop.
+   */
+  bool processRequest(
+      const fuse_in_header* header,
+      const uint8_t* arg,
+      pid_t myPid);
+
+  /**
+   * Reply to a FUSE_GETATTR or FUSE_LOOKUP request from the calling worker
+   * thread if the Dispatcher can answer it without blocking.
+   *
+   * This skips the RequestContext, the RequestData and the future chain that
+   * every other request needs.  Returns false if the request must be
+   * dispatched normally.
+   */
+  bool tryReplyInline(const fuse_in_header* header, const uint8_t* arg);
+
+  /**
+   * Log a failure to write a reply to the FUSE device, and return the error
+   * that sendRawReply() reports for it.
+   */
+  std::system_error replyWriteError(int err) const;
+
   /**
    * Requests that the worker threads terminate their processing loop.
    */
@@ -533,6 +653,18 @@ class FuseChannel {
   Dispatcher* const dispatcher_{nullptr};
   const AbsolutePath mountPath_;
 
+  /*
+   * Whether the worker threads use processSessionIoUring().  This is
+   * decided in the constructor and is constant afterwards.
+   */
+  bool useIoUring_{false};
+
+  /*
+   * An eventfd used to wake worker threads in processSessionIoUring() when
+   * the session is asked to stop.  Only valid if useIoUring_ is true.
+   */
+  folly::File stopEventFd_;
+
   /*
    * connInfo_ is modified during the initialization process,
    * but constant once initialization is complete.
@@ -563,6 +695,31 @@ class FuseChannel {
    */
   std::atomic<bool> stop_{false};
   folly::Synchronized<State> state_;
+
+  /**
+   * The outstanding requests, so that FUSE_INTERRUPT and
+   * getOutstandingRequests() can find them.
+   *
+   * Every request is added and removed here, so the table is sharded by
+   * request ID rather than kept under state_: worker threads starting and
+   * finishing requests rarely contend with each other.
+   */
+  static constexpr size_t kNumRequestShards = 16;
+  using RequestMap =
+      std::unordered_map<uint64_t, std::weak_ptr<folly::RequestContext>>;
+  struct alignas(folly::hardware_destructive_interference_size) RequestShard {
+    folly::Synchronized<RequestMap, std::mutex> requests;
+  };
+  RequestShard& getRequestShard(uint64_t unique);
+  std::array<RequestShard, kNumRequestShards> requestShards_;
+
+  /**
+   * The number of outstanding requests, plus one that is released when the
+   * last worker thread stops (or by destroy(), if the worker threads were
+   * never all started).  Whichever thread releases the last reference calls
+   * requestsDrained().
+   */
+  std::atomic<size_t> outstandingRequests_{1};
   folly::Promise<StopFuture> initPromise_;
   folly::Promise<StopData> sessionCompletePromise_;
 
@@ -112,16 +112,26 @@ class RequestData : public folly::RequestData {
   static void genericErrorHandler(const std::exception& err);
 
   template <typename T>
-  void sendReply(const T& payload) {
-    channel_->sendReply(stealReq(), payload);
+  void sendReply(const T& payload, ReplyErrorCallback onError = nullptr) {
+    channel_->sendReply(stealReq(), payload, std::move(onError));
   }
 
   void sendReply(folly::ByteRange bytes) {
     channel_->sendReply(stealReq(), bytes);
   }
 
-  void sendReply(folly::fbvector<iovec>&& vec) {
-    channel_->sendReply(stealReq(), std::move(vec));
+  void sendReply(folly::ByteRange bytes, std::shared_ptr<const void> owner) {
+    channel_->sendReply(stealReq(), bytes, std::move(owner));
+  }
+
+  void sendReply(BufVec&& buf) {
+    channel_->sendReply(stealReq(), std::move(buf));
+  }
+
+  void sendReply(
+      folly::fbvector<iovec>&& vec,
+      ReplyErrorCallback onError = nullptr) {
+    channel_->sendReply(stealReq(), std::move(vec), std::move(onError));
   }
 
   void sendReply(folly::StringPiece piece) {
@@ -0,0 +1,222 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/*
+ * Measures the cost of dispatching FUSE_GETATTR requests through a
+ * FuseChannel connected to a FakeFuse device, with and without inline
+ * replies, and of answering FUSE_READ requests with blocking writes and
+ * with io_uring.
+ *
+ * Every heap allocation made by the process while requests are in flight is
+ * counted, so the allocations per request include the FakeFuse side of the
+ * exchange; that part is the same for all modes.
+ */
+#include <folly/init/Init.h>
+#include <folly/io/IOBuf.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "eden/fs/fuse/BufVec.h"
+#include "eden/fs/fuse/Dispatcher.h"
+#include "eden/fs/fuse/EdenStats.h"
+#include "eden/fs/fuse/FuseChannel.h"
+#include "eden/fs/testharness/FakeFuse.h"
+#include "eden/fs/utils/ProcessNameCache.h"
+
+using namespace facebook::eden;
+using namespace std::chrono_literals;
+
+DEFINE_uint64(requests, 100000, "Number of FUSE_GETATTR requests to send");
+DEFINE_uint64(threads, 2, "Number of FUSE worker threads");
+DEFINE_uint64(read_size, 64 * 1024, "Number of bytes in each FUSE_READ reply");
+DEFINE_uint64(pipeline, 16, "Number of FUSE_READ requests kept in flight");
+
+DECLARE_bool(fuse_inline_replies);
+
+namespace {
+std::atomic<uint64_t> allocationCount{0};
+} // namespace
+
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (auto* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+/**
+ * Answers every FUSE_GETATTR with the same attributes, either immediately
+ * or through a ready future.
+ */
+class GetattrDispatcher : public Dispatcher {
+ public:
+  using Dispatcher::Dispatcher;
+
+  folly::Future<Attr> getattr(InodeNumber ino) override {
+    return makeAttr(ino);
+  }
+
+  std::optional<Attr> getattrIfReady(InodeNumber ino) override {
+    return makeAttr(ino);
+  }
+
+ private:
+  static Attr makeAttr(InodeNumber ino) {
+    struct stat st = {};
+    st.st_ino = ino.get();
+    st.st_mode = S_IFREG | 0644;
+    st.st_nlink = 1;
+    return Attr{st};
+  }
+};
+
+/**
+ * Answers every FUSE_READ with --read_size bytes.  The buffer is shared
+ * rather than copied, so the reply path is the only place the data can be
+ * copied.
+ */
+class ReadDispatcher : public Dispatcher {
+ public:
+  explicit ReadDispatcher(ThreadLocalEdenStats* stats)
+      : Dispatcher(stats),
+        data_(folly::IOBuf::copyBuffer(std::string(FLAGS_read_size, 'a'))) {}
+
+  folly::Future<BufVec>
+  read(InodeNumber /*ino*/, size_t /*size*/, off_t /*off*/) override {
+    return BufVec(data_->clone());
+  }
+
+ private:
+  std::unique_ptr<folly::IOBuf> data_;
+};
+
+struct RunningChannel {
+  std::unique_ptr<FuseChannel, FuseChannelDeleter> channel;
+  FuseChannel::StopFuture completeFuture;
+};
+
+RunningChannel
+startChannel(FakeFuse& fuse, Dispatcher* dispatcher, bool useIoUring) {
+  std::unique_ptr<FuseChannel, FuseChannelDeleter> channel{new FuseChannel(
+      fuse.start(),
+      AbsolutePath{"/fake/mount/path"},
+      FLAGS_threads,
+      dispatcher,
+      std::make_shared<ProcessNameCache>(),
+      useIoUring)};
+  auto initFuture = channel->initialize();
+  fuse.sendInitRequest();
+  fuse.recvResponse();
+  auto completeFuture = std::move(initFuture).get(10s);
+  return RunningChannel{std::move(channel), std::move(completeFuture)};
+}
+
+void printResult(
+    const char* name,
+    folly::stop_watch<>::duration elapsed,
+    uint64_t allocations) {
+  printf(
+      "%-8s %8.2f us/request, %6.1f allocations/request\n",
+      name,
+      std::chrono::duration<double, std::micro>(elapsed).count() /
+          FLAGS_requests,
+      static_cast<double>(allocations) / FLAGS_requests);
+}
+
+void benchmarkGetattr(const char* name, bool inlineReplies) {
+  FLAGS_fuse_inline_replies = inlineReplies;
+
+  FakeFuse fuse;
+  ThreadLocalEdenStats stats;
+  GetattrDispatcher dispatcher{&stats};
+  auto running = startChannel(fuse, &dispatcher, /*useIoUring=*/false);
+
+  fuse_getattr_in getattrArg = {};
+  auto allocationsBefore = allocationCount.load();
+  folly::stop_watch<> timer;
+  for (uint64_t i = 0; i < FLAGS_requests; ++i) {
+    fuse.sendRequest(FUSE_GETATTR, FUSE_ROOT_ID, getattrArg);
+    fuse.recvResponse();
+  }
+  auto elapsed = timer.elapsed();
+  printResult(name, elapsed, allocationCount.load() - allocationsBefore);
+
+  fuse.close();
+  std::move(running.completeFuture).get(10s);
+}
+
+void benchmarkRead(const char* name, bool useIoUring) {
+  FLAGS_fuse_inline_replies = false;
+
+  FakeFuse fuse;
+  ThreadLocalEdenStats stats;
+  ReadDispatcher dispatcher{&stats};
+  auto running = startChannel(fuse, &dispatcher, useIoUring);
+
+  fuse_read_in readArg = {};
+  readArg.size = FLAGS_read_size;
+  auto allocationsBefore = allocationCount.load();
+  folly::stop_watch<> timer;
+  for (uint64_t sent = 0; sent < FLAGS_requests;) {
+    auto batch = std::min(FLAGS_pipeline, FLAGS_requests - sent);
+    for (uint64_t i = 0; i < batch; ++i) {
+      fuse.sendRequest(FUSE_READ, FUSE_ROOT_ID, readArg);
+    }
+    for (uint64_t i = 0; i < batch; ++i) {
+      fuse.recvResponse();
+    }
+    sent += batch;
+  }
+  auto elapsed = timer.elapsed();
+  printResult(name, elapsed, allocationCount.load() - allocationsBefore);
+
+  fuse.close();
+  std::move(running.completeFuture).get(10s);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  printf(
+      "Sending %" PRIu64 " FUSE_GETATTR requests to %" PRIu64 " threads\n",
+      FLAGS_requests,
+      FLAGS_threads);
+  benchmarkGetattr("futures", false);
+  benchmarkGetattr("inline", true);
+
+  printf(
+      "Sending %" PRIu64 " FUSE_READ requests of %" PRIu64
+      " bytes, %" PRIu64 " at a time\n",
+      FLAGS_requests,
+      FLAGS_read_size,
+      FLAGS_pipeline);
+  benchmarkRead("writev", false);
+  benchmarkRead("io_uring", true);
+  return 0;
+}
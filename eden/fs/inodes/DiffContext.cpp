@@ -31,5 +31,32 @@ const GitIgnoreStack* DiffContext::getToplevelIgnore() const {
   return topLevelIgnores_->getStack();
 }
 
+void DiffContext::setPathFilter(std::unordered_set<RelativePath> paths) {
+  filterPaths_ = std::move(paths);
+  filterParents_.clear();
+  for (const auto& path : filterPaths_) {
+    for (auto parent : path.dirname().allPaths()) {
+      filterParents_.emplace(parent);
+    }
+  }
+}
+
+bool DiffContext::isIncludedByFilter(RelativePathPiece path) const {
+  if (filterPaths_.empty()) {
+    return true;
+  }
+  for (auto parent : path.allPaths()) {
+    if (filterPaths_.count(RelativePath{parent}) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DiffContext::isOnFilterPath(RelativePathPiece path) const {
+  RelativePath key{path};
+  return filterPaths_.count(key) != 0 || filterParents_.count(key) != 0;
+}
+
 } // namespace eden
 } // namespace facebook
@@ -10,6 +10,9 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <unordered_set>
+
+#include "eden/fs/utils/PathFuncs.h"
 
 namespace facebook {
 namespace eden {
@@ -52,8 +55,36 @@ class DiffContext {
 
   const GitIgnoreStack* getToplevelIgnore() const;
 
+  /**
+   * Restrict the diff to the given paths and everything underneath them.
+   *
+   * This is used to bring an earlier diff result up to date when only a few
+   * paths have changed since it was computed.  The directories leading to
+   * each path are still walked so that their ignore files are applied, but
+   * none of their other entries are examined or reported.
+   *
+   * An empty set removes the restriction.  This must be called before the
+   * diff starts.
+   */
+  void setPathFilter(std::unordered_set<RelativePath> paths);
+
+  /**
+   * Returns true if path or one of its parent directories was passed to
+   * setPathFilter(), or if there is no path filter.  Every entry inside such
+   * a directory should be diffed.
+   */
+  bool isIncludedByFilter(RelativePathPiece path) const;
+
+  /**
+   * Returns true if path was passed to setPathFilter() or is a parent
+   * directory of one of those paths.
+   */
+  bool isOnFilterPath(RelativePathPiece path) const;
+
  private:
   std::unique_ptr<TopLevelIgnores> topLevelIgnores_;
+  std::unordered_set<RelativePath> filterPaths_;
+  std::unordered_set<RelativePath> filterParents_;
 };
 } // namespace eden
 } // namespace facebook
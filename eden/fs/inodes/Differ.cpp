@@ -11,13 +11,26 @@
 #include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+#include "eden/fs/inodes/DiffContext.h"
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/InodeDiffCallback.h"
+#include "eden/fs/inodes/ServerState.h"
+#include "eden/fs/inodes/TreeInode.h"
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/TreeEntry.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/fs/utils/PathFuncs.h"
 
+DEFINE_int32(
+    status_cache_max_changed_paths,
+    10000,
+    "Maximum number of paths changed since the previous status request that "
+    "are diffed individually, rather than diffing the entire mount");
+
 namespace facebook {
 namespace eden {
 namespace {
@@ -72,6 +85,162 @@ class ThriftStatusCallback : public InodeDiffCallback {
  private:
   folly::Synchronized<std::map<std::string, ScmFileStatus>> data_;
 };
+
+/**
+ * An InodeDiffCallback that hands the status entries on in chunks, rather
+ * than collecting all of them.
+ */
+class StreamingStatusCallback : public InodeDiffCallback {
+ public:
+  StreamingStatusCallback(
+      size_t chunkSize,
+      std::function<void(ScmStatus&&)> onChunk)
+      : chunkSize_{std::max<size_t>(chunkSize, 1)},
+        onChunk_{std::move(onChunk)} {}
+
+  void ignoredFile(RelativePathPiece path) override {
+    addEntry(path, ScmFileStatus::IGNORED);
+  }
+
+  void untrackedFile(RelativePathPiece path) override {
+    addEntry(path, ScmFileStatus::ADDED);
+  }
+
+  void removedFile(
+      RelativePathPiece path,
+      const TreeEntry& /* sourceControlEntry */) override {
+    addEntry(path, ScmFileStatus::REMOVED);
+  }
+
+  void modifiedFile(
+      RelativePathPiece path,
+      const TreeEntry& /* sourceControlEntry */) override {
+    addEntry(path, ScmFileStatus::MODIFIED);
+  }
+
+  void diffError(RelativePathPiece path, const folly::exception_wrapper& ew)
+      override {
+    XLOG(WARNING) << "error computing status data for " << path << ": "
+                  << folly::exceptionStr(ew);
+  }
+
+  /**
+   * Deliver any entries that have not been delivered yet.  This should be
+   * called once the diff operation has completed.
+   */
+  void flush() {
+    auto chunk = chunk_.lock();
+    if (!chunk->entries.empty()) {
+      onChunk_(std::move(*chunk));
+      chunk->entries.clear();
+    }
+  }
+
+ private:
+  void addEntry(RelativePathPiece path, ScmFileStatus status) {
+    // The chunk is handed on with the lock held so that onChunk_ is only
+    // called by one thread at a time.
+    auto chunk = chunk_.lock();
+    chunk->entries.emplace(path.stringPiece().str(), status);
+    if (chunk->entries.size() >= chunkSize_) {
+      onChunk_(std::move(*chunk));
+      chunk->entries.clear();
+    }
+  }
+
+  const size_t chunkSize_;
+  const std::function<void(ScmStatus&&)> onChunk_;
+  folly::Synchronized<ScmStatus, std::mutex> chunk_;
+};
+
+/**
+ * Collect the paths recorded in the journal after sequence number since.
+ *
+ * Returns std::nullopt if a cached status cannot be brought up to date by
+ * diffing just these paths: the commit changed, the journal no longer covers
+ * the whole range, or too many paths changed.
+ */
+std::optional<std::unordered_set<RelativePath>> getChangedPathsSince(
+    const JournalDeltaPtr& latest,
+    JournalDelta::SequenceNumber since) {
+  static const PathComponentPiece kIgnoreFilename{".gitignore"};
+  const auto maxPaths =
+      static_cast<size_t>(FLAGS_status_cache_max_changed_paths);
+
+  std::unordered_set<RelativePath> paths;
+  const JournalDelta* delta = latest.get();
+  auto nextSequence = delta ? delta->toSequence : 0;
+  while (nextSequence > since) {
+    if (!delta || delta->toSequence != nextSequence ||
+        delta->fromSequence <= since) {
+      // The deltas we need were merged or dropped from the journal.
+      return std::nullopt;
+    }
+    if (delta->fromHash != delta->toHash || !delta->uncleanPaths.empty()) {
+      return std::nullopt;
+    }
+    for (const auto& entry : delta->changedFilesInOverlay) {
+      const auto& path = entry.first;
+      if (path.basename() == kIgnoreFilename) {
+        // A changed ignore file can affect everything in its directory.
+        paths.emplace(path.dirname());
+      } else {
+        paths.insert(path);
+      }
+    }
+    if (paths.size() > maxPaths) {
+      return std::nullopt;
+    }
+    nextSequence = delta->fromSequence - 1;
+    delta = delta->previous.get();
+  }
+
+  // Diffing the root directory is the same as diffing everything.
+  if (paths.count(RelativePath{}) != 0) {
+    return std::nullopt;
+  }
+  return paths;
+}
+
+/**
+ * Copy the entries of an earlier status result that lie outside of the
+ * re-diffed paths into status.
+ */
+void addUnchangedEntries(
+    const CachedScmStatus& cached,
+    const std::unordered_set<RelativePath>& changedPaths,
+    ScmStatus& status) {
+  for (const auto& entry : cached.entries) {
+    bool changed = false;
+    for (auto parent : RelativePathPiece{entry.first}.paths()) {
+      if (changedPaths.count(RelativePath{parent}) != 0) {
+        changed = true;
+        break;
+      }
+    }
+    if (!changed) {
+      status.entries.emplace(entry.first, entry.second);
+    }
+  }
+}
+
+/**
+ * Replace the mount's cached status with newStatus, unless the cache already
+ * holds a more recent result for the same request.
+ */
+void updateStatusCache(
+    const EdenMount* mount,
+    std::shared_ptr<const CachedScmStatus> newStatus) {
+  auto cache = mount->getStatusCache().wlock();
+  const auto& current = *cache;
+  if (current && current->commitHash == newStatus->commitHash &&
+      current->listIgnored == newStatus->listIgnored &&
+      current->topLevelIgnoresVersion == newStatus->topLevelIgnoresVersion &&
+      current->sequence > newStatus->sequence) {
+    return;
+  }
+  *cache = std::move(newStatus);
+}
 } // unnamed namespace
 
 char scmStatusCodeChar(ScmFileStatus code) {
@@ -101,13 +270,89 @@ std::ostream& operator<<(std::ostream& os, const ScmStatus& status) {
 
 folly::Future<std::unique_ptr<ScmStatus>>
 diffMountForStatus(const EdenMount* mount, Hash commitHash, bool listIgnored) {
+  auto* stats = mount->getStats()->get();
   auto callback = std::make_unique<ThriftStatusCallback>();
-  auto callbackPtr = callback.get();
-  return mount->diff(callbackPtr, commitHash, listIgnored)
-      .thenValue([callback = std::move(callback)](auto&&) {
-        return std::make_unique<ScmStatus>(callback->extractStatus());
+  // Creating the DiffContext reloads the top-level ignore files if they have
+  // changed, so this must happen before we check their version.
+  auto context = mount->createDiffContext(callback.get(), listIgnored);
+  auto ignoresVersion = mount->getServerState()->getTopLevelIgnoresVersion();
+
+  // Record the journal position before looking at any inodes.  Changes made
+  // while the diff is running may or may not be reflected in its result, so
+  // they will be diffed again by the next request.
+  auto latest = mount->getJournal().getLatest();
+  auto sequence = latest ? latest->toSequence : 0;
+
+  auto cached = *mount->getStatusCache().rlock();
+  std::optional<std::unordered_set<RelativePath>> changedPaths;
+  if (cached && cached->commitHash == commitHash &&
+      cached->listIgnored == listIgnored &&
+      cached->topLevelIgnoresVersion == ignoresVersion) {
+    if (cached->sequence == sequence) {
+      stats->statusCacheHit.incrementValue();
+      auto status = std::make_unique<ScmStatus>();
+      status->entries = cached->entries;
+      return folly::makeFuture(std::move(status));
+    }
+    changedPaths = getChangedPathsSince(latest, cached->sequence);
+  }
+
+  if (changedPaths) {
+    XLOG(DBG4) << "status: diffing " << changedPaths->size()
+               << " changed paths in " << mount->getPath();
+    stats->statusCachePartial.incrementValue();
+    context->setPathFilter(*changedPaths);
+  } else {
+    stats->statusCacheFull.incrementValue();
+    cached.reset();
+  }
+
+  auto* contextPtr = context.get();
+  return mount->diff(contextPtr, commitHash)
+      .thenValue([mount,
+                  // Holding the root inode keeps the mount alive.
+                  rootInode = mount->getRootInode(),
+                  commitHash,
+                  listIgnored,
+                  sequence,
+                  ignoresVersion,
+                  callback = std::move(callback),
+                  context = std::move(context),
+                  cached = std::move(cached),
+                  changedPaths = std::move(changedPaths)](auto&&) {
+        auto status = callback->extractStatus();
+        if (cached) {
+          addUnchangedEntries(*cached, *changedPaths, status);
+        }
+
+        auto newCached = std::make_shared<CachedScmStatus>();
+        newCached->commitHash = commitHash;
+        newCached->listIgnored = listIgnored;
+        newCached->sequence = sequence;
+        newCached->topLevelIgnoresVersion = ignoresVersion;
+        newCached->entries = status.entries;
+        updateStatusCache(mount, std::move(newCached));
+
+        return std::make_unique<ScmStatus>(std::move(status));
       });
 }
 
+folly::Future<folly::Unit> streamMountStatus(
+    const EdenMount* mount,
+    Hash commitHash,
+    bool listIgnored,
+    size_t chunkSize,
+    std::function<void(ScmStatus&&)> onChunk) {
+  auto callback =
+      std::make_unique<StreamingStatusCallback>(chunkSize, std::move(onChunk));
+  auto context = mount->createDiffContext(callback.get(), listIgnored);
+  auto* contextPtr = context.get();
+  // Holding the root inode keeps the mount alive until the diff completes.
+  return mount->diff(contextPtr, commitHash)
+      .thenValue([rootInode = mount->getRootInode(),
+                  callback = std::move(callback),
+                  context = std::move(context)](auto&&) { callback->flush(); });
+}
+
 } // namespace eden
 } // namespace facebook
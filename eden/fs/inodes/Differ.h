@@ -8,14 +8,18 @@
  *
  */
 #pragma once
+#include <functional>
 #include <iosfwd>
+#include <map>
+#include "eden/fs/journal/JournalDelta.h"
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/service/gen-cpp2/EdenService.h"
 
 namespace folly {
 template <typename T>
 class Future;
-}
+struct Unit;
+} // namespace folly
 
 namespace facebook {
 namespace eden {
@@ -30,8 +34,45 @@ char scmStatusCodeChar(ScmFileStatus code);
 
 std::ostream& operator<<(std::ostream& os, const ScmStatus& status);
 
+/**
+ * A status result remembered by diffMountForStatus().  It describes the
+ * working directory as of the given journal sequence number.
+ */
+struct CachedScmStatus {
+  Hash commitHash;
+  bool listIgnored;
+  JournalDelta::SequenceNumber sequence;
+  /** ServerState::getTopLevelIgnoresVersion() when this was computed. */
+  size_t topLevelIgnoresVersion;
+  std::map<std::string, ScmFileStatus> entries;
+};
+
+/**
+ * Compute the status of the working directory relative to commitHash.
+ *
+ * The result is cached on the mount.  If the journal shows that nothing has
+ * changed since the cached result was computed it is returned directly, and
+ * if only a few paths have changed just those paths are diffed again.
+ */
 folly::Future<std::unique_ptr<ScmStatus>>
 diffMountForStatus(const EdenMount* mount, Hash commitHash, bool listIgnored);
 
+/**
+ * Compute the status of the working directory relative to commitHash, like
+ * diffMountForStatus(), but hand the entries to onChunk in groups of about
+ * chunkSize as the diff finds them instead of returning them all at the end.
+ * onChunk is only called by one thread at a time, and the returned Future
+ * completes once the last group has been delivered.
+ *
+ * This always diffs the entire mount, and neither uses nor updates the cached
+ * status: keeping the complete result is what streaming is meant to avoid.
+ */
+folly::Future<folly::Unit> streamMountStatus(
+    const EdenMount* mount,
+    Hash commitHash,
+    bool listIgnored,
+    size_t chunkSize,
+    std::function<void(ScmStatus&&)> onChunk);
+
 } // namespace eden
 } // namespace facebook
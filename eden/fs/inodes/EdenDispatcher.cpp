@@ -26,6 +26,7 @@
 #include "eden/fs/inodes/InodeMap.h"
 #include "eden/fs/inodes/Overlay.h"
 #include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/inodes/TreePrefetcher.h"
 #include "eden/fs/utils/SystemError.h"
 
 using namespace folly;
@@ -80,13 +81,29 @@ folly::Future<Dispatcher::Attr> EdenDispatcher::getattr(InodeNumber ino) {
       [](const InodePtr& inode) { return inode->getattr(); });
 }
 
+std::optional<Dispatcher::Attr> EdenDispatcher::getattrIfReady(
+    InodeNumber ino) {
+  auto inode = inodeMap_->lookupLoadedInode(ino);
+  if (!inode) {
+    return std::nullopt;
+  }
+  auto attr = inode->getattrIfReady();
+  if (attr) {
+    FB_LOGF(mount_->getStraceLogger(), DBG7, "getattr({})", ino);
+  }
+  return attr;
+}
+
 folly::Future<std::shared_ptr<DirHandle>> EdenDispatcher::opendir(
     InodeNumber ino,
     int flags) {
   FB_LOGF(
       mount_->getStraceLogger(), DBG7, "opendir({}, flags={:x})", ino, flags);
   return inodeMap_->lookupTreeInode(ino).thenValue(
-      [](const TreeInodePtr& inode) { return inode->opendir(); });
+      [this](const TreeInodePtr& inode) {
+        mount_->getTreePrefetcher()->recordOpendir(inode);
+        return inode->opendir();
+      });
 }
 
 folly::Future<fuse_entry_out> EdenDispatcher::lookup(
@@ -94,7 +111,9 @@ folly::Future<fuse_entry_out> EdenDispatcher::lookup(
     PathComponentPiece namepiece) {
   FB_LOGF(mount_->getStraceLogger(), DBG7, "lookup({}, {})", parent, namepiece);
   return inodeMap_->lookupTreeInode(parent)
-      .thenValue([name = PathComponent(namepiece)](const TreeInodePtr& tree) {
+      .thenValue([this, name = PathComponent(namepiece)](
+                     const TreeInodePtr& tree) {
+        mount_->getTreePrefetcher()->recordLookup(tree);
         return tree->getOrLoadChild(name);
       })
       .thenValue([](const InodePtr& inode) {
@@ -145,6 +164,36 @@ folly::Future<fuse_entry_out> EdenDispatcher::lookup(
       });
 }
 
+std::optional<fuse_entry_out> EdenDispatcher::lookupIfReady(
+    InodeNumber parent,
+    PathComponentPiece name) {
+  // TreeInode::getOrLoadChild() resolves .eden in subdirectories to a
+  // symlink, and getattr failures need lookup()'s special handling, so leave
+  // both to lookup().
+  if (name == kDotEdenName) {
+    return std::nullopt;
+  }
+  auto tree = inodeMap_->lookupLoadedInode(parent).asTreePtrOrNull();
+  if (!tree) {
+    return std::nullopt;
+  }
+  auto inode = tree->getLoadedChild(name);
+  if (!inode) {
+    return std::nullopt;
+  }
+  auto attr = inode->getattrIfReady();
+  if (!attr) {
+    return std::nullopt;
+  }
+
+  FB_LOGF(mount_->getStraceLogger(), DBG7, "lookup({}, {})", parent, name);
+  mount_->getTreePrefetcher()->recordLookup(tree);
+  // Preserve inode's life for the duration of the prefetch.
+  inode->prefetch().ensure([inode] {});
+  inode->incFuseRefcount();
+  return computeEntryParam(inode->getNodeId(), *attr);
+}
+
 folly::Future<Dispatcher::Attr> EdenDispatcher::setattr(
     InodeNumber ino,
     const fuse_setattr_in& attr) {
@@ -32,6 +32,7 @@ class EdenDispatcher : public Dispatcher {
   explicit EdenDispatcher(EdenMount* mount);
 
   folly::Future<Attr> getattr(InodeNumber ino) override;
+  std::optional<Attr> getattrIfReady(InodeNumber ino) override;
   folly::Future<Attr> setattr(InodeNumber ino, const fuse_setattr_in& attr)
       override;
   folly::Future<std::shared_ptr<DirHandle>> opendir(InodeNumber ino, int flags)
@@ -39,6 +40,9 @@ class EdenDispatcher : public Dispatcher {
   folly::Future<fuse_entry_out> lookup(
       InodeNumber parent,
       PathComponentPiece name) override;
+  std::optional<fuse_entry_out> lookupIfReady(
+      InodeNumber parent,
+      PathComponentPiece name) override;
 
   void forget(InodeNumber ino, unsigned long nlookup) override;
   folly::Future<std::shared_ptr<FileHandle>> open(InodeNumber ino, int flags)
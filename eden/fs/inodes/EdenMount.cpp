@@ -39,6 +39,7 @@
 #include "eden/fs/inodes/ServerState.h"
 #include "eden/fs/inodes/TopLevelIgnores.h"
 #include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/inodes/TreePrefetcher.h"
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/git/GitIgnoreStack.h"
@@ -62,6 +63,10 @@ using std::vector;
 using std::chrono::system_clock;
 
 DEFINE_int32(fuseNumThreads, 16, "how many fuse dispatcher threads to spawn");
+DEFINE_bool(
+    fuse_use_io_uring,
+    false,
+    "Use io_uring for FUSE device I/O when the kernel supports it");
 
 namespace facebook {
 namespace eden {
@@ -192,6 +197,7 @@ EdenMount::EdenMount(
       blobCache_{std::move(blobCache)},
       blobAccess_{objectStore_, blobCache_},
       overlay_(std::make_unique<Overlay>(config_->getOverlayPath())),
+      treePrefetcher_(std::make_unique<TreePrefetcher>(this)),
       bindMounts_(config_->getBindMounts()),
       mountGeneration_(globalProcessGeneration | ++mountGeneration),
       straceLogger_{kEdenStracePrefix.str() + config_->getMountPath().value()},
@@ -200,7 +206,8 @@ EdenMount::EdenMount(
       clock_(serverState_->getClock()) {}
 
 folly::Future<folly::Unit> EdenMount::initialize(
-    const std::optional<SerializedInodeMap>& takeover) {
+    const std::optional<SerializedInodeMap>& takeover,
+    folly::File inodeTable) {
   auto parents = std::make_shared<ParentCommits>(config_->getParentCommits());
   parentInfo_.wlock()->parents.setParents(*parents);
 
@@ -221,10 +228,19 @@ folly::Future<folly::Unit> EdenMount::initialize(
 
   CHECK(overlay_->hasInitializedNextInodeNumber());
 
+  // Map the inode table now; the file itself can be closed once mapped.
+  std::unique_ptr<CompactInodeMap> compactInodeMap;
+  if (inodeTable) {
+    compactInodeMap = std::make_unique<CompactInodeMap>(inodeTable);
+    inodeTable.close();
+  }
+
   return createRootInode(*parents).thenValue(
-      [this, parents, takeover](TreeInodePtr initTreeNode) {
+      [this, parents, takeover, compactInodeMap = std::move(compactInodeMap)](
+          TreeInodePtr initTreeNode) mutable {
         if (takeover) {
-          inodeMap_->initializeFromTakeover(std::move(initTreeNode), *takeover);
+          inodeMap_->initializeFromTakeover(
+              std::move(initTreeNode), *takeover, std::move(compactInodeMap));
         } else {
           inodeMap_->initialize(std::move(initTreeNode));
         }
@@ -235,6 +251,7 @@ folly::Future<folly::Unit> EdenMount::initialize(
         auto delta = std::make_unique<JournalDelta>();
         delta->toHash = parents->parent1();
         journal_.addDelta(std::move(delta));
+
         return setupDotEden(getRootInode());
       });
 }
@@ -390,7 +407,7 @@ void EdenMount::destroy() {
               << " in unexpected state " << static_cast<uint32_t>(oldState);
 }
 
-Future<std::tuple<SerializedFileHandleMap, SerializedInodeMap>>
+Future<std::tuple<SerializedFileHandleMap, SerializedInodeMap, folly::File>>
 EdenMount::shutdown(bool doTakeover, bool allowFuseNotStarted) {
   // shutdown() should only be called on mounts that have not yet reached
   // SHUTTING_DOWN or later states.  Confirm this is the case, and move to
@@ -406,7 +423,7 @@ EdenMount::shutdown(bool doTakeover, bool allowFuseNotStarted) {
   return shutdownImpl(doTakeover);
 }
 
-Future<std::tuple<SerializedFileHandleMap, SerializedInodeMap>>
+Future<std::tuple<SerializedFileHandleMap, SerializedInodeMap, folly::File>>
 EdenMount::shutdownImpl(bool doTakeover) {
   journal_.cancelAllSubscribers();
   XLOG(DBG1) << "beginning shutdown for EdenMount " << getPath();
@@ -420,7 +437,7 @@ EdenMount::shutdownImpl(bool doTakeover) {
 
   return inodeMap_->shutdown(doTakeover)
       .thenValue([this, fileHandleMap = std::move(fileHandleMap)](
-                     SerializedInodeMap inodeMap) {
+                     std::tuple<SerializedInodeMap, folly::File> inodeMap) {
         XLOG(DBG1) << "shutdown complete for EdenMount " << getPath();
         // Close the Overlay object to make sure we have released its lock.
         // This is important during graceful restart to ensure that we have
@@ -428,7 +445,10 @@ EdenMount::shutdownImpl(bool doTakeover) {
         // the mount point.
         overlay_->close();
         state_.store(State::SHUT_DOWN);
-        return std::make_tuple(fileHandleMap, inodeMap);
+        return std::make_tuple(
+            fileHandleMap,
+            std::move(std::get<0>(inodeMap)),
+            std::move(std::get<1>(inodeMap)));
       });
 }
 const shared_ptr<UnboundedQueueExecutor>& EdenMount::getThreadPool() const {
@@ -824,7 +844,8 @@ void EdenMount::createFuseChannel(folly::File fuseDevice) {
       getPath(),
       FLAGS_fuseNumThreads,
       dispatcher_.get(),
-      serverState_->getProcessNameCache()));
+      serverState_->getProcessNameCache(),
+      FLAGS_fuse_use_io_uring));
 }
 
 void EdenMount::fuseInitSuccessful(
@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include <folly/File.h>
 #include <folly/Portability.h>
 #include <folly/SharedMutex.h>
 #include <folly/Synchronized.h>
@@ -45,6 +46,7 @@ namespace eden {
 
 class BindMount;
 class BlobCache;
+struct CachedScmStatus;
 class CheckoutConflict;
 class ClientConfig;
 class Clock;
@@ -62,6 +64,7 @@ class ObjectStore;
 class Overlay;
 class ServerState;
 class Tree;
+class TreePrefetcher;
 class UnboundedQueueExecutor;
 
 class RenameLock;
@@ -118,10 +121,12 @@ class EdenMount {
   /**
    * Asynchronous EdenMount initialization - post instantiation.
    *
-   * If takeover data is specified, it is used to initialize the inode map.
+   * If takeover data is specified, it is used to initialize the inode map,
+   * along with inodeTable if the previous process sent a CompactInodeMap.
    */
   FOLLY_NODISCARD folly::Future<folly::Unit> initialize(
-      const std::optional<SerializedInodeMap>& takeover = std::nullopt);
+      const std::optional<SerializedInodeMap>& takeover = std::nullopt,
+      folly::File inodeTable = folly::File{});
 
   /**
    * Destroy the EdenMount.
@@ -148,14 +153,16 @@ class EdenMount {
    * for all outstanding InodeBase objects to become unreferenced and be
    * destroyed.
    *
-   * If doTakeover is true, this function will return populated
-   * SerializedFileHandleMap and SerializedInodeMap instances generated by
-   * calling FileHandleMap::serializeMap() and InodeMap::shutdown.
+   * If doTakeover is true, this function will return the
+   * SerializedFileHandleMap generated by FileHandleMap::serializeMap() and
+   * the unloaded inode data generated by InodeMap::shutdown(), which is
+   * either a SerializedInodeMap or a file containing a CompactInodeMap.
    *
    * If doTakeover is false, this function will return default-constructed
-   * SerializedFileHandleMap and SerializedInodeMap instances.
+   * values.
    */
-  folly::Future<std::tuple<SerializedFileHandleMap, SerializedInodeMap>>
+  folly::Future<
+      std::tuple<SerializedFileHandleMap, SerializedInodeMap, folly::File>>
   shutdown(bool doTakeover, bool allowFuseNotStarted = false);
 
   /**
@@ -196,6 +203,13 @@ class EdenMount {
     return objectStore_.get();
   }
 
+  /**
+   * Return the ServerState shared by all of the mounts in this process.
+   */
+  const std::shared_ptr<ServerState>& getServerState() const {
+    return serverState_;
+  }
+
   /**
    * Return Eden's blob cache.
    *
@@ -237,10 +251,30 @@ class EdenMount {
 
   InodeMetadataTable* getInodeMetadataTable() const;
 
+  /**
+   * Return the TreePrefetcher for this mount.
+   */
+  TreePrefetcher* getTreePrefetcher() const {
+    return treePrefetcher_.get();
+  }
+
   Journal& getJournal() {
     return journal_;
   }
 
+  const Journal& getJournal() const {
+    return journal_;
+  }
+
+  /**
+   * The most recent result of diffMountForStatus(), which is used to answer
+   * later status requests without diffing the whole mount again.
+   */
+  folly::Synchronized<std::shared_ptr<const CachedScmStatus>>&
+  getStatusCache() const {
+    return statusCache_;
+  }
+
   uint64_t getMountGeneration() const {
     return mountGeneration_;
   }
@@ -584,7 +618,8 @@ class EdenMount {
   folly::Future<TreeInodePtr> createRootInode(
       const ParentCommits& parentCommits);
   FOLLY_NODISCARD folly::Future<folly::Unit> setupDotEden(TreeInodePtr root);
-  folly::Future<std::tuple<SerializedFileHandleMap, SerializedInodeMap>>
+  folly::Future<
+      std::tuple<SerializedFileHandleMap, SerializedInodeMap, folly::File>>
   shutdownImpl(bool doTakeover);
 
   std::unique_ptr<DiffContext> createDiffContext(
@@ -639,6 +674,7 @@ class EdenMount {
   std::shared_ptr<BlobCache> blobCache_;
   BlobAccess blobAccess_;
   std::unique_ptr<Overlay> overlay_;
+  std::unique_ptr<TreePrefetcher> treePrefetcher_;
   InodeNumber dotEdenInodeNumber_{};
 
   /**
@@ -667,6 +703,9 @@ class EdenMount {
 
   Journal journal_;
 
+  mutable folly::Synchronized<std::shared_ptr<const CachedScmStatus>>
+      statusCache_;
+
   /**
    * A number to uniquely identify this particular incarnation of this mount.
    * We use bits from the process id and the time at which we were mounted.
@@ -21,14 +21,17 @@
 #include "eden/fs/inodes/InodeTable.h"
 #include "eden/fs/inodes/Overlay.h"
 #include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/inodes/TreePrefetcher.h"
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/store/BlobAccess.h"
 #include "eden/fs/store/BlobMetadata.h"
 #include "eden/fs/store/ObjectStore.h"
+#include "eden/fs/store/StoreStats.h"
 #include "eden/fs/utils/Bug.h"
 #include "eden/fs/utils/Clock.h"
 #include "eden/fs/utils/DirType.h"
+#include "eden/fs/utils/ProcessFetchLog.h"
 #include "eden/fs/utils/UnboundedQueueExecutor.h"
 #include "eden/fs/utils/XAttr.h"
 
@@ -558,6 +561,48 @@ folly::Future<Dispatcher::Attr> FileInode::getattr() {
       [](const struct stat& st) { return Dispatcher::Attr{st}; });
 }
 
+std::optional<Dispatcher::Attr> FileInode::getattrIfReady() {
+  auto st = getMount()->initStatData();
+  st.st_nlink = 1;
+  st.st_ino = getNodeId().get();
+
+  auto state = LockedState{this};
+
+  getMetadataLocked(*state).applyToStat(st);
+
+  switch (state->tag) {
+    case State::BLOB_NOT_LOADING:
+    case State::BLOB_LOADING: {
+      CHECK(state->hash.has_value());
+      auto metadata = getObjectStore()->getCachedBlobMetadata(*state->hash);
+      if (!metadata) {
+        return std::nullopt;
+      }
+      getMount()->getTreePrefetcher()->recordFetch(*state->hash);
+      st.st_size = metadata->size;
+      break;
+    }
+
+    case State::MATERIALIZED_IN_OVERLAY: {
+      // Opening the overlay file is left to getattr().
+      if (!state->isFileOpen()) {
+        return std::nullopt;
+      }
+      struct stat overlayStat;
+      checkUnixError(fstat(state->file.fd(), &overlayStat));
+      if (overlayStat.st_size < static_cast<off_t>(Overlay::kHeaderLength)) {
+        // Let getattr() report the corrupt overlay file.
+        return std::nullopt;
+      }
+      st.st_size = overlayStat.st_size - Overlay::kHeaderLength;
+      break;
+    }
+  }
+
+  updateBlockCount(st);
+  return Dispatcher::Attr{st};
+}
+
 folly::Future<Dispatcher::Attr> FileInode::setattr(
     const fuse_setattr_in& attr) {
   // If this file is inside of .eden it cannot be reparented, so getParentRacy()
@@ -807,6 +852,7 @@ folly::Future<struct stat> FileInode::stat() {
       // look up the size. This is especially a win after restarting Eden -
       // metadata can be loaded from the local cache more cheaply than
       // deserializing an entire blob.
+      getMount()->getTreePrefetcher()->recordFetch(*state->hash);
       return getObjectStore()
           ->getBlobMetadata(*state->hash)
           .thenValue([st](const BlobMetadata& metadata) mutable {
@@ -909,7 +955,114 @@ Future<string> FileInode::readAll(CacheHint cacheHint) {
       });
 }
 
+namespace {
+BufVec readBlobRange(const Blob& blob, size_t size, off_t off) {
+  auto buf = blob.getContents();
+  folly::io::Cursor cursor(&buf);
+
+  if (!cursor.canAdvance(off)) {
+    // Seek beyond EOF.  Return an empty result.
+    return BufVec{folly::IOBuf::wrapBuffer("", 0)};
+  }
+
+  cursor.skip(off);
+
+  std::unique_ptr<folly::IOBuf> result;
+  cursor.cloneAtMost(result, size);
+
+  return BufVec{std::move(result)};
+}
+
+BufVec preadOverlayFile(int fd, size_t size, off_t off) {
+  auto buf = folly::IOBuf::createCombined(size);
+  auto res =
+      ::pread(fd, buf->writableBuffer(), size, off + Overlay::kHeaderLength);
+
+  checkUnixError(res);
+  buf->append(res);
+  return BufVec{std::move(buf)};
+}
+} // namespace
+
+std::optional<BufVec> FileInode::tryReadShared(size_t size, off_t off) {
+  auto state = state_.rlock();
+  switch (state->tag) {
+    case State::MATERIALIZED_IN_OVERLAY: {
+      // Opening the overlay file modifies the state, so leave that to the
+      // exclusive path.  The file cannot be closed while we hold the lock.
+      if (!state->isFileOpen()) {
+        return std::nullopt;
+      }
+      auto result = preadOverlayFile(state->file.fd(), size, off);
+      updateAtimeShared(*state);
+      return result;
+    }
+
+    case State::BLOB_NOT_LOADING: {
+      auto blob = state->interestHandle.getBlobNoWait();
+      if (!blob) {
+        return std::nullopt;
+      }
+      updateAtimeShared(*state);
+      // The blob is immutable, so copying out of it needs no lock.
+      state.unlock();
+      auto result = readBlobRange(*blob, size, off);
+      if (recordBlobRead(*blob, off, size)) {
+        releaseBlobInterestLocked(*LockedState{this}, *blob);
+      }
+      return result;
+    }
+
+    case State::BLOB_LOADING:
+      break;
+  }
+  return std::nullopt;
+}
+
+bool FileInode::recordBlobRead(const Blob& blob, off_t off, size_t size) {
+  auto blobSize = blob.getSize();
+  auto begin = std::min(static_cast<size_t>(off), blobSize);
+  auto end = begin + std::min(size, blobSize - begin);
+  // Only a read that starts within the prefix read so far extends it.  Reads
+  // that leave a gap are ignored, so a file read out of order keeps its blob
+  // until the inode unloads, as it did before.
+  auto highWater = readHighWater_.load(std::memory_order_relaxed);
+  while (begin <= highWater && end > highWater) {
+    if (readHighWater_.compare_exchange_weak(
+            highWater, end, std::memory_order_relaxed)) {
+      // Only the reader that reaches the end reports it.
+      return end == blobSize;
+    }
+  }
+  return false;
+}
+
+void FileInode::releaseBlobInterestLocked(State& state, const Blob& blob) {
+  readHighWater_.store(0, std::memory_order_relaxed);
+  // The inode may have been materialized, or may have dropped and reloaded
+  // the blob, since the read.
+  if (state.tag != State::BLOB_NOT_LOADING || state.hash != blob.getHash() ||
+      !state.interestHandle.isValid()) {
+    return;
+  }
+  // Demote rather than evict the blob: it stays readable, by us and by
+  // readers still copying out of it, until the BlobCache needs the space.
+  state.interestHandle.demote();
+  auto& stats = getStoreStats();
+  stats->blobCacheEarlyRelease.incrementValue();
+  stats->blobCacheEarlyReleaseBytes.incrementValue(blob.getSize());
+}
+
 Future<BufVec> FileInode::read(size_t size, off_t off) {
+  try {
+    if (auto result = tryReadShared(size, off)) {
+      return std::move(*result);
+    }
+  } catch (const std::exception& ex) {
+    return makeFuture<BufVec>(
+        folly::exception_wrapper{std::current_exception(), ex});
+  }
+
   return runWhileDataLoaded<Future<BufVec>>(
       LockedState{this},
       BlobCache::Interest::WantHandle,
@@ -920,42 +1073,21 @@ Future<BufVec> FileInode::read(size_t size, off_t off) {
           self->updateAtimeLocked(*state);
         };
 
-        // TODO: if blob, add [size, off] to coverage set and if coverage is
-        // full, drop interest.
-
         // Materialized either before or during blob load.
         if (state->tag == State::MATERIALIZED_IN_OVERLAY) {
           state.ensureFileOpen(self.get());
-          auto buf = folly::IOBuf::createCombined(size);
-          auto res = ::pread(
-              state->file.fd(),
-              buf->writableBuffer(),
-              size,
-              off + Overlay::kHeaderLength);
-
-          checkUnixError(res);
-          buf->append(res);
-          return BufVec{std::move(buf)};
+          return preadOverlayFile(state->file.fd(), size, off);
         }
 
         // runWhileDataLoaded() ensures that the state is either
         // MATERIALIZED_IN_OVERLAY or BLOB_NOT_LOADING
         DCHECK_EQ(state->tag, State::BLOB_NOT_LOADING);
         DCHECK(blob) << "blob missing after load completed";
-        auto buf = blob->getContents();
-        folly::io::Cursor cursor(&buf);
-
-        if (!cursor.canAdvance(off)) {
-          // Seek beyond EOF.  Return an empty result.
-          return BufVec{folly::IOBuf::wrapBuffer("", 0)};
+        auto result = readBlobRange(*blob, size, off);
+        if (self->recordBlobRead(*blob, off, size)) {
+          self->releaseBlobInterestLocked(*state, *blob);
         }
-
-        cursor.skip(off);
-
-        std::unique_ptr<folly::IOBuf> result;
-        cursor.cloneAtMost(result, size);
-
-        return BufVec{std::move(result)};
+        return result;
       });
 }
 
@@ -1109,6 +1241,7 @@ void FileInode::materializeNow(
   auto file = getMount()->getOverlay()->createOverlayFile(
       getNodeId(), blob->getContents());
   state.setMaterialized(std::move(file));
+  getProcessFetchLog().recordMaterialization();
 
   // If we have a SHA-1 from the metadata, apply it to the new file.  This
   // saves us from recomputing it again in the case that something opens the
@@ -1130,6 +1263,7 @@ void FileInode::materializeAndTruncate(LockedState& state) {
   auto file =
       getMount()->getOverlay()->createOverlayFile(getNodeId(), ByteRange{});
   state.setMaterialized(std::move(file));
+  getProcessFetchLog().recordMaterialization();
   storeSha1(state, Hash::sha1(ByteRange{}));
 }
 
@@ -12,6 +12,7 @@
 #include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
 #include <folly/futures/SharedPromise.h>
+#include <atomic>
 #include <chrono>
 #include <optional>
 #include "eden/fs/inodes/CacheHint.h"
@@ -192,6 +193,7 @@ class FileInode final : public InodeBaseMetadata<FileInodeState> {
       const InodeTimestamps& initialTimestamps);
 
   folly::Future<Dispatcher::Attr> getattr() override;
+  std::optional<Dispatcher::Attr> getattrIfReady() override;
   folly::Future<Dispatcher::Attr> setattr(const fuse_setattr_in& attr) override;
 
   /// Throws InodeError EINVAL if inode is not a symbolic node.
@@ -449,6 +451,32 @@ class FileInode final : public InodeBaseMetadata<FileInodeState> {
 
   folly::Future<struct stat> stat();
 
+  /**
+   * Serve a read while holding the state lock only in shared mode.
+   *
+   * This succeeds once the blob is loaded or the overlay file is open, so
+   * that concurrent readers of a hot file do not serialize on the state lock.
+   * Returns std::nullopt if the data must first be loaded, in which case
+   * read() falls back to runWhileDataLoaded().
+   */
+  std::optional<BufVec> tryReadShared(size_t size, off_t off);
+
+  /**
+   * Record that a read of blob at off asked for size bytes.  Returns true
+   * once the blob has been read sequentially up to its end.
+   */
+  bool recordBlobRead(const Blob& blob, off_t off, size_t size);
+
+  /**
+   * Drop the BlobCache interest taken when blob was loaded, if the inode
+   * still holds it.
+   *
+   * Once the whole file has been read the kernel's page cache holds it, so
+   * keeping the blob pinned in the BlobCache only costs memory.  If no other
+   * inode is interested in it the blob becomes the next one to be evicted.
+   */
+  void releaseBlobInterestLocked(State& state, const Blob& blob);
+
   /**
    * Update the st_blocks field in a stat structure based on the st_size value.
    */
@@ -456,6 +484,13 @@ class FileInode final : public InodeBaseMetadata<FileInodeState> {
 
   folly::Synchronized<State> state_;
 
+  /**
+   * The length of the prefix of the blob that read() has returned since the
+   * inode last released its interest in it.  This is atomic so that readers
+   * holding state_ in shared mode can advance it without a lock.
+   */
+  std::atomic<uint64_t> readHighWater_{0};
+
   friend class ::facebook::eden::EdenFileHandle;
 };
 } // namespace eden
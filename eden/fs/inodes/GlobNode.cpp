@@ -8,6 +8,11 @@
  *
  */
 #include "GlobNode.h"
+#include <folly/Synchronized.h>
+#include <gflags/gflags.h>
+#include <deque>
+#include <mutex>
+#include <optional>
 #include "eden/fs/inodes/TreeInode.h"
 
 using folly::Future;
@@ -18,6 +23,11 @@ using std::string;
 using std::unique_ptr;
 using std::vector;
 
+DEFINE_uint64(
+    glob_max_workers,
+    8,
+    "Maximum number of directories a single glob evaluates at once");
+
 namespace facebook {
 namespace eden {
 
@@ -264,18 +274,315 @@ void GlobNode::parse(StringPiece pattern) {
   }
 }
 
+/**
+ * Drives a single evaluate() call.
+ *
+ * Directories waiting to be matched go into one queue, which up to
+ * glob_max_workers tasks on the executor take turns draining; a worker that
+ * finds the queue empty goes idle until a tree load hands it more work.
+ * Each worker appends the matches it finds to a buffer of its own, and the
+ * buffers are only joined once the whole walk has finished.
+ *
+ * Child directories that have no loaded inode are not fetched one by one.
+ * They are collected, and once the queue runs dry the next worker to look
+ * fetches all of them with a single ObjectStore::getTrees() call.  Each of
+ * those trees is queued as soon as it has been loaded.
+ */
+class GlobNode::Walker : public std::enable_shared_from_this<Walker> {
+ public:
+  Walker(
+      const ObjectStore* store,
+      folly::Executor* executor,
+      PrefetchList fileBlobsToPrefetch,
+      size_t chunkSize = 0,
+      MatchCallback onMatches = nullptr)
+      : store_{store},
+        executor_{executor},
+        fileBlobsToPrefetch_{std::move(fileBlobsToPrefetch)},
+        chunkSize_{std::max<size_t>(chunkSize, 1)},
+        onMatches_{std::move(onMatches)} {
+    auto numWorkers = std::max<size_t>(FLAGS_glob_max_workers, 1);
+    buffers_.resize(numWorkers);
+    auto state = state_.lock();
+    for (size_t worker = numWorkers; worker > 0; --worker) {
+      state->idleWorkers.push_back(worker - 1);
+    }
+  }
+
+  Future<vector<RelativePath>> getFuture() {
+    return promise_.getFuture();
+  }
+
+  void start(
+      GlobNode* node,
+      RelativePathPiece rootPath,
+      TreeInodePtr inode,
+      std::shared_ptr<const Tree> tree) {
+    enqueue(Task{node, false, rootPath.copy(), std::move(inode), tree});
+  }
+
+  bool prefetchingBlobs() const {
+    return fileBlobsToPrefetch_ != nullptr;
+  }
+
+  void prefetchBlob(const Hash& hash) {
+    fileBlobsToPrefetch_->wlock()->emplace_back(hash);
+  }
+
+  /**
+   * Evaluate node against the child directory at path once it has been
+   * loaded.
+   */
+  void addChildTree(
+      Future<TreeInodePtr>&& childTree,
+      GlobNode* node,
+      bool recursive,
+      RelativePath path) {
+    ++state_.lock()->outstanding;
+    std::move(childTree).thenTry(
+        [self = shared_from_this(), node, recursive, path = std::move(path)](
+            folly::Try<TreeInodePtr>&& dir) mutable {
+          if (dir.hasException()) {
+            self->fail(std::move(dir.exception()));
+          } else {
+            self->enqueue(
+                Task{node, recursive, std::move(path), std::move(*dir), {}});
+          }
+          self->finishOne();
+        });
+  }
+
+  /**
+   * Evaluate node against the Tree with the given hash, fetching it along
+   * with the other unloaded directories found so far.
+   */
+  void addUnloadedTree(
+      const Hash& hash,
+      GlobNode* node,
+      bool recursive,
+      RelativePath path) {
+    auto state = state_.lock();
+    ++state->outstanding;
+    state->unfetched.push_back(
+        TreeFetch{node, recursive, std::move(path), hash});
+  }
+
+ private:
+  struct Task {
+    GlobNode* node;
+    // If true, only evaluate the recursive children of node.
+    bool recursive;
+    RelativePath path;
+    // Exactly one of inode and tree is set.
+    TreeInodePtr inode;
+    std::shared_ptr<const Tree> tree;
+  };
+
+  struct TreeFetch {
+    GlobNode* node;
+    bool recursive;
+    RelativePath path;
+    Hash hash;
+  };
+
+  struct State {
+    std::deque<Task> ready;
+    vector<TreeFetch> unfetched;
+    vector<size_t> idleWorkers;
+    // The number of tasks, tree fetches, and child loads not yet finished.
+    size_t outstanding{0};
+    folly::exception_wrapper error;
+  };
+
+  void enqueue(Task&& task) {
+    std::optional<size_t> worker;
+    {
+      auto state = state_.lock();
+      ++state->outstanding;
+      state->ready.push_back(std::move(task));
+      if (!state->idleWorkers.empty()) {
+        worker = state->idleWorkers.back();
+        state->idleWorkers.pop_back();
+      }
+    }
+    if (worker) {
+      executor_->add([self = shared_from_this(), worker = *worker] {
+        self->runWorker(worker);
+      });
+    }
+  }
+
+  void runWorker(size_t worker) {
+    auto& matches = buffers_[worker];
+    while (true) {
+      std::optional<Task> task;
+      vector<TreeFetch> fetches;
+      {
+        auto state = state_.lock();
+        if (!state->ready.empty()) {
+          task = std::move(state->ready.front());
+          state->ready.pop_front();
+        } else if (!state->unfetched.empty()) {
+          fetches.swap(state->unfetched);
+        } else {
+          state->idleWorkers.push_back(worker);
+          return;
+        }
+      }
+
+      if (task) {
+        runTask(*task, matches);
+        finishOne();
+      } else {
+        fetchTrees(std::move(fetches));
+      }
+    }
+  }
+
+  void runTask(Task& task, vector<RelativePath>& matches) {
+    try {
+      if (task.inode) {
+        TreeInodePtrRoot root{std::move(task.inode)};
+        if (task.recursive) {
+          task.node->evaluateRecursiveComponentImpl(
+              *this, matches, task.path, root);
+        } else {
+          task.node->evaluateImpl(*this, matches, task.path, root);
+        }
+      } else {
+        TreeRoot root{task.tree};
+        if (task.recursive) {
+          task.node->evaluateRecursiveComponentImpl(
+              *this, matches, task.path, root);
+        } else {
+          task.node->evaluateImpl(*this, matches, task.path, root);
+        }
+      }
+      if (onMatches_ && matches.size() >= chunkSize_) {
+        deliver(matches);
+      }
+    } catch (const std::exception& ex) {
+      fail(folly::exception_wrapper{std::current_exception(), ex});
+    }
+  }
+
+  void deliver(vector<RelativePath>& matches) {
+    std::lock_guard<std::mutex> guard(onMatchesMutex_);
+    onMatches_(std::move(matches));
+    matches.clear();
+  }
+
+  void fetchTrees(vector<TreeFetch>&& fetches) {
+    vector<Hash> ids;
+    ids.reserve(fetches.size());
+    for (const auto& fetch : fetches) {
+      ids.push_back(fetch.hash);
+    }
+
+    vector<Future<std::shared_ptr<const Tree>>> trees;
+    try {
+      trees = store_->getTrees(ids);
+    } catch (const std::exception& ex) {
+      fail(folly::exception_wrapper{std::current_exception(), ex});
+      for (size_t i = 0; i < fetches.size(); ++i) {
+        finishOne();
+      }
+      return;
+    }
+
+    // Each tree is walked as soon as it arrives, rather than once the whole
+    // batch has been fetched.
+    for (size_t i = 0; i < fetches.size(); ++i) {
+      auto& fetch = fetches[i];
+      std::move(trees[i]).thenTry(
+          [self = shared_from_this(),
+           node = fetch.node,
+           recursive = fetch.recursive,
+           path = std::move(fetch.path)](
+              folly::Try<std::shared_ptr<const Tree>>&& tree) mutable {
+            if (tree.hasException()) {
+              self->fail(std::move(tree.exception()));
+            } else {
+              self->enqueue(
+                  Task{node, recursive, std::move(path), {}, std::move(*tree)});
+            }
+            self->finishOne();
+          });
+    }
+  }
+
+  void fail(folly::exception_wrapper&& ew) {
+    auto state = state_.lock();
+    if (!state->error) {
+      state->error = std::move(ew);
+    }
+  }
+
+  void finishOne() {
+    folly::exception_wrapper error;
+    {
+      auto state = state_.lock();
+      if (--state->outstanding != 0) {
+        return;
+      }
+      error = std::move(state->error);
+    }
+
+    // Nothing is running any more, so the buffers can be read safely.
+    if (error) {
+      promise_.setException(std::move(error));
+      return;
+    }
+    if (onMatches_) {
+      promise_.setWith([this] {
+        for (auto& buffer : buffers_) {
+          if (!buffer.empty()) {
+            deliver(buffer);
+          }
+        }
+        return vector<RelativePath>{};
+      });
+      return;
+    }
+    size_t total = 0;
+    for (const auto& buffer : buffers_) {
+      total += buffer.size();
+    }
+    vector<RelativePath> results;
+    results.reserve(total);
+    for (auto& buffer : buffers_) {
+      results.insert(
+          results.end(),
+          std::make_move_iterator(buffer.begin()),
+          std::make_move_iterator(buffer.end()));
+    }
+    promise_.setValue(std::move(results));
+  }
+
+  const ObjectStore* const store_;
+  folly::Executor* const executor_;
+  const PrefetchList fileBlobsToPrefetch_;
+  const size_t chunkSize_;
+  // If set, matches are handed to this in chunks rather than returned at the
+  // end.  onMatchesMutex_ ensures only one worker calls it at a time.
+  const MatchCallback onMatches_;
+  std::mutex onMatchesMutex_;
+  // One buffer per worker.  Only the worker holding an index writes to that
+  // buffer, so they need no lock.
+  vector<vector<RelativePath>> buffers_;
+  folly::Synchronized<State, std::mutex> state_;
+  folly::Promise<vector<RelativePath>> promise_;
+};
+
 template <typename ROOT>
-Future<vector<RelativePath>> GlobNode::evaluateImpl(
-    const ObjectStore* store,
+void GlobNode::evaluateImpl(
+    Walker& walker,
+    vector<RelativePath>& matches,
     RelativePathPiece rootPath,
-    ROOT&& root,
-    GlobNode::PrefetchList fileBlobsToPrefetch) {
-  vector<RelativePath> results;
-  vector<std::pair<PathComponentPiece, GlobNode*>> recurse;
-  vector<Future<vector<RelativePath>>> futures;
-  futures.emplace_back(evaluateRecursiveComponentImpl(
-      store, rootPath, root, fileBlobsToPrefetch));
+    ROOT&& root) {
+  evaluateRecursiveComponentImpl(walker, matches, rootPath, root);
 
+  vector<std::pair<RelativePath, GlobNode*>> recurse;
   {
     auto contents = root.lockContents();
     for (auto& node : children_) {
@@ -286,9 +593,9 @@ Future<vector<RelativePath>> GlobNode::evaluateImpl(
         if (entry) {
           // Matched!
           if (node->isLeaf_) {
-            results.emplace_back((rootPath + name));
-            if (fileBlobsToPrefetch && root.entryShouldPrefetch(entry)) {
-              fileBlobsToPrefetch->wlock()->emplace_back(root.entryHash(entry));
+            matches.emplace_back((rootPath + name));
+            if (walker.prefetchingBlobs() && root.entryShouldPrefetch(entry)) {
+              walker.prefetchBlob(root.entryHash(entry));
             }
             continue;
           }
@@ -296,22 +603,10 @@ Future<vector<RelativePath>> GlobNode::evaluateImpl(
           // Not the leaf of a pattern; if this is a dir, we need to recurse
           if (root.entryIsTree(entry)) {
             if (root.entryShouldLoadChildTree(entry)) {
-              recurse.emplace_back(std::make_pair(name, node.get()));
+              recurse.emplace_back(rootPath + name, node.get());
             } else {
-              auto candidateName = rootPath + name;
-              futures.emplace_back(
-                  store->getTree(root.entryHash(entry))
-                      .thenValue([candidateName,
-                                  store,
-                                  innerNode = node.get(),
-                                  fileBlobsToPrefetch](
-                                     std::shared_ptr<const Tree> dir) {
-                        return innerNode->evaluateImpl(
-                            store,
-                            candidateName,
-                            TreeRoot(dir),
-                            fileBlobsToPrefetch);
-                      }));
+              walker.addUnloadedTree(
+                  root.entryHash(entry), node.get(), false, rootPath + name);
             }
           }
         }
@@ -321,10 +616,10 @@ Future<vector<RelativePath>> GlobNode::evaluateImpl(
           auto name = root.entryName(entry);
           if (node->alwaysMatch_ || node->matcher_.match(name.stringPiece())) {
             if (node->isLeaf_) {
-              results.emplace_back((rootPath + name));
-              if (fileBlobsToPrefetch && root.entryShouldPrefetch(entry)) {
-                fileBlobsToPrefetch->wlock()->emplace_back(
-                    root.entryHash(entry));
+              matches.emplace_back((rootPath + name));
+              if (walker.prefetchingBlobs() &&
+                  root.entryShouldPrefetch(entry)) {
+                walker.prefetchBlob(root.entryHash(entry));
               }
               continue;
             }
@@ -332,22 +627,10 @@ Future<vector<RelativePath>> GlobNode::evaluateImpl(
             // recurse
             if (root.entryIsTree(entry)) {
               if (root.entryShouldLoadChildTree(entry)) {
-                recurse.emplace_back(std::make_pair(name, node.get()));
+                recurse.emplace_back(rootPath + name, node.get());
               } else {
-                auto candidateName = rootPath + name;
-                futures.emplace_back(
-                    store->getTree(root.entryHash(entry))
-                        .thenValue([candidateName,
-                                    store,
-                                    innerNode = node.get(),
-                                    fileBlobsToPrefetch](
-                                       std::shared_ptr<const Tree> dir) {
-                          return innerNode->evaluateImpl(
-                              store,
-                              candidateName,
-                              TreeRoot(dir),
-                              fileBlobsToPrefetch);
-                        }));
+                walker.addUnloadedTree(
+                    root.entryHash(entry), node.get(), false, rootPath + name);
               }
             }
           }
@@ -356,51 +639,57 @@ Future<vector<RelativePath>> GlobNode::evaluateImpl(
     }
   }
 
-  // Recursively load child inodes and evaluate matches
-
+  // Load child inodes now that the contents lock has been released
   for (auto& item : recurse) {
-    auto candidateName = rootPath + item.first;
-    futures.emplace_back(root.getOrLoadChildTree(item.first)
-                             .thenValue([store,
-                                         candidateName,
-                                         node = item.second,
-                                         fileBlobsToPrefetch](
-                                            TreeInodePtr dir) {
-                               return node->evaluateImpl(
-                                   store,
-                                   candidateName,
-                                   TreeInodePtrRoot(dir),
-                                   fileBlobsToPrefetch);
-                             }));
-  }
-  return folly::collect(futures).thenValue(
-      [shadowResults = std::move(results)](
-          vector<vector<RelativePath>>&& matchVector) mutable {
-        for (auto& matches : matchVector) {
-          shadowResults.insert(
-              shadowResults.end(),
-              std::make_move_iterator(matches.begin()),
-              std::make_move_iterator(matches.end()));
-        }
-        return shadowResults;
-      });
+    auto childTree = root.getOrLoadChildTree(item.first.basename());
+    walker.addChildTree(
+        std::move(childTree), item.second, false, std::move(item.first));
+  }
 }
 
 Future<vector<RelativePath>> GlobNode::evaluate(
     const ObjectStore* store,
+    folly::Executor* executor,
     RelativePathPiece rootPath,
     TreeInodePtr root,
     GlobNode::PrefetchList fileBlobsToPrefetch) {
-  return evaluateImpl(
-      store, rootPath, TreeInodePtrRoot(root), fileBlobsToPrefetch);
+  auto walker =
+      std::make_shared<Walker>(store, executor, std::move(fileBlobsToPrefetch));
+  auto future = walker->getFuture();
+  walker->start(this, rootPath, std::move(root), nullptr);
+  return future;
 }
 
 folly::Future<vector<RelativePath>> GlobNode::evaluate(
     const ObjectStore* store,
+    folly::Executor* executor,
     RelativePathPiece rootPath,
     const std::shared_ptr<const Tree>& tree,
     GlobNode::PrefetchList fileBlobsToPrefetch) {
-  return evaluateImpl(store, rootPath, TreeRoot(tree), fileBlobsToPrefetch);
+  auto walker =
+      std::make_shared<Walker>(store, executor, std::move(fileBlobsToPrefetch));
+  auto future = walker->getFuture();
+  walker->start(this, rootPath, nullptr, tree);
+  return future;
+}
+
+Future<folly::Unit> GlobNode::evaluate(
+    const ObjectStore* store,
+    folly::Executor* executor,
+    RelativePathPiece rootPath,
+    TreeInodePtr root,
+    GlobNode::PrefetchList fileBlobsToPrefetch,
+    size_t chunkSize,
+    MatchCallback onMatches) {
+  auto walker = std::make_shared<Walker>(
+      store,
+      executor,
+      std::move(fileBlobsToPrefetch),
+      chunkSize,
+      std::move(onMatches));
+  auto future = walker->getFuture();
+  walker->start(this, rootPath, std::move(root), nullptr);
+  return std::move(future).unit();
 }
 
 StringPiece GlobNode::tokenize(StringPiece& pattern, bool* hasSpecials) {
@@ -442,18 +731,16 @@ GlobNode* GlobNode::lookupToken(
 }
 
 template <typename ROOT>
-Future<vector<RelativePath>> GlobNode::evaluateRecursiveComponentImpl(
-    const ObjectStore* store,
+void GlobNode::evaluateRecursiveComponentImpl(
+    Walker& walker,
+    vector<RelativePath>& matches,
     RelativePathPiece rootPath,
-    ROOT&& root,
-    GlobNode::PrefetchList fileBlobsToPrefetch) {
-  vector<RelativePath> results;
+    ROOT&& root) {
   if (recursiveChildren_.empty()) {
-    return results;
+    return;
   }
 
   vector<RelativePath> subDirNames;
-  vector<Future<vector<RelativePath>>> futures;
   {
     auto contents = root.lockContents();
     for (auto& entry : root.iterate(contents)) {
@@ -462,9 +749,9 @@ Future<vector<RelativePath>> GlobNode::evaluateRecursiveComponentImpl(
       for (auto& node : recursiveChildren_) {
         if (node->alwaysMatch_ ||
             node->matcher_.match(candidateName.stringPiece())) {
-          results.emplace_back(candidateName);
-          if (fileBlobsToPrefetch && root.entryShouldPrefetch(entry)) {
-            fileBlobsToPrefetch->wlock()->emplace_back(root.entryHash(entry));
+          matches.emplace_back(candidateName);
+          if (walker.prefetchingBlobs() && root.entryShouldPrefetch(entry)) {
+            walker.prefetchBlob(root.entryHash(entry));
           }
           // No sense running multiple matches for this same file.
           break;
@@ -475,18 +762,10 @@ Future<vector<RelativePath>> GlobNode::evaluateRecursiveComponentImpl(
       // the lock on the contents.
       if (root.entryIsTree(entry)) {
         if (root.entryShouldLoadChildTree(entry)) {
-          subDirNames.emplace_back(candidateName);
+          subDirNames.emplace_back(std::move(candidateName));
         } else {
-          futures.emplace_back(
-              store->getTree(root.entryHash(entry))
-                  .thenValue([candidateName, store, this, fileBlobsToPrefetch](
-                                 const std::shared_ptr<const Tree>& tree) {
-                    return evaluateRecursiveComponentImpl(
-                        store,
-                        candidateName,
-                        TreeRoot(tree),
-                        fileBlobsToPrefetch);
-                  }));
+          walker.addUnloadedTree(
+              root.entryHash(entry), this, true, std::move(candidateName));
         }
       }
     }
@@ -494,29 +773,10 @@ Future<vector<RelativePath>> GlobNode::evaluateRecursiveComponentImpl(
 
   // Recursively load child inodes and evaluate matches
   for (auto& candidateName : subDirNames) {
-    futures.emplace_back(
-        root.getOrLoadChildTree(candidateName.basename())
-            .thenValue([candidateName, store, this, fileBlobsToPrefetch](
-                           TreeInodePtr dir) {
-              return evaluateRecursiveComponentImpl(
-                  store,
-                  candidateName,
-                  TreeInodePtrRoot(dir),
-                  fileBlobsToPrefetch);
-            }));
-  }
-
-  return folly::collect(futures).thenValue(
-      [shadowResults = std::move(results)](
-          vector<vector<RelativePath>>&& matchVector) mutable {
-        for (auto& matches : matchVector) {
-          shadowResults.insert(
-              shadowResults.end(),
-              std::make_move_iterator(matches.begin()),
-              std::make_move_iterator(matches.end()));
-        }
-        return shadowResults;
-      });
+    auto childTree = root.getOrLoadChildTree(candidateName.basename());
+    walker.addChildTree(
+        std::move(childTree), this, true, std::move(candidateName));
+  }
 }
 
 } // namespace eden
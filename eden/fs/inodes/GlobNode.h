@@ -8,7 +8,9 @@
  *
  */
 #pragma once
+#include <folly/Executor.h>
 #include <folly/futures/Future.h>
+#include <functional>
 #include "eden/fs/inodes/InodePtrFwd.h"
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/model/Tree.h"
@@ -43,9 +45,11 @@ class GlobNode {
   // directory separator separated path component.
   void parse(folly::StringPiece pattern);
 
-  // This is a recursive function to evaluate the compiled glob against
-  // the provided input path and inode.
+  // Evaluate the compiled glob against the provided input path and inode.
   // It returns the set of matching file names.
+  // The directories are walked by at most glob_max_workers tasks running on
+  // executor at once, with the Trees of unloaded subdirectories fetched from
+  // the ObjectStore in batches.
   // Note: the caller is responsible for ensuring that this
   // GlobNode exists until the returned Future is resolved.
   // If prefetchFiles is true, each matching file will have its content
@@ -54,6 +58,7 @@ class GlobNode {
   // inodes assigned.
   folly::Future<std::vector<RelativePath>> evaluate(
       const ObjectStore* store,
+      folly::Executor* executor,
       RelativePathPiece rootPath,
       TreeInodePtr root,
       PrefetchList fileBlobsToPrefetch);
@@ -61,10 +66,27 @@ class GlobNode {
   // This is the Tree version of the method above
   folly::Future<std::vector<RelativePath>> evaluate(
       const ObjectStore* store,
+      folly::Executor* executor,
       RelativePathPiece rootPath,
       const std::shared_ptr<const Tree>& tree,
       PrefetchList fileBlobsToPrefetch);
 
+  using MatchCallback = std::function<void(std::vector<RelativePath>&&)>;
+
+  // Streaming version of evaluate(): instead of returning every match at
+  // the end, the matches are handed to onMatches in chunks of about
+  // chunkSize paths as the workers find them.  onMatches is only called by
+  // one worker at a time.  The returned Future completes once the last chunk
+  // has been delivered.
+  folly::Future<folly::Unit> evaluate(
+      const ObjectStore* store,
+      folly::Executor* executor,
+      RelativePathPiece rootPath,
+      TreeInodePtr root,
+      PrefetchList fileBlobsToPrefetch,
+      size_t chunkSize,
+      MatchCallback onMatches);
+
  private:
   // Returns the next glob node token.
   // This is the text from the start of pattern up to the first
@@ -82,26 +104,32 @@ class GlobNode {
   GlobNode* lookupToken(
       std::vector<std::unique_ptr<GlobNode>>* container,
       folly::StringPiece token);
+  // Tracks the state of one evaluate() call; defined in GlobNode.cpp.
+  class Walker;
+
   // Evaluates any recursive glob entries associated with this node.
-  // This is a recursive function which evaluates the current GlobNode against
-  // the recursive set of children.
-  // By contrast, evaluate() walks down through the GlobNodes AND the
+  // This matches the current GlobNode against every entry of root, and has
+  // the walker do the same for each child directory.
+  // By contrast, evaluateImpl() walks down through the GlobNodes AND the
   // inode children.
   // The difference is because a pattern like "**/foo" must be recursively
   // matched against all the children of the inode.
   template <typename ROOT>
-  folly::Future<std::vector<RelativePath>> evaluateRecursiveComponentImpl(
-      const ObjectStore* store,
+  void evaluateRecursiveComponentImpl(
+      Walker& walker,
+      std::vector<RelativePath>& matches,
       RelativePathPiece rootPath,
-      ROOT&& root,
-      PrefetchList fileBlobsToPrefetch);
+      ROOT&& root);
 
+  // Matches the children of this node against the entries of root, adding
+  // matching names to matches and handing the child directories that need
+  // to be walked to the walker.
   template <typename ROOT>
-  folly::Future<std::vector<RelativePath>> evaluateImpl(
-      const ObjectStore* store,
+  void evaluateImpl(
+      Walker& walker,
+      std::vector<RelativePath>& matches,
       RelativePathPiece rootPath,
-      ROOT&& root,
-      PrefetchList fileBlobsToPrefetch);
+      ROOT&& root);
 
   // The pattern fragment for this node
   std::string pattern_;
@@ -75,6 +75,10 @@ folly::Future<Dispatcher::Attr> InodeBase::getattr() {
   FUSELL_NOT_IMPL();
 }
 
+std::optional<Dispatcher::Attr> InodeBase::getattrIfReady() {
+  return std::nullopt;
+}
+
 folly::Future<folly::Unit> InodeBase::setxattr(
     folly::StringPiece /*name*/,
     folly::StringPiece /*value*/,
@@ -356,6 +360,12 @@ void InodeBase::updateAtime() {
       getNodeId(), [&](auto& metadata) { metadata.timestamps.atime = now; });
 }
 
+void InodeBase::updateAtimeExclusive() {
+  auto now = getNow();
+  getMount()->getInodeMetadataTable()->modifyExclusiveOrThrow(
+      getNodeId(), [&](auto& metadata) { metadata.timestamps.atime = now; });
+}
+
 InodeTimestamps InodeBase::updateMtimeAndCtime(timespec now) {
   return getMount()
       ->getInodeMetadataTable()
@@ -8,6 +8,7 @@
  *
  */
 #pragma once
+#include <folly/ScopeGuard.h>
 #include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
 #include <atomic>
@@ -103,6 +104,12 @@ class InodeBase {
   // See Dispatcher::getattr
   virtual folly::Future<Dispatcher::Attr> getattr();
 
+  /**
+   * Returns the attributes if they can be computed without waiting on a load
+   * or a fetch, and std::nullopt otherwise.  See Dispatcher::getattrIfReady.
+   */
+  virtual std::optional<Dispatcher::Attr> getattrIfReady();
+
   // See Dispatcher::setattr
   virtual folly::Future<Dispatcher::Attr> setattr(
       const fuse_setattr_in& attr) = 0;
@@ -273,6 +280,16 @@ class InodeBase {
     return numFuseReferences_.load(std::memory_order_acquire);
   }
 
+  /**
+   * Get the FUSE refcount of a loaded inode once its mount's FUSE channel
+   * has stopped, after which the count can no longer change.
+   *
+   * This is only used by InodeMap to record loaded inodes during takeover.
+   */
+  uint32_t getFuseRefcountAfterStop() const {
+    return numFuseReferences_.load(std::memory_order_acquire);
+  }
+
   /**
    * Set the FUSE reference count.
    *
@@ -371,6 +388,9 @@ class InodeBase {
   // state lock for this type of inode when calling getMetadataLocked().
   InodeMetadata getMetadataLocked() const;
   void updateAtime();
+  // Like updateAtime(), but safe without exclusive access to this inode's
+  // metadata record.
+  void updateAtimeExclusive();
   InodeTimestamps updateMtimeAndCtime(timespec now);
 
   template <typename InodeType>
@@ -577,6 +597,30 @@ class InodeBaseMetadata : public InodeBase {
     return InodeBase::updateAtime();
   }
 
+  /**
+   * Like updateAtimeLocked(), for readers holding the inode state lock in
+   * shared mode.
+   *
+   * Other metadata updates rely on the exclusive state lock to serialize
+   * access to the inode's InodeMetadataTable record, and only hold the
+   * table's lock in shared mode.  Here other readers of this inode may be
+   * reading the record, or trying to update the atime themselves, so the
+   * table's lock is taken exclusively instead.
+   *
+   * Only one reader updates the atime at a time.  Readers that find an
+   * update already in progress skip theirs, since it would record
+   * practically the same time, rather than all queueing on the table's lock.
+   */
+  void updateAtimeShared(const InodeState&) {
+    if (sharedAtimeUpdate_.exchange(true, std::memory_order_acquire)) {
+      return;
+    }
+    SCOPE_EXIT {
+      sharedAtimeUpdate_.store(false, std::memory_order_release);
+    };
+    InodeBase::updateAtimeExclusive();
+  }
+
   /**
    * Updates this inode's mtime and ctime to the given timestamp. The inode's
    * state lock must be held.
@@ -584,6 +628,13 @@ class InodeBaseMetadata : public InodeBase {
   InodeTimestamps updateMtimeAndCtimeLocked(InodeState&, timespec now) {
     return InodeBase::updateMtimeAndCtime(now);
   }
+
+ private:
+  /**
+   * Set while a reader holding the state lock in shared mode updates the
+   * atime.
+   */
+  std::atomic<bool> sharedAtimeUpdate_{false};
 };
 } // namespace eden
 } // namespace facebook
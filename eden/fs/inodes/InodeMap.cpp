@@ -13,6 +13,8 @@
 #include <folly/Exception.h>
 #include <folly/Likely.h>
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+#include <unordered_set>
 
 #include "eden/fs/inodes/EdenMount.h"
 #include "eden/fs/inodes/FileInode.h"
@@ -30,6 +32,12 @@ using std::optional;
 using std::string;
 using namespace std::chrono_literals;
 
+DEFINE_bool(
+    takeover_compact_inode_map,
+    true,
+    "Hand unloaded inodes to the next process as a memory-mapped "
+    "CompactInodeMap during graceful restart, rather than as a thrift list");
+
 namespace facebook {
 namespace eden {
 
@@ -117,7 +125,8 @@ void InodeMap::initialize(TreeInodePtr root) {
 
 void InodeMap::initializeFromTakeover(
     TreeInodePtr root,
-    const SerializedInodeMap& takeover) {
+    const SerializedInodeMap& takeover,
+    std::unique_ptr<CompactInodeMap> inodeTable) {
   auto data = data_.wlock();
 
   CHECK_EQ(data->loadedInodes_.size(), 0)
@@ -161,11 +170,72 @@ void InodeMap::initializeFromTakeover(
     }
   }
 
+  if (inodeTable) {
+    // Entries are validated as they are moved into unloadedInodes_.
+    data->takeoverInodesRemaining_ = inodeTable->size();
+    data->takeoverInodesMoved_.assign(inodeTable->size(), false);
+    data->takeoverInodes_ = std::move(inodeTable);
+  }
+
   XLOG(DBG2) << "InodeMap initialized mount " << mount_->getPath()
-             << " from takeover, " << data->unloadedInodes_.size()
+             << " from takeover, "
+             << data->unloadedInodes_.size() + data->takeoverInodesRemaining_
              << " inodes registered";
 }
 
+std::optional<size_t> InodeMap::findTakeoverInode(
+    const Members& data,
+    InodeNumber number) {
+  if (data.takeoverInodesRemaining_ == 0) {
+    return std::nullopt;
+  }
+  auto index = data.takeoverInodes_->find(number.get());
+  if (index == data.takeoverInodes_->size() ||
+      data.takeoverInodesMoved_[index]) {
+    return std::nullopt;
+  }
+  return index;
+}
+
+bool InodeMap::isUnloadedInode(const Members& data, InodeNumber number) {
+  return data.unloadedInodes_.count(number) > 0 ||
+      findTakeoverInode(data, number).has_value();
+}
+
+InodeMap::UnloadedInode* InodeMap::findUnloadedInode(
+    Members& data,
+    InodeNumber number) {
+  auto iter = data.unloadedInodes_.find(number);
+  if (iter != data.unloadedInodes_.end()) {
+    return &iter->second;
+  }
+
+  auto index = findTakeoverInode(data, number);
+  if (!index) {
+    return nullptr;
+  }
+  auto entry = data.takeoverInodes_->getEntry(*index);
+  auto result = data.unloadedInodes_.emplace(
+      number,
+      UnloadedInode(
+          number,
+          InodeNumber::fromThrift(entry.parentInode),
+          PathComponentPiece{entry.name},
+          entry.isUnlinked,
+          entry.mode,
+          entry.hash.empty() ? std::nullopt
+                             : std::optional<Hash>{Hash{entry.hash}},
+          entry.numFuseReferences));
+  DCHECK(result.second);
+  data.takeoverInodesMoved_[*index] = true;
+  if (--data.takeoverInodesRemaining_ == 0) {
+    // Every entry has been moved, so the mapping is no longer needed.
+    data.takeoverInodes_.reset();
+    data.takeoverInodesMoved_.clear();
+  }
+  return &result.first->second;
+}
+
 Future<InodePtr> InodeMap::lookupInode(InodeNumber number) {
   // Lock the data.
   // We hold it while doing most of our work below, but explicitly unlock it
@@ -186,8 +256,8 @@ Future<InodePtr> InodeMap::lookupInode(InodeNumber number) {
   }
 
   // Look up the data in the unloadedInodes_ map.
-  auto unloadedIter = data->unloadedInodes_.find(number);
-  if (UNLIKELY(unloadedIter == data->unloadedInodes_.end())) {
+  auto* unloadedData = findUnloadedInode(*data, number);
+  if (UNLIKELY(!unloadedData)) {
     // This generally shouldn't happen.  If a InodeNumber has been allocated we
     // should always know about it.  It's a bug if our caller calls us with an
     // invalid InodeNumber number.
@@ -197,7 +267,6 @@ Future<InodePtr> InodeMap::lookupInode(InodeNumber number) {
   }
 
   // Check to see if anyone else has already started loading this inode.
-  auto* unloadedData = &unloadedIter->second;
   bool alreadyLoading = !unloadedData->promises.empty();
 
   // Add a new entry to the promises list.
@@ -248,8 +317,8 @@ Future<InodePtr> InodeMap::lookupInode(InodeNumber number) {
     }
 
     // Look up the parent in unloadedInodes_
-    unloadedIter = data->unloadedInodes_.find(unloadedData->parent);
-    if (UNLIKELY(unloadedIter == data->unloadedInodes_.end())) {
+    auto* parentData = findUnloadedInode(*data, unloadedData->parent);
+    if (UNLIKELY(!parentData)) {
       // This shouldn't happen.  We must know about the parent inode number if
       // we knew about the child.
       auto bug = EDEN_BUG() << "unknown parent inode " << unloadedData->parent
@@ -260,7 +329,6 @@ Future<InodePtr> InodeMap::lookupInode(InodeNumber number) {
       return result;
     }
 
-    auto* parentData = &unloadedIter->second;
     alreadyLoading = !parentData->promises.empty();
 
     // Add a new entry to the promises list.
@@ -463,6 +531,22 @@ std::optional<RelativePath> InodeMap::getPathForInodeHelper(
                    << "appears to contain non-unlinked child " << inodeNumber;
       }
       return *dir + unloadedIt->second.name;
+    } else if (auto index = findTakeoverInode(*data, inodeNumber)) {
+      // Read the entry in place, since we only hold the lock in shared mode.
+      auto entry = data->takeoverInodes_->getEntry(*index);
+      if (entry.isUnlinked) {
+        return std::nullopt;
+      }
+      auto parent = InodeNumber::fromThrift(entry.parentInode);
+      if (parent == kRootNodeId) {
+        return RelativePath(PathComponentPiece{entry.name});
+      }
+      auto dir = getPathForInodeHelper(parent, data);
+      if (!dir) {
+        EDEN_BUG() << "unlinked parent inode " << parent
+                   << "appears to contain non-unlinked child " << inodeNumber;
+      }
+      return *dir + PathComponentPiece{entry.name};
     } else {
       throwSystemErrorExplicit(EINVAL, "unknown inode number ", inodeNumber);
     }
@@ -490,21 +574,21 @@ void InodeMap::decFuseRefcount(InodeNumber number, uint32_t count) {
   }
 
   // If it wasn't loaded, it should be in the unloaded map
-  auto unloadedIter = data->unloadedInodes_.find(number);
-  if (UNLIKELY(unloadedIter == data->unloadedInodes_.end())) {
+  auto* unloadedData = findUnloadedInode(*data, number);
+  if (UNLIKELY(!unloadedData)) {
     EDEN_BUG() << "InodeMap::decFuseRefcount() called on unknown inode number "
                << number;
   }
 
   // Decrement the reference count in the unloaded entry
-  auto& unloadedEntry = unloadedIter->second;
+  auto& unloadedEntry = *unloadedData;
   CHECK_GE(unloadedEntry.numFuseReferences, count);
   unloadedEntry.numFuseReferences -= count;
   if (unloadedEntry.numFuseReferences <= 0) {
     // We can completely forget about this unloaded inode now.
     XLOG(DBG5) << "forgetting unloaded inode " << number << ": "
                << unloadedEntry.parent << ":" << unloadedEntry.name;
-    data->unloadedInodes_.erase(unloadedIter);
+    data->unloadedInodes_.erase(number);
   }
 }
 
@@ -514,7 +598,8 @@ void InodeMap::setUnmounted() {
   data->isUnmounted_ = true;
 }
 
-Future<SerializedInodeMap> InodeMap::shutdown(bool doTakeover) {
+Future<std::tuple<SerializedInodeMap, folly::File>> InodeMap::shutdown(
+    bool doTakeover) {
   // Record that we are in the process of shutting down.
   auto future = Future<folly::Unit>::makeEmpty();
   {
@@ -526,8 +611,15 @@ Future<SerializedInodeMap> InodeMap::shutdown(bool doTakeover) {
     future = data->shutdownPromise->getFuture();
 
     XLOG(DBG3) << "starting InodeMap::shutdown: loadedCount="
-               << data->loadedInodes_.size()
-               << " unloadedCount=" << data->unloadedInodes_.size();
+               << data->loadedInodes_.size() << " unloadedCount="
+               << data->unloadedInodes_.size() + data->takeoverInodesRemaining_;
+  }
+
+  // Record the loaded inodes as they are, rather than through unloading
+  // each of them below.
+  folly::File inodeTable;
+  if (doTakeover && FLAGS_takeover_compact_inode_map) {
+    inodeTable = saveInodesForTakeover();
   }
 
   // Walk from the root of the tree down, finding all unreferenced inodes,
@@ -579,17 +671,20 @@ Future<SerializedInodeMap> InodeMap::shutdown(bool doTakeover) {
   // we know that all inodes have been destroyed and we can complete shutdown.
   root_.manualDecRef();
 
-  return std::move(future).thenValue([this, doTakeover](auto&&) {
+  return std::move(future).thenValue([this,
+                                      doTakeover,
+                                      inodeTable = std::move(inodeTable)](
+                                         auto&&) mutable {
     // TODO: This check could occur after the loadedInodes_ assertion below to
     // maximize coverage of any invariants that are broken during shutdown.
     if (!doTakeover) {
-      return SerializedInodeMap{};
+      return std::make_tuple(SerializedInodeMap{}, folly::File{});
     }
     auto data = data_.wlock();
     XLOG(DBG3)
         << "InodeMap::shutdown after releasing inodesToClear: loadedCount="
-        << data->loadedInodes_.size()
-        << " unloadedCount=" << data->unloadedInodes_.size();
+        << data->loadedInodes_.size() << " unloadedCount="
+        << data->unloadedInodes_.size() + data->takeoverInodesRemaining_;
 
     if (data->loadedInodes_.size() != 1) {
       EDEN_BUG() << "After InodeMap::shutdown() finished, "
@@ -598,30 +693,161 @@ Future<SerializedInodeMap> InodeMap::shutdown(bool doTakeover) {
                  << "have been unloaded for this to succeed!";
     }
 
-    SerializedInodeMap result;
-    result.unloadedInodes.reserve(data->unloadedInodes_.size());
+    if (inodeTable) {
+      return std::make_tuple(SerializedInodeMap{}, std::move(inodeTable));
+    }
+
+    // Entries from the previous takeover that were never used are passed on
+    // as they are.  Their names and hashes point into takeoverInodes_, which
+    // stays mapped while we hold the lock.
+    std::vector<CompactInodeMap::Entry> entries;
+    entries.reserve(
+        data->unloadedInodes_.size() + data->takeoverInodesRemaining_);
+    for (size_t n = 0; n < data->takeoverInodesMoved_.size(); ++n) {
+      if (!data->takeoverInodesMoved_[n]) {
+        entries.push_back(data->takeoverInodes_->getEntry(n));
+      }
+    }
     for (const auto& it : data->unloadedInodes_) {
       const auto& entry = it.second;
-      SerializedInodeMapEntry serializedEntry;
 
       XLOG(DBG5) << "  serializing unloaded inode " << entry.number.get()
                  << " parent=" << entry.parent.get() << " name=" << entry.name;
+      entries.push_back(getCompactEntry(entry));
+    }
 
-      serializedEntry.inodeNumber = entry.number.get();
-      serializedEntry.parentInode = entry.parent.get();
-      serializedEntry.name = entry.name.stringPiece().str();
+    SerializedInodeMap result;
+    result.unloadedInodes.reserve(entries.size());
+    for (const auto& entry : entries) {
+      SerializedInodeMapEntry serializedEntry;
+      serializedEntry.inodeNumber = entry.inodeNumber;
+      serializedEntry.parentInode = entry.parentInode;
+      serializedEntry.name = entry.name.str();
       serializedEntry.isUnlinked = entry.isUnlinked;
       serializedEntry.numFuseReferences = entry.numFuseReferences;
-      serializedEntry.hash = thriftHash(entry.hash);
+      serializedEntry.hash = folly::StringPiece{entry.hash}.str();
       serializedEntry.mode = entry.mode;
-
       result.unloadedInodes.emplace_back(std::move(serializedEntry));
     }
-
-    return result;
+    return std::make_tuple(std::move(result), folly::File{});
   });
 }
 
+folly::File InodeMap::saveInodesForTakeover() {
+  // Hold the rename lock so that no inode is renamed or unlinked while we
+  // record its location.
+  auto renameLock = mount_->acquireRenameLock();
+
+  // Take references so that the loaded inodes stay loaded while we examine
+  // them.  Their own locks rank above data_, so examine them without it.
+  std::vector<InodePtr> loaded;
+  {
+    auto data = data_.wlock();
+    loaded.reserve(data->loadedInodes_.size());
+    for (const auto& entry : data->loadedInodes_) {
+      if (entry.second.get() != root_.get()) {
+        loaded.push_back(entry.second.getPtr());
+      }
+    }
+  }
+
+  std::unordered_map<InodeNumber, UnloadedInode> loadedEntries;
+  loadedEntries.reserve(loaded.size());
+  for (const auto& inode : loaded) {
+    auto location = inode->getLocationInfo(renameLock);
+    // The FUSE channel has stopped, so this count can no longer change.
+    auto fuseCount = inode->getFuseRefcountAfterStop();
+    if (location.unlinked && fuseCount == 0) {
+      // Unloading discards these, along with their overlay data.
+      continue;
+    }
+    if (auto* asTree = inode.asTreeOrNull()) {
+      auto treeHash = asTree->getContents().rlock()->treeHash;
+      loadedEntries.emplace(
+          inode->getNodeId(),
+          UnloadedInode(
+              asTree,
+              location.parent.get(),
+              location.name.piece(),
+              location.unlinked,
+              treeHash,
+              fuseCount));
+    } else {
+      loadedEntries.emplace(
+          inode->getNodeId(),
+          UnloadedInode(
+              inode.asFileOrNull(),
+              location.parent.get(),
+              location.name.piece(),
+              location.unlinked,
+              fuseCount));
+    }
+  }
+
+  // Like unloading, keep only the loaded inodes that FUSE references, and
+  // the directories above any inode we remember.
+  std::unordered_set<InodeNumber> keep;
+  auto keepWithAncestors = [&](InodeNumber number) {
+    while (true) {
+      auto it = loadedEntries.find(number);
+      if (it == loadedEntries.end() || !keep.insert(number).second) {
+        return;
+      }
+      number = it->second.parent;
+    }
+  };
+  for (const auto& it : loadedEntries) {
+    if (it.second.numFuseReferences > 0) {
+      keepWithAncestors(it.first);
+    }
+  }
+
+  auto data = data_.wlock();
+  // Entries from the previous takeover that were never used are passed on as
+  // they are.  Their names and hashes point into takeoverInodes_, which stays
+  // mapped while we hold the lock.
+  std::vector<CompactInodeMap::Entry> entries;
+  entries.reserve(
+      data->unloadedInodes_.size() + data->takeoverInodesRemaining_ +
+      loadedEntries.size());
+  for (size_t n = 0; n < data->takeoverInodesMoved_.size(); ++n) {
+    if (!data->takeoverInodesMoved_[n]) {
+      entries.push_back(data->takeoverInodes_->getEntry(n));
+      keepWithAncestors(InodeNumber::fromThrift(entries.back().parentInode));
+    }
+  }
+  for (const auto& it : data->unloadedInodes_) {
+    entries.push_back(getCompactEntry(it.second));
+    keepWithAncestors(it.second.parent);
+  }
+  for (auto number : keep) {
+    // An inode that finished loading since we looked is already recorded.
+    if (!isUnloadedInode(*data, number)) {
+      entries.push_back(getCompactEntry(loadedEntries.at(number)));
+    }
+  }
+  XLOG(DBG3) << "saving " << entries.size() << " inodes for takeover, "
+             << keep.size() << " of them loaded";
+
+  auto file = CompactInodeMap::write(std::move(entries));
+  data->takeoverInodesSaved_ = true;
+  return file;
+}
+
+CompactInodeMap::Entry InodeMap::getCompactEntry(const UnloadedInode& entry) {
+  CompactInodeMap::Entry compactEntry;
+  compactEntry.inodeNumber = entry.number.get();
+  compactEntry.parentInode = entry.parent.get();
+  compactEntry.name = entry.name.stringPiece();
+  compactEntry.isUnlinked = entry.isUnlinked;
+  compactEntry.numFuseReferences = entry.numFuseReferences;
+  if (entry.hash.has_value()) {
+    compactEntry.hash = entry.hash->getBytes();
+  }
+  compactEntry.mode = entry.mode;
+  return compactEntry;
+}
+
 void InodeMap::shutdownComplete(
     folly::Synchronized<Members>::LockedPtr&& data) {
   // We manually dropped our reference count to the root inode in
@@ -640,7 +866,7 @@ void InodeMap::shutdownComplete(
 }
 
 bool InodeMap::isInodeRemembered(InodeNumber ino) const {
-  return data_.rlock()->unloadedInodes_.count(ino) > 0;
+  return isUnloadedInode(*data_.rlock(), ino);
 }
 
 void InodeMap::onInodeUnreferenced(
@@ -785,6 +1011,12 @@ optional<InodeMap::UnloadedInode> InodeMap::updateOverlayForUnload(
     return std::nullopt;
   }
 
+  // shutdown() has already recorded this inode for the next process if it
+  // needs to be remembered.
+  if (data->takeoverInodesSaved_) {
+    return std::nullopt;
+  }
+
   // If the tree is unlinked and no longer referenced we can delete it from
   // the overlay and completely forget about it.
   if (isUnlinked && fuseCount == 0) {
@@ -826,7 +1058,7 @@ optional<InodeMap::UnloadedInode> InodeMap::updateOverlayForUnload(
     for (const auto& pair : treeContentsLock->entries) {
       const auto& childName = pair.first;
       const auto& entry = pair.second;
-      if (data->unloadedInodes_.count(entry.getInodeNumber())) {
+      if (isUnloadedInode(*data, entry.getInodeNumber())) {
         XLOG(DBG5) << "remembering inode " << asTree->getNodeId() << " ("
                    << asTree->getLogPath() << ") because its child "
                    << childName << " was remembered";
@@ -862,9 +1094,10 @@ bool InodeMap::shouldLoadChild(
     InodeNumber childInode,
     folly::Promise<InodePtr> promise) {
   auto data = data_.wlock();
-  auto iter = data->unloadedInodes_.find(childInode);
-  UnloadedInode* unloadedData{nullptr};
-  if (iter == data->unloadedInodes_.end()) {
+  // This also moves any entry handed over during takeover into
+  // unloadedInodes_, so that its FUSE refcount is applied when it loads.
+  auto* unloadedData = findUnloadedInode(*data, childInode);
+  if (!unloadedData) {
     InodeNumber parentNumber = parent->getNodeId();
     auto newUnloadedData = UnloadedInode(childInode, parentNumber, name);
     auto ret =
@@ -872,7 +1105,6 @@ bool InodeMap::shouldLoadChild(
     DCHECK(ret.second);
     unloadedData = &ret.first->second;
   } else {
-    unloadedData = &iter->second;
     DCHECK_EQ(unloadedData->number, childInode);
   }
 
@@ -925,6 +1157,16 @@ std::vector<InodeNumber> InodeMap::getReferencedInodes() const {
         inodes.push_back(unloadedInode.number);
       }
     }
+
+    for (size_t n = 0; n < data->takeoverInodesMoved_.size(); ++n) {
+      if (data->takeoverInodesMoved_[n]) {
+        continue;
+      }
+      auto entry = data->takeoverInodes_->getEntry(n);
+      if (entry.numFuseReferences > 0) {
+        inodes.push_back(InodeNumber::fromThrift(entry.inodeNumber));
+      }
+    }
   }
 
   return inodes;
@@ -9,16 +9,20 @@
  */
 #pragma once
 
+#include <folly/File.h>
 #include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
 #include <list>
 #include <memory>
 #include <optional>
+#include <tuple>
 #include <unordered_map>
+#include <vector>
 
 #include "eden/fs/fuse/FuseChannel.h"
 #include "eden/fs/inodes/InodePtr.h"
 #include "eden/fs/model/Hash.h"
+#include "eden/fs/takeover/CompactInodeMap.h"
 #include "eden/fs/takeover/gen-cpp2/takeover_types.h"
 #include "eden/fs/utils/PathFuncs.h"
 
@@ -128,11 +132,16 @@ class InodeMap {
    * Initialize the InodeMap from data handed over from a process being taken
    * over.
    *
+   * If inodeTable is given, its entries are not decoded now.  Each one is
+   * moved into the InodeMap the first time its inode number is used, so the
+   * time spent here does not depend on the number of inodes handed over.
+   *
    * This method has the same constraints and concerns as initialize().
    */
   void initializeFromTakeover(
       TreeInodePtr root,
-      const SerializedInodeMap& takeover);
+      const SerializedInodeMap& takeover,
+      std::unique_ptr<CompactInodeMap> inodeTable = nullptr);
 
   /**
    * Get the root inode.
@@ -244,14 +253,19 @@ class InodeMap {
    * The shutdown process must wait for all Inode objects in this InodeMap to
    * become unreferenced and be unloaded.  Returns a Future that will be
    * fulfilled once the shutdown has completed.  If doTakeover is true, the
-   * resulting SerializedInodeMap will include data sufficient for
-   * reconstructing all inode state in the new process.
+   * result will include data sufficient for reconstructing all inode state in
+   * the new process: either a memfd containing a CompactInodeMap, or, if
+   * --takeover_compact_inode_map is disabled, a SerializedInodeMap.
+   *
+   * The CompactInodeMap is written before any inode is unloaded, recording
+   * loaded inodes as they are, so unloading them does no further work.
    *
    * This function should generally only be invoked by EdenMount::shutdown().
    * Other callers should use EdenMount::shutdown() instead of invoking this
    * function directly.
    */
-  FOLLY_NODISCARD folly::Future<SerializedInodeMap> shutdown(bool doTakeover);
+  FOLLY_NODISCARD folly::Future<std::tuple<SerializedInodeMap, folly::File>>
+  shutdown(bool doTakeover);
 
   /**
    * Returns true if we have stored information about this inode that may
@@ -382,7 +396,8 @@ class InodeMap {
     return data_.rlock()->loadedInodes_.size();
   }
   size_t getUnloadedInodeCount() const {
-    return data_.rlock()->unloadedInodes_.size();
+    auto data = data_.rlock();
+    return data->unloadedInodes_.size() + data->takeoverInodesRemaining_;
   }
 
   /*
@@ -516,6 +531,23 @@ class InodeMap {
      */
     std::unordered_map<InodeNumber, UnloadedInode> unloadedInodes_;
 
+    /**
+     * Unloaded inodes handed over by the previous edenfs process.  Entries
+     * are moved into unloadedInodes_ the first time they are needed, and
+     * takeoverInodesMoved_ records which ones have been moved.  Once moved,
+     * unloadedInodes_ is the only source of truth for that inode.
+     */
+    std::unique_ptr<CompactInodeMap> takeoverInodes_;
+    std::vector<bool> takeoverInodesMoved_;
+    size_t takeoverInodesRemaining_{0};
+
+    /**
+     * Set by shutdown() once it has written every inode the next process
+     * needs to a CompactInodeMap.  Inodes unloaded after that point are
+     * simply forgotten.
+     */
+    bool takeoverInodesSaved_{false};
+
     /**
      * Indicates if the FUSE mount point has been unmounted.
      *
@@ -543,6 +575,35 @@ class InodeMap {
 
   void shutdownComplete(folly::Synchronized<Members>::LockedPtr&& data);
 
+  /**
+   * Write every inode that the next process needs to remember, loaded or
+   * not, to a CompactInodeMap.
+   *
+   * shutdown() calls this before it unloads anything when performing a
+   * takeover, so that unloading the loaded inodes only has to free them.
+   */
+  folly::File saveInodesForTakeover();
+
+  static CompactInodeMap::Entry getCompactEntry(const UnloadedInode& entry);
+
+  /**
+   * Returns the unloadedInodes_ entry for number, first moving it out of
+   * takeoverInodes_ if it has not been used since takeover.  Returns nullptr
+   * if the inode is not an unloaded inode.
+   */
+  static UnloadedInode* findUnloadedInode(Members& data, InodeNumber number);
+
+  /**
+   * Returns the index of number in takeoverInodes_ if it has not yet been
+   * moved into unloadedInodes_.
+   */
+  static std::optional<size_t> findTakeoverInode(
+      const Members& data,
+      InodeNumber number);
+
+  /** Returns true if number is in unloadedInodes_ or takeoverInodes_. */
+  static bool isUnloadedInode(const Members& data, InodeNumber number);
+
   void setupParentLookupPromise(
       folly::Promise<InodePtr>& promise,
       PathComponentPiece childName,
@@ -189,6 +189,26 @@ class InodeTable {
     });
   }
 
+  /**
+   * Like modifyOrThrow(), but holds the table's lock exclusively while fn
+   * runs.  Use this when the caller's own locks do not keep other threads
+   * from reading or modifying the same record.
+   */
+  template <typename ModFn>
+  Record modifyExclusiveOrThrow(InodeNumber ino, ModFn&& fn) {
+    return state_.withWLock([&](auto& state) {
+      auto iter = state.indices.find(ino);
+      if (iter == state.indices.end()) {
+        throw std::out_of_range(
+            folly::to<std::string>("no entry in InodeTable for inode ", ino));
+      }
+      auto index = iter->second;
+      CHECK_LT(index, state.storage.size());
+      fn(state.storage[index].record);
+      return state.storage[index].record;
+    });
+  }
+
   // TODO: replace with freeInodes - it's much more efficient to free a bunch
   // at once.
   void freeInode(InodeNumber ino) {
@@ -10,6 +10,7 @@
 #include "eden/fs/inodes/Overlay.h"
 
 #include <boost/filesystem.hpp>
+#include <fcntl.h>
 #include <folly/Exception.h>
 #include <folly/File.h>
 #include <folly/FileUtil.h>
@@ -340,7 +341,44 @@ InodeNumber Overlay::allocateInodeNumber() {
 }
 
 optional<DirContents> Overlay::loadOverlayDir(InodeNumber inodeNumber) {
-  auto dirData = deserializeOverlayDir(inodeNumber);
+  return convertOverlayDir(inodeNumber, deserializeOverlayDir(inodeNumber));
+}
+
+std::vector<folly::Try<optional<DirContents>>> Overlay::loadOverlayDirs(
+    folly::Range<const InodeNumber*> inodeNumbers) {
+  std::vector<folly::Try<File>> files;
+  files.reserve(inodeNumbers.size());
+  for (auto inodeNumber : inodeNumbers) {
+    files.push_back(folly::makeTryWith([&] {
+      auto file = openOverlayDirFile(inodeNumber);
+#ifdef __linux__
+      if (file) {
+        // This is only a hint, so a failure just means a slower read below.
+        posix_fadvise(file.fd(), 0, 0, POSIX_FADV_WILLNEED);
+      }
+#endif
+      return file;
+    }));
+  }
+
+  std::vector<folly::Try<optional<DirContents>>> results;
+  results.reserve(inodeNumbers.size());
+  for (size_t i = 0; i < inodeNumbers.size(); ++i) {
+    results.push_back(folly::makeTryWith([&]() -> optional<DirContents> {
+      const auto& file = files[i].value();
+      if (!file) {
+        return std::nullopt;
+      }
+      return convertOverlayDir(
+          inodeNumbers[i], deserializeOverlayDir(inodeNumbers[i], file));
+    }));
+  }
+  return results;
+}
+
+optional<DirContents> Overlay::convertOverlayDir(
+    InodeNumber inodeNumber,
+    optional<overlay::OverlayDir> dirData) {
   if (!dirData.has_value()) {
     return std::nullopt;
   }
@@ -560,14 +598,21 @@ Overlay::InodePath Overlay::getFilePath(InodeNumber inodeNumber) {
 
 optional<overlay::OverlayDir> Overlay::deserializeOverlayDir(
     InodeNumber inodeNumber) const {
-  // Open the file.  Return std::nullopt if the file does not exist.
+  auto file = openOverlayDirFile(inodeNumber);
+  if (!file) {
+    // There is no overlay here
+    return std::nullopt;
+  }
+  return deserializeOverlayDir(inodeNumber, file);
+}
+
+File Overlay::openOverlayDirFile(InodeNumber inodeNumber) const {
   auto path = getFilePath(inodeNumber);
   int fd = openat(dirFile_.fd(), path.c_str(), O_RDWR | O_CLOEXEC | O_NOFOLLOW);
   if (fd == -1) {
     int err = errno;
     if (err == ENOENT) {
-      // There is no overlay here
-      return std::nullopt;
+      return File{};
     }
     folly::throwSystemErrorExplicit(
         err,
@@ -576,7 +621,13 @@ optional<overlay::OverlayDir> Overlay::deserializeOverlayDir(
         " in ",
         localDir_);
   }
-  folly::File file{fd, /* ownsFd */ true};
+  return File{fd, /* ownsFd */ true};
+}
+
+optional<overlay::OverlayDir> Overlay::deserializeOverlayDir(
+    InodeNumber inodeNumber,
+    const File& file) const {
+  auto path = getFilePath(inodeNumber);
 
   // Read the file data
   std::string serializedData;
@@ -10,12 +10,14 @@
 #pragma once
 #include <folly/File.h>
 #include <folly/Range.h>
+#include <folly/Try.h>
 #include <folly/futures/Promise.h>
 #include <gtest/gtest_prod.h>
 #include <array>
 #include <condition_variable>
 #include <optional>
 #include <thread>
+#include <vector>
 #include "eden/fs/fuse/FuseTypes.h"
 #include "eden/fs/inodes/gen-cpp2/overlay_types.h"
 #include "eden/fs/utils/DirType.h"
@@ -127,6 +129,17 @@ class Overlay {
 
   std::optional<DirContents> loadOverlayDir(InodeNumber inodeNumber);
 
+  /**
+   * Load the overlay data for several directories at once.
+   *
+   * Every file is opened and given a readahead hint before any of them is
+   * read, so the kernel can fetch them concurrently rather than one at a time.
+   * Each result holds what loadOverlayDir() would have returned for the
+   * corresponding inode number, or the exception it would have thrown.
+   */
+  std::vector<folly::Try<std::optional<DirContents>>> loadOverlayDirs(
+      folly::Range<const InodeNumber*> inodeNumbers);
+
   void removeOverlayData(InodeNumber inodeNumber);
 
   /**
@@ -225,6 +238,20 @@ class Overlay {
   std::optional<overlay::OverlayDir> deserializeOverlayDir(
       InodeNumber inodeNumber) const;
 
+  /**
+   * Open the overlay file for a directory, returning a closed File if it
+   * does not exist.
+   */
+  folly::File openOverlayDirFile(InodeNumber inodeNumber) const;
+
+  std::optional<overlay::OverlayDir> deserializeOverlayDir(
+      InodeNumber inodeNumber,
+      const folly::File& file) const;
+
+  std::optional<DirContents> convertOverlayDir(
+      InodeNumber inodeNumber,
+      std::optional<overlay::OverlayDir> dirData);
+
   /**
    * Creates header for the files stored in Overlay
    */
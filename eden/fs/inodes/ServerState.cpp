@@ -112,5 +112,10 @@ std::unique_ptr<TopLevelIgnores> ServerState::getTopLevelIgnores() {
       std::move(userGitIgnore), std::move(systemGitIgnore));
 }
 
+size_t ServerState::getTopLevelIgnoresVersion() const {
+  return userIgnoreFileMonitor_.rlock()->getUpdateCount() +
+      systemIgnoreFileMonitor_.rlock()->getUpdateCount();
+}
+
 } // namespace eden
 } // namespace facebook
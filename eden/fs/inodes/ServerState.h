@@ -92,6 +92,12 @@ class ServerState : public ReloadableConfig {
    */
   std::unique_ptr<TopLevelIgnores> getTopLevelIgnores();
 
+  /**
+   * Returns a number that changes each time getTopLevelIgnores() picks up
+   * new contents for the system or user ignore file.
+   */
+  size_t getTopLevelIgnoresVersion() const;
+
   /**
    * Get the UserInfo object describing the user running this edenfs process.
    */
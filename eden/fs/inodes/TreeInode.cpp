@@ -15,6 +15,8 @@
 #include <folly/futures/Future.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+#include <atomic>
 #include <vector>
 
 #include "eden/fs/fuse/FuseChannel.h"
@@ -33,6 +35,7 @@
 #include "eden/fs/inodes/InodeTable.h"
 #include "eden/fs/inodes/Overlay.h"
 #include "eden/fs/inodes/TreeInodeDirHandle.h"
+#include "eden/fs/inodes/TreePrefetcher.h"
 #include "eden/fs/journal/JournalDelta.h"
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/TreeEntry.h"
@@ -60,12 +63,92 @@ using std::shared_ptr;
 using std::unique_ptr;
 using std::vector;
 
+DEFINE_uint64(
+    materialized_load_batch_size,
+    64,
+    "Number of overlay directory records read together when bulk loading "
+    "materialized inodes");
+DEFINE_uint64(
+    materialized_load_parallelism,
+    8,
+    "Maximum number of overlay read batches in flight at once when bulk "
+    "loading materialized inodes");
+
 namespace facebook {
 namespace eden {
 
 TreeInode::CreateResult::CreateResult(const EdenMount* mount)
     : attr(mount->initStatData()) {}
 
+/**
+ * Materialized directories whose loads have been claimed but whose overlay
+ * records still need to be read.
+ *
+ * Each reader claims the next batch of directories and reads all of their
+ * records with one Overlay::loadOverlayDirs() call, until none are left.
+ */
+class TreeInode::MaterializedDirQueue {
+ public:
+  struct Load {
+    TreeInodePtr parent;
+    PathComponent name;
+    InodeNumber number;
+    mode_t mode;
+    folly::Promise<unique_ptr<InodeBase>> promise;
+  };
+
+  explicit MaterializedDirQueue(vector<Load>&& loads)
+      : loads_{std::move(loads)} {}
+
+  void readAll(size_t batchSize) {
+    while (true) {
+      auto begin = next_.fetch_add(batchSize, std::memory_order_relaxed);
+      if (begin >= loads_.size()) {
+        return;
+      }
+      auto end = std::min(begin + batchSize, loads_.size());
+      readBatch(folly::range(loads_.begin() + begin, loads_.begin() + end));
+    }
+  }
+
+ private:
+  static void readBatch(folly::Range<vector<Load>::iterator> batch) {
+    auto* mount = batch.front().parent->getMount();
+    vector<InodeNumber> numbers;
+    numbers.reserve(batch.size());
+    for (const auto& load : batch) {
+      numbers.push_back(load.number);
+    }
+
+    auto results = mount->getOverlay()->loadOverlayDirs(numbers);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      auto& load = batch[i];
+      auto& result = results[i];
+      if (result.hasException()) {
+        load.promise.setException(std::move(result.exception()));
+      } else if (!result.value()) {
+        auto bug = EDEN_BUG() << "missing overlay for "
+                              << load.parent->getLogPath() << " / "
+                              << load.name;
+        load.promise.setException(bug.toException());
+      } else {
+        load.promise.setValue(make_unique<TreeInode>(
+            load.number,
+            load.parent,
+            load.name,
+            load.mode,
+            std::nullopt,
+            std::move(*result.value()),
+            std::nullopt));
+      }
+    }
+    mount->getStats()->get()->materializedLoadBatches.incrementValue(1);
+  }
+
+  vector<Load> loads_;
+  std::atomic<size_t> next_{0};
+};
+
 /**
  * A helper class to track info about inode loads that we started while holding
  * the contents_ lock.
@@ -86,6 +169,18 @@ class TreeInode::IncompleteInodeLoad {
         name_{name},
         future_{std::move(future)} {}
 
+  /**
+   * A load of a materialized directory whose overlay record is read later,
+   * in a batch with the others passed to finishLoads().
+   */
+  IncompleteInodeLoad(TreeInode* inode, MaterializedDirQueue::Load&& dirLoad)
+      : treeInode_{inode},
+        number_{dirLoad.number},
+        name_{dirLoad.name},
+        future_{dirLoad.promise.getFuture()},
+        dirLoad_{make_unique<MaterializedDirQueue::Load>(std::move(dirLoad))} {
+  }
+
   IncompleteInodeLoad(IncompleteInodeLoad&&) = default;
   IncompleteInodeLoad& operator=(IncompleteInodeLoad&&) = default;
 
@@ -103,6 +198,13 @@ class TreeInode::IncompleteInodeLoad {
                     << "calling finish()";
       finish();
     }
+    if (dirLoad_) {
+      // Nothing is going to batch this read, so do it now rather than leave
+      // the load hanging.
+      vector<MaterializedDirQueue::Load> loads;
+      loads.push_back(std::move(*dirLoad_));
+      MaterializedDirQueue{std::move(loads)}.readAll(1);
+    }
   }
 
   void finish() {
@@ -112,6 +214,14 @@ class TreeInode::IncompleteInodeLoad {
     treeInode_.release()->registerInodeLoadComplete(future_, name_, number_);
   }
 
+  /**
+   * Take the overlay read this load still needs, if it was created for a
+   * materialized directory.
+   */
+  unique_ptr<MaterializedDirQueue::Load> takeDirLoad() {
+    return std::move(dirLoad_);
+  }
+
  private:
   struct NoopDeleter {
     void operator()(TreeInode*) const {}
@@ -124,6 +234,7 @@ class TreeInode::IncompleteInodeLoad {
   InodeNumber number_;
   PathComponent name_;
   Future<unique_ptr<InodeBase>> future_;
+  unique_ptr<MaterializedDirQueue::Load> dirLoad_;
 };
 
 TreeInode::TreeInode(
@@ -172,6 +283,10 @@ folly::Future<Dispatcher::Attr> TreeInode::getattr() {
   return getAttrLocked(contents_.rlock()->entries);
 }
 
+std::optional<Dispatcher::Attr> TreeInode::getattrIfReady() {
+  return getAttrLocked(contents_.rlock()->entries);
+}
+
 Dispatcher::Attr TreeInode::getAttrLocked(const DirContents& contents) {
   Dispatcher::Attr attr(getMount()->initStatData());
 
@@ -189,6 +304,15 @@ folly::Future<InodePtr> TreeInode::getChildByName(
   return getOrLoadChild(namepiece);
 }
 
+InodePtr TreeInode::getLoadedChild(PathComponentPiece name) {
+  auto contents = contents_.rlock();
+  auto iter = contents->entries.find(name);
+  if (iter == contents->entries.end() || !iter->second.getInode()) {
+    return nullptr;
+  }
+  return iter->second.getInodePtr();
+}
+
 Future<InodePtr> TreeInode::getOrLoadChild(PathComponentPiece name) {
   TraceBlock block("getOrLoadChild");
 
@@ -585,6 +709,7 @@ Future<unique_ptr<InodeBase>> TreeInode::startLoadingInode(
   }
 
   if (!entry.isMaterialized()) {
+    getMount()->getTreePrefetcher()->recordFetch(entry.getHash());
     return getStore()
         ->getTree(entry.getHash())
         .thenValue(
@@ -1938,7 +2063,17 @@ Future<Unit> TreeInode::computeDiff(
     // their entry state.
     auto contents = std::move(contentsLock);
 
+    // When the diff is restricted to a few paths, only look at the entries
+    // that lead to them.
+    const bool includeAll = context->isIncludedByFilter(currentPath);
+    auto isFiltered = [&](PathComponentPiece name) {
+      return !includeAll && !context->isOnFilterPath(currentPath + name);
+    };
+
     auto processUntracked = [&](PathComponentPiece name, DirEntry* inodeEntry) {
+      if (isFiltered(name)) {
+        return;
+      }
       bool entryIgnored = isIgnored;
       auto fileType = inodeEntry->isDirectory() ? GitIgnore::TYPE_DIR
                                                 : GitIgnore::TYPE_FILE;
@@ -1965,7 +2100,7 @@ Future<Unit> TreeInode::computeDiff(
                     ignore.get(),
                     entryIgnored));
           } else {
-            auto inodeFuture = self->loadChildLocked(
+            auto inodeFuture = self->loadChildBatchedLocked(
                 contents->entries, name, *inodeEntry, &pendingLoads);
             deferredEntries.emplace_back(
                 DeferredDiffEntry::createUntrackedEntryFromInodeFuture(
@@ -1991,6 +2126,9 @@ Future<Unit> TreeInode::computeDiff(
     };
 
     auto processRemoved = [&](const TreeEntry& scmEntry) {
+      if (isFiltered(scmEntry.getName())) {
+        return;
+      }
       if (scmEntry.isTree()) {
         deferredEntries.emplace_back(DeferredDiffEntry::createRemovedEntry(
             context, currentPath + scmEntry.getName(), scmEntry));
@@ -2004,6 +2142,10 @@ Future<Unit> TreeInode::computeDiff(
 
     auto processBothPresent = [&](const TreeEntry& scmEntry,
                                   DirEntry* inodeEntry) {
+      if (isFiltered(scmEntry.getName())) {
+        return;
+      }
+
       // We only need to know the ignored status if this is a directory.
       // If this is a regular file on disk and in source control, then it
       // is always included since it is already tracked in source control.
@@ -2036,7 +2178,7 @@ Future<Unit> TreeInode::computeDiff(
       } else if (inodeEntry->isMaterialized()) {
         // This inode is not loaded but is materialized.
         // We'll have to load it to confirm if it is the same or different.
-        auto inodeFuture = self->loadChildLocked(
+        auto inodeFuture = self->loadChildBatchedLocked(
             contents->entries, scmEntry.getName(), *inodeEntry, &pendingLoads);
         deferredEntries.emplace_back(
             DeferredDiffEntry::createModifiedEntryFromInodeFuture(
@@ -2059,7 +2201,7 @@ Future<Unit> TreeInode::computeDiff(
       } else if (inodeEntry->isDirectory()) {
         // This is a modified directory.  We have to load it then recurse
         // into it to find files with differences.
-        auto inodeFuture = self->loadChildLocked(
+        auto inodeFuture = self->loadChildBatchedLocked(
             contents->entries, scmEntry.getName(), *inodeEntry, &pendingLoads);
         deferredEntries.emplace_back(
             DeferredDiffEntry::createModifiedEntryFromInodeFuture(
@@ -2156,10 +2298,9 @@ Future<Unit> TreeInode::computeDiff(
   }
 
   // Finish setting up any load operations we started while holding the
-  // contents_ lock above.
-  for (auto& load : pendingLoads) {
-    load.finish();
-  }
+  // contents_ lock above.  Materialized directories have their overlay
+  // records read together, in batches.
+  finishLoads(pendingLoads);
 
   // Now process all of the deferred work.
   vector<Future<Unit>> deferredFutures;
@@ -2212,10 +2353,9 @@ Future<Unit> TreeInode::checkout(
   computeCheckoutActions(
       ctx, fromTree.get(), toTree.get(), &actions, &pendingLoads);
 
-  // Wire up the callbacks for any pending inode loads we started
-  for (auto& load : pendingLoads) {
-    load.finish();
-  }
+  // Wire up the callbacks for any pending inode loads we started, and read
+  // the overlay records of materialized directories in batches.
+  finishLoads(pendingLoads);
 
   // Now start all of the checkout actions
   vector<Future<Unit>> actionFutures;
@@ -2477,7 +2617,8 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
     // This child is potentially modified (or has saved state that must be
     // updated), but is not currently loaded. Start loading it and create a
     // CheckoutAction to process it once it is loaded.
-    auto inodeFuture = loadChildLocked(contents, name, entry, pendingLoads);
+    auto inodeFuture =
+        loadChildBatchedLocked(contents, name, entry, pendingLoads);
     return make_unique<CheckoutAction>(
         ctx, oldScmEntry, newScmEntry, std::move(inodeFuture));
   } else {
@@ -2496,7 +2637,8 @@ unique_ptr<CheckoutAction> TreeInode::processCheckoutEntry(
     // If this is a directory we unfortunately have to load it and recurse into
     // it just so we can accurately report the list of files with conflicts.
     if (entry.isDirectory()) {
-      auto inodeFuture = loadChildLocked(contents, name, entry, pendingLoads);
+      auto inodeFuture =
+          loadChildBatchedLocked(contents, name, entry, pendingLoads);
       return make_unique<CheckoutAction>(
           ctx, oldScmEntry, newScmEntry, std::move(inodeFuture));
     }
@@ -2867,14 +3009,82 @@ folly::Future<InodePtr> TreeInode::loadChildLocked(
   return future;
 }
 
-folly::Future<folly::Unit> TreeInode::loadMaterializedChildren() {
+folly::Future<InodePtr> TreeInode::loadChildBatchedLocked(
+    DirContents& contents,
+    PathComponentPiece name,
+    DirEntry& entry,
+    std::vector<IncompleteInodeLoad>* pendingLoads) {
+  if (!entry.isDirectory() || !entry.isMaterialized()) {
+    return loadChildLocked(contents, name, entry, pendingLoads);
+  }
+  DCHECK(!entry.getInode());
+
+  // Claim the load now, but leave reading the overlay record to
+  // finishLoads(), once the contents_ lock has been released.
+  folly::Promise<InodePtr> promise;
+  auto future = promise.getFuture();
+  auto number = entry.getInodeNumber();
+  if (getInodeMap()->shouldLoadChild(this, name, number, std::move(promise))) {
+    pendingLoads->emplace_back(
+        this,
+        MaterializedDirQueue::Load{inodePtrFromThis(),
+                                   PathComponent{name},
+                                   number,
+                                   entry.getInitialMode(),
+                                   {}});
+  }
+  return future;
+}
+
+void TreeInode::finishLoads(std::vector<IncompleteInodeLoad>& pendingLoads) {
+  std::vector<MaterializedDirQueue::Load> dirLoads;
+  for (auto& load : pendingLoads) {
+    load.finish();
+    if (auto dirLoad = load.takeDirLoad()) {
+      dirLoads.push_back(std::move(*dirLoad));
+    }
+  }
+  if (dirLoads.empty()) {
+    return;
+  }
+
+  // Read the directory records with a bounded number of readers.  The
+  // calling thread is one of them, so the loads complete even if the
+  // background threads are busy, and a single batch needs no thread hop.
+  auto* mount = dirLoads.front().parent->getMount();
+  auto batchSize = std::max<size_t>(FLAGS_materialized_load_batch_size, 1);
+  auto numBatches = (dirLoads.size() + batchSize - 1) / batchSize;
+  auto numReaders = std::min<size_t>(
+      std::max<size_t>(FLAGS_materialized_load_parallelism, 1), numBatches);
+  auto queue = std::make_shared<MaterializedDirQueue>(std::move(dirLoads));
+  for (size_t i = 1; i < numReaders; ++i) {
+    mount->getThreadPool()->addWithPriority(
+        [queue, batchSize] { queue->readAll(batchSize); },
+        UnboundedQueueExecutor::kBackgroundPriority);
+  }
+  queue->readAll(batchSize);
+}
+
+folly::Future<folly::Unit> TreeInode::loadMaterializedChildren(
+    bool recursive) {
+  return loadMaterializedLevel({inodePtrFromThis()}, recursive);
+}
+
+folly::Future<folly::Unit> TreeInode::loadMaterializedLevel(
+    std::vector<TreeInodePtr> dirs,
+    bool recursive) {
+  if (dirs.empty()) {
+    return folly::makeFuture();
+  }
+  auto* mount = dirs.front()->getMount();
+
   std::vector<IncompleteInodeLoad> pendingLoads;
   std::vector<Future<InodePtr>> inodeFutures;
 
-  {
-    auto contents = contents_.wlock();
+  for (const auto& dir : dirs) {
+    auto contents = dir->contents_.wlock();
     if (!contents->isMaterialized()) {
-      return folly::makeFuture();
+      continue;
     }
 
     for (auto& entry : contents->entries) {
@@ -2885,31 +3095,42 @@ folly::Future<folly::Unit> TreeInode::loadMaterializedChildren() {
       }
 
       if (ent.getInode()) {
-        // Already loaded, most likely via prefetch
+        // Already loaded, most likely via prefetch.  Its own materialized
+        // children may not be, so keep it for the next level.
+        if (recursive && ent.isDirectory()) {
+          inodeFutures.emplace_back(makeFuture(ent.getInodePtr()));
+        }
         continue;
       }
 
-      auto future =
-          loadChildLocked(contents->entries, name, ent, &pendingLoads);
-      inodeFutures.emplace_back(std::move(future));
+      // Files are created without reading anything from the overlay, and
+      // directories have their records read in batches by finishLoads().
+      inodeFutures.emplace_back(dir->loadChildBatchedLocked(
+          contents->entries, name, ent, &pendingLoads));
     }
   }
 
-  // Hook up the pending load futures to properly complete the loading process
-  // then the futures are ready.  We can only do this after releasing the
-  // contents_ lock.
-  for (auto& load : pendingLoads) {
-    load.finish();
-  }
-
-  // Now add callbacks to the Inode futures so that we recurse into
-  // children directories when each child inode becomes ready.
-  std::vector<Future<folly::Unit>> results;
-  for (auto& future : inodeFutures) {
-    results.emplace_back(std::move(future).unit());
-  }
+  // Hook up the pending load futures and start reading the overlay.  We can
+  // only do this after releasing the contents_ locks.
+  mount->getStats()->get()->materializedLoadInodes.incrementValue(
+      pendingLoads.size());
+  finishLoads(pendingLoads);
 
-  return folly::collectAll(results).unit();
+  return folly::collectAll(inodeFutures)
+      .thenValue([recursive](std::vector<folly::Try<InodePtr>> results) {
+        if (!recursive) {
+          return folly::makeFuture();
+        }
+        std::vector<TreeInodePtr> nextLevel;
+        for (auto& result : results) {
+          if (result.hasValue()) {
+            if (auto tree = result.value().asTreePtrOrNull()) {
+              nextLevel.push_back(std::move(tree));
+            }
+          }
+        }
+        return loadMaterializedLevel(std::move(nextLevel), recursive);
+      });
 }
 
 namespace {
@@ -3207,7 +3428,9 @@ InodeMetadata TreeInode::getMetadataLocked(const DirContents&) const {
 }
 
 folly::Future<folly::Unit> TreeInode::prefetch() {
-  return folly::via(getMount()->getThreadPool().get())
+  return folly::via(
+             getMount()->getThreadPool().get(),
+             UnboundedQueueExecutor::kBackgroundPriority)
       .thenValue([this](auto&&) { return loadMaterializedChildren(); });
 }
 
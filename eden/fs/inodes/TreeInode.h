@@ -119,6 +119,7 @@ class TreeInode final : public InodeBaseMetadata<DirContents> {
   ~TreeInode() override;
 
   folly::Future<Dispatcher::Attr> getattr() override;
+  std::optional<Dispatcher::Attr> getattrIfReady() override;
   folly::Future<Dispatcher::Attr> setattr(const fuse_setattr_in& attr) override;
 
   folly::Future<std::vector<std::string>> listxattr() override;
@@ -137,6 +138,14 @@ class TreeInode final : public InodeBaseMetadata<DirContents> {
    * The Inode object will be loaded if it is not already loaded.
    */
   folly::Future<InodePtr> getOrLoadChild(PathComponentPiece name);
+
+  /**
+   * Get the inode object for a child of this directory if it is already
+   * loaded.
+   *
+   * Returns nullptr if the child is not loaded, or if it does not exist.
+   */
+  InodePtr getLoadedChild(PathComponentPiece name);
   folly::Future<TreeInodePtr> getOrLoadChildTree(PathComponentPiece name);
 
   /**
@@ -336,10 +345,17 @@ class TreeInode final : public InodeBaseMetadata<DirContents> {
   /**
    * Load materialized children underneath this TreeInode.
    *
+   * The overlay records of materialized child directories are read in
+   * parallel batches on the mount's thread pool.  If recursive is true, the
+   * materialized children of those directories are loaded too, one level of
+   * the tree at a time, until every materialized inode in the subtree is
+   * loaded.
+   *
    * Returns a Future that completes once all materialized inodes have been
    * loaded.
    */
-  FOLLY_NODISCARD folly::Future<folly::Unit> loadMaterializedChildren();
+  FOLLY_NODISCARD folly::Future<folly::Unit> loadMaterializedChildren(
+      bool recursive = false);
 
   /*
    * Update a tree entry as part of a checkout operation.
@@ -395,6 +411,7 @@ class TreeInode final : public InodeBaseMetadata<DirContents> {
  private:
   class TreeRenameLocks;
   class IncompleteInodeLoad;
+  class MaterializedDirQueue;
 
   InodeMetadata getMetadataLocked(const DirContents&) const;
 
@@ -418,6 +435,14 @@ class TreeInode final : public InodeBaseMetadata<DirContents> {
       PathComponentPiece childName,
       std::unique_ptr<InodeBase> childInode);
 
+  /**
+   * Load the materialized children of every directory in dirs, then move on
+   * to the next level of the tree if recursive is true.
+   */
+  static folly::Future<folly::Unit> loadMaterializedLevel(
+      std::vector<TreeInodePtr> dirs,
+      bool recursive);
+
   folly::Future<std::unique_ptr<InodeBase>> startLoadingInodeNoThrow(
       const DirEntry& entry,
       PathComponentPiece name) noexcept;
@@ -571,6 +596,26 @@ class TreeInode final : public InodeBaseMetadata<DirContents> {
       DirEntry& entry,
       std::vector<IncompleteInodeLoad>* pendingLoads);
 
+  /**
+   * Like loadChildLocked(), but a materialized directory's overlay record is
+   * not read until finishLoads() is called, so that the records of many
+   * directories can be read together.  Used by diff and checkout, which load
+   * all of the materialized children they come across.
+   */
+  folly::Future<InodePtr> loadChildBatchedLocked(
+      DirContents& dir,
+      PathComponentPiece name,
+      DirEntry& entry,
+      std::vector<IncompleteInodeLoad>* pendingLoads);
+
+  /**
+   * Finish the loads started while holding contents_ locks.  This must be
+   * called after the locks are released.  The overlay records deferred by
+   * loadChildBatchedLocked() are read in batches by the calling thread,
+   * helped by a bounded number of background threads.
+   */
+  static void finishLoads(std::vector<IncompleteInodeLoad>& pendingLoads);
+
   /**
    * Load the .gitignore file for this directory, then call computeDiff() once
    * it is loaded.
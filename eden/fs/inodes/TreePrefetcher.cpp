@@ -0,0 +1,203 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/TreePrefetcher.h"
+
+#include <folly/futures/Future.h>
+#include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/store/ObjectStore.h"
+#include "eden/fs/utils/UnboundedQueueExecutor.h"
+
+DEFINE_bool(
+    enable_tree_prefetch,
+    true,
+    "Prefetch source control data for directories that are being walked");
+DEFINE_int32(
+    tree_prefetch_trigger,
+    3,
+    "Number of child accesses in a directory before its remaining children "
+    "are prefetched");
+DEFINE_int32(
+    tree_prefetch_max_per_directory,
+    1000,
+    "Maximum number of objects to prefetch for a single directory");
+DEFINE_int32(
+    tree_prefetch_mount_budget,
+    10000,
+    "Maximum number of objects being prefetched at once for a single mount");
+
+namespace facebook {
+namespace eden {
+
+namespace {
+/** How many recently accessed directories to track per mount. */
+constexpr size_t kMaxTrackedDirectories = 10000;
+/** How many prefetched-but-unused object IDs to remember per mount. */
+constexpr size_t kMaxTrackedPrefetches = 100000;
+} // namespace
+
+TreePrefetcher::UnusedPrefetchShard::UnusedPrefetchShard()
+    : ids{folly::in_place, kMaxTrackedPrefetches / kNumUnusedPrefetchShards} {}
+
+TreePrefetcher::TreePrefetcher(EdenMount* mount)
+    : mount_{mount}, dirAccesses_{folly::in_place, kMaxTrackedDirectories} {
+  for (auto& shard : unusedPrefetches_) {
+    shard.ids.wlock()->setPruneHook(
+        [this, stats = mount_->getStats()](const Hash&, folly::Unit&&) {
+          unusedPrefetchCount_.fetch_sub(1, std::memory_order_relaxed);
+          stats->get()->prefetchWasted.incrementValue();
+        });
+  }
+}
+
+TreePrefetcher::~TreePrefetcher() {}
+
+void TreePrefetcher::recordLookup(const TreeInodePtr& parent) {
+  recordChildAccess(parent);
+}
+
+void TreePrefetcher::recordOpendir(const TreeInodePtr& dir) {
+  // Opening several sibling directories in a row is a strong hint that the
+  // rest of the siblings will be opened too.
+  auto parent = dir->getParentRacy();
+  if (parent) {
+    recordChildAccess(parent);
+  }
+}
+
+void TreePrefetcher::recordFetch(const Hash& id) {
+  if (unusedPrefetchCount_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  if (getUnusedPrefetchShard(id).ids.wlock()->erase(id)) {
+    unusedPrefetchCount_.fetch_sub(1, std::memory_order_relaxed);
+    mount_->getStats()->get()->prefetchUsed.incrementValue();
+  }
+}
+
+TreePrefetcher::UnusedPrefetchShard& TreePrefetcher::getUnusedPrefetchShard(
+    const Hash& id) {
+  return unusedPrefetches_[id.getHashCode() % kNumUnusedPrefetchShards];
+}
+
+void TreePrefetcher::trackPrefetch(const Hash& id) {
+  auto ids = getUnusedPrefetchShard(id).ids.wlock();
+  if (ids->exists(id)) {
+    return;
+  }
+  // Count the ID before inserting it, since inserting may evict another ID
+  // and run the prune hook.
+  unusedPrefetchCount_.fetch_add(1, std::memory_order_relaxed);
+  ids->set(id, folly::unit);
+}
+
+void TreePrefetcher::recordChildAccess(const TreeInodePtr& dir) {
+  if (!FLAGS_enable_tree_prefetch) {
+    return;
+  }
+
+  {
+    auto dirAccesses = dirAccesses_.wlock();
+    auto it = dirAccesses->find(dir->getNodeId());
+    if (it == dirAccesses->end()) {
+      it = dirAccesses->insert(dir->getNodeId(), DirAccess{}).first;
+    }
+    auto& access = it->second;
+    if (access.prefetched ||
+        ++access.childAccesses <
+            static_cast<uint32_t>(FLAGS_tree_prefetch_trigger)) {
+      return;
+    }
+    access.prefetched = true;
+  }
+
+  // Do the actual work on the server thread pool rather than in the FUSE
+  // worker thread that noticed the pattern, behind any interactive work.
+  mount_->getThreadPool()->addWithPriority(
+      [this, dir] { prefetchChildren(dir); },
+      UnboundedQueueExecutor::kBackgroundPriority);
+}
+
+void TreePrefetcher::prefetchChildren(TreeInodePtr dir) {
+  auto maxPerDir = static_cast<size_t>(FLAGS_tree_prefetch_max_per_directory);
+  auto budget = static_cast<size_t>(FLAGS_tree_prefetch_mount_budget);
+
+  std::vector<Hash> trees;
+  std::vector<Hash> blobs;
+  {
+    auto contents = dir->getContents().rlock();
+    for (const auto& entry : contents->entries) {
+      const auto& ent = entry.second;
+      if (ent.getInode() || ent.isMaterialized()) {
+        continue;
+      }
+      if (trees.size() + blobs.size() >= maxPerDir) {
+        break;
+      }
+      if (ent.isDirectory()) {
+        trees.push_back(ent.getHash());
+      } else {
+        blobs.push_back(ent.getHash());
+      }
+    }
+  }
+
+  auto count = trees.size() + blobs.size();
+  if (count == 0) {
+    return;
+  }
+
+  // Reserve our share of the mount's budget, or give up entirely.  Partial
+  // prefetches are not worth the complexity of deciding which half to drop.
+  auto inFlight = inFlight_.load(std::memory_order_relaxed);
+  do {
+    if (inFlight + count > budget) {
+      XLOG(DBG4) << "skipping prefetch of " << count << " objects for "
+                 << dir->getLogPath() << ": " << inFlight
+                 << " objects already in flight";
+      mount_->getStats()->get()->prefetchOverBudget.incrementValue();
+      return;
+    }
+  } while (!inFlight_.compare_exchange_weak(
+      inFlight, inFlight + count, std::memory_order_relaxed));
+
+  XLOG(DBG4) << "prefetching " << trees.size() << " trees and " << blobs.size()
+             << " blobs for " << dir->getLogPath();
+  for (const auto& id : trees) {
+    trackPrefetch(id);
+  }
+  mount_->getStats()->get()->prefetchTreesIssued.incrementValue(trees.size());
+
+  auto* store = mount_->getObjectStore();
+  std::vector<folly::Future<folly::Unit>> futures;
+  futures.emplace_back(store->prefetchTrees(trees));
+  // prefetchBlobMetadata() only loads metadata that is already stored
+  // locally, so only the blobs it actually loaded count as prefetched.
+  futures.emplace_back(store->prefetchBlobMetadata(blobs).thenValue(
+      [this](std::vector<Hash>&& loaded) {
+        for (const auto& id : loaded) {
+          trackPrefetch(id);
+        }
+        mount_->getStats()->get()->prefetchBlobMetadataIssued.incrementValue(
+            loaded.size());
+      }));
+  // Holding dir keeps the EdenMount (and therefore this object) alive until
+  // the prefetch completes.
+  folly::collectAll(futures).thenTry(
+      [this, count, dir = std::move(dir)](auto&&) {
+        inFlight_.fetch_sub(count, std::memory_order_relaxed);
+      });
+}
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/lang/Align.h>
+#include <array>
+#include <atomic>
+
+#include "eden/fs/fuse/FuseTypes.h"
+#include "eden/fs/inodes/InodePtr.h"
+#include "eden/fs/model/Hash.h"
+
+namespace facebook {
+namespace eden {
+
+class EdenMount;
+
+/**
+ * TreePrefetcher watches directory access patterns on a mount and warms the
+ * ObjectStore with the source control data that the accessing process is
+ * likely to need next.
+ *
+ * Two patterns are currently recognized:
+ * - A process looks up several children of the same directory.  This is
+ *   typical of a recursive walk, so we fetch the Trees for the remaining
+ *   child directories and the metadata for the remaining child files.
+ * - A process opens several sibling directories for reading.  This is
+ *   treated as an access to their common parent, with the same result.
+ *
+ * Only entries that are neither loaded nor materialized are prefetched, since
+ * everything else already has its data available locally.
+ *
+ * The amount of outstanding prefetch work is bounded per mount.  Prefetched
+ * object IDs are remembered in a bounded set so that we can report how many
+ * of them were later used by an inode load, and how many aged out unused.
+ *
+ * All methods are thread-safe.
+ */
+class TreePrefetcher {
+ public:
+  explicit TreePrefetcher(EdenMount* mount);
+  ~TreePrefetcher();
+
+  /**
+   * Record that a child of the given directory was looked up.
+   */
+  void recordLookup(const TreeInodePtr& parent);
+
+  /**
+   * Record that the given directory was opened for reading.
+   */
+  void recordOpendir(const TreeInodePtr& dir);
+
+  /**
+   * Record that an inode load needed the object with the given ID.
+   *
+   * This is used purely to track prefetch effectiveness.
+   */
+  void recordFetch(const Hash& id);
+
+  /**
+   * Returns the number of objects currently being prefetched.
+   */
+  size_t getInFlightCount() const {
+    return inFlight_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct DirAccess {
+    uint32_t childAccesses{0};
+    bool prefetched{false};
+  };
+
+  TreePrefetcher(TreePrefetcher const&) = delete;
+  TreePrefetcher& operator=(TreePrefetcher const&) = delete;
+
+  void recordChildAccess(const TreeInodePtr& dir);
+  void prefetchChildren(TreeInodePtr dir);
+  void trackPrefetch(const Hash& id);
+
+  EdenMount* const mount_;
+
+  /**
+   * Recently accessed directories, keyed by inode number.
+   */
+  folly::Synchronized<folly::EvictingCacheMap<InodeNumber, DirAccess>>
+      dirAccesses_;
+
+  /**
+   * IDs that were prefetched but have not yet been used by an inode load.
+   * Entries evicted from these maps are counted as wasted prefetches.
+   *
+   * recordFetch() is called on every tree load and stat, so the set is
+   * sharded by ID, and unusedPrefetchCount_ lets it return without taking
+   * any lock while nothing prefetched is waiting to be used.
+   */
+  static constexpr size_t kNumUnusedPrefetchShards = 16;
+  using UnusedPrefetchMap = folly::EvictingCacheMap<Hash, folly::Unit>;
+  struct alignas(folly::hardware_destructive_interference_size)
+      UnusedPrefetchShard {
+    UnusedPrefetchShard();
+    folly::Synchronized<UnusedPrefetchMap> ids;
+  };
+  UnusedPrefetchShard& getUnusedPrefetchShard(const Hash& id);
+  std::array<UnusedPrefetchShard, kNumUnusedPrefetchShards> unusedPrefetches_;
+  std::atomic<size_t> unusedPrefetchCount_{0};
+
+  std::atomic<size_t> inFlight_{0};
+};
+} // namespace eden
+} // namespace facebook
@@ -14,6 +14,7 @@
 #include <gtest/gtest.h>
 
 #include "eden/fs/inodes/DiffContext.h"
+#include "eden/fs/inodes/Differ.h"
 #include "eden/fs/inodes/FileInode.h"
 #include "eden/fs/inodes/InodeDiffCallback.h"
 #include "eden/fs/inodes/TopLevelIgnores.h"
@@ -1231,3 +1232,129 @@ TEST(DiffTest, fileNotReady) {
           RelativePath{"doc/c.txt"},
           RelativePath{"doc/d.txt"}));
 }
+
+namespace {
+struct StatusCacheCounts {
+  int64_t hit{0};
+  int64_t partial{0};
+  int64_t full{0};
+};
+
+StatusCacheCounts getStatusCacheCounts(TestMount& mount) {
+  StatusCacheCounts counts;
+  for (auto& stats : mount.getEdenMount()->getStats()->accessAllThreads()) {
+    counts.hit += stats.statusCacheHit.value();
+    counts.partial += stats.statusCachePartial.value();
+    counts.full += stats.statusCacheFull.value();
+  }
+  return counts;
+}
+
+std::map<std::string, ScmFileStatus> getStatus(TestMount& mount) {
+  auto edenMount = mount.getEdenMount();
+  auto future = diffMountForStatus(
+      edenMount.get(), edenMount->getParentCommits().parent1(), false);
+  return EXPECT_FUTURE_RESULT(future)->entries;
+}
+} // namespace
+
+TEST(DiffTest, statusCacheHit) {
+  DiffTest test;
+  auto& mount = test.getMount();
+  mount.overwriteFile("src/1.txt", "This file has been updated.\n");
+
+  std::map<std::string, ScmFileStatus> expected{
+      {"src/1.txt", ScmFileStatus::MODIFIED}};
+  EXPECT_EQ(expected, getStatus(mount));
+  EXPECT_EQ(expected, getStatus(mount));
+
+  auto counts = getStatusCacheCounts(mount);
+  EXPECT_EQ(1, counts.full);
+  EXPECT_EQ(0, counts.partial);
+  EXPECT_EQ(1, counts.hit);
+}
+
+TEST(DiffTest, statusCacheRediffsChangedPaths) {
+  DiffTest test;
+  auto& mount = test.getMount();
+  mount.overwriteFile("src/1.txt", "This file has been updated.\n");
+  getStatus(mount);
+
+  mount.addFile("src/new.txt", "extra stuff");
+  mount.deleteFile("doc/readme.txt");
+  std::map<std::string, ScmFileStatus> expected{
+      {"src/1.txt", ScmFileStatus::MODIFIED},
+      {"src/new.txt", ScmFileStatus::ADDED},
+      {"doc/readme.txt", ScmFileStatus::REMOVED}};
+  EXPECT_EQ(expected, getStatus(mount));
+
+  // Restoring the original contents drops the file from the status.
+  mount.overwriteFile("src/1.txt", "This is src/1.txt.\n");
+  expected.erase("src/1.txt");
+  EXPECT_EQ(expected, getStatus(mount));
+
+  // Renaming a directory re-diffs everything underneath both names.
+  mount.move("src/a", "src/z");
+  expected.emplace("src/a/b/3.txt", ScmFileStatus::REMOVED);
+  expected.emplace("src/a/b/c/4.txt", ScmFileStatus::REMOVED);
+  expected.emplace("src/z/b/3.txt", ScmFileStatus::ADDED);
+  expected.emplace("src/z/b/c/4.txt", ScmFileStatus::ADDED);
+  EXPECT_EQ(expected, getStatus(mount));
+
+  auto counts = getStatusCacheCounts(mount);
+  EXPECT_EQ(1, counts.full);
+  EXPECT_EQ(3, counts.partial);
+  EXPECT_EQ(0, counts.hit);
+}
+
+TEST(DiffTest, statusCacheAppliesNewIgnoreFile) {
+  DiffTest test;
+  auto& mount = test.getMount();
+  mount.addFile("src/a/new.txt", "extra stuff");
+  mount.addFile("src/a/b/new.txt", "extra stuff");
+  std::map<std::string, ScmFileStatus> expected{
+      {"src/a/new.txt", ScmFileStatus::ADDED},
+      {"src/a/b/new.txt", ScmFileStatus::ADDED}};
+  EXPECT_EQ(expected, getStatus(mount));
+
+  // The new ignore file applies to files that did not change themselves.
+  mount.addFile("src/a/.gitignore", "new.txt\n");
+  expected = {{"src/a/.gitignore", ScmFileStatus::ADDED}};
+  EXPECT_EQ(expected, getStatus(mount));
+
+  auto counts = getStatusCacheCounts(mount);
+  EXPECT_EQ(1, counts.full);
+  EXPECT_EQ(1, counts.partial);
+}
+
+TEST(DiffTest, streamMountStatusDeliversEveryEntryInChunks) {
+  DiffTest test;
+  auto& mount = test.getMount();
+  mount.overwriteFile("src/1.txt", "This file has been updated.\n");
+  mount.addFile("src/new.txt", "extra stuff");
+  mount.addFile("src/a/new.txt", "extra stuff");
+  mount.deleteFile("doc/readme.txt");
+  mount.deleteFile("src/a/b/3.txt");
+
+  std::map<std::string, ScmFileStatus> streamed;
+  size_t numChunks = 0;
+  auto edenMount = mount.getEdenMount();
+  auto future = streamMountStatus(
+      edenMount.get(),
+      edenMount->getParentCommits().parent1(),
+      /*listIgnored=*/false,
+      /*chunkSize=*/2,
+      [&](ScmStatus&& chunk) {
+        EXPECT_LE(chunk.entries.size(), 2);
+        ++numChunks;
+        for (auto& entry : chunk.entries) {
+          EXPECT_TRUE(streamed.insert(entry).second) << entry.first;
+        }
+      });
+  EXPECT_FUTURE_RESULT(future);
+
+  EXPECT_EQ(getStatus(mount), streamed);
+  EXPECT_EQ(3, numChunks);
+  // Streaming does not populate the status cache.
+  EXPECT_EQ(1, getStatusCacheCounts(mount).full);
+}
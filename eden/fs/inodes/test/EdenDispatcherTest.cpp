@@ -99,3 +99,40 @@ TEST_F(EdenDispatcherTest, createReturnsNameTooLong) {
     EXPECT_EQ(ENAMETOOLONG, e.code().value());
   }
 }
+
+TEST(EdenDispatcherIfReady, lookupIfReadyOnlyAnswersLoadedChildren) {
+  FakeTreeBuilder builder;
+  builder.setFile("src/main.c", "int main() {}\n");
+  TestMount mount{builder};
+  auto dispatcher = mount.getDispatcher();
+
+  EXPECT_FALSE(dispatcher->lookupIfReady(kRootNodeId, "src"_pc).has_value());
+
+  auto src = mount.getTreeInode("src");
+  auto entry = dispatcher->lookupIfReady(kRootNodeId, "src"_pc);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(src->getNodeId().get(), entry->nodeid);
+  EXPECT_EQ(src->getNodeId().get(), entry->attr.ino);
+  EXPECT_TRUE(S_ISDIR(entry->attr.mode));
+
+  EXPECT_FALSE(
+      dispatcher->lookupIfReady(src->getNodeId(), "missing.c"_pc).has_value());
+}
+
+TEST(EdenDispatcherIfReady, getattrIfReadyNeedsCachedBlobMetadata) {
+  FakeTreeBuilder builder;
+  builder.setFile("src/main.c", "int main() {}\n");
+  TestMount mount{builder};
+  auto dispatcher = mount.getDispatcher();
+
+  auto file = mount.getFileInode("src/main.c");
+  EXPECT_FALSE(dispatcher->getattrIfReady(file->getNodeId()).has_value());
+
+  // getattr() fetches the blob metadata, after which the size is known.
+  auto attr = dispatcher->getattr(file->getNodeId()).get(0ms);
+  auto readyAttr = dispatcher->getattrIfReady(file->getNodeId());
+  ASSERT_TRUE(readyAttr.has_value());
+  EXPECT_EQ(attr.st.st_size, readyAttr->st.st_size);
+  EXPECT_EQ(attr.st.st_mode, readyAttr->st.st_mode);
+  EXPECT_EQ(14, readyAttr->st.st_size);
+}
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <fcntl.h>
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <thread>
+#include <vector>
+
+#include "eden/fs/fuse/FileHandle.h"
+#include "eden/fs/inodes/FileInode.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+
+using namespace facebook::eden;
+
+DEFINE_uint64(file_size, 16 * 1024 * 1024, "Size of the file to read");
+DEFINE_uint64(read_size, 4096, "Size of each read");
+DEFINE_uint64(reads_per_thread, 100000, "Number of reads each thread makes");
+DEFINE_uint64(max_threads, 8, "Largest number of reader threads to time");
+
+namespace {
+
+/**
+ * Read inode from numThreads threads at once and return the total number of
+ * reads per second.
+ */
+double timeConcurrentReads(const FileInodePtr& inode, uint64_t numThreads) {
+  auto maxOffset = FLAGS_file_size > FLAGS_read_size
+      ? FLAGS_file_size - FLAGS_read_size
+      : 0;
+  std::vector<std::thread> threads;
+  folly::stop_watch<> timer;
+  for (uint64_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&] {
+      for (uint64_t i = 0; i < FLAGS_reads_per_thread; ++i) {
+        auto off = folly::Random::rand64(maxOffset + 1);
+        inode->read(FLAGS_read_size, off).get();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto seconds = std::chrono::duration<double>(timer.elapsed()).count();
+  return numThreads * FLAGS_reads_per_thread / seconds;
+}
+
+void benchmarkReads(const char* name, const FileInodePtr& inode) {
+  // Readers hold the file open, as they would through FUSE.
+  auto handle = inode->open(O_RDONLY).get();
+  // Load the data before timing.
+  inode->read(FLAGS_read_size, 0).get();
+
+  double baseline = 0;
+  for (uint64_t numThreads = 1; numThreads <= FLAGS_max_threads;
+       numThreads *= 2) {
+    auto readsPerSecond = timeConcurrentReads(inode, numThreads);
+    if (numThreads == 1) {
+      baseline = readsPerSecond;
+    }
+    printf(
+        "%-13s %2" PRIu64 " threads: %12.0f reads/s (%.2fx)\n",
+        name,
+        numThreads,
+        readsPerSecond,
+        readsPerSecond / baseline);
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+
+  std::string contents(FLAGS_file_size, 'x');
+  FakeTreeBuilder builder;
+  builder.setFile("blob", contents);
+  builder.setFile("materialized", contents);
+  TestMount mount{builder};
+  mount.overwriteFile("materialized", contents);
+
+  benchmarkReads("blob", mount.getFileInode("blob"));
+  benchmarkReads("materialized", mount.getFileInode("materialized"));
+  return 0;
+}
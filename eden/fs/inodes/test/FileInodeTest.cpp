@@ -17,6 +17,7 @@
 
 #include "eden/fs/fuse/FileHandle.h"
 #include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/store/BlobCache.h"
 #include "eden/fs/testharness/FakeBackingStore.h"
 #include "eden/fs/testharness/FakeTreeBuilder.h"
 #include "eden/fs/testharness/TestChecks.h"
@@ -522,6 +523,41 @@ TEST(FileInode, truncateDuringLoad) {
   EXPECT_FILE_INODE(inode, "\0\0\0\0\0foobar\n"_sp, 0644);
 }
 
+TEST(FileInode, readingWholeFileDemotesBlob) {
+  FakeTreeBuilder builder;
+  builder.setFiles({{"file.txt", "0123456789"}, {"other.txt", "abc"}});
+  TestMount mount_{builder};
+  auto inode = mount_.getFileInode("file.txt");
+  auto other = mount_.getFileInode("other.txt");
+  auto handle = inode->open(O_RDONLY).get(0ms);
+  auto otherHandle = other->open(O_RDONLY).get(0ms);
+
+  auto leastRecentlyUsed = [&] {
+    return mount_.getBlobCache()
+        ->getSnapshot()
+        .front()
+        ->getContents()
+        .cloneAsValue()
+        .moveToFbString();
+  };
+
+  EXPECT_EQ("a", other->read(1, 0).get(0ms).copyData());
+  EXPECT_EQ("01234", inode->read(5, 0).get(0ms).copyData());
+  EXPECT_EQ("abc", leastRecentlyUsed());
+
+  // Reads past EOF, or that leave a gap, do not complete the file.
+  EXPECT_EQ("", inode->read(5, 20).get(0ms).copyData());
+  EXPECT_EQ("89", inode->read(2, 8).get(0ms).copyData());
+  EXPECT_EQ("abc", leastRecentlyUsed());
+
+  // Once the rest has been read the blob is the first to be evicted, but it
+  // stays cached and readable until then.
+  EXPECT_EQ("3456789", inode->read(4096, 3).get(0ms).copyData());
+  EXPECT_EQ("0123456789", leastRecentlyUsed());
+  EXPECT_EQ(13, mount_.getBlobCache()->getTotalSize());
+  EXPECT_EQ("789", inode->read(4096, 7).get(0ms).copyData());
+}
+
 // TODO: test multiple flags together
 // TODO: ensure ctime is updated after every call to setattr()
 // TODO: ensure mtime is updated after opening a file, writing to it, then
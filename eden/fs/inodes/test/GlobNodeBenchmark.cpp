@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/*
+ * Measures the time to evaluate a recursive glob over a synthetic tree with
+ * depth levels of fanout directories each, with different numbers of glob
+ * workers.  None of the directories are loaded as inodes, so the walk goes
+ * through the ObjectStore the way a glob over an unmodified checkout does.
+ */
+#include <folly/Conv.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/init/Init.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/GlobNode.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+
+using namespace facebook::eden;
+
+DEFINE_uint64(depth, 6, "Number of directory levels in the tree");
+DEFINE_uint64(fanout, 4, "Number of subdirectories in each directory");
+DEFINE_uint64(files, 8, "Number of files in each directory");
+DEFINE_uint64(threads, 8, "Number of threads in the executor");
+DEFINE_uint64(max_workers, 8, "Largest number of glob workers to time");
+DEFINE_string(pattern, "**/*.java", "Glob pattern to evaluate");
+
+DECLARE_uint64(glob_max_workers);
+
+namespace {
+
+/**
+ * Add files to dir and to every directory below it, alternating between
+ * .java and .txt files.
+ */
+void buildTree(
+    FakeTreeBuilder& builder,
+    const std::string& dir,
+    uint64_t depth) {
+  for (uint64_t i = 0; i < FLAGS_files; ++i) {
+    auto name = folly::to<std::string>("file", i, i % 2 ? ".txt" : ".java");
+    builder.setFile(dir.empty() ? name : dir + "/" + name, name);
+  }
+  if (depth == 0) {
+    return;
+  }
+  for (uint64_t i = 0; i < FLAGS_fanout; ++i) {
+    auto name = folly::to<std::string>("dir", i);
+    buildTree(builder, dir.empty() ? name : dir + "/" + name, depth - 1);
+  }
+}
+
+size_t evaluateGlob(EdenMount* mount, folly::Executor* executor) {
+  GlobNode globRoot(/*includeDotfiles=*/true);
+  globRoot.parse(FLAGS_pattern);
+  return globRoot
+      .evaluate(
+          mount->getObjectStore(),
+          executor,
+          RelativePathPiece(),
+          mount->getRootInode(),
+          /*fileBlobsToPrefetch=*/nullptr)
+      .get()
+      .size();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+
+  FakeTreeBuilder builder;
+  buildTree(builder, "", FLAGS_depth);
+  TestMount mount{builder};
+  folly::CPUThreadPoolExecutor executor(FLAGS_threads);
+
+  // Load every Tree into the LocalStore before timing.
+  auto numMatches = evaluateGlob(mount.getEdenMount().get(), &executor);
+  printf("%s matches %zu files\n", FLAGS_pattern.c_str(), numMatches);
+
+  double baseline = 0;
+  for (uint64_t workers = 1; workers <= FLAGS_max_workers; workers *= 2) {
+    FLAGS_glob_max_workers = workers;
+    folly::stop_watch<> timer;
+    evaluateGlob(mount.getEdenMount().get(), &executor);
+    auto seconds = std::chrono::duration<double>(timer.elapsed()).count();
+    if (workers == 1) {
+      baseline = seconds;
+    }
+    printf(
+        "%2" PRIu64 " workers: %8.3f ms (%.2fx)\n",
+        workers,
+        seconds * 1000,
+        baseline / seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/GlobNode.h"
+
+#include <folly/executors/ManualExecutor.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+
+using namespace facebook::eden;
+using namespace std::chrono_literals;
+
+DECLARE_uint64(glob_max_workers);
+
+namespace {
+
+class GlobNodeTest : public ::testing::TestWithParam<uint64_t> {
+ protected:
+  void SetUp() override {
+    FLAGS_glob_max_workers = GetParam();
+
+    FakeTreeBuilder builder;
+    builder.setFiles({
+        {"Top.java", ""},
+        {"README", ""},
+        {"src/A.java", ""},
+        {"src/a.txt", ""},
+        {"src/deep/er/B.java", ""},
+        {"src/deep/er/b.txt", ""},
+        {"test/C.java", ""},
+    });
+    mount_.initialize(builder);
+  }
+
+  std::vector<std::string> glob(std::vector<std::string> patterns) {
+    GlobNode globRoot(/*includeDotfiles=*/true);
+    for (const auto& pattern : patterns) {
+      globRoot.parse(pattern);
+    }
+    auto future = globRoot.evaluate(
+        mount_.getEdenMount()->getObjectStore(),
+        &executor_,
+        RelativePathPiece(),
+        mount_.getEdenMount()->getRootInode(),
+        /*fileBlobsToPrefetch=*/nullptr);
+    executor_.drain();
+
+    std::vector<std::string> matches;
+    for (const auto& path : std::move(future).get(0ms)) {
+      matches.push_back(path.stringPiece().str());
+    }
+    std::sort(matches.begin(), matches.end());
+    return matches;
+  }
+
+  // Evaluate patterns with the streaming evaluate(), returning the chunks
+  // that it delivered.
+  std::vector<std::vector<std::string>> streamGlob(
+      std::vector<std::string> patterns,
+      size_t chunkSize) {
+    GlobNode globRoot(/*includeDotfiles=*/true);
+    for (const auto& pattern : patterns) {
+      globRoot.parse(pattern);
+    }
+    std::vector<std::vector<std::string>> chunks;
+    auto future = globRoot.evaluate(
+        mount_.getEdenMount()->getObjectStore(),
+        &executor_,
+        RelativePathPiece(),
+        mount_.getEdenMount()->getRootInode(),
+        /*fileBlobsToPrefetch=*/nullptr,
+        chunkSize,
+        [&](std::vector<RelativePath>&& paths) {
+          chunks.emplace_back();
+          for (const auto& path : paths) {
+            chunks.back().push_back(path.stringPiece().str());
+          }
+        });
+    executor_.drain();
+    std::move(future).get(0ms);
+    return chunks;
+  }
+
+  gflags::FlagSaver flagSaver_;
+  folly::ManualExecutor executor_;
+  TestMount mount_;
+};
+
+} // namespace
+
+TEST_P(GlobNodeTest, recursiveGlobMatchesEveryLevel) {
+  EXPECT_EQ(
+      (std::vector<std::string>{
+          "Top.java", "src/A.java", "src/deep/er/B.java", "test/C.java"}),
+      glob({"**/*.java"}));
+}
+
+TEST_P(GlobNodeTest, nonRecursiveGlobMatchesOneLevel) {
+  EXPECT_EQ(
+      (std::vector<std::string>{"src/A.java", "test/C.java"}),
+      glob({"*/*.java"}));
+  EXPECT_EQ(
+      (std::vector<std::string>{"src/deep/er/b.txt"}),
+      glob({"src/deep/er/*.txt"}));
+}
+
+TEST_P(GlobNodeTest, globSeesMaterializedDirectories) {
+  mount_.mkdir("src/new");
+  mount_.addFile("src/new/D.java", "");
+  mount_.addFile("src/deep/E.java", "");
+
+  EXPECT_EQ(
+      (std::vector<std::string>{"src/A.java",
+                                "src/deep/E.java",
+                                "src/deep/er/B.java",
+                                "src/new/D.java"}),
+      glob({"src/**/*.java"}));
+}
+
+TEST_P(GlobNodeTest, streamingGlobDeliversEveryMatchOnce) {
+  auto chunks = streamGlob({"**/*.java", "**/*.txt"}, /*chunkSize=*/2);
+
+  std::vector<std::string> matches;
+  for (const auto& chunk : chunks) {
+    EXPECT_FALSE(chunk.empty());
+    matches.insert(matches.end(), chunk.begin(), chunk.end());
+  }
+  std::sort(matches.begin(), matches.end());
+  EXPECT_EQ(glob({"**/*.java", "**/*.txt"}), matches);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    GlobNodeTest,
+    GlobNodeTest,
+    ::testing::Values(1, 2, 8));
@@ -12,6 +12,7 @@
 #include <folly/Format.h>
 #include <folly/String.h>
 #include <folly/test/TestUtils.h>
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 #include "eden/fs/inodes/EdenMount.h"
@@ -27,6 +28,8 @@ using namespace std::chrono_literals;
 using namespace facebook::eden;
 using folly::StringPiece;
 
+DECLARE_bool(takeover_compact_inode_map);
+
 TEST(InodeMap, invalidInodeNumber) {
   FakeTreeBuilder builder;
   builder.setFile("Makefile", "all:\necho success\n");
@@ -497,3 +500,80 @@ TEST_F(
   EXPECT_EQ(oldFile1Id, file1->getNodeId());
   EXPECT_EQ(oldFile2Id, file2->getNodeId());
 }
+
+TEST_F(
+    InodePersistenceTakeoverTest,
+    takeoverInodesAreUsableBeforeBeingLoaded) {
+  auto* inodeMap = edenMount->getInodeMap();
+  EXPECT_EQ(3, inodeMap->getUnloadedInodeCount());
+
+  // Paths can be computed without loading the inodes.
+  EXPECT_EQ(
+      RelativePath{"dir/file1.txt"}, inodeMap->getPathForInode(oldFile1Id));
+  EXPECT_TRUE(inodeMap->isInodeRemembered(oldTreeId));
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(oldTreeId));
+
+  // Dropping the last FUSE reference forgets the inode.
+  inodeMap->decFuseRefcount(oldFile1Id);
+  EXPECT_EQ(2, inodeMap->getUnloadedInodeCount());
+  EXPECT_FALSE(inodeMap->isInodeRemembered(oldFile1Id));
+
+  // Inodes that were never touched are handed over again.
+  edenMount.reset();
+  testMount.remountGracefully();
+  edenMount = testMount.getEdenMount();
+  inodeMap = edenMount->getInodeMap();
+  EXPECT_EQ(2, inodeMap->getUnloadedInodeCount());
+
+  auto file2 = edenMount->getInode("dir/file2.txt"_relpath).get();
+  EXPECT_EQ(oldFile2Id, file2->getNodeId());
+  EXPECT_EQ(1, file2->debugGetFuseRefcount());
+  EXPECT_EQ(
+      1, edenMount->getInode("dir"_relpath).get()->debugGetFuseRefcount());
+}
+
+TEST_F(InodePersistenceTreeTest, takeoverRemembersOnlyReferencedLoadedInodes) {
+  TestMount testMount{builder};
+  auto edenMount = testMount.getEdenMount();
+  auto file1 = edenMount->getInode("dir/file1.txt"_relpath).get();
+  auto file2 = edenMount->getInode("dir/file2.txt"_relpath).get();
+  // file2 and dir stay loaded, but FUSE does not reference them.
+  file1->incFuseRefcount();
+  auto oldFile1Id = file1->getNodeId();
+  auto oldTreeId = edenMount->getInode("dir"_relpath).get()->getNodeId();
+
+  edenMount.reset();
+  file1.reset();
+  file2.reset();
+  testMount.remountGracefully();
+  edenMount = testMount.getEdenMount();
+
+  // dir is remembered because file1 is.
+  auto* inodeMap = edenMount->getInodeMap();
+  EXPECT_EQ(2, inodeMap->getUnloadedInodeCount());
+  EXPECT_TRUE(inodeMap->isInodeRemembered(oldTreeId));
+  EXPECT_EQ(
+      RelativePath{"dir/file1.txt"}, inodeMap->getPathForInode(oldFile1Id));
+}
+
+TEST_F(
+    InodePersistenceTreeTest,
+    preservesInodeNumbersDuringTakeoverWithoutCompactInodeMap) {
+  gflags::FlagSaver flagSaver;
+  FLAGS_takeover_compact_inode_map = false;
+
+  TestMount testMount{builder};
+  auto edenMount = testMount.getEdenMount();
+  auto file1 = edenMount->getInode("dir/file1.txt"_relpath).get();
+  file1->incFuseRefcount();
+  auto oldFile1Id = file1->getNodeId();
+
+  edenMount.reset();
+  file1.reset();
+  testMount.remountGracefully();
+  edenMount = testMount.getEdenMount();
+
+  file1 = edenMount->getInode("dir/file1.txt"_relpath).get();
+  EXPECT_EQ(oldFile1Id, file1->getNodeId());
+  EXPECT_EQ(1, file1->debugGetFuseRefcount());
+}
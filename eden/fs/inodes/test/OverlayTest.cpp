@@ -240,6 +240,31 @@ TEST_F(OverlayTest, roundTripThroughSaveAndLoad) {
   EXPECT_TRUE(two.isMaterialized());
 }
 
+TEST_F(OverlayTest, loadOverlayDirsReturnsEachDirInOrder) {
+  auto overlay = mount_.getEdenMount()->getOverlay();
+
+  auto ino1 = overlay->allocateInodeNumber();
+  auto ino2 = overlay->allocateInodeNumber();
+  auto ino3 = overlay->allocateInodeNumber();
+  auto missing = overlay->allocateInodeNumber();
+
+  DirContents dir1;
+  dir1.emplace("one"_pc, S_IFDIR | 0755, ino3);
+  overlay->saveOverlayDir(ino1, dir1);
+  overlay->saveOverlayDir(ino2, DirContents{});
+
+  std::vector<InodeNumber> numbers{ino2, missing, ino1};
+  auto results = overlay->loadOverlayDirs(numbers);
+  ASSERT_EQ(3, results.size());
+
+  ASSERT_TRUE(results[0].value());
+  EXPECT_EQ(0, results[0].value()->size());
+  EXPECT_FALSE(results[1].value());
+  ASSERT_TRUE(results[2].value());
+  ASSERT_EQ(1, results[2].value()->size());
+  EXPECT_EQ(ino3, results[2].value()->find("one"_pc)->second.getInodeNumber());
+}
+
 TEST_F(OverlayTest, getFilePath) {
   Overlay::InodePath path;
 
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/init/Init.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include "eden/fs/inodes/Differ.h"
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+
+using namespace facebook::eden;
+
+DEFINE_uint64(directories, 1000, "Number of directories in the test mount");
+DEFINE_uint64(files_per_directory, 1000, "Number of files in each directory");
+DEFINE_uint64(changed_files, 10, "Files modified between status requests");
+DEFINE_uint64(iterations, 20, "Number of status requests to time");
+
+namespace {
+
+std::string fileName(uint64_t dir, uint64_t file) {
+  return folly::to<std::string>("dir", dir, "/file", file);
+}
+
+void getStatus(EdenMount* mount) {
+  diffMountForStatus(mount, mount->getParentCommits().parent1(), false).get();
+}
+
+template <typename Fn>
+void timeStatus(const char* name, Fn&& beforeEach, EdenMount* mount) {
+  std::chrono::nanoseconds elapsed{0};
+  for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+    beforeEach(i);
+    folly::stop_watch<> timer;
+    getStatus(mount);
+    elapsed += timer.elapsed();
+  }
+  printf(
+      "%-10s average time per status: %.2f ms\n",
+      name,
+      std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+          elapsed / FLAGS_iterations)
+          .count());
+}
+
+void benchmarkStatus() {
+  // Each directory has one modified file, so that every directory is
+  // materialized and a full diff has to compare every entry in the mount
+  // against source control.
+  FakeTreeBuilder builder;
+  for (uint64_t dir = 0; dir < FLAGS_directories; ++dir) {
+    for (uint64_t file = 0; file < FLAGS_files_per_directory; ++file) {
+      builder.setFile(fileName(dir, file), "contents\n");
+    }
+  }
+  TestMount testMount{builder};
+  for (uint64_t dir = 0; dir < FLAGS_directories; ++dir) {
+    testMount.overwriteFile(fileName(dir, 0), "modified\n");
+  }
+  auto mount = testMount.getEdenMount();
+  printf(
+      "Mount has %" PRIu64 " files in %" PRIu64 " directories\n",
+      FLAGS_directories * FLAGS_files_per_directory,
+      FLAGS_directories);
+
+  timeStatus(
+      "full",
+      [&](uint64_t) { *mount->getStatusCache().wlock() = nullptr; },
+      mount.get());
+
+  getStatus(mount.get());
+  timeStatus("cached", [](uint64_t) {}, mount.get());
+
+  timeStatus(
+      "partial",
+      [&](uint64_t iteration) {
+        for (uint64_t i = 0; i < FLAGS_changed_files; ++i) {
+          auto dir = (iteration * FLAGS_changed_files + i) % FLAGS_directories;
+          testMount.overwriteFile(
+              fileName(dir, 1), folly::to<std::string>(iteration, "\n"));
+        }
+      },
+      mount.get());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  benchmarkStatus();
+  return 0;
+}
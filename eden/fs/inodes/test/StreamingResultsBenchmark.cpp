@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/*
+ * Compares building a complete glob or status result against streaming it
+ * in chunks, the way globFiles()/getScmStatus() and
+ * streamGlobFiles()/streamScmStatus() do.  Reports the time until the first
+ * result is available, the total time, and the peak RSS of the process.
+ *
+ * Peak RSS only ever grows, so run each --mode in its own process:
+ *
+ *   StreamingResultsBenchmark --operation=glob --mode=list
+ *   StreamingResultsBenchmark --operation=glob --mode=stream
+ */
+#include <folly/Conv.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/init/Init.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+#include <optional>
+
+#include "eden/fs/inodes/Differ.h"
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/GlobNode.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/testharness/FakeBackingStore.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+
+using namespace facebook::eden;
+using Clock = std::chrono::steady_clock;
+
+DEFINE_string(operation, "glob", "Operation to time: glob or status");
+DEFINE_string(mode, "stream", "How to produce the result: list or stream");
+DEFINE_uint64(directories, 1000, "Number of directories in the test mount");
+DEFINE_uint64(files_per_directory, 1000, "Number of files in each directory");
+DEFINE_uint64(chunk_size, 1024, "Number of paths in each streamed chunk");
+DEFINE_uint64(threads, 8, "Number of threads in the glob executor");
+
+namespace {
+
+int64_t peakRssKB() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/**
+ * Keeps the time of the first result and the total number of paths, the way
+ * a client reading the reply would see them.
+ */
+struct ResultTimer {
+  void received(size_t numPaths) {
+    if (!firstResult) {
+      firstResult = timer.elapsed();
+    }
+    paths += numPaths;
+  }
+
+  folly::stop_watch<> timer;
+  std::optional<Clock::duration> firstResult;
+  size_t paths{0};
+};
+
+void timeGlob(EdenMount* mount, ResultTimer& result) {
+  folly::CPUThreadPoolExecutor executor(FLAGS_threads);
+  GlobNode globRoot(/*includeDotfiles=*/true);
+  globRoot.parse("**/*");
+  if (FLAGS_mode == "list") {
+    auto paths = globRoot
+                     .evaluate(
+                         mount->getObjectStore(),
+                         &executor,
+                         RelativePathPiece(),
+                         mount->getRootInode(),
+                         /*fileBlobsToPrefetch=*/nullptr)
+                     .get();
+    result.received(paths.size());
+  } else {
+    globRoot
+        .evaluate(
+            mount->getObjectStore(),
+            &executor,
+            RelativePathPiece(),
+            mount->getRootInode(),
+            /*fileBlobsToPrefetch=*/nullptr,
+            FLAGS_chunk_size,
+            [&](std::vector<RelativePath>&& paths) {
+              result.received(paths.size());
+            })
+        .get();
+  }
+}
+
+void timeStatus(EdenMount* mount, Hash emptyCommit, ResultTimer& result) {
+  if (FLAGS_mode == "list") {
+    auto status = diffMountForStatus(mount, emptyCommit, false).get();
+    result.received(status->entries.size());
+  } else {
+    streamMountStatus(
+        mount,
+        emptyCommit,
+        false,
+        FLAGS_chunk_size,
+        [&](ScmStatus&& chunk) { result.received(chunk.entries.size()); })
+        .get();
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+
+  FakeTreeBuilder builder;
+  for (uint64_t dir = 0; dir < FLAGS_directories; ++dir) {
+    for (uint64_t file = 0; file < FLAGS_files_per_directory; ++file) {
+      builder.setFile(
+          folly::to<std::string>("dir", dir, "/file", file), "contents\n");
+    }
+  }
+  TestMount testMount{builder};
+  auto mount = testMount.getEdenMount();
+
+  // Every file in the mount shows up as added relative to a commit whose
+  // tree holds a single unrelated file.
+  FakeTreeBuilder emptyBuilder;
+  emptyBuilder.setFile("unrelated", "contents\n");
+  emptyBuilder.finalize(testMount.getBackingStore(), /*setReady=*/true);
+  auto emptyCommit = testMount.nextCommitHash();
+  testMount.getBackingStore()
+      ->putCommit(emptyCommit, emptyBuilder)
+      ->setReady();
+
+  auto baselineRss = peakRssKB();
+  ResultTimer result;
+  if (FLAGS_operation == "glob") {
+    timeGlob(mount.get(), result);
+  } else if (FLAGS_operation == "status") {
+    timeStatus(mount.get(), emptyCommit, result);
+  } else {
+    fprintf(stderr, "unknown --operation %s\n", FLAGS_operation.c_str());
+    return 1;
+  }
+  auto total = result.timer.elapsed();
+
+  auto ms = [](Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  };
+  printf(
+      "%s %s: %zu paths, first result %.2f ms, total %.2f ms, "
+      "peak RSS %" PRId64 " KB (%" PRId64 " KB before)\n",
+      FLAGS_operation.c_str(),
+      FLAGS_mode.c_str(),
+      result.paths,
+      ms(result.firstResult.value_or(total)),
+      ms(total),
+      peakRssKB(),
+      baselineRss);
+  return 0;
+}
@@ -9,11 +9,19 @@
  */
 #include "eden/fs/inodes/TreeInode.h"
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/InodeMap.h"
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/TreeEntry.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
 
 using namespace facebook::eden;
+using namespace std::chrono_literals;
+
+DECLARE_uint64(materialized_load_batch_size);
 
 static DirEntry makeDirEntry() {
   return DirEntry{S_IFREG | 0644, 1_ino, Hash{}};
@@ -65,3 +73,56 @@ TEST(TreeInode, findEntryDifferencesWithOneAddition) {
   EXPECT_TRUE(differences);
   EXPECT_EQ((std::vector<std::string>{"+ three"}), *differences);
 }
+
+TEST(TreeInode, loadMaterializedChildrenLoadsOnlyDirectChildren) {
+  FakeTreeBuilder builder;
+  builder.setFile("src/a.txt", "a");
+  TestMount mount{builder};
+  mount.mkdir("src/x");
+  mount.addFile("src/x/b.txt", "b");
+  auto xNumber = mount.getTreeInode("src/x")->getNodeId();
+  auto bNumber = mount.getFileInode("src/x/b.txt")->getNodeId();
+  mount.remount();
+
+  auto* inodeMap = mount.getEdenMount()->getInodeMap();
+  auto future = mount.getTreeInode("src")->loadMaterializedChildren();
+  mount.drainServerExecutor();
+  std::move(future).get(0ms);
+
+  EXPECT_TRUE(inodeMap->lookupLoadedInode(xNumber));
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(bNumber));
+}
+
+TEST(TreeInode, loadMaterializedChildrenRecursivelyLoadsSubtree) {
+  gflags::FlagSaver flagSaver;
+  // Read one directory per batch so several batches are in flight.
+  FLAGS_materialized_load_batch_size = 1;
+
+  FakeTreeBuilder builder;
+  builder.setFile("src/a.txt", "a");
+  TestMount mount{builder};
+  std::vector<InodeNumber> materialized;
+  for (auto dir : {"src/x", "src/y", "src/z", "src/x/deeper"}) {
+    mount.mkdir(dir);
+    materialized.push_back(mount.getTreeInode(dir)->getNodeId());
+  }
+  mount.addFile("src/x/deeper/b.txt", "b");
+  materialized.push_back(mount.getFileInode("src/x/deeper/b.txt")->getNodeId());
+  auto aNumber = mount.getFileInode("src/a.txt")->getNodeId();
+  mount.remount();
+
+  auto* inodeMap = mount.getEdenMount()->getInodeMap();
+  for (auto number : materialized) {
+    EXPECT_FALSE(inodeMap->lookupLoadedInode(number));
+  }
+
+  auto future = mount.getEdenMount()->getRootInode()->loadMaterializedChildren(
+      /* recursive */ true);
+  mount.drainServerExecutor();
+  std::move(future).get(0ms);
+
+  for (auto number : materialized) {
+    EXPECT_TRUE(inodeMap->lookupLoadedInode(number)) << number;
+  }
+  EXPECT_FALSE(inodeMap->lookupLoadedInode(aNumber));
+}
@@ -0,0 +1,141 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/inodes/TreePrefetcher.h"
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/model/Blob.h"
+#include "eden/fs/store/LocalStore.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+
+DECLARE_int32(tree_prefetch_trigger);
+DECLARE_int32(tree_prefetch_mount_budget);
+
+using namespace facebook::eden;
+
+namespace {
+struct PrefetchCounts {
+  int64_t trees{0};
+  int64_t blobs{0};
+  int64_t used{0};
+  int64_t overBudget{0};
+};
+
+PrefetchCounts getCounts(TestMount& mount) {
+  PrefetchCounts counts;
+  for (auto& stats : mount.getEdenMount()->getStats()->accessAllThreads()) {
+    counts.trees += stats.prefetchTreesIssued.value();
+    counts.blobs += stats.prefetchBlobMetadataIssued.value();
+    counts.used += stats.prefetchUsed.value();
+    counts.overBudget += stats.prefetchOverBudget.value();
+  }
+  return counts;
+}
+
+void makeWideTree(FakeTreeBuilder& builder) {
+  builder.setFiles({
+      {"a/1.txt", "one"},
+      {"b/2.txt", "two"},
+      {"c/3.txt", "three"},
+      {"d/4.txt", "four"},
+      {"top.txt", "top"},
+  });
+}
+
+/**
+ * Store top.txt in the LocalStore, along with its metadata, so that its
+ * metadata can be prefetched.
+ */
+void storeTopBlob(TestMount& mount) {
+  auto root = mount.getEdenMount()->getRootInode();
+  auto hash = root->getContents()
+                  .rlock()
+                  ->entries.find(PathComponentPiece{"top.txt"})
+                  ->second.getHash();
+  Blob blob{hash, folly::StringPiece{"top"}};
+  mount.getLocalStore()->putBlob(hash, &blob);
+}
+} // namespace
+
+TEST(TreePrefetcher, prefetchesChildrenAfterRepeatedLookups) {
+  FakeTreeBuilder builder;
+  makeWideTree(builder);
+  TestMount mount{builder};
+  auto root = mount.getEdenMount()->getRootInode();
+  auto* prefetcher = mount.getEdenMount()->getTreePrefetcher();
+  storeTopBlob(mount);
+
+  for (int i = 0; i < FLAGS_tree_prefetch_trigger - 1; ++i) {
+    prefetcher->recordLookup(root);
+  }
+  mount.drainServerExecutor();
+  EXPECT_EQ(0, getCounts(mount).trees);
+
+  prefetcher->recordLookup(root);
+  mount.drainServerExecutor();
+  auto counts = getCounts(mount);
+  EXPECT_EQ(4, counts.trees);
+  EXPECT_EQ(1, counts.blobs);
+  EXPECT_EQ(0, prefetcher->getInFlightCount());
+
+  // A second burst of lookups in the same directory does not prefetch again.
+  prefetcher->recordLookup(root);
+  mount.drainServerExecutor();
+  EXPECT_EQ(4, getCounts(mount).trees);
+
+  // Loading one of the prefetched trees counts as a use.
+  mount.getTreeInode("a");
+  EXPECT_EQ(1, getCounts(mount).used);
+}
+
+TEST(TreePrefetcher, siblingOpendirPrefetchesParent) {
+  FakeTreeBuilder builder;
+  makeWideTree(builder);
+  TestMount mount{builder};
+  auto* prefetcher = mount.getEdenMount()->getTreePrefetcher();
+
+  auto a = mount.getTreeInode("a");
+  auto b = mount.getTreeInode("b");
+  auto c = mount.getTreeInode("c");
+  prefetcher->recordOpendir(a);
+  prefetcher->recordOpendir(b);
+  prefetcher->recordOpendir(c);
+  mount.drainServerExecutor();
+
+  // Only "d" is left unloaded.  The metadata of top.txt is not stored
+  // locally, so it is not counted as prefetched.
+  auto counts = getCounts(mount);
+  EXPECT_EQ(1, counts.trees);
+  EXPECT_EQ(0, counts.blobs);
+}
+
+TEST(TreePrefetcher, respectsMountBudget) {
+  FakeTreeBuilder builder;
+  makeWideTree(builder);
+  TestMount mount{builder};
+  auto root = mount.getEdenMount()->getRootInode();
+  auto* prefetcher = mount.getEdenMount()->getTreePrefetcher();
+
+  auto savedBudget = FLAGS_tree_prefetch_mount_budget;
+  FLAGS_tree_prefetch_mount_budget = 2;
+  for (int i = 0; i < FLAGS_tree_prefetch_trigger; ++i) {
+    prefetcher->recordLookup(root);
+  }
+  mount.drainServerExecutor();
+  FLAGS_tree_prefetch_mount_budget = savedBudget;
+
+  auto counts = getCounts(mount);
+  EXPECT_EQ(0, counts.trees);
+  EXPECT_EQ(1, counts.overBudget);
+}
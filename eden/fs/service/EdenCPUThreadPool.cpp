@@ -12,12 +12,28 @@
 #include <gflags/gflags.h>
 
 DEFINE_int32(num_eden_threads, 12, "the number of eden CPU worker threads");
+DEFINE_int32(
+    eden_normal_thread_limit,
+    0,
+    "the maximum number of eden CPU worker threads running normal priority "
+    "work, such as thrift requests, at once (0 means no limit)");
+DEFINE_int32(
+    eden_background_thread_limit,
+    4,
+    "the maximum number of eden CPU worker threads running background work, "
+    "such as prefetches and periodic inode unloading, at once (0 means no "
+    "limit)");
 
 namespace facebook {
 namespace eden {
 
 EdenCPUThreadPool::EdenCPUThreadPool()
-    : UnboundedQueueExecutor(FLAGS_num_eden_threads, "EdenCPUThread") {}
+    : UnboundedQueueExecutor(FLAGS_num_eden_threads, "EdenCPUThread") {
+  // Interactive work has no limit.  Limiting the other classes keeps threads
+  // free for it when a burst of background work arrives.
+  setConcurrencyLimit(kNormalPriority, FLAGS_eden_normal_thread_limit);
+  setConcurrencyLimit(kBackgroundPriority, FLAGS_eden_background_thread_limit);
+}
 
 } // namespace eden
 } // namespace facebook
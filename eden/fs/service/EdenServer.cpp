@@ -11,6 +11,7 @@
 
 #include <folly/Exception.h>
 #include <folly/FileUtil.h>
+#include <folly/MapUtil.h>
 #include <folly/SocketAddress.h>
 #include <folly/String.h>
 #include <folly/chrono/Conv.h>
@@ -47,16 +48,19 @@
 #include "eden/fs/service/EdenCPUThreadPool.h"
 #include "eden/fs/service/EdenServiceHandler.h"
 #include "eden/fs/store/BlobCache.h"
+#include "eden/fs/store/CacheSnapshot.h"
 #include "eden/fs/store/EmptyBackingStore.h"
 #include "eden/fs/store/LocalStore.h"
 #include "eden/fs/store/MemoryLocalStore.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/fs/store/SqliteLocalStore.h"
+#include "eden/fs/store/StoreStats.h"
 #include "eden/fs/store/git/GitBackingStore.h"
 #include "eden/fs/store/hg/HgBackingStore.h"
 
 #include "eden/fs/utils/Clock.h"
 #include "eden/fs/utils/ProcUtil.h"
+#include "eden/fs/utils/UnboundedQueueExecutor.h"
 
 DEFINE_bool(
     debug,
@@ -67,6 +71,18 @@ DEFINE_bool(
     false,
     "If another edenfs process is already running, "
     "attempt to gracefully takeover its mount points.");
+DEFINE_bool(
+    preload_materialized_inodes,
+    false,
+    "Load every materialized inode in the background once a mount has "
+    "started.  Status and checkout already read the overlay records of the "
+    "materialized directories they visit in batches, so this is only worth "
+    "it when those directories are very deep.");
+DEFINE_bool(
+    takeover_cache_handover,
+    true,
+    "Hand the in-memory blob and blob metadata caches to the new edenfs "
+    "process during graceful takeover.");
 
 #ifndef EDEN_WIN
 #define DEFAULT_STORAGE_ENGINE "rocksdb"
@@ -86,6 +102,11 @@ DEFINE_string(
     "memory is currently very dangerous as you will "
     "lose state across restarts and graceful restarts! "
     "It is unsafe to change this between edenfs invocations!");
+DEFINE_uint64(
+    memory_local_store_max_bytes,
+    0,
+    "With the memory storage engine, evict the oldest objects once this many "
+    "bytes are stored. 0 means no limit.");
 DEFINE_int32(
     thrift_num_workers,
     std::thread::hardware_concurrency(),
@@ -140,6 +161,14 @@ constexpr StringPiece kThriftSocketName{"socket"};
 constexpr StringPiece kTakeoverSocketName{"takeover"};
 constexpr StringPiece kRocksDBPath{"storage/rocks-db"};
 constexpr StringPiece kSqlitePath{"storage/sqlite.db"};
+
+// Counters describing the most recent graceful takeover, in milliseconds
+// unless noted otherwise.
+constexpr StringPiece kTakeoverPauseKey{"takeover.pause_ms"};
+constexpr StringPiece kCacheSnapshotSaveKey{"takeover.cache_snapshot.save_ms"};
+constexpr StringPiece kCacheSnapshotLoadKey{"takeover.cache_snapshot.load_ms"};
+constexpr StringPiece kCacheSnapshotBlobsKey{
+    "takeover.cache_snapshot.blob_count"};
 } // namespace
 
 namespace facebook {
@@ -321,6 +350,7 @@ void EdenServer::scheduleFlushStats() {
       [this] {
         flushStatsNow();
         reportProcStats();
+        reportThreadPoolStats();
         scheduleFlushStats();
       },
       std::chrono::seconds(1));
@@ -360,14 +390,20 @@ void EdenServer::unloadInodes() {
     serviceData->setCounter(kPeriodicUnloadCounterKey, totalUnloaded);
   }
 
-  scheduleInodeUnload(std::chrono::minutes(FLAGS_unload_interval_minutes));
+  mainEventBase_->runInEventBaseThread([this] {
+    scheduleInodeUnload(std::chrono::minutes(FLAGS_unload_interval_minutes));
+  });
 }
 
 void EdenServer::scheduleInodeUnload(std::chrono::milliseconds timeout) {
   mainEventBase_->timer().scheduleTimeoutFn(
       [this] {
         XLOG(DBG4) << "Beginning periodic inode unload";
-        unloadInodes();
+        // Walking every mount can take a while, so do it on the thread pool
+        // rather than blocking the main EventBase.
+        serverState_->getThreadPool()->addWithPriority(
+            [this] { unloadInodes(); },
+            UnboundedQueueExecutor::kBackgroundPriority);
       },
       timeout);
 }
@@ -431,6 +467,8 @@ Future<Unit> EdenServer::prepareImpl(std::shared_ptr<StartupLogger> logger) {
   // This will shut down the old process.
   const auto takeoverPath = edenDir_ + PathComponentPiece{kTakeoverSocketName};
   TakeoverData takeoverData;
+  folly::stop_watch<std::chrono::milliseconds> takeoverWatch;
+  std::shared_ptr<CacheSnapshot> cacheSnapshot;
 #endif
   if (doingTakeover) {
 #ifndef EDEN_WIN
@@ -443,6 +481,33 @@ Future<Unit> EdenServer::prepareImpl(std::shared_ptr<StartupLogger> logger) {
         takeoverData.mountPoints.size(),
         " mount points");
 
+    if (takeoverData.cacheSnapshot && FLAGS_takeover_cache_handover) {
+      try {
+        folly::stop_watch<std::chrono::milliseconds> watch;
+        cacheSnapshot = std::make_shared<CacheSnapshot>(
+            CacheSnapshot::read(takeoverData.cacheSnapshot));
+        // The snapshot is ordered least recently used first, which preserves
+        // the old process's eviction order.
+        auto blobCount = cacheSnapshot->blobs.size();
+        for (auto& blob : cacheSnapshot->blobs) {
+          blobCache_->insert(std::move(blob));
+        }
+        cacheSnapshot->blobs.clear();
+        auto serviceData = stats::ServiceData::get();
+        serviceData->setCounter(kCacheSnapshotLoadKey, watch.elapsed().count());
+        serviceData->setCounter(kCacheSnapshotBlobsKey, blobCount);
+        logger->log(
+            "Loaded takeover cache snapshot in ",
+            watch.elapsed().count(),
+            "ms");
+      } catch (const std::exception& ex) {
+        logger->warn(
+            "Ignoring takeover cache snapshot: ", folly::exceptionStr(ex));
+        cacheSnapshot.reset();
+      }
+    }
+    takeoverData.cacheSnapshot.close();
+
     // Take over the eden lock file and the thrift server socket.
     lockFile_ = std::move(takeoverData.lockFile);
     server_->useExistingSocket(takeoverData.thriftSocket.release());
@@ -456,7 +521,8 @@ Future<Unit> EdenServer::prepareImpl(std::shared_ptr<StartupLogger> logger) {
 
   if (FLAGS_local_storage_engine_unsafe == "memory") {
     logger->log("Creating new memory store.");
-    localStore_ = make_shared<MemoryLocalStore>(serverState_);
+    localStore_ = make_shared<MemoryLocalStore>(
+        serverState_, FLAGS_memory_local_store_max_bytes);
   } else if (FLAGS_local_storage_engine_unsafe == "sqlite") {
     const auto path = edenDir_ + RelativePathPiece{kSqlitePath};
     const auto parentDir = path.dirname();
@@ -508,9 +574,18 @@ Future<Unit> EdenServer::prepareImpl(std::shared_ptr<StartupLogger> logger) {
                 AbsolutePathPiece{info.stateDirectory});
             return mount(std::move(initialConfig), std::move(info));
           })
-              .thenTry([logger, mountPath = info.mountPath](
+              .thenTry([logger, mountPath = info.mountPath, cacheSnapshot](
                            folly::Try<std::shared_ptr<EdenMount>>&& result) {
                 if (result.hasValue()) {
+                  if (cacheSnapshot) {
+                    auto* metadata = folly::get_ptr(
+                        cacheSnapshot->metadata,
+                        mountPath.stringPiece().str());
+                    if (metadata) {
+                      result.value()->getObjectStore()->restoreMetadataCache(
+                          *metadata);
+                    }
+                  }
                   logger->log("Successfully took over mount ", mountPath);
                   return makeFuture();
                 } else {
@@ -524,6 +599,17 @@ Future<Unit> EdenServer::prepareImpl(std::shared_ptr<StartupLogger> logger) {
               });
       mountFutures.push_back(std::move(mountFuture));
     }
+
+    // FUSE requests have been blocked since the old process stopped its
+    // mounts, so record how long the takeover paused them for.
+    auto mountsDone = folly::collectAll(mountFutures)
+                          .thenValue([takeoverWatch](auto&&) {
+                            stats::ServiceData::get()->setCounter(
+                                kTakeoverPauseKey,
+                                takeoverWatch.elapsed().count());
+                          });
+    mountFutures.clear();
+    mountFutures.push_back(std::move(mountsDone));
 #else
     NOT_IMPLEMENTED();
 #endif
@@ -623,10 +709,44 @@ void EdenServer::run(void (*runThriftServer)(const EdenServer&)) {
 
 #ifndef EDEN_WIN
 Future<Unit> EdenServer::performTakeoverShutdown(folly::File thriftSocket) {
+  // Write the cache snapshot before stopping the mounts, so that its cost is
+  // not added to the time FUSE requests are paused for.  Blobs loaded after
+  // this point are simply not handed over.
+  folly::File cacheSnapshotFile;
+  if (FLAGS_takeover_cache_handover) {
+    // A failure here only costs the new process a cold cache.
+    try {
+      folly::stop_watch<std::chrono::milliseconds> watch;
+      CacheSnapshot cacheSnapshot;
+      {
+        const auto mountPoints = mountPoints_.rlock();
+        for (const auto& entry : *mountPoints) {
+          cacheSnapshot.metadata[entry.first.str()] =
+              entry.second.edenMount->getObjectStore()
+                  ->getMetadataCacheSnapshot();
+        }
+      }
+      cacheSnapshot.blobs = blobCache_->getSnapshot();
+      cacheSnapshotFile = cacheSnapshot.write();
+      stats::ServiceData::get()->setCounter(
+          kCacheSnapshotSaveKey, watch.elapsed().count());
+      XLOG(INFO) << "saved " << cacheSnapshot.blobs.size()
+                 << " blobs to the takeover cache snapshot in "
+                 << watch.elapsed().count() << "ms";
+    } catch (const std::exception& ex) {
+      XLOG(ERR) << "error saving takeover cache snapshot: "
+                << folly::exceptionStr(ex);
+    }
+  }
+
   // stop processing new FUSE requests for the mounts,
   return stopMountsForTakeover().thenValue(
       [this,
-       socket = std::move(thriftSocket)](TakeoverData&& takeover) mutable {
+       socket = std::move(thriftSocket),
+       cacheSnapshotFile = std::move(cacheSnapshotFile)](
+          TakeoverData&& takeover) mutable {
+        takeover.cacheSnapshot = std::move(cacheSnapshotFile);
+
         // Destroy the local store and backing stores.
         // We shouldn't access the local store any more after giving up our
         // lock, and we need to close it to release its lock before the new
@@ -829,7 +949,9 @@ folly::Future<std::shared_ptr<EdenMount>> EdenServer::mount(
 
   auto initFuture = edenMount->initialize(
       optionalTakeover ? std::make_optional(optionalTakeover->inodeMap)
-                       : std::nullopt);
+                       : std::nullopt,
+      optionalTakeover ? std::move(optionalTakeover->inodeTable)
+                       : folly::File{});
   return std::move(initFuture)
       .thenValue([this,
                   doTakeover,
@@ -863,6 +985,18 @@ folly::Future<std::shared_ptr<EdenMount>> EdenServer::mount(
 
               registerStats(edenMount);
 
+              if (FLAGS_preload_materialized_inodes) {
+                // Nothing waits for this; it only saves later requests from
+                // reading the overlay one directory at a time.
+                edenMount->getRootInode()
+                    ->loadMaterializedChildren(/* recursive */ true)
+                    .thenError([mountPath = edenMount->getPath()](
+                                   const folly::exception_wrapper& ew) {
+                      XLOG(ERR) << "error preloading materialized inodes in "
+                                << mountPath << ": " << folly::exceptionStr(ew);
+                    });
+              }
+
               if (doTakeover) {
                 // The bind mounts are already mounted in the takeover case
                 return makeFuture<std::shared_ptr<EdenMount>>(
@@ -954,15 +1088,18 @@ void EdenServer::mountFinished(
           [unmountPromise = std::move(unmountPromise),
            takeoverPromise = std::move(takeoverPromise),
            takeoverData = std::move(takeover)](
-              folly::Try<
-                  std::tuple<SerializedFileHandleMap, SerializedInodeMap>>&&
-                  result) mutable {
+              folly::Try<std::tuple<
+                  SerializedFileHandleMap,
+                  SerializedInodeMap,
+                  folly::File>>&& result) mutable {
             if (takeoverPromise) {
               takeoverPromise.value().setWith([&]() mutable {
                 takeoverData.value().fileHandleMap =
                     std::move(std::get<0>(result.value()));
                 takeoverData.value().inodeMap =
                     std::move(std::get<1>(result.value()));
+                takeoverData.value().inodeTable =
+                    std::move(std::get<2>(result.value()));
                 return std::move(takeoverData.value());
               });
             }
@@ -1192,6 +1329,32 @@ void EdenServer::flushStatsNow() {
   for (auto& stats : serverState_->getStats().accessAllThreads()) {
     stats.aggregate();
   }
+  for (auto& stats : getStoreStats().accessAllThreads()) {
+    stats.aggregate();
+  }
+}
+
+void EdenServer::reportThreadPoolStats() {
+  static constexpr std::pair<folly::StringPiece, int8_t> kClasses[] = {
+      {"interactive", UnboundedQueueExecutor::kInteractivePriority},
+      {"normal", UnboundedQueueExecutor::kNormalPriority},
+      {"background", UnboundedQueueExecutor::kBackgroundPriority},
+  };
+  auto serviceData = stats::ServiceData::get();
+  const auto& threadPool = serverState_->getThreadPool();
+  for (const auto& [name, priority] : kClasses) {
+    auto stats = threadPool->getStats(priority);
+    auto setCounter = [&](folly::StringPiece suffix, int64_t value) {
+      serviceData->setCounter(
+          folly::to<std::string>(kThreadPoolStatsPrefix, name, ".", suffix),
+          value);
+    };
+    setCounter("queued", stats.queued);
+    setCounter("running", stats.running);
+    setCounter("started", stats.started);
+    setCounter("wait_us", stats.totalWait.count());
+    setCounter("oldest_wait_us", stats.oldestWait.count());
+  }
 }
 
 void EdenServer::reportProcStats() {
@@ -44,6 +44,7 @@
 constexpr folly::StringPiece kPeriodicUnloadCounterKey{"PeriodicUnloadCounter"};
 constexpr folly::StringPiece kPrivateBytes{"memory_private_bytes"};
 constexpr folly::StringPiece kRssBytes{"memory_vm_rss_bytes"};
+constexpr folly::StringPiece kThreadPoolStatsPrefix{"thread_pool."};
 constexpr std::chrono::seconds kMemoryPollSeconds{30};
 
 namespace apache {
@@ -241,6 +242,12 @@ class EdenServer : private TakeoverHandler {
    */
   void reportProcStats();
 
+  /**
+   * Publish the queue depth, running count and queueing delay of each
+   * priority class of the server thread pool.
+   */
+  void reportThreadPoolStats();
+
   /**
    * Get the main thread's EventBase.
    *
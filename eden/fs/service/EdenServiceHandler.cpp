@@ -20,6 +20,7 @@
 #include <folly/logging/xlog.h>
 #include <folly/stop_watch.h>
 #include <folly/system/Shell.h>
+#include <gflags/gflags.h>
 #include <optional>
 #include "common/stats/ServiceData.h"
 #include "eden/fs/config/ClientConfig.h"
@@ -39,6 +40,7 @@
 #include "eden/fs/inodes/InodeTable.h"
 #include "eden/fs/inodes/Overlay.h"
 #include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/utils/ProcessFetchLog.h"
 #include "eden/fs/utils/ProcessNameCache.h"
 #endif // EDEN_WIN
 
@@ -48,14 +50,23 @@
 #include "eden/fs/model/TreeEntry.h"
 #include "eden/fs/service/EdenError.h"
 #include "eden/fs/service/EdenServer.h"
+#include "eden/fs/service/StreamingGlob.h"
 #include "eden/fs/service/StreamingSubscriber.h"
 #include "eden/fs/service/ThriftUtil.h"
 #include "eden/fs/store/BlobMetadata.h"
 #include "eden/fs/store/Diff.h"
 #include "eden/fs/store/LocalStore.h"
 #include "eden/fs/store/ObjectStore.h"
+#include "eden/fs/tracing/ChromeTrace.h"
 #include "eden/fs/tracing/Tracing.h"
 #include "eden/fs/utils/ProcUtil.h"
+#include "eden/fs/utils/UnboundedQueueExecutor.h"
+
+DEFINE_uint64(
+    thrift_stream_chunk_size,
+    1024,
+    "The number of paths to send in each item of streamGlobFiles() and "
+    "streamScmStatus() results");
 
 using folly::Future;
 using folly::makeFuture;
@@ -537,6 +548,125 @@ EdenServiceHandler::subscribeStreamTemporary(
 
   return std::move(reader);
 }
+
+namespace {
+/**
+ * Wraps the StreamPublisher for a stream of results that ends on its own,
+ * such as streamGlobFiles().
+ *
+ * The StreamPublisher must be completed before it is destroyed, so if the
+ * operation is abandoned without calling finish() the destructor completes
+ * the stream with an error.
+ *
+ * StreamPublisher has no flow control: next() queues the item for the client
+ * whether or not the client has asked for more.  A client that reads more
+ * slowly than the results are produced therefore makes the daemon hold the
+ * unread chunks, and streaming only bounds daemon memory for clients that
+ * keep up.
+ */
+template <typename T>
+class ResultStreamWriter {
+ public:
+  explicit ResultStreamWriter(apache::thrift::StreamPublisher<T> publisher)
+      : publisher_{std::in_place, std::move(publisher)} {}
+
+  ~ResultStreamWriter() {
+    finish(folly::make_exception_wrapper<std::runtime_error>(
+        "result stream abandoned before it completed"));
+  }
+
+  void next(T&& item) {
+    auto publisher = publisher_.lock();
+    if (publisher->has_value()) {
+      publisher->value().next(std::move(item));
+    }
+  }
+
+  /**
+   * Complete the stream, with an error if ew is set.  Only the first call
+   * has any effect.
+   */
+  void finish(folly::exception_wrapper ew = {}) {
+    auto publisher = publisher_.lock();
+    if (!publisher->has_value()) {
+      return;
+    }
+    if (ew) {
+      std::move(publisher->value()).complete(std::move(ew));
+    } else {
+      std::move(publisher->value()).complete();
+    }
+    publisher->reset();
+  }
+
+ private:
+  folly::Synchronized<std::optional<apache::thrift::StreamPublisher<T>>>
+      publisher_;
+};
+} // namespace
+
+apache::thrift::Stream<Glob> EdenServiceHandler::streamGlobFiles(
+    std::unique_ptr<GlobParams> params) {
+  auto helper = INSTRUMENT_THRIFT_CALL(
+      DBG3,
+      params->mountPoint,
+      "[" + folly::join(", ", params->globs) + "]",
+      params->includeDotfiles);
+  auto edenMount = server_->getMount(params->mountPoint);
+
+  auto [reader, writer] = createStreamPublisher<Glob>(
+      [] { XLOG(DBG3) << "streamGlobFiles client disconnected"; });
+  auto stream = std::make_shared<ResultStreamWriter<Glob>>(std::move(writer));
+
+  streamGlob(
+      std::move(edenMount),
+      *params,
+      FLAGS_thrift_stream_chunk_size,
+      [stream](Glob&& chunk) { stream->next(std::move(chunk)); })
+      .thenTry([stream, helper = std::move(helper)](folly::Try<Unit>&& result) {
+        // helper is captured so that the call is logged when the stream
+        // completes.
+        stream->finish(
+            result.hasException() ? std::move(result.exception())
+                                  : folly::exception_wrapper{});
+      });
+
+  return std::move(reader);
+}
+
+apache::thrift::Stream<ScmStatus> EdenServiceHandler::streamScmStatus(
+    std::unique_ptr<std::string> mountPoint,
+    bool listIgnored,
+    std::unique_ptr<std::string> commitHash) {
+  auto helper = INSTRUMENT_THRIFT_CALL(
+      DBG2,
+      *mountPoint,
+      folly::to<string>("listIgnored=", listIgnored ? "true" : "false"),
+      folly::to<string>("commitHash=", logHash(*commitHash)));
+
+  auto mount = server_->getMount(*mountPoint);
+  auto hash = hashFromThrift(*commitHash);
+
+  auto [reader, writer] = createStreamPublisher<ScmStatus>(
+      [] { XLOG(DBG3) << "streamScmStatus client disconnected"; });
+  auto stream =
+      std::make_shared<ResultStreamWriter<ScmStatus>>(std::move(writer));
+
+  streamMountStatus(
+      mount.get(),
+      hash,
+      listIgnored,
+      FLAGS_thrift_stream_chunk_size,
+      [stream](ScmStatus&& chunk) { stream->next(std::move(chunk)); })
+      .thenTry([stream, mount, helper = std::move(helper)](
+                   folly::Try<Unit>&& result) {
+        stream->finish(
+            result.hasException() ? std::move(result.exception())
+                                  : folly::exception_wrapper{});
+      });
+
+  return std::move(reader);
+}
 #endif // !EDEN_WIN
 
 void EdenServiceHandler::getFilesChangedSince(
@@ -763,6 +893,7 @@ void EdenServiceHandler::glob(
     auto matches = globRoot
                        .evaluate(
                            edenMount->getObjectStore(),
+                           edenMount->getThreadPool().get(),
                            RelativePathPiece(),
                            rootInode,
                            /*fileBlobsToPrefetch=*/nullptr)
@@ -808,6 +939,7 @@ folly::Future<std::unique_ptr<Glob>> EdenServiceHandler::future_globFiles(
       globRoot
           ->evaluate(
               edenMount->getObjectStore(),
+              edenMount->getThreadPool().get(),
               RelativePathPiece(),
               rootInode,
               fileBlobsToPrefetch)
@@ -828,25 +960,9 @@ folly::Future<std::unique_ptr<Glob>> EdenServiceHandler::future_globFiles(
               }
             }
             if (fileBlobsToPrefetch) {
-              std::vector<folly::Future<folly::Unit>> futures;
-
-              auto store = edenMount->getObjectStore();
-              auto blobs = fileBlobsToPrefetch->rlock();
-              std::vector<Hash> batch;
-
-              for (auto& hash : *blobs) {
-                if (batch.size() >= 20480) {
-                  futures.emplace_back(store->prefetchBlobs(batch));
-                  batch.clear();
-                }
-                batch.emplace_back(hash);
-              }
-              if (!batch.empty()) {
-                futures.emplace_back(store->prefetchBlobs(batch));
-              }
-
-              return folly::collect(futures).thenValue(
-                  [glob = std::move(out)](auto&&) mutable {
+              return prefetchBlobsInBatches(
+                         edenMount->getObjectStore(), *fileBlobsToPrefetch)
+                  .thenValue([glob = std::move(out)](auto&&) mutable {
                     return makeFuture(std::move(glob));
                   });
             }
@@ -1169,6 +1285,26 @@ void EdenServiceHandler::getAccessCounts(
 #endif // !EDEN_WIN
 }
 
+void EdenServiceHandler::getFetchCounts(GetFetchCountsResult& result) {
+#ifndef EDEN_WIN
+  auto helper = INSTRUMENT_THRIFT_CALL(DBG3);
+
+  result.exeNamesByPid =
+      server_->getServerState()->getProcessNameCache()->getAllProcessNames();
+
+  for (auto& [pid, counts] : getProcessFetchLog().getAllCounts()) {
+    auto& fetchCounts = result.fetchCountsByPid[pid];
+    fetchCounts.blobFetches = counts.blobFetches;
+    fetchCounts.treeFetches = counts.treeFetches;
+    fetchCounts.fetchedBytes = counts.fetchedBytes;
+    fetchCounts.fetchTimeMicroseconds = counts.fetchTime.count();
+    fetchCounts.materializations = counts.materializations;
+  }
+#else
+  NOT_IMPLEMENTED();
+#endif // !EDEN_WIN
+}
+
 void EdenServiceHandler::clearAndCompactLocalStore() {
   auto helper = INSTRUMENT_THRIFT_CALL(DBG1);
   server_->getLocalStore()->clearCachesAndCompactAll();
@@ -1329,6 +1465,20 @@ void EdenServiceHandler::getTracePoints(std::vector<TracePoint>& result) {
   }
 }
 
+void EdenServiceHandler::setTraceBufferSize(int64_t maxTracePoints) {
+  auto helper = INSTRUMENT_THRIFT_CALL(INFO, maxTracePoints);
+  if (maxTracePoints < 0) {
+    throw newEdenError(EINVAL, "trace buffer size must not be negative");
+  }
+  setMaxBufferedTracepoints(static_cast<size_t>(maxTracePoints));
+}
+
+int64_t EdenServiceHandler::exportTracePoints(
+    std::unique_ptr<std::string> path) {
+  auto helper = INSTRUMENT_THRIFT_CALL(INFO, *path);
+  return exportChromeTrace(AbsolutePathPiece{*path}.stringPiece());
+}
+
 void EdenServiceHandler::initiateShutdown(std::unique_ptr<std::string> reason) {
   auto helper = INSTRUMENT_THRIFT_CALL(INFO);
   XLOG(INFO) << "initiateShutdown requested, reason: " << *reason;
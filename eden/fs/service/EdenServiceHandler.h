@@ -104,6 +104,14 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
 #ifndef EDEN_WIN
   apache::thrift::Stream<JournalPosition> subscribeStreamTemporary(
       std::unique_ptr<std::string> mountPoint) override;
+
+  apache::thrift::Stream<Glob> streamGlobFiles(
+      std::unique_ptr<GlobParams> params) override;
+
+  apache::thrift::Stream<ScmStatus> streamScmStatus(
+      std::unique_ptr<std::string> mountPoint,
+      bool listIgnored,
+      std::unique_ptr<std::string> commitHash) override;
 #endif // !EDEN_WIN
 
   void getManifestEntry(
@@ -161,6 +169,8 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
   void getAccessCounts(GetAccessCountsResult& result, int64_t duration)
       override;
 
+  void getFetchCounts(GetFetchCountsResult& result) override;
+
   void clearAndCompactLocalStore() override;
 
   void debugClearLocalStoreCaches() override;
@@ -183,6 +193,8 @@ class EdenServiceHandler : virtual public StreamingEdenServiceSvIf,
   void enableTracing() override;
   void disableTracing() override;
   void getTracePoints(std::vector<TracePoint>& result) override;
+  void setTraceBufferSize(int64_t maxTracePoints) override;
+  int64_t exportTracePoints(std::unique_ptr<std::string> path) override;
 
   /**
    * When this Thrift handler is notified to shutdown, it notifies the
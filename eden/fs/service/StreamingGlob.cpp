@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/service/StreamingGlob.h"
+
+#include <unordered_set>
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/inodes/GlobNode.h"
+#include "eden/fs/inodes/TreeInode.h"
+#include "eden/fs/service/EdenError.h"
+#include "eden/fs/store/ObjectStore.h"
+#include "eden/fs/utils/UnboundedQueueExecutor.h"
+
+using folly::Future;
+using folly::makeFuture;
+using folly::Unit;
+using std::vector;
+
+namespace facebook {
+namespace eden {
+
+Future<Unit> prefetchBlobsInBatches(
+    const ObjectStore* store,
+    const folly::Synchronized<vector<Hash>>& blobsToPrefetch) {
+  vector<Future<Unit>> futures;
+
+  auto blobs = blobsToPrefetch.rlock();
+  vector<Hash> batch;
+
+  for (auto& hash : *blobs) {
+    if (batch.size() >= 20480) {
+      futures.emplace_back(store->prefetchBlobs(batch));
+      batch.clear();
+    }
+    batch.emplace_back(hash);
+  }
+  if (!batch.empty()) {
+    futures.emplace_back(store->prefetchBlobs(batch));
+  }
+
+  return folly::collect(futures).unit();
+}
+
+Future<Unit> streamGlob(
+    std::shared_ptr<EdenMount> mount,
+    const GlobParams& params,
+    size_t chunkSize,
+    std::function<void(Glob&&)> onChunk) {
+  // Compile the list of globs into a tree
+  auto globRoot = std::make_shared<GlobNode>(params.includeDotfiles);
+  try {
+    for (auto& globString : params.globs) {
+      globRoot->parse(globString);
+    }
+  } catch (const std::system_error& exc) {
+    throw newEdenError(exc);
+  }
+
+  auto fileBlobsToPrefetch = params.prefetchFiles
+      ? std::make_shared<folly::Synchronized<vector<Hash>>>()
+      : nullptr;
+
+  // A single pattern cannot match the same file twice, so only remember the
+  // paths that have been sent when there is more than one.  GlobNode never
+  // runs this callback concurrently, so seenPaths needs no lock.
+  auto onMatches = [onChunk = std::move(onChunk),
+                    suppressFileList = params.suppressFileList,
+                    seenPaths = std::unordered_set<RelativePath>(),
+                    dedup = params.globs.size() > 1](
+                       vector<RelativePath>&& paths) mutable {
+    if (suppressFileList) {
+      return;
+    }
+    Glob chunk;
+    chunk.matchingFiles.reserve(paths.size());
+    for (auto& fileName : paths) {
+      if (dedup && !seenPaths.insert(fileName).second) {
+        continue;
+      }
+      chunk.matchingFiles.emplace_back(fileName.stringPiece().str());
+    }
+    if (!chunk.matchingFiles.empty()) {
+      onChunk(std::move(chunk));
+    }
+  };
+
+  auto rootInode = mount->getRootInode();
+  return globRoot
+      ->evaluate(
+          mount->getObjectStore(),
+          mount->getThreadPool().get(),
+          RelativePathPiece(),
+          std::move(rootInode),
+          fileBlobsToPrefetch,
+          chunkSize,
+          std::move(onMatches))
+      .thenValue([mount, fileBlobsToPrefetch](auto&&) {
+        if (!fileBlobsToPrefetch) {
+          return makeFuture();
+        }
+        return prefetchBlobsInBatches(
+            mount->getObjectStore(), *fileBlobsToPrefetch);
+      })
+      .ensure([globRoot]() {
+        // keep globRoot alive until the end
+      });
+}
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/service/gen-cpp2/eden_types.h"
+
+namespace facebook {
+namespace eden {
+
+class EdenMount;
+class ObjectStore;
+
+/**
+ * Prefetch the contents of the given blobs, splitting them into batches so
+ * that no single import request gets too large.
+ */
+folly::Future<folly::Unit> prefetchBlobsInBatches(
+    const ObjectStore* store,
+    const folly::Synchronized<std::vector<Hash>>& blobsToPrefetch);
+
+/**
+ * Evaluate the globs in params against the root of mount like globFiles(),
+ * but hand the matching files to onChunk in Globs of about chunkSize paths
+ * as they are found.  onChunk is only called by one thread at a time.
+ *
+ * If params.prefetchFiles is set, the returned Future completes once the
+ * matching blobs have been prefetched.  Throws an EdenError if one of the
+ * globs cannot be parsed.
+ *
+ * When params holds more than one glob the same file can match more than
+ * once, so every path handed to onChunk is remembered until the glob
+ * completes in order to drop the duplicates.  Memory use for those calls
+ * still grows with the number of matches.
+ */
+folly::Future<folly::Unit> streamGlob(
+    std::shared_ptr<EdenMount> mount,
+    const GlobParams& params,
+    size_t chunkSize,
+    std::function<void(Glob&&)> onChunk);
+
+} // namespace eden
+} // namespace facebook
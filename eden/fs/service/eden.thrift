@@ -426,6 +426,20 @@ struct GetAccessCountsResult {
   // 3: map<pid_t, AccessCount> thriftAccesses
 }
 
+struct ProcessFetchCounts {
+  1: i64 blobFetches
+  2: i64 treeFetches
+  3: i64 fetchedBytes
+  // Total time spent waiting on the backing store for these fetches
+  4: i64 fetchTimeMicroseconds
+  5: i64 materializations
+}
+
+struct GetFetchCountsResult {
+  1: map<pid_t, binary> exeNamesByPid
+  2: map<pid_t, ProcessFetchCounts> fetchCountsByPid
+}
+
 enum TracePointEvent {
   // Start of a new block
   START = 0;
@@ -729,6 +743,13 @@ service EdenService extends fb303.FacebookService {
   GetAccessCountsResult getAccessCounts(1: i64 duration)
     throws (1: EdenError ex)
 
+  /**
+   * Returns, for each process, the backing store fetches and file
+   * materializations that its FUSE requests have caused since edenfs started.
+   */
+  GetFetchCountsResult getFetchCounts()
+    throws (1: EdenError ex)
+
   /**
    * Column by column, clears and compacts the LocalStore. All columns are
    * compacted, but only columns that contain ephemeral data are cleared.
@@ -796,6 +817,22 @@ service EdenService extends fb303.FacebookService {
   void disableTracing()
   list<TracePoint> getTracePoints()
 
+  /**
+   * Bound the number of trace points buffered in memory, turning the trace
+   * buffer into a ring buffer that discards the oldest points.  This allows
+   * tracing to be left enabled continuously.  0 removes the bound.
+   */
+  void setTraceBufferSize(1: i64 maxTracePoints)
+
+  /**
+   * Write the currently buffered trace points to the given local path in
+   * Chrome trace event JSON format, which chrome://tracing and the Perfetto
+   * UI can both load.  Like getTracePoints() this consumes the buffered
+   * points, so repeated exports do not repeat them; blocks still running
+   * are exported as incomplete.  Returns the number of trace points written.
+   */
+  i64 exportTracePoints(1: PathString path) throws (1: EdenError ex)
+
   /**
    * Ask the server to shutdown and provide it some context for its logs
    */
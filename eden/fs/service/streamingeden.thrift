@@ -25,4 +25,28 @@ service StreamingEdenService extends eden.EdenService {
    * method above. */
   stream eden.JournalPosition subscribeStreamTemporary(
     1: string mountPoint)
+
+  /** Like globFiles(), but the matching files are sent in chunks as they
+   * are found, rather than all at once when the glob completes.
+   * Together the Globs in the stream hold the same paths that globFiles()
+   * would return, without duplicates.  Any matching blobs are prefetched
+   * before the stream completes.
+   *
+   * The stream has no flow control: chunks that the client has not read yet
+   * are queued in the daemon, so a slow client still costs daemon memory.
+   * When more than one glob is given, the paths already sent are also kept
+   * until the stream completes, in order to drop duplicates. */
+  stream eden.Glob streamGlobFiles(
+    1: eden.GlobParams params)
+
+  /** Like getScmStatus(), but the entries are sent in chunks as the diff
+   * finds them, rather than all at once when it completes.
+   * Each ScmStatus in the stream holds a different set of paths.
+   * Unlike getScmStatus() this always compares the entire mount.
+   * As with streamGlobFiles(), chunks the client has not read yet are queued
+   * in the daemon. */
+  stream eden.ScmStatus streamScmStatus(
+    1: eden.PathString mountPoint,
+    2: bool listIgnored,
+    3: eden.BinaryHash commit)
 }
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/service/StreamingGlob.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+
+#include "eden/fs/inodes/EdenMount.h"
+#include "eden/fs/testharness/FakeTreeBuilder.h"
+#include "eden/fs/testharness/TestMount.h"
+
+using namespace facebook::eden;
+using namespace std::chrono_literals;
+
+namespace {
+
+class StreamingGlobTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FakeTreeBuilder builder;
+    builder.setFiles({
+        {"Top.java", ""},
+        {"src/A.java", ""},
+        {"src/a.txt", ""},
+        {"src/deep/B.java", ""},
+        {"test/C.java", ""},
+    });
+    mount_.initialize(builder);
+  }
+
+  /**
+   * Run streamGlob() the way streamGlobFiles() does and return the chunks
+   * it produced.
+   */
+  std::vector<std::vector<std::string>> streamGlobFiles(
+      std::vector<std::string> globs,
+      size_t chunkSize,
+      bool suppressFileList = false) {
+    GlobParams params;
+    params.globs = std::move(globs);
+    params.includeDotfiles = true;
+    params.suppressFileList = suppressFileList;
+
+    std::vector<std::vector<std::string>> chunks;
+    auto future = streamGlob(
+        mount_.getEdenMount(), params, chunkSize, [&](Glob&& chunk) {
+          chunks.push_back(std::move(chunk.matchingFiles));
+        });
+    mount_.drainServerExecutor();
+    std::move(future).get(0ms);
+    return chunks;
+  }
+
+  static std::vector<std::string> concat(
+      const std::vector<std::vector<std::string>>& chunks) {
+    std::vector<std::string> all;
+    for (const auto& chunk : chunks) {
+      all.insert(all.end(), chunk.begin(), chunk.end());
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+  }
+
+  TestMount mount_;
+};
+
+} // namespace
+
+TEST_F(StreamingGlobTest, sendsEveryMatchInChunks) {
+  auto chunks = streamGlobFiles({"**/*.java"}, /*chunkSize=*/1);
+  for (const auto& chunk : chunks) {
+    EXPECT_FALSE(chunk.empty());
+  }
+  EXPECT_EQ(
+      (std::vector<std::string>{
+          "Top.java", "src/A.java", "src/deep/B.java", "test/C.java"}),
+      concat(chunks));
+}
+
+TEST_F(StreamingGlobTest, overlappingGlobsSendEachPathOnce) {
+  auto chunks =
+      streamGlobFiles({"src/*.java", "**/*.java", "src/**"}, /*chunkSize=*/2);
+  EXPECT_EQ(
+      (std::vector<std::string>{"Top.java",
+                                "src/A.java",
+                                "src/a.txt",
+                                "src/deep",
+                                "src/deep/B.java",
+                                "test/C.java"}),
+      concat(chunks));
+}
+
+TEST_F(StreamingGlobTest, suppressFileListSendsNothing) {
+  EXPECT_TRUE(
+      streamGlobFiles({"**/*.java"}, /*chunkSize=*/1, /*suppress=*/true)
+          .empty());
+}
+
+TEST_F(StreamingGlobTest, invalidGlobThrowsEdenError) {
+  GlobParams params;
+  params.globs = {"src/[a"};
+  EXPECT_THROW(
+      streamGlob(mount_.getEdenMount(), params, 1, [](Glob&&) {}), EdenError);
+}
@@ -37,9 +37,12 @@ void checkSqliteResult(sqlite3* db, int result) {
       to<string>("sqlite error: ", result, ": ", sqlite3_errstr(result)));
 }
 
-SqliteDatabase::SqliteDatabase(AbsolutePathPiece path) {
+SqliteDatabase::SqliteDatabase(AbsolutePathPiece path)
+    : SqliteDatabase(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) {}
+
+SqliteDatabase::SqliteDatabase(AbsolutePathPiece path, int flags) {
   sqlite3* db = nullptr;
-  auto result = sqlite3_open(path.copy().c_str(), &db);
+  auto result = sqlite3_open_v2(path.copy().c_str(), &db, flags, nullptr);
   if (result != SQLITE_OK) {
     // On most error conditions sqlite3_open() does allocate the DB object,
     // and it needs to be closed afterwards if it is non-null.
@@ -88,6 +91,11 @@ bool SqliteStatement::step() {
   }
 }
 
+void SqliteStatement::reset() {
+  sqlite3_reset(stmt_);
+  sqlite3_clear_bindings(stmt_);
+}
+
 void SqliteStatement::bind(
     size_t paramNo,
     folly::StringPiece blob,
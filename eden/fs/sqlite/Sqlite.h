@@ -28,6 +28,12 @@ class SqliteDatabase {
    */
   explicit SqliteDatabase(AbsolutePathPiece path);
 
+  /** Open a handle to the database at the specified path, passing flags
+   * through to sqlite3_open_v2().  For example, SQLITE_OPEN_READONLY opens a
+   * connection that can only read an existing database.
+   */
+  SqliteDatabase(AbsolutePathPiece path, int flags);
+
   // Not copyable...
   SqliteDatabase(const SqliteDatabase&) = delete;
   SqliteDatabase& operator=(const SqliteDatabase&) = delete;
@@ -95,6 +101,15 @@ class SqliteStatement {
    */
   bool step();
 
+  /** Reset the statement so that it can be executed again, and clear its
+   * bindings.
+   * step() does this itself once it reaches the end of the result set, but
+   * a caller that stops reading rows before then must call reset() before
+   * reusing the statement.  Until then the statement holds its read
+   * transaction open.
+   */
+  void reset();
+
   /** Bind a stringy parameter to a prepared statement placeholder.
    * Parameters are 1-based, with the first parameter having paramNo==1.
    * Throws an exception on error.
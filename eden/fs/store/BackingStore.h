@@ -47,6 +47,18 @@ class BackingStore {
     return folly::unit;
   }
 
+  /**
+   * Fetch the given trees into the LocalStore ahead of their use.
+   *
+   * This is purely a performance hint for stores that can fetch many trees
+   * at once.  The default implementation does nothing, and callers must
+   * still be prepared to load each tree with getTree().
+   */
+  FOLLY_NODISCARD virtual folly::Future<folly::Unit> prefetchTrees(
+      const std::vector<Hash>& /* ids */) const {
+    return folly::unit;
+  }
+
  private:
   // Forbidden copy constructor and assignment operator
   BackingStore(BackingStore const&) = delete;
@@ -9,8 +9,10 @@
  */
 #include "BlobCache.h"
 #include <folly/MapUtil.h>
+#include <folly/ThreadLocal.h>
 #include <folly/logging/xlog.h>
 #include "eden/fs/model/Blob.h"
+#include "eden/fs/store/StoreStats.h"
 
 namespace facebook {
 namespace eden {
@@ -33,6 +35,13 @@ void BlobInterestHandle::reset() noexcept {
   blobCache_.reset();
 }
 
+void BlobInterestHandle::demote() noexcept {
+  if (auto blobCache = blobCache_.lock()) {
+    blobCache->demoteInterestHandle(hash_);
+  }
+  blobCache_.reset();
+}
+
 std::shared_ptr<const Blob> BlobInterestHandle::getBlob() const {
   auto blobCache = blobCache_.lock();
   if (blobCache) {
@@ -49,6 +58,16 @@ std::shared_ptr<const Blob> BlobInterestHandle::getBlob() const {
   return blob_.lock();
 }
 
+std::shared_ptr<const Blob> BlobInterestHandle::getBlobNoWait() const {
+  auto blob = blob_.lock();
+  if (blob) {
+    if (auto blobCache = blobCache_.lock()) {
+      blobCache->tryPromote(hash_);
+    }
+  }
+  return blob;
+}
+
 std::shared_ptr<BlobCache> BlobCache::create(
     size_t maximumCacheSizeBytes,
     size_t minimumEntryCount) {
@@ -71,12 +90,15 @@ BlobCache::GetResult BlobCache::get(const Hash& hash, Interest interest) {
   // runs after the lock is released.
   BlobInterestHandle interestHandle;
 
+  LatencyRecorder latency{&StoreStats::blobCacheGet};
   auto state = state_.wlock();
 
   auto* item = folly::get_ptr(state->items, hash);
   if (!item) {
+    getStoreStats()->blobCacheMiss.incrementValue();
     return GetResult{};
   }
+  getStoreStats()->blobCacheHit.incrementValue();
 
   switch (interest) {
     case Interest::UnlikelyNeededAgain:
@@ -157,6 +179,16 @@ size_t BlobCache::getTotalSize() const {
   return state_.rlock()->totalSize;
 }
 
+std::vector<BlobCache::BlobPtr> BlobCache::getSnapshot() const {
+  auto state = state_.rlock();
+  std::vector<BlobPtr> blobs;
+  blobs.reserve(state->evictionQueue.size());
+  for (const auto* item : state->evictionQueue) {
+    blobs.push_back(item->blob);
+  }
+  return blobs;
+}
+
 void BlobCache::dropInterestHandle(const Hash& hash) noexcept {
   auto state = state_.wlock();
 
@@ -179,6 +211,41 @@ void BlobCache::dropInterestHandle(const Hash& hash) noexcept {
   }
 }
 
+void BlobCache::demoteInterestHandle(const Hash& hash) noexcept {
+  auto state = state_.wlock();
+
+  auto* item = folly::get_ptr(state->items, hash);
+  if (!item) {
+    // Cached item already evicted.
+    return;
+  }
+
+  if (item->referenceCount == 0) {
+    XLOG(WARN)
+        << "Reference count on item for " << hash
+        << " was already zero: an exception must have been thrown during get()";
+    return;
+  }
+
+  if (--item->referenceCount == 0) {
+    state->evictionQueue.splice(
+        state->evictionQueue.begin(), state->evictionQueue, item->index);
+  }
+}
+
+void BlobCache::tryPromote(const Hash& hash) noexcept {
+  auto state = state_.tryWLock();
+  if (!state) {
+    return;
+  }
+
+  auto* item = folly::get_ptr(state->items, hash);
+  if (item) {
+    state->evictionQueue.splice(
+        state->evictionQueue.end(), state->evictionQueue, item->index);
+  }
+}
+
 void BlobCache::evictUntilFits(State& state) noexcept {
   while (state.totalSize > maximumCacheSizeBytes_ &&
          state.evictionQueue.size() > minimumEntryCount_) {
@@ -13,6 +13,7 @@
 #include <cstddef>
 #include <list>
 #include <unordered_map>
+#include <vector>
 #include "eden/fs/model/Hash.h"
 
 namespace facebook {
@@ -34,7 +35,9 @@ class BlobInterestHandle {
   }
 
   BlobInterestHandle(BlobInterestHandle&& other) noexcept
-      : blobCache_{std::move(other.blobCache_)}, hash_{other.hash_} {
+      : blobCache_{std::move(other.blobCache_)},
+        hash_{other.hash_},
+        blob_{std::move(other.blob_)} {
     // We don't need to clear other.hash_ because it's only referenced when
     // blobCache_ is not expired.
   }
@@ -44,6 +47,7 @@ class BlobInterestHandle {
       reset();
       blobCache_ = std::move(other.blobCache_);
       hash_ = other.hash_;
+      blob_ = std::move(other.blob_);
     }
     return *this;
   }
@@ -56,8 +60,32 @@ class BlobInterestHandle {
    */
   std::shared_ptr<const Blob> getBlob() const;
 
+  /**
+   * Like getBlob(), but never waits for the BlobCache lock, so concurrent
+   * readers of one blob do not serialize on it.  If the lock is busy the blob
+   * is not moved to the back of the eviction queue; when a blob is hot,
+   * another reader is likely doing that at the same time.
+   *
+   * Returns nullptr if the blob is no longer in memory.
+   */
+  std::shared_ptr<const Blob> getBlobNoWait() const;
+
   void reset() noexcept;
 
+  /**
+   * Like reset(), but if this was the last interest in the blob, leave it in
+   * the cache at the front of the eviction queue rather than evicting it.
+   * The blob can still be read until the cache needs the space.
+   */
+  void demote() noexcept;
+
+  /**
+   * Returns true if this handle still holds an interest in a live BlobCache.
+   */
+  bool isValid() const noexcept {
+    return !blobCache_.expired();
+  }
+
  private:
   explicit BlobInterestHandle(std::weak_ptr<const Blob> blob);
   BlobInterestHandle(
@@ -162,6 +190,12 @@ class BlobCache : public std::enable_shared_from_this<BlobCache> {
    */
   size_t getTotalSize() const;
 
+  /**
+   * Returns every cached blob, least recently used first.  Inserting them
+   * into another BlobCache in this order reproduces the eviction order.
+   */
+  std::vector<BlobPtr> getSnapshot() const;
+
  private:
   /*
    * TODO: This data structure could be implemented more efficiently. But since
@@ -197,6 +231,13 @@ class BlobCache : public std::enable_shared_from_this<BlobCache> {
   };
 
   void dropInterestHandle(const Hash& hash) noexcept;
+  void demoteInterestHandle(const Hash& hash) noexcept;
+
+  /**
+   * Move the blob to the back of the eviction queue, unless another thread
+   * holds the lock.
+   */
+  void tryPromote(const Hash& hash) noexcept;
 
   explicit BlobCache(size_t maximumCacheSizeBytes, size_t minimumEntryCount);
   void evictUntilFits(State& state) noexcept;
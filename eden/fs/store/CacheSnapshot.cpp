@@ -0,0 +1,208 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/CacheSnapshot.h"
+
+#include <folly/Bits.h>
+#include <folly/Conv.h>
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <stdexcept>
+#include "eden/fs/model/Blob.h"
+
+using folly::ByteRange;
+using folly::io::Cursor;
+
+namespace facebook {
+namespace eden {
+
+namespace {
+
+/*
+ * The snapshot layout.  All integers are big-endian.
+ *
+ *   magic "EDENSNAP", uint32 format version
+ *   uint64 blob count, then for each blob:
+ *     hash (20 bytes), uint64 size, contents
+ *   uint32 mount count, then for each mount:
+ *     uint32 path length, path, uint64 entry count, then for each entry:
+ *       blob ID (20 bytes), SHA-1 (20 bytes), uint64 size
+ */
+constexpr folly::StringPiece kMagic{"EDENSNAP"};
+constexpr uint32_t kFormatVersion = 1;
+
+/**
+ * Buffers small writes to a file descriptor.  Blob contents are usually
+ * large enough to be written directly.
+ */
+class SnapshotWriter {
+ public:
+  explicit SnapshotWriter(int fd) : fd_{fd} {
+    buffer_.reserve(kBufferSize);
+  }
+
+  template <typename T>
+  void writeBE(T value) {
+    value = folly::Endian::big(value);
+    write(ByteRange{reinterpret_cast<const uint8_t*>(&value), sizeof(value)});
+  }
+
+  void write(ByteRange data) {
+    if (buffer_.size() + data.size() > kBufferSize) {
+      flush();
+    }
+    if (data.size() >= kBufferSize) {
+      writeToFile(data);
+    } else {
+      buffer_.append(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+  }
+
+  void write(const folly::IOBuf& buf) {
+    for (auto range : buf) {
+      write(range);
+    }
+  }
+
+  void flush() {
+    writeToFile(ByteRange{folly::StringPiece{buffer_}});
+    buffer_.clear();
+  }
+
+ private:
+  static constexpr size_t kBufferSize = 64 * 1024;
+
+  void writeToFile(ByteRange data) {
+    auto written = folly::writeFull(fd_, data.data(), data.size());
+    folly::checkUnixError(written, "error writing cache snapshot");
+  }
+
+  int fd_;
+  std::string buffer_;
+};
+
+Hash readHash(Cursor& cursor) {
+  Hash::Storage bytes;
+  cursor.pull(bytes.data(), bytes.size());
+  return Hash{bytes};
+}
+
+} // namespace
+
+folly::File CacheSnapshot::write() const {
+  auto fd = memfd_create("eden_cache_snapshot", MFD_CLOEXEC);
+  folly::checkUnixError(fd, "failed to create cache snapshot memfd");
+  folly::File file{fd, /*ownsFd=*/true};
+
+  SnapshotWriter writer{file.fd()};
+  writer.write(ByteRange{kMagic});
+  writer.writeBE<uint32_t>(kFormatVersion);
+
+  writer.writeBE<uint64_t>(blobs.size());
+  for (const auto& blob : blobs) {
+    writer.write(blob->getHash().getBytes());
+    writer.writeBE<uint64_t>(blob->getSize());
+    writer.write(blob->getContents());
+  }
+
+  writer.writeBE<uint32_t>(metadata.size());
+  for (const auto& mount : metadata) {
+    writer.writeBE<uint32_t>(mount.first.size());
+    writer.write(ByteRange{folly::StringPiece{mount.first}});
+    writer.writeBE<uint64_t>(mount.second.size());
+    for (const auto& entry : mount.second) {
+      writer.write(entry.first.getBytes());
+      writer.write(entry.second.sha1.getBytes());
+      writer.writeBE<uint64_t>(entry.second.size);
+    }
+  }
+  writer.flush();
+  return file;
+}
+
+CacheSnapshot CacheSnapshot::read(const folly::File& file) {
+  struct stat st;
+  folly::checkUnixError(fstat(file.fd(), &st), "failed to stat cache snapshot");
+  auto size = static_cast<size_t>(st.st_size);
+  if (size < kMagic.size() + sizeof(uint32_t)) {
+    throw std::runtime_error("cache snapshot is truncated");
+  }
+
+  auto* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd(), 0);
+  if (map == MAP_FAILED) {
+    folly::throwSystemError("failed to map cache snapshot");
+  }
+
+  // Each blob's contents are copied out, so that the mapping is released
+  // when we return.  Sharing it would keep the whole snapshot in memory for
+  // as long as any one blob survived, unaccounted for by the BlobCache.
+  folly::IOBuf buf{
+      folly::IOBuf::TAKE_OWNERSHIP,
+      map,
+      size,
+      [](void* addr, void* length) {
+        munmap(addr, reinterpret_cast<size_t>(length));
+      },
+      reinterpret_cast<void*>(size)};
+
+  // The Cursor throws std::out_of_range if the data is truncated.
+  Cursor cursor{&buf};
+  if (cursor.readFixedString(kMagic.size()) != kMagic) {
+    throw std::runtime_error("not a cache snapshot");
+  }
+  auto version = cursor.readBE<uint32_t>();
+  if (version != kFormatVersion) {
+    throw std::runtime_error(folly::to<std::string>(
+        "unsupported cache snapshot version ", version));
+  }
+
+  CacheSnapshot snapshot;
+  auto blobCount = cursor.readBE<uint64_t>();
+  // Don't trust the counts when reserving space, in case they are corrupt.
+  snapshot.blobs.reserve(std::min<uint64_t>(
+      blobCount, cursor.totalLength() / (Hash::RAW_SIZE + sizeof(uint64_t))));
+  for (uint64_t i = 0; i < blobCount; ++i) {
+    auto hash = readHash(cursor);
+    auto blobSize = cursor.readBE<uint64_t>();
+    // Check the size before allocating, in case it is corrupt.
+    if (blobSize > cursor.totalLength()) {
+      throw std::out_of_range("cache snapshot is truncated");
+    }
+    folly::IOBuf contents{folly::IOBuf::CREATE, blobSize};
+    cursor.pull(contents.writableData(), blobSize);
+    contents.append(blobSize);
+    snapshot.blobs.push_back(
+        std::make_shared<const Blob>(hash, std::move(contents)));
+  }
+
+  auto mountCount = cursor.readBE<uint32_t>();
+  for (uint32_t i = 0; i < mountCount; ++i) {
+    auto path = cursor.readFixedString(cursor.readBE<uint32_t>());
+    auto& entries = snapshot.metadata[path];
+    auto entryCount = cursor.readBE<uint64_t>();
+    entries.reserve(std::min<uint64_t>(
+        entryCount,
+        cursor.totalLength() / (2 * Hash::RAW_SIZE + sizeof(uint64_t))));
+    for (uint64_t j = 0; j < entryCount; ++j) {
+      auto id = readHash(cursor);
+      auto sha1 = readHash(cursor);
+      auto blobSize = cursor.readBE<uint64_t>();
+      entries.emplace_back(id, BlobMetadata{sha1, blobSize});
+    }
+  }
+  return snapshot;
+}
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,54 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/File.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "eden/fs/store/ObjectStore.h"
+
+namespace facebook {
+namespace eden {
+
+class Blob;
+
+/**
+ * A copy of the in-memory object caches, handed from one edenfs process to
+ * the next during graceful restart so that the new process does not start
+ * with cold caches.
+ *
+ * The snapshot is written to an anonymous memfd, which is passed over the
+ * takeover socket along with the FUSE device descriptors.  The receiving
+ * process maps the file and rebuilds its caches from it.
+ */
+struct CacheSnapshot {
+  /** The contents of the BlobCache, least recently used first. */
+  std::vector<std::shared_ptr<const Blob>> blobs;
+
+  /** Each mount's ObjectStore metadata cache, keyed by mount path. */
+  std::unordered_map<std::string, ObjectStore::MetadataSnapshot> metadata;
+
+  /** Write the snapshot to a new anonymous memfd. */
+  folly::File write() const;
+
+  /**
+   * Read a snapshot from a file created by write().  Throws if the file is
+   * truncated or was written in an unsupported format.
+   *
+   * The file is only mapped while it is being read: each blob owns a copy
+   * of its contents.
+   */
+  static CacheSnapshot read(const folly::File& file);
+};
+
+} // namespace eden
+} // namespace facebook
@@ -44,20 +44,31 @@ enum class Persistence : bool {
 static constexpr struct KeySpaceRecord {
   LocalStore::KeySpace keySpace;
   Persistence persistence;
+  StoreStats::HistogramPtr getLatency;
 } kKeySpaceRecords[] = {
-    {LocalStore::BlobFamily, Persistence::Ephemeral},
-    {LocalStore::BlobMetaDataFamily, Persistence::Ephemeral},
+    {LocalStore::BlobFamily,
+     Persistence::Ephemeral,
+     &StoreStats::localStoreGetBlob},
+    {LocalStore::BlobMetaDataFamily,
+     Persistence::Ephemeral,
+     &StoreStats::localStoreGetBlobMetadata},
 
     // If the trees were imported from a flatmanifest, we cannot delete them.
     // See test_contents_are_the_same_if_handle_is_held_open when running
     // against a flatmanifest repository.
-    {LocalStore::TreeFamily, Persistence::Persistent},
+    {LocalStore::TreeFamily,
+     Persistence::Persistent,
+     &StoreStats::localStoreGetTree},
 
     // Proxy hashes are required to fetch objects from hg from a hash.
     // Deleting them breaks re-importing after an inode is unloaded.
-    {LocalStore::HgProxyHashFamily, Persistence::Persistent},
+    {LocalStore::HgProxyHashFamily,
+     Persistence::Persistent,
+     &StoreStats::localStoreGetHgProxyHash},
 
-    {LocalStore::HgCommitToTreeFamily, Persistence::Ephemeral},
+    {LocalStore::HgCommitToTreeFamily,
+     Persistence::Ephemeral,
+     &StoreStats::localStoreGetHgCommitToTree},
 };
 } // namespace
 
@@ -90,6 +101,16 @@ void LocalStore::compactStorage() {
   }
 }
 
+LatencyRecorder LocalStore::recordGetLatency(KeySpace keySpace) {
+  for (const auto& ks : kKeySpaceRecords) {
+    if (ks.keySpace == keySpace) {
+      return LatencyRecorder{ks.getLatency};
+    }
+  }
+  throw std::invalid_argument(
+      folly::to<string>("unknown key space ", static_cast<int>(keySpace)));
+}
+
 StoreResult LocalStore::get(KeySpace keySpace, const Hash& id) const {
   return get(keySpace, id.getBytes());
 }
@@ -116,6 +137,20 @@ folly::Future<std::vector<StoreResult>> LocalStore::getBatch(
   });
 }
 
+folly::Future<std::vector<Hash>> LocalStore::getMissing(
+    KeySpace keySpace,
+    const std::vector<Hash>& ids) const {
+  return folly::makeFutureWith([keySpace, ids, this] {
+    std::vector<Hash> missing;
+    for (const auto& id : ids) {
+      if (!hasKey(keySpace, id)) {
+        missing.push_back(id);
+      }
+    }
+    return missing;
+  });
+}
+
 // TODO(mbolin): Currently, all objects in our RocksDB are Git objects. We
 // probably want to namespace these by column family going forward, at which
 // point we might want to have a GitLocalStore that delegates to an
@@ -251,6 +286,18 @@ BlobMetadata LocalStore::WriteBatch::putBlob(const Hash& id, const Blob* blob) {
   return metadata;
 }
 
+void LocalStore::WriteBatch::afterFlush(folly::Function<void()> callback) {
+  afterFlushCallbacks_.push_back(std::move(callback));
+}
+
+void LocalStore::WriteBatch::runAfterFlushCallbacks() {
+  auto callbacks = std::move(afterFlushCallbacks_);
+  afterFlushCallbacks_.clear();
+  for (auto& callback : callbacks) {
+    callback();
+  }
+}
+
 LocalStore::WriteBatch::~WriteBatch() {}
 LocalStore::~LocalStore() {}
 
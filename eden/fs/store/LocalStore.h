@@ -9,13 +9,16 @@
  */
 #pragma once
 
+#include <folly/Function.h>
 #include <folly/Range.h>
 #include <memory>
 #include <optional>
+#include <vector>
 #ifndef EDEN_WIN
 #include "eden/fs/rocksdb/RocksHandles.h"
 #endif
 #include "eden/fs/store/BlobMetadata.h"
+#include "eden/fs/store/StoreStats.h"
 #include "eden/fs/utils/PathFuncs.h"
 
 namespace folly {
@@ -124,6 +127,17 @@ class LocalStore {
       KeySpace keySpace,
       const std::vector<folly::ByteRange>& keys) const;
 
+  /**
+   * Return the subset of ids that are not present in the given KeySpace, in
+   * the order they were given.
+   *
+   * This only checks for the keys; it does not read their values.  The
+   * default implementation calls hasKey() for each id.
+   */
+  FOLLY_NODISCARD virtual folly::Future<std::vector<Hash>> getMissing(
+      KeySpace keySpace,
+      const std::vector<Hash>& ids) const;
+
   /**
    * Get a Tree from the store.
    *
@@ -243,6 +257,12 @@ class LocalStore {
      */
     virtual void flush() = 0;
 
+    /**
+     * Run callback once everything put in this batch so far has been
+     * flushed to the store, from whichever flush() writes it.
+     */
+    void afterFlush(folly::Function<void()> callback);
+
     // Forbidden copy construction/assignment; allow only moves
     WriteBatch(const WriteBatch&) = delete;
     WriteBatch(WriteBatch&&) = default;
@@ -251,8 +271,16 @@ class LocalStore {
     virtual ~WriteBatch();
     WriteBatch() = default;
 
+   protected:
+    /**
+     * Implementations call this at the end of every successful flush().
+     */
+    void runAfterFlushCallbacks();
+
    private:
     friend class LocalStore;
+
+    std::vector<folly::Function<void()>> afterFlushCallbacks_;
   };
 
   /**
@@ -267,6 +295,12 @@ class LocalStore {
   virtual std::unique_ptr<WriteBatch> beginWrite(size_t bufSize = 0) = 0;
 
  protected:
+  /**
+   * Start timing a read from the given KeySpace.  Implementations should keep
+   * the returned object alive until the read completes.
+   */
+  static LatencyRecorder recordGetLatency(KeySpace keySpace);
+
   std::shared_ptr<ReloadableConfig> config_;
 };
 } // namespace eden
@@ -9,6 +9,9 @@
  */
 #include "eden/fs/store/MemoryLocalStore.h"
 #include <folly/String.h>
+#include <folly/futures/Future.h>
+#include <folly/hash/SpookyHashV2.h>
+#include <algorithm>
 #include "eden/fs/store/StoreResult.h"
 namespace facebook {
 namespace eden {
@@ -16,17 +19,35 @@ namespace eden {
 using folly::StringPiece;
 
 namespace {
-class MemoryWriteBatch : public LocalStore::WriteBatch {
+/**
+ * Whether values in keySpace may be evicted to stay within the byte budget.
+ * Everything but the proxy hashes can be fetched again from the
+ * BackingStore, but without its proxy hash an hg object cannot be fetched at
+ * all.
+ */
+bool isEvictable(LocalStore::KeySpace keySpace) {
+  return keySpace != LocalStore::KeySpace::HgProxyHashFamily;
+}
+
+std::shared_ptr<const std::string> makeValue(folly::ByteRange value) {
+  return std::make_shared<const std::string>(
+      reinterpret_cast<const char*>(value.data()), value.size());
+}
+} // namespace
+
+/**
+ * Buffers writes by shard, so that flush() takes each shard's lock once.
+ */
+class MemoryLocalStore::MemoryWriteBatch : public LocalStore::WriteBatch {
  public:
-  explicit MemoryWriteBatch(MemoryLocalStore* store) : store_(store) {
-    storage_.resize(LocalStore::KeySpace::End);
-  }
+  MemoryWriteBatch(MemoryLocalStore* store, size_t bufSize)
+      : store_(store), bufSize_(bufSize) {}
 
   void put(
       LocalStore::KeySpace keySpace,
       folly::ByteRange key,
       folly::ByteRange value) override {
-    storage_[keySpace][StringPiece(key)] = StringPiece(value).str();
+    add(keySpace, key, makeValue(value));
   }
 
   void put(
@@ -37,36 +58,114 @@ class MemoryWriteBatch : public LocalStore::WriteBatch {
     for (const auto& slice : valueSlices) {
       value.append(reinterpret_cast<const char*>(slice.data()), slice.size());
     }
-    put(keySpace, key, StringPiece(value));
+    add(keySpace, key, std::make_shared<const std::string>(std::move(value)));
   }
 
   void flush() override {
-    for (size_t keySpace = 0; keySpace < storage_.size(); ++keySpace) {
-      for (const auto& it : storage_[keySpace]) {
-        store_->put(
-            static_cast<LocalStore::KeySpace>(keySpace),
-            folly::StringPiece(it.first),
-            StringPiece(it.second));
+    for (size_t i = 0; i < kNumShards; ++i) {
+      auto& items = buffer_[i];
+      if (items.empty()) {
+        continue;
       }
-      storage_[keySpace].clear();
+      auto shard = store_->shards_[i].data.wlock();
+      for (auto& item : items) {
+        store_->putLocked(
+            *shard, item.keySpace, item.key, std::move(item.value));
+      }
+      items.clear();
     }
+    bufferedBytes_ = 0;
+    runAfterFlushCallbacks();
   }
 
  private:
+  struct Item {
+    LocalStore::KeySpace keySpace;
+    std::string key;
+    Value value;
+  };
+
+  void add(LocalStore::KeySpace keySpace, folly::ByteRange key, Value value) {
+    bufferedBytes_ += key.size() + value->size();
+    buffer_[store_->getShardIndex(key)].push_back(
+        Item{keySpace, StringPiece(key).str(), std::move(value)});
+    if (bufSize_ > 0 && bufferedBytes_ >= bufSize_) {
+      flush();
+    }
+  }
+
   MemoryLocalStore* store_;
-  std::vector<folly::StringKeyedUnorderedMap<std::string>> storage_;
+  size_t bufSize_;
+  size_t bufferedBytes_{0};
+  std::array<std::vector<Item>, kNumShards> buffer_;
 };
-} // namespace
 
-MemoryLocalStore::MemoryLocalStore(std::shared_ptr<ReloadableConfig> config)
-    : LocalStore(std::move(config)) {
-  storage_->resize(KeySpace::End);
-}
+MemoryLocalStore::MemoryLocalStore(
+    std::shared_ptr<ReloadableConfig> config,
+    size_t maxBytes)
+    : LocalStore(std::move(config)),
+      maxShardBytes_(
+          maxBytes ? std::max<size_t>(maxBytes / kNumShards, 1) : 0) {}
 
 void MemoryLocalStore::close() {}
 
+size_t MemoryLocalStore::getShardIndex(folly::ByteRange key) const {
+  return folly::hash::SpookyHashV2::Hash64(key.data(), key.size(), 0) %
+      kNumShards;
+}
+
+void MemoryLocalStore::putLocked(
+    ShardData& shard,
+    KeySpace keySpace,
+    StringPiece key,
+    Value value) {
+  auto valueSize = value->size();
+  auto& map = shard.keySpaces[keySpace];
+  auto it = map.find(key);
+  if (it != map.end()) {
+    shard.totalBytes -= it->second->size();
+    it->second = std::move(value);
+  } else {
+    map.emplace(key, std::move(value));
+    shard.totalBytes += key.size();
+    if (maxShardBytes_ > 0 && isEvictable(keySpace)) {
+      shard.evictionQueue.emplace_back(keySpace, key.str());
+    }
+  }
+  shard.totalBytes += valueSize;
+
+  if (maxShardBytes_ == 0) {
+    return;
+  }
+  while (shard.totalBytes > maxShardBytes_ && !shard.evictionQueue.empty()) {
+    const auto& oldest = shard.evictionQueue.front();
+    auto& oldestMap = shard.keySpaces[oldest.first];
+    auto oldestIt = oldestMap.find(oldest.second);
+    if (oldestIt != oldestMap.end()) {
+      shard.totalBytes -= oldest.second.size() + oldestIt->second->size();
+      oldestMap.erase(oldestIt);
+    }
+    shard.evictionQueue.pop_front();
+  }
+}
+
 void MemoryLocalStore::clearKeySpace(KeySpace keySpace) {
-  (*storage_.wlock())[keySpace].clear();
+  for (auto& shard : shards_) {
+    auto data = shard.data.wlock();
+    auto& map = data->keySpaces[keySpace];
+    for (const auto& entry : map) {
+      data->totalBytes -= entry.first.size() + entry.second->size();
+    }
+    map.clear();
+
+    auto& queue = data->evictionQueue;
+    queue.erase(
+        std::remove_if(
+            queue.begin(),
+            queue.end(),
+            [keySpace](const auto& item) { return item.first == keySpace; }),
+        queue.end());
+  }
 }
 
 void MemoryLocalStore::compactKeySpace(KeySpace) {}
@@ -74,31 +173,77 @@ void MemoryLocalStore::compactKeySpace(KeySpace) {}
 StoreResult MemoryLocalStore::get(
     LocalStore::KeySpace keySpace,
     folly::ByteRange key) const {
-  auto store = storage_.rlock();
-  auto it = (*store)[keySpace].find(StringPiece(key));
-  if (it == (*store)[keySpace].end()) {
+  auto latency = recordGetLatency(keySpace);
+  auto data = shards_[getShardIndex(key)].data.rlock();
+  const auto& map = data->keySpaces[keySpace];
+  auto it = map.find(StringPiece(key));
+  if (it == map.end()) {
     return StoreResult();
   }
-  return StoreResult(std::string(it->second));
+  return StoreResult(it->second);
+}
+
+folly::Future<std::vector<StoreResult>> MemoryLocalStore::getBatch(
+    KeySpace keySpace,
+    const std::vector<folly::ByteRange>& keys) const {
+  return folly::makeFutureWith([&] {
+    auto latency = recordGetLatency(keySpace);
+
+    // Take each shard's lock once, looking up all of the keys that hash to
+    // it.
+    std::array<std::vector<size_t>, kNumShards> keysByShard;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      keysByShard[getShardIndex(keys[i])].push_back(i);
+    }
+
+    std::vector<StoreResult> results(keys.size());
+    for (size_t shardIndex = 0; shardIndex < kNumShards; ++shardIndex) {
+      const auto& indices = keysByShard[shardIndex];
+      if (indices.empty()) {
+        continue;
+      }
+      auto data = shards_[shardIndex].data.rlock();
+      const auto& map = data->keySpaces[keySpace];
+      for (auto index : indices) {
+        auto it = map.find(StringPiece(keys[index]));
+        if (it != map.end()) {
+          results[index] = StoreResult(it->second);
+        }
+      }
+    }
+    return results;
+  });
 }
 
 bool MemoryLocalStore::hasKey(
     LocalStore::KeySpace keySpace,
     folly::ByteRange key) const {
-  auto store = storage_.rlock();
-  auto it = (*store)[keySpace].find(StringPiece(key));
-  return it != (*store)[keySpace].end();
+  auto data = shards_[getShardIndex(key)].data.rlock();
+  const auto& map = data->keySpaces[keySpace];
+  return map.find(StringPiece(key)) != map.end();
 }
 
 void MemoryLocalStore::put(
     LocalStore::KeySpace keySpace,
     folly::ByteRange key,
     folly::ByteRange value) {
-  (*storage_.wlock())[keySpace][StringPiece(key)] = StringPiece(value).str();
+  // Copy the value before taking the lock.
+  auto storedValue = makeValue(value);
+  auto data = shards_[getShardIndex(key)].data.wlock();
+  putLocked(*data, keySpace, StringPiece(key), std::move(storedValue));
+}
+
+std::unique_ptr<LocalStore::WriteBatch> MemoryLocalStore::beginWrite(
+    size_t bufSize) {
+  return std::make_unique<MemoryWriteBatch>(this, bufSize);
 }
 
-std::unique_ptr<LocalStore::WriteBatch> MemoryLocalStore::beginWrite(size_t) {
-  return std::make_unique<MemoryWriteBatch>(this);
+size_t MemoryLocalStore::getTotalSize() const {
+  size_t totalSize = 0;
+  for (const auto& shard : shards_) {
+    totalSize += shard.data.rlock()->totalBytes;
+  }
+  return totalSize;
 }
 
 } // namespace eden
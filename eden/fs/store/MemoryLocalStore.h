@@ -9,26 +9,44 @@
  */
 #pragma once
 #include <folly/Synchronized.h>
+#include <folly/concurrency/CacheLocality.h>
 #include <folly/experimental/StringKeyedUnorderedMap.h>
+#include <array>
+#include <deque>
+#include <memory>
 #include "eden/fs/store/LocalStore.h"
 
 namespace facebook {
 namespace eden {
 
 /** An implementation of LocalStore that stores values in memory.
- * Stored values remain in memory for the lifetime of the
- * MemoryLocalStore instance.
  * MemoryLocalStore is thread safe, allowing concurrent reads and
  * writes from any thread.
+ *
+ * Keys are spread over a fixed number of shards, each with its own lock, so
+ * that accesses to different keys rarely contend.  Values are stored as
+ * immutable shared strings, and get() hands out a reference to the stored
+ * value rather than a copy.
+ *
+ * By default stored values remain in memory for the lifetime of the
+ * MemoryLocalStore instance.  If maxBytes is non-zero, the oldest values are
+ * evicted once the keys and values stored exceed it.  Only key spaces that
+ * can be refetched from the BackingStore are ever evicted; the
+ * HgProxyHashFamily cannot be, and is always kept.
  * */
 class MemoryLocalStore : public LocalStore {
  public:
-  explicit MemoryLocalStore(std::shared_ptr<ReloadableConfig> config = nullptr);
+  explicit MemoryLocalStore(
+      std::shared_ptr<ReloadableConfig> config = nullptr,
+      size_t maxBytes = 0);
   void close() override;
   void clearKeySpace(KeySpace keySpace) override;
   void compactKeySpace(KeySpace keySpace) override;
   StoreResult get(LocalStore::KeySpace keySpace, folly::ByteRange key)
       const override;
+  FOLLY_NODISCARD folly::Future<std::vector<StoreResult>> getBatch(
+      KeySpace keySpace,
+      const std::vector<folly::ByteRange>& keys) const override;
   bool hasKey(LocalStore::KeySpace keySpace, folly::ByteRange key)
       const override;
   void put(
@@ -38,9 +56,45 @@ class MemoryLocalStore : public LocalStore {
   std::unique_ptr<LocalStore::WriteBatch> beginWrite(
       size_t bufSize = 0) override;
 
+  /**
+   * Returns the number of bytes of keys and values currently stored.
+   */
+  size_t getTotalSize() const;
+
  private:
-  folly::Synchronized<std::vector<folly::StringKeyedUnorderedMap<std::string>>>
-      storage_;
+  class MemoryWriteBatch;
+
+  using Value = std::shared_ptr<const std::string>;
+  using KeySpaceMap = folly::StringKeyedUnorderedMap<Value>;
+
+  struct ShardData {
+    std::array<KeySpaceMap, KeySpace::End> keySpaces;
+    // The evictable entries in the order they were added.  This is only
+    // maintained when the store has a byte budget.
+    std::deque<std::pair<KeySpace, std::string>> evictionQueue;
+    size_t totalBytes{0};
+  };
+
+  static constexpr size_t kNumShards = 32;
+  struct alignas(folly::hardware_destructive_interference_size) Shard {
+    folly::Synchronized<ShardData> data;
+  };
+
+  size_t getShardIndex(folly::ByteRange key) const;
+
+  /**
+   * Store value under key in a locked shard, and evict the shard's oldest
+   * entries if that takes it over its share of the byte budget.
+   */
+  void putLocked(
+      ShardData& shard,
+      KeySpace keySpace,
+      folly::StringPiece key,
+      Value value);
+
+  // The byte budget for each shard, or 0 if the store is unbounded.
+  const size_t maxShardBytes_;
+  std::array<Shard, kNumShards> shards_;
 };
 
 } // namespace eden
@@ -13,12 +13,19 @@
 #include <folly/futures/Future.h>
 #include <folly/io/IOBuf.h>
 #include <folly/logging/xlog.h>
+#include <folly/stop_watch.h>
 #include <stdexcept>
 
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Tree.h"
+#include "eden/fs/model/git/GitTree.h"
 #include "eden/fs/store/BackingStore.h"
 #include "eden/fs/store/LocalStore.h"
+#include "eden/fs/store/SerializedBlobMetadata.h"
+#include "eden/fs/store/StoreResult.h"
+#include "eden/fs/store/StoreStats.h"
+#include "eden/fs/tracing/Tracing.h"
+#include "eden/fs/utils/ProcessFetchLog.h"
 
 using folly::Future;
 using folly::IOBuf;
@@ -47,8 +54,9 @@ ObjectStore::ObjectStore(
 ObjectStore::~ObjectStore() {}
 
 Future<shared_ptr<const Tree>> ObjectStore::getTree(const Hash& id) const {
+  TraceBlock block{"ObjectStore::getTree"};
   // Check in the LocalStore first
-  return localStore_->getTree(id).thenValue(
+  auto result = localStore_->getTree(id).thenValue(
       [id, backingStore = backingStore_](shared_ptr<const Tree> tree) {
         if (tree) {
           XLOG(DBG4) << "tree " << id << " found in local store";
@@ -66,8 +74,14 @@ Future<shared_ptr<const Tree>> ObjectStore::getTree(const Hash& id) const {
         // this layer.
 
         // Load the tree from the BackingStore.
+        TraceBlock fetchBlock{"BackingStore::getTree"};
+        LatencyRecorder latency{&StoreStats::backingStoreGetTree};
+        folly::stop_watch<std::chrono::microseconds> fetchTimer;
         return backingStore->getTree(id).thenValue(
-            [id](unique_ptr<const Tree> loadedTree) {
+            [id,
+             fetchBlock = std::move(fetchBlock),
+             latency = std::move(latency),
+             fetchTimer](unique_ptr<const Tree> loadedTree) {
               if (!loadedTree) {
                 // TODO: Perhaps we should do some short-term negative caching?
                 XLOG(DBG2) << "unable to find tree " << id;
@@ -81,13 +95,16 @@ Future<shared_ptr<const Tree>> ObjectStore::getTree(const Hash& id) const {
               //
               // localStore_->putTree(loadedTree.get());
               XLOG(DBG3) << "tree " << id << " retrieved from backing store";
+              getProcessFetchLog().recordTreeFetch(fetchTimer.elapsed());
               return shared_ptr<const Tree>(std::move(loadedTree));
             });
       });
+  return std::move(result).ensure([block = std::move(block)] {});
 }
 
 Future<shared_ptr<const Blob>> ObjectStore::getBlob(const Hash& id) const {
-  return localStore_->getBlob(id).thenValue(
+  TraceBlock block{"ObjectStore::getBlob"};
+  auto result = localStore_->getBlob(id).thenValue(
       [id, self = shared_from_this()](shared_ptr<const Blob> blob) {
         if (blob) {
           // Not computing the BlobMetadata here because if the blob was found
@@ -100,8 +117,15 @@ Future<shared_ptr<const Blob>> ObjectStore::getBlob(const Hash& id) const {
         }
 
         // Look in the BackingStore
+        TraceBlock fetchBlock{"BackingStore::getBlob"};
+        LatencyRecorder latency{&StoreStats::backingStoreGetBlob};
+        folly::stop_watch<std::chrono::microseconds> fetchTimer;
         return self->backingStore_->getBlob(id).thenValue(
-            [self, id](unique_ptr<const Blob> loadedBlob) {
+            [self,
+             id,
+             fetchBlock = std::move(fetchBlock),
+             latency = std::move(latency),
+             fetchTimer](unique_ptr<const Blob> loadedBlob) {
               if (!loadedBlob) {
                 XLOG(DBG2) << "unable to find blob " << id;
                 // TODO: Perhaps we should do some short-term negative caching?
@@ -110,11 +134,14 @@ Future<shared_ptr<const Blob>> ObjectStore::getBlob(const Hash& id) const {
               }
 
               XLOG(DBG3) << "blob " << id << "  retrieved from backing store";
+              getProcessFetchLog().recordBlobFetch(
+                  loadedBlob->getSize(), fetchTimer.elapsed());
               auto metadata = self->localStore_->putBlob(id, loadedBlob.get());
               self->metadataCache_.wlock()->set(id, metadata);
               return shared_ptr<const Blob>(std::move(loadedBlob));
             });
       });
+  return std::move(result).ensure([block = std::move(block)] {});
 }
 
 folly::Future<folly::Unit> ObjectStore::prefetchBlobs(
@@ -130,7 +157,183 @@ folly::Future<folly::Unit> ObjectStore::prefetchBlobs(
   if (ids.empty()) {
     return folly::unit;
   }
-  return backingStore_->prefetchBlobs(ids);
+  LatencyRecorder latency{&StoreStats::backingStorePrefetchBlobs};
+  return backingStore_->prefetchBlobs(ids).ensure(
+      [latency = std::move(latency)] {});
+}
+
+Future<folly::Unit> ObjectStore::prefetchTrees(
+    const std::vector<Hash>& ids) const {
+  if (ids.empty()) {
+    return folly::unit;
+  }
+
+  auto requested = std::make_shared<std::vector<Hash>>(ids);
+  std::vector<folly::ByteRange> keys;
+  keys.reserve(requested->size());
+  for (const auto& id : *requested) {
+    keys.push_back(id.getBytes());
+  }
+
+  return folly::makeFutureWith([&] {
+           return localStore_->getBatch(LocalStore::TreeFamily, keys);
+         })
+      .thenValue([requested, self = shared_from_this()](
+                     std::vector<StoreResult>&& results) {
+        auto missing = std::make_shared<std::vector<Hash>>();
+        for (size_t i = 0; i < requested->size(); ++i) {
+          if (!results[i].isValid()) {
+            missing->push_back((*requested)[i]);
+          }
+        }
+        if (missing->empty()) {
+          return makeFuture();
+        }
+
+        // Give the BackingStore a chance to fetch all of the missing trees
+        // at once.  Anything it did not fetch is then loaded individually.
+        return self->backingStore_->prefetchTrees(*missing)
+            .onError([](const folly::exception_wrapper& ew) {
+              XLOG(DBG3) << "error batch prefetching trees: " << ew.what();
+            })
+            .thenValue([missing, self](folly::Unit) {
+              std::vector<Future<folly::Unit>> futures;
+              futures.reserve(missing->size());
+              for (const auto& id : *missing) {
+                futures.emplace_back(self->getTree(id).unit().onError(
+                    [id](const folly::exception_wrapper& ew) {
+                      XLOG(DBG3) << "error prefetching tree " << id << ": "
+                                 << ew.what();
+                    }));
+              }
+              return folly::collectAll(futures).unit();
+            });
+      })
+      .onError([](const folly::exception_wrapper& ew) {
+        XLOG(DBG3) << "error prefetching trees: " << ew.what();
+      });
+}
+
+std::vector<Future<shared_ptr<const Tree>>> ObjectStore::getTrees(
+    const std::vector<Hash>& ids) const {
+  using TreePromises = std::vector<folly::Promise<shared_ptr<const Tree>>>;
+  auto promises = std::make_shared<TreePromises>(ids.size());
+  std::vector<Future<shared_ptr<const Tree>>> futures;
+  futures.reserve(ids.size());
+  for (auto& promise : *promises) {
+    futures.push_back(promise.getFuture());
+  }
+  if (ids.empty()) {
+    return futures;
+  }
+
+  auto requested = std::make_shared<std::vector<Hash>>(ids);
+  std::vector<folly::ByteRange> keys;
+  keys.reserve(requested->size());
+  for (const auto& id : *requested) {
+    keys.push_back(id.getBytes());
+  }
+
+  folly::makeFutureWith([&] {
+    return localStore_->getBatch(LocalStore::TreeFamily, keys);
+  }).thenTry([requested, promises, self = shared_from_this()](
+                 folly::Try<std::vector<StoreResult>>&& results) {
+    // If the batched read failed, load every tree the way getTree() does.
+    if (results.hasException()) {
+      XLOG(DBG3) << "error reading trees from the local store: "
+                 << results.exception().what();
+    }
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < requested->size(); ++i) {
+      if (results.hasValue() && (*results)[i].isValid()) {
+        const auto& id = (*requested)[i];
+        const auto& data = (*results)[i];
+        (*promises)[i].setWith([&] {
+          return shared_ptr<const Tree>(deserializeGitTree(id, data.bytes()));
+        });
+      } else {
+        missing.push_back(i);
+      }
+    }
+    if (missing.empty()) {
+      return;
+    }
+
+    // Give the BackingStore a chance to fetch all of the missing trees at
+    // once.  getTree() then finds them in the LocalStore, or fetches any the
+    // batch did not cover.
+    std::vector<Hash> missingIds;
+    missingIds.reserve(missing.size());
+    for (auto index : missing) {
+      missingIds.push_back((*requested)[index]);
+    }
+    folly::makeFutureWith([&] {
+      return self->backingStore_->prefetchTrees(missingIds);
+    }).thenTry([requested, promises, self, missing = std::move(missing)](
+                   folly::Try<folly::Unit>&& prefetched) {
+      if (prefetched.hasException()) {
+        XLOG(DBG3) << "error batch prefetching trees: "
+                   << prefetched.exception().what();
+      }
+      for (auto index : missing) {
+        folly::makeFutureWith([&] {
+          return self->getTree((*requested)[index]);
+        }).thenTry([promises, index](
+                       folly::Try<shared_ptr<const Tree>>&& tree) {
+          (*promises)[index].setTry(std::move(tree));
+        });
+      }
+    });
+  });
+  return futures;
+}
+
+Future<std::vector<Hash>> ObjectStore::prefetchBlobMetadata(
+    const std::vector<Hash>& ids) const {
+  // Skip anything we already have cached in memory.
+  auto missing = std::make_shared<std::vector<Hash>>();
+  {
+    auto metadataCache = metadataCache_.wlock();
+    for (const auto& id : ids) {
+      if (metadataCache->find(id) == metadataCache->end()) {
+        missing->push_back(id);
+      }
+    }
+  }
+  if (missing->empty()) {
+    return std::vector<Hash>{};
+  }
+
+  std::vector<folly::ByteRange> keys;
+  keys.reserve(missing->size());
+  for (const auto& id : *missing) {
+    keys.push_back(id.getBytes());
+  }
+
+  return folly::makeFutureWith([&] {
+           return localStore_->getBatch(LocalStore::BlobMetaDataFamily, keys);
+         })
+      .thenValue([missing, self = shared_from_this()](
+                     std::vector<StoreResult>&& results) {
+        // Blobs without stored metadata are skipped rather than fetched:
+        // computing their metadata would mean downloading their contents,
+        // which is more than a speculative prefetch should cost.
+        std::vector<Hash> loaded;
+        auto metadataCache = self->metadataCache_.wlock();
+        for (size_t i = 0; i < results.size(); ++i) {
+          if (results[i].isValid()) {
+            const auto& id = (*missing)[i];
+            metadataCache->set(
+                id, SerializedBlobMetadata::parse(id, results[i]));
+            loaded.push_back(id);
+          }
+        }
+        return loaded;
+      })
+      .onError([](const folly::exception_wrapper& ew) {
+        XLOG(DBG3) << "error prefetching blob metadata: " << ew.what();
+        return std::vector<Hash>{};
+      });
 }
 
 Future<shared_ptr<const Tree>> ObjectStore::getTreeForCommit(
@@ -151,15 +354,28 @@ Future<shared_ptr<const Tree>> ObjectStore::getTreeForCommit(
       });
 }
 
+std::optional<BlobMetadata> ObjectStore::getCachedBlobMetadata(
+    const Hash& id) const {
+  auto metadataCache = metadataCache_.wlock();
+  auto cacheIter = metadataCache->find(id);
+  if (cacheIter == metadataCache->end()) {
+    return std::nullopt;
+  }
+  getStoreStats()->metadataCacheHit.incrementValue();
+  return cacheIter->second;
+}
+
 Future<BlobMetadata> ObjectStore::getBlobMetadata(const Hash& id) const {
   // First, check the in-memory cache.
   {
     auto metadataCache = metadataCache_.wlock();
     auto cacheIter = metadataCache->find(id);
     if (cacheIter != metadataCache->end()) {
+      getStoreStats()->metadataCacheHit.incrementValue();
       return cacheIter->second;
     }
   }
+  getStoreStats()->metadataCacheMiss.incrementValue();
 
   return localStore_->getBlobMetadata(id).thenValue(
       [id, self = shared_from_this()](std::optional<BlobMetadata>&& localData) {
@@ -176,13 +392,16 @@ Future<BlobMetadata> ObjectStore::getBlobMetadata(const Hash& id) const {
         //
         // TODO: This should probably check the LocalStore for the blob first,
         // especially when we begin to expire entries in RocksDB.
+        folly::stop_watch<std::chrono::microseconds> fetchTimer;
         return self->backingStore_->getBlob(id).thenValue(
-            [self, id](std::unique_ptr<Blob> blob) {
+            [self, id, fetchTimer](std::unique_ptr<Blob> blob) {
               if (!blob) {
                 // TODO: Perhaps we should do some short-term negative caching?
                 throw std::domain_error(
                     folly::to<string>("blob ", id.toString(), " not found"));
               }
+              getProcessFetchLog().recordBlobFetch(
+                  blob->getSize(), fetchTimer.elapsed());
 
               auto metadata = self->localStore_->putBlob(id, blob.get());
               self->metadataCache_.wlock()->set(id, metadata);
@@ -195,5 +414,23 @@ Future<Hash> ObjectStore::getSha1(const Hash& id) const {
   return getBlobMetadata(id).thenValue(
       [](const BlobMetadata& metadata) { return metadata.sha1; });
 }
+
+ObjectStore::MetadataSnapshot ObjectStore::getMetadataCacheSnapshot() const {
+  auto metadataCache = metadataCache_.rlock();
+  MetadataSnapshot snapshot;
+  snapshot.reserve(metadataCache->size());
+  // EvictingCacheMap iterates from most to least recently used.
+  for (auto it = metadataCache->rbegin(); it != metadataCache->rend(); ++it) {
+    snapshot.emplace_back(it->first, it->second);
+  }
+  return snapshot;
+}
+
+void ObjectStore::restoreMetadataCache(const MetadataSnapshot& snapshot) const {
+  auto metadataCache = metadataCache_.wlock();
+  for (const auto& entry : snapshot) {
+    metadataCache->set(entry.first, entry.second);
+  }
+}
 } // namespace eden
 } // namespace facebook
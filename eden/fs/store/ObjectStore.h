@@ -12,6 +12,9 @@
 #include <folly/Synchronized.h>
 #include <folly/container/EvictingCacheMap.h>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/store/BlobMetadata.h"
 #include "eden/fs/store/IObjectStore.h"
@@ -37,6 +40,8 @@ class Tree;
 class ObjectStore : public IObjectStore,
                     public std::enable_shared_from_this<ObjectStore> {
  public:
+  using MetadataSnapshot = std::vector<std::pair<Hash, BlobMetadata>>;
+
   static std::shared_ptr<ObjectStore> create(
       std::shared_ptr<LocalStore> localStore,
       std::shared_ptr<BackingStore> backingStore);
@@ -83,11 +88,69 @@ class ObjectStore : public IObjectStore,
    */
   folly::Future<BlobMetadata> getBlobMetadata(const Hash& id) const override;
 
+  /**
+   * Get metadata about a Blob if it is in the in-memory metadata cache.
+   *
+   * Returns std::nullopt rather than consulting the LocalStore or the
+   * BackingStore, so this never blocks on I/O.
+   */
+  std::optional<BlobMetadata> getCachedBlobMetadata(const Hash& id) const;
+
+  /**
+   * Ensure that the given trees are present in the LocalStore, fetching
+   * any that are missing from the BackingStore.  The missing trees are
+   * first handed to BackingStore::prefetchTrees() so that stores which
+   * support batched fetches can load them with a single request.
+   *
+   * The returned Future completes once every fetch has finished.  Errors
+   * fetching individual trees are logged and otherwise ignored, since
+   * callers use this purely as a performance hint.
+   */
+  folly::Future<folly::Unit> prefetchTrees(const std::vector<Hash>& ids) const;
+
+  /**
+   * Get several Trees at once.
+   *
+   * The Trees that are already in the LocalStore are read with one batched
+   * read, and the missing ones are handed to BackingStore::prefetchTrees()
+   * together before being loaded as getTree() would.  Returns one Future per
+   * id, in the same order.  Each completes as soon as its own Tree has been
+   * loaded, so Trees found locally do not wait for the BackingStore.
+   */
+  std::vector<folly::Future<std::shared_ptr<const Tree>>> getTrees(
+      const std::vector<Hash>& ids) const;
+
+  /**
+   * Populate the in-memory metadata cache for the given blobs.
+   *
+   * Entries already present in the cache are skipped and the remainder are
+   * looked up in the LocalStore with a single batched read.  Blobs whose
+   * metadata is not stored locally are left alone rather than downloaded.
+   * Like prefetchTrees(), errors are logged and ignored.
+   *
+   * Returns the IDs whose metadata was loaded from the LocalStore.
+   */
+  folly::Future<std::vector<Hash>> prefetchBlobMetadata(
+      const std::vector<Hash>& ids) const;
+
   /**
    * Returns the SHA-1 hash of the contents of the blob with the given ID.
    */
   folly::Future<Hash> getSha1(const Hash& id) const;
 
+  /**
+   * Returns the contents of the in-memory metadata cache, least recently
+   * used first.  Used to carry the cache across a graceful restart.
+   */
+  MetadataSnapshot getMetadataCacheSnapshot() const;
+
+  /**
+   * Add the entries of a snapshot returned by getMetadataCacheSnapshot() to
+   * the in-memory metadata cache.  Entries later in the snapshot are treated
+   * as more recently used.
+   */
+  void restoreMetadataCache(const MetadataSnapshot& snapshot) const;
+
   /**
    * Get the LocalStore used by this ObjectStore
    */
@@ -15,10 +15,15 @@
 #include <folly/io/IOBuf.h>
 #include <folly/lang/Bits.h>
 #include <folly/logging/xlog.h>
+#include <rocksdb/cache.h>
+#include <rocksdb/convenience.h>
 #include <rocksdb/db.h>
 #include <rocksdb/filter_policy.h>
 #include <rocksdb/table.h>
+#include <algorithm>
 #include <array>
+#include <optional>
+#include "eden/fs/config/ReloadableConfig.h"
 #include "eden/fs/rocksdb/RocksException.h"
 #include "eden/fs/rocksdb/RocksHandles.h"
 #include "eden/fs/store/StoreResult.h"
@@ -39,15 +44,78 @@ using std::unique_ptr;
 namespace {
 using namespace facebook::eden;
 
-rocksdb::ColumnFamilyOptions makeColumnOptions(uint64_t LRUblockCacheSizeMB) {
+/**
+ * Returns the compression type for a configured name, or std::nullopt to
+ * keep the compression that OptimizeLevelStyleCompaction() chose.
+ *
+ * EdenConfig only accepts known names, but a codec may not have been compiled
+ * into this build of RocksDB, and DB::Open() rejects options that use it.
+ */
+std::optional<rocksdb::CompressionType> parseCompression(StringPiece name) {
+  rocksdb::CompressionType type;
+  if (name == "auto") {
+    return std::nullopt;
+  } else if (name == "none") {
+    return rocksdb::kNoCompression;
+  } else if (name == "snappy") {
+    type = rocksdb::kSnappyCompression;
+  } else if (name == "zlib") {
+    type = rocksdb::kZlibCompression;
+  } else if (name == "lz4") {
+    type = rocksdb::kLZ4Compression;
+  } else if (name == "zstd") {
+    type = rocksdb::kZSTD;
+  } else {
+    XLOG(ERR) << "unknown rocksdb compression type \"" << name
+              << "\", using the default compression";
+    return std::nullopt;
+  }
+
+  static const auto supported = rocksdb::GetSupportedCompressions();
+  if (std::find(supported.begin(), supported.end(), type) == supported.end()) {
+    XLOG(ERR) << "rocksdb compression type \"" << name
+              << "\" is not supported by this build of rocksdb, using the "
+                 "default compression";
+    return std::nullopt;
+  }
+  return type;
+}
+
+rocksdb::ColumnFamilyOptions makeColumnOptions(
+    std::shared_ptr<rocksdb::Cache> blockCache,
+    const EdenConfig& config,
+    StringPiece compression) {
   rocksdb::ColumnFamilyOptions options;
 
   // We'll never perform range scans on any of the keys that we store.
-  // This enables bloom filters and a hash policy that improves our
-  // get/put performance.
-  options.OptimizeForPointLookup(LRUblockCacheSizeMB);
-
+  // This is what OptimizeForPointLookup() sets up, but with a configurable
+  // bloom filter.  Every key is a whole hash, so whole key filtering lets
+  // most lookups for missing keys skip reading data blocks entirely, and
+  // there is no useful prefix to extract.
+  rocksdb::BlockBasedTableOptions tableOptions;
+  tableOptions.data_block_index_type =
+      rocksdb::BlockBasedTableOptions::kDataBlockBinaryAndHash;
+  tableOptions.data_block_hash_table_util_ratio = 0.75;
+  tableOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(
+      config.getRocksDbBloomBitsPerKey(), /*use_block_based_builder=*/false));
+  tableOptions.whole_key_filtering = true;
+  tableOptions.block_cache = std::move(blockCache);
+  options.table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(tableOptions));
+  options.memtable_prefix_bloom_size_ratio = 0.02;
+  options.memtable_whole_key_filtering = true;
+
+  // OptimizeLevelStyleCompaction() leaves the first levels uncompressed for
+  // write speed, and picks a supported codec for the rest.  An explicitly
+  // configured compression replaces that codec.
   options.OptimizeLevelStyleCompaction();
+  if (auto compressionType = parseCompression(compression)) {
+    for (size_t level = 2; level < options.compression_per_level.size();
+         ++level) {
+      options.compression_per_level[level] = *compressionType;
+    }
+    options.compression = *compressionType;
+  }
   return options;
 }
 
@@ -55,25 +123,62 @@ rocksdb::ColumnFamilyOptions makeColumnOptions(uint64_t LRUblockCacheSizeMB) {
  * The different key spaces that we desire.
  * The ordering is coupled with the values of the LocalStore::KeySpace enum.
  */
-const std::vector<rocksdb::ColumnFamilyDescriptor>& columnFamilies() {
+std::vector<rocksdb::ColumnFamilyDescriptor> columnFamilies(
+    const EdenConfig& config) {
   // Most of the column families will share the same cache.  We
   // want the blob data to live in its own smaller cache; the assumption
   // is that the vfs cache will compensate for that, together with the
   // idea that we shouldn't need to materialize a great many files.
-  auto options = makeColumnOptions(64);
-  auto blobOptions = makeColumnOptions(8);
+  auto sharedCache = rocksdb::NewLRUCache(64 * 1024 * 1024);
+  auto metadataOptions = makeColumnOptions(
+      sharedCache, config, config.getRocksDbMetadataCompression());
+  auto treeOptions = makeColumnOptions(
+      sharedCache, config, config.getRocksDbTreeCompression());
+  auto blobOptions = makeColumnOptions(
+      rocksdb::NewLRUCache(8 * 1024 * 1024),
+      config,
+      config.getRocksDbBlobCompression());
+
+  if (config.getRocksDbBlobFiles()) {
+    // Keep file contents in blob files, so that compaction only rewrites the
+    // small references to them instead of multi-megabyte values.
+    blobOptions.enable_blob_files = true;
+    blobOptions.min_blob_size = config.getRocksDbMinBlobFileValueSize();
+    // Blob files are written alongside the lowest levels, so compress them
+    // the same way.
+    blobOptions.blob_compression_type =
+        blobOptions.compression_per_level.empty()
+        ? blobOptions.compression
+        : blobOptions.compression_per_level.back();
+    blobOptions.enable_blob_garbage_collection = true;
+  }
 
-  // Meyers singleton to avoid SIOF issues
-  static const std::vector<rocksdb::ColumnFamilyDescriptor> families{
+  return {
       rocksdb::ColumnFamilyDescriptor{rocksdb::kDefaultColumnFamilyName,
-                                      options},
+                                      metadataOptions},
       rocksdb::ColumnFamilyDescriptor{"blob", blobOptions},
-      rocksdb::ColumnFamilyDescriptor{"blobmeta", options},
-      rocksdb::ColumnFamilyDescriptor{"tree", options},
-      rocksdb::ColumnFamilyDescriptor{"hgproxyhash", options},
-      rocksdb::ColumnFamilyDescriptor{"hgcommit2tree", options},
+      rocksdb::ColumnFamilyDescriptor{"blobmeta", metadataOptions},
+      rocksdb::ColumnFamilyDescriptor{"tree", treeOptions},
+      rocksdb::ColumnFamilyDescriptor{"hgproxyhash", metadataOptions},
+      rocksdb::ColumnFamilyDescriptor{"hgcommit2tree", metadataOptions},
   };
-  return families;
+}
+
+/**
+ * Returns the current EdenConfig, or one with the default settings if the
+ * store was created without a config.
+ */
+std::shared_ptr<const EdenConfig> getConfig(ReloadableConfig* config) {
+  if (config) {
+    return config->getEdenConfig();
+  }
+  static const auto defaultConfig = std::make_shared<const EdenConfig>(
+      /*userName=*/StringPiece{},
+      /*userHomePath=*/AbsolutePath{"/"},
+      /*userConfigPath=*/AbsolutePath{"/.edenrc"},
+      /*systemConfigDir=*/AbsolutePath{"/etc/eden"},
+      /*systemConfigPath=*/AbsolutePath{"/etc/eden/edenfs.rc"});
+  return defaultConfig;
 }
 
 rocksdb::Slice _createSlice(folly::ByteRange bytes) {
@@ -105,6 +210,7 @@ class RocksDbWriteBatch : public LocalStore::WriteBatch {
 void RocksDbWriteBatch::flush() {
   auto pending = writeBatch_.Count();
   if (pending == 0) {
+    runAfterFlushCallbacks();
     return;
   }
 
@@ -120,6 +226,7 @@ void RocksDbWriteBatch::flush() {
   }
 
   writeBatch_.Clear();
+  runAfterFlushCallbacks();
 }
 
 void RocksDbWriteBatch::flushIfNeeded() {
@@ -184,7 +291,9 @@ RocksDbLocalStore::RocksDbLocalStore(
     AbsolutePathPiece pathToRocksDb,
     std::shared_ptr<ReloadableConfig> config)
     : LocalStore(std::move(config)),
-      dbHandles_(pathToRocksDb.stringPiece(), columnFamilies()),
+      dbHandles_(
+          pathToRocksDb.stringPiece(),
+          columnFamilies(*getConfig(config_.get()))),
       ioPool_(12, "RocksLocalStore") {}
 
 RocksDbLocalStore::~RocksDbLocalStore() {
@@ -227,6 +336,7 @@ void RocksDbLocalStore::compactKeySpace(KeySpace keySpace) {
 
 StoreResult RocksDbLocalStore::get(LocalStore::KeySpace keySpace, ByteRange key)
     const {
+  auto latency = recordGetLatency(keySpace);
   string value;
   auto status = dbHandles_.db->Get(
       ReadOptions(),
@@ -291,6 +401,7 @@ RocksDbLocalStore::getBatch(
   for (auto& batch : batches) {
     futures.emplace_back(
         folly::via(&ioPool_, [this, keySpace, keys = std::move(batch)] {
+          auto latency = recordGetLatency(keySpace);
           std::vector<Slice> keySlices;
           std::vector<std::string> values;
           std::vector<rocksdb::ColumnFamilyHandle*> columns;
@@ -346,12 +457,25 @@ RocksDbLocalStore::getBatch(
 bool RocksDbLocalStore::hasKey(
     LocalStore::KeySpace keySpace,
     folly::ByteRange key) const {
-  string value;
-  auto status = dbHandles_.db->Get(
-      ReadOptions(),
-      dbHandles_.columns[keySpace].get(),
-      _createSlice(key),
-      &value);
+  auto* column = dbHandles_.columns[keySpace].get();
+  auto keySlice = _createSlice(key);
+
+  // KeyMayExist() only consults the memtables, the bloom filters and the
+  // block cache.  It never reads from disk, so it can rule out most missing
+  // keys cheaply, and it finds recently used keys without a full lookup.
+  string cachedValue;
+  bool valueFound = false;
+  if (!dbHandles_.db->KeyMayExist(
+          ReadOptions(), column, keySlice, &cachedValue, &valueFound)) {
+    return false;
+  }
+  if (valueFound) {
+    return true;
+  }
+
+  // Pin the value where it lies rather than copying it out.
+  rocksdb::PinnableSlice value;
+  auto status = dbHandles_.db->Get(ReadOptions(), column, keySlice, &value);
   if (!status.ok()) {
     if (status.IsNotFound()) {
       return false;
@@ -368,6 +492,21 @@ bool RocksDbLocalStore::hasKey(
   return true;
 }
 
+folly::Future<std::vector<Hash>> RocksDbLocalStore::getMissing(
+    KeySpace keySpace,
+    const std::vector<Hash>& ids) const {
+  return folly::via(&ioPool_, [this, keySpace, ids] {
+    auto latency = recordGetLatency(keySpace);
+    std::vector<Hash> missing;
+    for (const auto& id : ids) {
+      if (!hasKey(keySpace, id.getBytes())) {
+        missing.push_back(id);
+      }
+    }
+    return missing;
+  });
+}
+
 std::unique_ptr<LocalStore::WriteBatch> RocksDbLocalStore::beginWrite(
     size_t bufSize) {
   return std::make_unique<RocksDbWriteBatch>(dbHandles_, bufSize);
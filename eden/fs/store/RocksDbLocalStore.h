@@ -39,6 +39,9 @@ class RocksDbLocalStore : public LocalStore {
       const std::vector<folly::ByteRange>& keys) const override;
   bool hasKey(LocalStore::KeySpace keySpace, folly::ByteRange key)
       const override;
+  FOLLY_NODISCARD folly::Future<std::vector<Hash>> getMissing(
+      KeySpace keySpace,
+      const std::vector<Hash>& ids) const override;
   void put(
       LocalStore::KeySpace keySpace,
       folly::ByteRange key,
@@ -8,6 +8,7 @@
  *
  */
 #include "eden/fs/store/SqliteLocalStore.h"
+#include <folly/ScopeGuard.h>
 #include <folly/String.h>
 #include <folly/container/Array.h>
 #include <folly/logging/xlog.h>
@@ -33,20 +34,26 @@ constexpr auto tableNames = folly::make_array(
     StringPiece("hgproxyhash"),
     StringPiece("hgcommit2tree"));
 
+// How long a connection waits for another to release a lock, for example
+// while the WAL is checkpointed, before failing with SQLITE_BUSY.
+constexpr int kBusyTimeoutMs = 5000;
+
+} // namespace
+
 /**
  * Implements the write batching helper.
  * In an ideal world, we'd just start a transaction and have the WriteBatch
  * methods accumulate against that transaction, committing on flush.
- * To do that we'd either need to lock the underlying sqlite handle
- * for the lifetime of the WriteBatch, or open a separate database connection.
- * The latter might be interesting to explore if the cost of opening the
- * connection is cheap enough.
- * For now though, we batch up the incoming data and then send it to the
- * database in the flush method.
+ * To do that we'd need to lock the writer connection for the lifetime of the
+ * WriteBatch, which would stall every other write.
+ * Instead we batch up the incoming data and then send it to the database in
+ * a single transaction in the flush method, which also runs once the
+ * buffered data reaches bufSize.
  */
-class SqliteWriteBatch : public LocalStore::WriteBatch {
+class SqliteLocalStore::SqliteWriteBatch : public LocalStore::WriteBatch {
  public:
-  explicit SqliteWriteBatch(SqliteDatabase& db) : db_(db) {
+  SqliteWriteBatch(Connection& writer, size_t bufSize)
+      : writer_(writer), bufSize_(bufSize) {
     buffer_.resize(LocalStore::KeySpace::End);
   }
 
@@ -54,6 +61,8 @@ class SqliteWriteBatch : public LocalStore::WriteBatch {
       override {
     buffer_[keySpace].emplace_back(
         StringPiece(key).str(), StringPiece(value).str());
+    bufferedBytes_ += key.size() + value.size();
+    flushIfNeeded();
   }
 
   void put(
@@ -68,21 +77,17 @@ class SqliteWriteBatch : public LocalStore::WriteBatch {
   }
 
   void flush() override {
-    auto db = db_.lock();
-
-    // Start a transaction for the flush operation
-    SqliteStatement(db, "BEGIN").step();
+    auto db = writer_.lock();
 
-    try {
+    writer_.transaction(db, [&] {
       for (size_t i = 1; i < buffer_.size(); ++i) {
         auto& items = buffer_[i];
         if (items.empty()) {
           continue;
         }
 
-        // See commentary in SqliteLocalStore::put re: `or ignore`
-        SqliteStatement stmt(
-            db, "insert or ignore into ", tableNames[i], " VALUES(?, ?)");
+        auto& stmt = writer_.getStatement(
+            db, Query::Insert, static_cast<LocalStore::KeySpace>(i));
 
         for (const auto& item : items) {
           const auto& key = item.first;
@@ -92,32 +97,126 @@ class SqliteWriteBatch : public LocalStore::WriteBatch {
           stmt.bind(2, value);
           stmt.step();
         }
-        items.clear();
       }
+    });
 
-      SqliteStatement(db, "COMMIT").step();
-    } catch (const std::exception&) {
-      // Speculative rollback to make sure that we're not still in a
-      // transaction if we bail out in the error path
-      SqliteStatement(db, "ROLLBACK").step();
-      throw;
+    // Only discard the items once they are committed.
+    for (auto& items : buffer_) {
+      items.clear();
     }
+    bufferedBytes_ = 0;
+    runAfterFlushCallbacks();
   }
 
  private:
+  void flushIfNeeded() {
+    if (bufSize_ > 0 && bufferedBytes_ >= bufSize_) {
+      flush();
+    }
+  }
+
   std::vector<std::vector<std::pair<string, string>>> buffer_;
-  SqliteDatabase& db_;
+  Connection& writer_;
+  size_t bufSize_;
+  size_t bufferedBytes_{0};
 };
 
-} // namespace
+SqliteLocalStore::Connection::Connection(AbsolutePathPiece path, int flags)
+    : db_{path, flags} {
+  auto db = db_.lock();
+  checkSqliteResult(*db, sqlite3_busy_timeout(*db, kBusyTimeoutMs));
+}
+
+SqliteStatement& SqliteLocalStore::Connection::getStatement(
+    Synchronized<sqlite3*>::LockedPtr& db,
+    Query query,
+    KeySpace keySpace) {
+  auto& stmt = statements_[static_cast<size_t>(query)][keySpace];
+  if (stmt) {
+    return *stmt;
+  }
+
+  auto table = tableNames[keySpace];
+  switch (query) {
+    case Query::Get:
+      stmt = std::make_unique<SqliteStatement>(
+          db, "select value from ", table, " where key = ?");
+      break;
+    case Query::HasKey:
+      stmt = std::make_unique<SqliteStatement>(
+          db, "select 1 from ", table, " where key = ?");
+      break;
+    case Query::Insert:
+      stmt = std::make_unique<SqliteStatement>(
+          db,
+          // TODO: we need `or ignore` otherwise we hit primary key violations
+          // when running our integration tests.  This implies that we're
+          // over-fetching and that we have a perf improvement opportunity.
+          "insert or ignore into ",
+          table,
+          " VALUES(?, ?)");
+      break;
+    case Query::Begin:
+      stmt = std::make_unique<SqliteStatement>(db, "BEGIN");
+      break;
+    case Query::Commit:
+      stmt = std::make_unique<SqliteStatement>(db, "COMMIT");
+      break;
+    case Query::Rollback:
+      stmt = std::make_unique<SqliteStatement>(db, "ROLLBACK");
+      break;
+    case Query::End:
+      throw std::invalid_argument("invalid SqliteLocalStore query");
+  }
+  return *stmt;
+}
+
+void SqliteLocalStore::Connection::transaction(
+    Synchronized<sqlite3*>::LockedPtr& db,
+    folly::FunctionRef<void()> fn) {
+  getStatement(db, Query::Begin).step();
+
+  try {
+    fn();
+    getStatement(db, Query::Commit).step();
+  } catch (const std::exception&) {
+    // Speculative rollback to make sure that we're not still in a
+    // transaction if we bail out in the error path
+    getStatement(db, Query::Rollback).step();
+    throw;
+  }
+}
+
+void SqliteLocalStore::Connection::close() {
+  {
+    // The statements must be finalized before the connection can close.
+    auto db = db_.lock();
+    for (auto& statements : statements_) {
+      for (auto& stmt : statements) {
+        stmt.reset();
+      }
+    }
+  }
+  db_.close();
+}
 
 SqliteLocalStore::SqliteLocalStore(
     AbsolutePathPiece pathToDb,
     std::shared_ptr<ReloadableConfig> config)
-    : LocalStore(std::move(config)), db_(SqliteDatabase(pathToDb)) {
-  auto db = db_.lock();
-
-  // Write ahead log for faster perf
+    : LocalStore(std::move(config)),
+      pathToDb_(pathToDb.copy()),
+      writer_(pathToDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE),
+      readers_([this] {
+        // Each reader connection is only used by its own thread, and its
+        // lock already serializes that use with close(), so sqlite's own
+        // mutex is not needed.
+        return new Connection(
+            pathToDb_, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX);
+      }) {
+  auto db = writer_.lock();
+
+  // Write ahead log for faster perf, and so that the reader connections do
+  // not block on writes.
   // https://www.sqlite.org/wal.html
   SqliteStatement(db, "PRAGMA journal_mode=WAL").step();
 
@@ -139,11 +238,14 @@ SqliteLocalStore::SqliteLocalStore(
 }
 
 void SqliteLocalStore::close() {
-  db_.close();
+  writer_.close();
+  for (auto& reader : readers_.accessAll()) {
+    reader.close();
+  }
 }
 
 void SqliteLocalStore::clearKeySpace(KeySpace keySpace) {
-  auto db = db_.lock();
+  auto db = writer_.lock();
 
   SqliteStatement stmt(db, "delete from ", tableNames[keySpace]);
   stmt.step();
@@ -153,10 +255,15 @@ void SqliteLocalStore::compactKeySpace(KeySpace) {}
 
 StoreResult SqliteLocalStore::get(LocalStore::KeySpace keySpace, ByteRange key)
     const {
-  auto db = db_.lock();
+  auto latency = recordGetLatency(keySpace);
+  auto& reader = *readers_;
+  auto db = reader.lock();
 
-  SqliteStatement stmt(
-      db, "select value from ", tableNames[keySpace], " where key = ?");
+  auto& stmt = reader.getStatement(db, Query::Get, keySpace);
+  // Finish the statement's read transaction whether or not a row was found.
+  SCOPE_EXIT {
+    stmt.reset();
+  };
 
   // Bind the key; parameters are 1-based
   stmt.bind(1, key);
@@ -170,12 +277,45 @@ StoreResult SqliteLocalStore::get(LocalStore::KeySpace keySpace, ByteRange key)
   return StoreResult();
 }
 
+folly::Future<std::vector<StoreResult>> SqliteLocalStore::getBatch(
+    KeySpace keySpace,
+    const std::vector<folly::ByteRange>& keys) const {
+  return folly::makeFutureWith([&] {
+    auto latency = recordGetLatency(keySpace);
+    auto& reader = *readers_;
+    auto db = reader.lock();
+
+    // Look every key up in a single read transaction, rather than starting
+    // one for each key.
+    std::vector<StoreResult> results;
+    results.reserve(keys.size());
+    reader.transaction(db, [&] {
+      auto& stmt = reader.getStatement(db, Query::Get, keySpace);
+      for (auto& key : keys) {
+        SCOPE_EXIT {
+          stmt.reset();
+        };
+        stmt.bind(1, key);
+        if (stmt.step()) {
+          results.emplace_back(stmt.columnBlob(0).str());
+        } else {
+          results.emplace_back();
+        }
+      }
+    });
+    return results;
+  });
+}
+
 bool SqliteLocalStore::hasKey(LocalStore::KeySpace keySpace, ByteRange key)
     const {
-  auto db = db_.lock();
+  auto& reader = *readers_;
+  auto db = reader.lock();
 
-  SqliteStatement stmt(
-      db, "select 1 from ", tableNames[keySpace], " where key = ?");
+  auto& stmt = reader.getStatement(db, Query::HasKey, keySpace);
+  SCOPE_EXIT {
+    stmt.reset();
+  };
 
   stmt.bind(1, key);
   return stmt.step();
@@ -185,24 +325,21 @@ void SqliteLocalStore::put(
     LocalStore::KeySpace keySpace,
     ByteRange key,
     ByteRange value) {
-  auto db = db_.lock();
+  auto db = writer_.lock();
 
-  SqliteStatement stmt(
-      db,
-      // TODO: we need `or ignore` otherwise we hit primary key violations
-      // when running our integration tests.  This implies that we're
-      // over-fetching and that we have a perf improvement opportunity.
-      "insert or ignore into ",
-      tableNames[keySpace],
-      " VALUES(?, ?)");
+  auto& stmt = writer_.getStatement(db, Query::Insert, keySpace);
+  SCOPE_EXIT {
+    stmt.reset();
+  };
 
   stmt.bind(1, key);
   stmt.bind(2, value);
   stmt.step();
 }
 
-std::unique_ptr<LocalStore::WriteBatch> SqliteLocalStore::beginWrite(size_t) {
-  return std::make_unique<SqliteWriteBatch>(db_);
+std::unique_ptr<LocalStore::WriteBatch> SqliteLocalStore::beginWrite(
+    size_t bufSize) {
+  return std::make_unique<SqliteWriteBatch>(writer_, bufSize);
 }
 
 } // namespace eden
@@ -8,7 +8,11 @@
  *
  */
 #pragma once
+#include <folly/Function.h>
 #include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
+#include <array>
+#include <memory>
 #include "eden/fs/sqlite/Sqlite.h"
 #include "eden/fs/store/LocalStore.h"
 
@@ -18,6 +22,11 @@ namespace eden {
 /** An implementation of LocalStore that stores values in Sqlite.
  * SqliteLocalStore is thread safe, allowing reads and writes from
  * any thread.
+ *
+ * Writes go through a single connection.  Each thread that reads gets a
+ * connection of its own, so with the database in WAL mode readers neither
+ * wait for each other nor for the writer.  Every connection keeps the
+ * statements it has prepared, so a get() only binds and steps.
  * */
 class SqliteLocalStore : public LocalStore {
  public:
@@ -29,6 +38,9 @@ class SqliteLocalStore : public LocalStore {
   void compactKeySpace(KeySpace keySpace) override;
   StoreResult get(LocalStore::KeySpace keySpace, folly::ByteRange key)
       const override;
+  FOLLY_NODISCARD folly::Future<std::vector<StoreResult>> getBatch(
+      KeySpace keySpace,
+      const std::vector<folly::ByteRange>& keys) const override;
   bool hasKey(LocalStore::KeySpace keySpace, folly::ByteRange key)
       const override;
   void put(
@@ -39,7 +51,69 @@ class SqliteLocalStore : public LocalStore {
       size_t bufSize = 0) override;
 
  private:
-  mutable SqliteDatabase db_;
+  /**
+   * The statements that each Connection caches.  Those that name a table are
+   * cached once per KeySpace.
+   */
+  enum class Query {
+    Get,
+    HasKey,
+    Insert,
+    Begin,
+    Commit,
+    Rollback,
+    End,
+  };
+
+  /**
+   * A database connection and the statements prepared on it.
+   *
+   * The statements may only be used while holding the lock returned by
+   * lock().
+   */
+  class Connection {
+   public:
+    Connection(AbsolutePathPiece path, int flags);
+
+    folly::Synchronized<sqlite3*>::LockedPtr lock() {
+      return db_.lock();
+    }
+
+    /**
+     * Return the statement for query, preparing it on first use.  db must be
+     * the lock returned by lock().
+     */
+    SqliteStatement& getStatement(
+        folly::Synchronized<sqlite3*>::LockedPtr& db,
+        Query query,
+        KeySpace keySpace = KeySpace::BlobFamily);
+
+    /**
+     * Run fn() inside a transaction, rolling it back if fn() throws.  db must
+     * be the lock returned by lock().
+     */
+    void transaction(
+        folly::Synchronized<sqlite3*>::LockedPtr& db,
+        folly::FunctionRef<void()> fn);
+
+    /**
+     * Finalize the cached statements and close the connection.
+     */
+    void close();
+
+   private:
+    SqliteDatabase db_;
+    std::array<
+        std::array<std::unique_ptr<SqliteStatement>, KeySpace::End>,
+        static_cast<size_t>(Query::End)>
+        statements_;
+  };
+
+  class SqliteWriteBatch;
+
+  AbsolutePath pathToDb_;
+  mutable Connection writer_;
+  mutable folly::ThreadLocal<Connection> readers_;
 };
 
 } // namespace eden
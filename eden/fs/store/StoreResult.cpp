@@ -18,6 +18,13 @@ void freeString(void* /* buffer */, void* userData) {
   auto str = static_cast<std::string*>(userData);
   delete str;
 }
+
+using SharedString = std::shared_ptr<const std::string>;
+
+void releaseSharedString(void* /* buffer */, void* userData) {
+  auto str = static_cast<SharedString*>(userData);
+  delete str;
+}
 } // namespace
 
 namespace facebook {
@@ -31,6 +38,23 @@ IOBuf StoreResult::iobufWrapper() const {
 folly::IOBuf StoreResult::extractIOBuf() {
   ensureValid();
 
+  if (shared_) {
+    // Hold a reference to the shared value for as long as the IOBuf needs it.
+    auto sharedPtr = std::make_unique<SharedString>(std::move(shared_));
+    auto data = const_cast<char*>((*sharedPtr)->data());
+    auto size = (*sharedPtr)->size();
+    IOBuf buf(
+        IOBuf::TAKE_OWNERSHIP,
+        data,
+        size,
+        releaseSharedString,
+        sharedPtr.release());
+    // The store and other readers still see this memory, so make sure
+    // isShared() reports it and nothing writes to it in place.
+    buf.markExternallySharedOne();
+    return buf;
+  }
+
   // Unfortunately RocksDB returns data to us in a std::string.  This makes it
   // difficult for us to control the lifetime.  We end up having to allocate a
   // new std::string on the heap, just to control when it will free the
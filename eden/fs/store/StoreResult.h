@@ -10,6 +10,7 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <memory>
 #include <string>
 
 namespace folly {
@@ -31,6 +32,10 @@ namespace eden {
  * - It is move-only, so prevents us from ever unintentionally copying the
  *   string data.
  * - It provides APIs for creating IOBuf objects around the string result.
+ *
+ * Stores that keep their values in memory, such as MemoryLocalStore, can
+ * instead hand out a reference to an immutable shared string, so that reads
+ * do not copy the value.
  */
 class StoreResult {
  public:
@@ -45,6 +50,12 @@ class StoreResult {
   explicit StoreResult(std::string&& data)
       : valid_(true), data_(std::move(data)) {}
 
+  /**
+   * Construct a StoreResult that shares an immutable string with the store.
+   */
+  explicit StoreResult(std::shared_ptr<const std::string> data)
+      : valid_(true), shared_(std::move(data)) {}
+
   StoreResult(StoreResult&&) = default;
   StoreResult& operator=(StoreResult&&) = default;
 
@@ -63,7 +74,7 @@ class StoreResult {
    */
   const std::string& asString() const {
     ensureValid();
-    return data_;
+    return value();
   }
 
   /**
@@ -73,7 +84,7 @@ class StoreResult {
    */
   folly::ByteRange bytes() const {
     ensureValid();
-    return folly::StringPiece{data_};
+    return folly::StringPiece{value()};
   }
 
   /**
@@ -83,7 +94,7 @@ class StoreResult {
    */
   folly::StringPiece piece() const {
     ensureValid();
-    return folly::StringPiece{data_};
+    return folly::StringPiece{value()};
   }
 
   /**
@@ -97,10 +108,16 @@ class StoreResult {
 
   /**
    * Extract the std::string contained in this StoreResult.
+   *
+   * If the value is shared with the store this has to copy it.
    */
   std::string extractValue() {
     ensureValid();
     valid_ = false;
+    if (shared_) {
+      auto shared = std::move(shared_);
+      return *shared;
+    }
     return std::move(data_);
   }
 
@@ -112,7 +129,9 @@ class StoreResult {
    *
    * This does require a memory allocation to move the stored std::string onto
    * the heap (but it just does a small allocation for the string object
-   * itself, and not the string data).
+   * itself, and not the string data).  A value shared with the store is not
+   * copied; the IOBuf keeps a reference to it instead and is marked as
+   * externally shared, so callers must unshare() it before modifying it.
    */
   folly::IOBuf extractIOBuf();
 
@@ -133,11 +152,17 @@ class StoreResult {
 
   [[noreturn]] void throwInvalidError() const;
 
+  const std::string& value() const {
+    return shared_ ? *shared_ : data_;
+  }
+
   // Whether or not the result is value
   // If the key was not found in the store, valid_ will be false.
   bool valid_{false};
   // The std::string containing the data
   std::string data_;
+  // Set instead of data_ when the value is shared with the store
+  std::shared_ptr<const std::string> shared_;
 };
 } // namespace eden
 } // namespace facebook
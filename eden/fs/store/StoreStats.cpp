@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/StoreStats.h"
+
+#include <folly/ThreadLocal.h>
+
+using namespace std::chrono;
+
+namespace {
+constexpr microseconds kLocalMaxValue{10000};
+constexpr microseconds kLocalBucketSize{1000};
+
+// Imports routinely take tens or hundreds of milliseconds, so use much wider
+// buckets for them.
+constexpr microseconds kFetchMaxValue{1000000};
+constexpr microseconds kFetchBucketSize{50000};
+} // namespace
+
+namespace facebook {
+namespace eden {
+
+StoreStats::StoreStats() {}
+
+StoreStats::Histogram StoreStats::createLocalHistogram(
+    const std::string& name) {
+  return Histogram{this,
+                   name,
+                   static_cast<size_t>(kLocalBucketSize.count()),
+                   0,
+                   kLocalMaxValue.count(),
+                   facebook::stats::COUNT,
+                   50,
+                   90,
+                   99};
+}
+
+StoreStats::Histogram StoreStats::createFetchHistogram(
+    const std::string& name) {
+  return Histogram{this,
+                   name,
+                   static_cast<size_t>(kFetchBucketSize.count()),
+                   0,
+                   kFetchMaxValue.count(),
+                   facebook::stats::COUNT,
+                   50,
+                   90,
+                   99};
+}
+
+StoreStats::Counter StoreStats::createCounter(const std::string& name) {
+  return Counter{this, name};
+}
+
+void StoreStats::recordLatency(HistogramPtr item, microseconds elapsed) {
+  (this->*item).addValue(elapsed.count());
+}
+
+ThreadLocalStoreStats& getStoreStats() {
+  // Leaked so that stores destroyed during static destruction can still
+  // record their final operations.
+  static auto* stats = new ThreadLocalStoreStats;
+  return *stats;
+}
+
+LatencyRecorder::~LatencyRecorder() {
+  if (histogram_) {
+    getStoreStats()->recordLatency(
+        histogram_,
+        duration_cast<microseconds>(steady_clock::now() - start_));
+  }
+}
+
+} // namespace eden
+} // namespace facebook
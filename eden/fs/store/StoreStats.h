@@ -0,0 +1,154 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <chrono>
+
+#include "common/stats/ThreadLocalStats.h"
+
+namespace folly {
+template <class T, class Tag, class AccessMode>
+class ThreadLocal;
+}
+
+namespace facebook {
+namespace eden {
+
+/**
+ * A tag class for using with folly::ThreadLocal when storing StoreStats.
+ */
+class StoreStatsTag {};
+class StoreStats;
+
+using ThreadLocalStoreStats =
+    folly::ThreadLocal<StoreStats, StoreStatsTag, void>;
+
+/**
+ * StoreStats contains thread-local stats for the storage tiers that sit
+ * below the inode layer: the LocalStore, the BackingStore and its importer,
+ * and the in-memory BlobCache.
+ *
+ * Unlike EdenStats, which belongs to the ServerState, there is a single
+ * process-wide set of StoreStats returned by getStoreStats().  The stores are
+ * shared between mounts and are created in many places that have no access
+ * to the ServerState.
+ */
+class StoreStats : public facebook::stats::ThreadLocalStatsT<
+                       facebook::stats::TLStatsThreadSafe> {
+ public:
+  using Histogram = TLHistogram;
+  using Counter = TLCounter;
+
+  explicit StoreStats();
+
+  // As in EdenStats, latencies are recorded in microseconds.
+
+  // LocalStore reads, one histogram per KeySpace.
+  Histogram localStoreGetBlob{createLocalHistogram("local_store.get_blob_us")};
+  Histogram localStoreGetBlobMetadata{
+      createLocalHistogram("local_store.get_blob_metadata_us")};
+  Histogram localStoreGetTree{createLocalHistogram("local_store.get_tree_us")};
+  Histogram localStoreGetHgProxyHash{
+      createLocalHistogram("local_store.get_hg_proxy_hash_us")};
+  Histogram localStoreGetHgCommitToTree{
+      createLocalHistogram("local_store.get_hg_commit_to_tree_us")};
+
+  // Fetches that missed the LocalStore and went to the BackingStore.
+  Histogram backingStoreGetTree{
+      createFetchHistogram("backing_store.get_tree_us")};
+  Histogram backingStoreGetBlob{
+      createFetchHistogram("backing_store.get_blob_us")};
+  Histogram backingStorePrefetchBlobs{
+      createFetchHistogram("backing_store.prefetch_blobs_us")};
+
+  // Round trips to the hg_import_helper process.
+  Histogram hgImporterManifest{
+      createFetchHistogram("hg_importer.import_manifest_us")};
+  Histogram hgImporterCatFile{
+      createFetchHistogram("hg_importer.cat_file_us")};
+  Histogram hgImporterFetchTree{
+      createFetchHistogram("hg_importer.fetch_tree_us")};
+  Histogram hgImporterPrefetchFiles{
+      createFetchHistogram("hg_importer.prefetch_files_us")};
+  Histogram hgImporterManifestNode{
+      createFetchHistogram("hg_importer.manifest_node_for_commit_us")};
+
+  Histogram blobCacheGet{createLocalHistogram("blob_cache.get_us")};
+  Counter blobCacheHit{createCounter("blob_cache.hit")};
+  Counter blobCacheMiss{createCounter("blob_cache.miss")};
+  // Interest handles that FileInode dropped because the whole file had been
+  // read, and the total size of those blobs.
+  Counter blobCacheEarlyRelease{createCounter("blob_cache.early_release")};
+  Counter blobCacheEarlyReleaseBytes{
+      createCounter("blob_cache.early_release_bytes")};
+
+  // ObjectStore's in-memory BlobMetadata cache.
+  Counter metadataCacheHit{createCounter("object_store.metadata_cache.hit")};
+  Counter metadataCacheMiss{
+      createCounter("object_store.metadata_cache.miss")};
+
+  // HgProxyHashCache.  Misses are the proxy hash lookups that read the
+  // LocalStore.
+  Counter hgProxyHashCacheHit{createCounter("hg_proxy_hash.cache.hit")};
+  Counter hgProxyHashCacheMiss{createCounter("hg_proxy_hash.cache.miss")};
+
+  using HistogramPtr = Histogram StoreStats::*;
+
+  /** Record the latency for an operation.
+   * item is the pointer-to-member for one of the histograms defined above.
+   * elapsed is the duration of the operation, measured in microseconds. */
+  void recordLatency(HistogramPtr item, std::chrono::microseconds elapsed);
+
+ private:
+  /** For operations that are normally served from memory or local disk. */
+  Histogram createLocalHistogram(const std::string& name);
+  /** For operations that may need to talk to another process or server. */
+  Histogram createFetchHistogram(const std::string& name);
+  Counter createCounter(const std::string& name);
+};
+
+/**
+ * Get the process-wide StoreStats.
+ */
+ThreadLocalStoreStats& getStoreStats();
+
+/**
+ * Records the time between its construction and its destruction into one of
+ * the StoreStats histograms, on whichever thread destroys it.
+ *
+ * LatencyRecorder is movable so that it can be captured by a future's
+ * callback in order to time an asynchronous operation:
+ *
+ *   LatencyRecorder latency{&StoreStats::backingStoreGetTree};
+ *   return fetch().ensure([latency = std::move(latency)] {});
+ */
+class LatencyRecorder {
+ public:
+  explicit LatencyRecorder(StoreStats::HistogramPtr histogram)
+      : histogram_{histogram}, start_{std::chrono::steady_clock::now()} {}
+
+  LatencyRecorder(LatencyRecorder&& other) noexcept
+      : histogram_{other.histogram_}, start_{other.start_} {
+    other.histogram_ = nullptr;
+  }
+
+  LatencyRecorder& operator=(LatencyRecorder&& other) = delete;
+  LatencyRecorder(const LatencyRecorder&) = delete;
+  LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+  ~LatencyRecorder();
+
+ private:
+  StoreStats::HistogramPtr histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace eden
+} // namespace facebook
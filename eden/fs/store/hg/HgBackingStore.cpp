@@ -17,6 +17,9 @@
 #include <folly/executors/thread_factory/NamedThreadFactory.h>
 #include <folly/futures/Future.h>
 #include <folly/logging/xlog.h>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
 #include "eden/fs/config/ReloadableConfig.h"
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Hash.h"
@@ -80,6 +83,17 @@ DEFINE_int32(
     mononoke_timeout,
     2000, // msec
     "[unit: ms] Timeout for Mononoke requests");
+DEFINE_int32(
+    mononoke_batch_size,
+    256,
+    "Maximum number of objects to request from Mononoke in one prefetch "
+    "request");
+DEFINE_int32(
+    hg_fetch_tree_batch_size,
+    64,
+    "Maximum number of missing trees to fetch from the remote mercurial "
+    "server in one request.  Trees that are missed while an earlier request "
+    "is outstanding are fetched together (1 disables batching)");
 
 namespace facebook {
 namespace eden {
@@ -140,6 +154,48 @@ class HgImporterTestExecutor : public folly::InlineExecutor {
 };
 
 #if EDEN_HAVE_HG_TREEMANIFEST
+#ifndef EDEN_WIN_NOMONONOKE
+/**
+ * Convert a tree fetched from mononoke into an eden Tree with ID edenTreeID,
+ * and record it in writeBatch along with the proxy hashes and any metadata
+ * that mononoke provided for its entries.
+ */
+std::unique_ptr<Tree> importMononokeTree(
+    const Tree& mononokeTree,
+    const Hash& edenTreeID,
+    RelativePathPiece path,
+    LocalStore::WriteBatch* writeBatch) {
+  std::vector<TreeEntry> entries;
+
+  for (const auto& entry : mononokeTree.getTreeEntries()) {
+    auto blobHash = entry.getHash();
+    auto entryName = entry.getName();
+    auto proxyHash = HgProxyHash::store(path + entryName, blobHash, writeBatch);
+
+    entries.emplace_back(proxyHash, entryName.stringPiece(), entry.getType());
+
+    if (entry.getContentSha1() && entry.getSize()) {
+      BlobMetadata metadata{*entry.getContentSha1(), *entry.getSize()};
+
+      SerializedBlobMetadata metadataBytes(metadata);
+      auto hashSlice = proxyHash.getBytes();
+      writeBatch->put(
+          KeySpace::BlobMetaDataFamily, hashSlice, metadataBytes.slice());
+    }
+  }
+
+  auto tree = make_unique<Tree>(std::move(entries), edenTreeID);
+  auto serialized = LocalStore::serializeTree(tree.get());
+  writeBatch->put(
+      KeySpace::TreeFamily, edenTreeID, serialized.second.coalesce());
+  return tree;
+}
+
+size_t getMononokeBatchSize() {
+  return std::max(FLAGS_mononoke_batch_size, 1);
+}
+#endif // !EDEN_WIN_NOMONONOKE
+
 // A helper function to avoid repeating noisy casts/conversions when
 // loading data from a UnionDatapackStore instance.
 ConstantStringRef unionStoreGet(
@@ -479,38 +535,12 @@ Future<unique_ptr<Tree>> HgBackingStore::importTreeImpl(
 
     RelativePath ownedPath(path);
     return mononoke_->getTree(manifestNode)
-        .via(serverThreadPool_)
+        .via(serverThreadPool_, UnboundedQueueExecutor::getCurrentPriority())
         .thenTry([edenTreeID, ownedPath, writeBatch](
                      auto mononokeTreeTry) mutable {
           auto& mononokeTree = mononokeTreeTry.value();
-          std::vector<TreeEntry> entries;
-
-          for (const auto& entry : mononokeTree->getTreeEntries()) {
-            auto blobHash = entry.getHash();
-            auto entryName = entry.getName();
-            auto proxyHash = HgProxyHash::store(
-                ownedPath + entryName, blobHash, writeBatch.get());
-
-            entries.emplace_back(
-                proxyHash, entryName.stringPiece(), entry.getType());
-
-            if (entry.getContentSha1() && entry.getSize()) {
-              BlobMetadata metadata{*entry.getContentSha1(), *entry.getSize()};
-
-              SerializedBlobMetadata metadataBytes(metadata);
-              auto hashSlice = proxyHash.getBytes();
-              writeBatch->put(
-                  KeySpace::BlobMetaDataFamily,
-                  hashSlice,
-                  metadataBytes.slice());
-            }
-          }
-
-          auto tree = make_unique<Tree>(std::move(entries), edenTreeID);
-          auto serialized = LocalStore::serializeTree(tree.get());
-          writeBatch->put(
-              KeySpace::TreeFamily, edenTreeID, serialized.second.coalesce());
-          return makeFuture(std::move(tree));
+          return makeFuture(importMononokeTree(
+              *mononokeTree, edenTreeID, ownedPath, writeBatch.get()));
         })
         .onError([this, manifestNode, edenTreeID, ownedPath, writeBatch](
                      const folly::exception_wrapper& ex) mutable {
@@ -573,52 +603,139 @@ folly::Future<std::unique_ptr<Tree>> HgBackingStore::fetchTreeFromImporter(
     Hash edenTreeID,
     RelativePath path,
     std::shared_ptr<LocalStore::WriteBatch> writeBatch) {
+  if (FLAGS_hg_fetch_tree_batch_size > 1) {
+    // Queue the tree, and let whichever import thread gets to it first fetch
+    // it along with every other tree queued by then.
+    folly::Promise<unique_ptr<Tree>> promise;
+    auto future = promise.getFuture();
+    pendingTreeFetches_.wlock()->push_back(PendingTreeFetch{
+        std::move(path), manifestNode, edenTreeID, std::move(promise)});
+    importThreadPool_->add([this] { fetchPendingTrees(); });
+    return std::move(future).via(
+        serverThreadPool_, UnboundedQueueExecutor::getCurrentPriority());
+  }
+
   auto fut =
       folly::via(
           importThreadPool_.get(),
           [path, manifestNode] {
             return getThreadLocalImporter().fetchTree(path, manifestNode);
           })
-          .via(serverThreadPool_);
+          .via(serverThreadPool_, UnboundedQueueExecutor::getCurrentPriority());
   return std::move(fut).thenTry(
       [this,
        ownedPath = std::move(path),
        node = std::move(manifestNode),
        treeID = std::move(edenTreeID),
        batch = std::move(writeBatch)](folly::Try<folly::Unit> val) {
-        try {
-          val.value();
-          // Now try loading it again
+        if (val.hasValue()) {
           unionStore_->wlock()->markForRefresh();
-          auto content = unionStoreGet(
-              *unionStore_->wlock(), ownedPath.stringPiece(), node);
-          return processTree(content, node, treeID, ownedPath, batch.get());
-        } catch (const HgImportPyError& ex) {
-          if (FLAGS_allow_flatmanifest_fallback) {
-            // For now translate any error thrown into a MissingKeyError,
-            // so that our caller will retry this tree import using
-            // flatmanifest import if possible.
-            //
-            // The mercurial code can throw a wide variety of errors here
-            // that all effectively mean mean it couldn't fetch the tree
-            // data.
-            //
-            // We most commonly expect to get a MissingNodesError if the
-            // remote server does not know about these trees (for instance
-            // if they are only available locally, but simply only have
-            // flatmanifest information rather than treemanifest info).
-            //
-            // However we can also get lots of other errors: no remote
-            // server configured, remote repository does not exist, remote
-            // repository does not support fetching tree info, etc.
-            throw MissingKeyError(ex.what());
-          } else {
-            throw;
-          }
         }
+        return processFetchedTree(
+            std::move(val), ownedPath, node, treeID, batch.get());
       });
 }
 
+void HgBackingStore::fetchPendingTrees() {
+  std::vector<PendingTreeFetch> batch;
+  {
+    auto pending = pendingTreeFetches_.wlock();
+    auto count = std::min<size_t>(
+        pending->size(), std::max(FLAGS_hg_fetch_tree_batch_size, 1));
+    std::move(
+        pending->begin(), pending->begin() + count, std::back_inserter(batch));
+    pending->erase(pending->begin(), pending->begin() + count);
+  }
+  if (batch.empty()) {
+    // An earlier call fetched the tree that this call was queued for.
+    return;
+  }
+
+  std::vector<std::pair<RelativePath, Hash>> trees;
+  trees.reserve(batch.size());
+  for (const auto& fetch : batch) {
+    trees.emplace_back(fetch.path, fetch.manifestNode);
+  }
+  // The importer reports a separate result for each tree, so a tree that
+  // cannot be fetched only fails its own caller.  If the request as a whole
+  // fails, after the importer has already retried it, so does every tree.
+  std::vector<folly::Try<folly::Unit>> fetched;
+  try {
+    fetched = getThreadLocalImporter().fetchTrees(trees);
+  } catch (const std::exception& ex) {
+    XLOG(DBG2) << "failed to fetch " << batch.size()
+               << " trees in one request: " << folly::exceptionStr(ex);
+    fetched.assign(
+        batch.size(),
+        folly::Try<folly::Unit>{
+            folly::exception_wrapper{std::current_exception(), ex}});
+  }
+  if (std::any_of(fetched.begin(), fetched.end(), [](const auto& result) {
+        return result.hasValue();
+      })) {
+    unionStore_->wlock()->markForRefresh();
+  }
+
+  // Insert every tree and its entries' proxy hashes in one write batch, and
+  // only hand the trees out once they are all in the LocalStore.
+  auto writeBatch = localStore_->beginWrite();
+  std::vector<folly::Try<unique_ptr<Tree>>> results;
+  results.reserve(batch.size());
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const auto& fetch = batch[i];
+    results.push_back(folly::makeTryWith([&] {
+      return processFetchedTree(
+          std::move(fetched[i]),
+          fetch.path,
+          fetch.manifestNode,
+          fetch.edenTreeID,
+          writeBatch.get());
+    }));
+  }
+  writeBatch->flush();
+
+  for (size_t i = 0; i < batch.size(); ++i) {
+    batch[i].promise.setTry(std::move(results[i]));
+  }
+}
+
+std::unique_ptr<Tree> HgBackingStore::processFetchedTree(
+    folly::Try<folly::Unit> fetched,
+    RelativePathPiece path,
+    const Hash& manifestNode,
+    const Hash& edenTreeID,
+    LocalStore::WriteBatch* writeBatch) {
+  try {
+    fetched.value();
+    // Now try loading it again
+    auto content =
+        unionStoreGet(*unionStore_->wlock(), path.stringPiece(), manifestNode);
+    return processTree(content, manifestNode, edenTreeID, path, writeBatch);
+  } catch (const HgImportPyError& ex) {
+    if (FLAGS_allow_flatmanifest_fallback) {
+      // For now translate any error thrown into a MissingKeyError,
+      // so that our caller will retry this tree import using
+      // flatmanifest import if possible.
+      //
+      // The mercurial code can throw a wide variety of errors here
+      // that all effectively mean mean it couldn't fetch the tree
+      // data.
+      //
+      // We most commonly expect to get a MissingNodesError if the
+      // remote server does not know about these trees (for instance
+      // if they are only available locally, but simply only have
+      // flatmanifest information rather than treemanifest info).
+      //
+      // However we can also get lots of other errors: no remote
+      // server configured, remote repository does not exist, remote
+      // repository does not support fetching tree info, etc.
+      throw MissingKeyError(ex.what());
+    } else {
+      throw;
+    }
+  }
+}
+
 std::unique_ptr<Tree> HgBackingStore::processTree(
     ConstantStringRef& content,
     const Hash& manifestNode,
@@ -708,7 +825,7 @@ folly::Future<Hash> HgBackingStore::importTreeManifest(const Hash& commitId) {
                return getThreadLocalImporter().resolveManifestNode(
                    commitId.toString());
              })
-      .via(serverThreadPool_)
+      .via(serverThreadPool_, UnboundedQueueExecutor::getCurrentPriority())
       .thenValue([this, commitId](auto manifestNode) {
         XLOG(DBG2) << "revision " << commitId.toString()
                    << " has manifest node " << manifestNode;
@@ -737,6 +854,8 @@ Future<unique_ptr<Blob>> HgBackingStore::getBlob(const Hash& id) {
   // Look up the mercurial path and file revision hash,
   // which we need to import the data from mercurial
   HgProxyHash hgInfo(localStore_, id, "importFileContents");
+  // Run the completion at the priority of whoever asked for the blob.
+  auto priority = UnboundedQueueExecutor::getCurrentPriority();
 
 #if EDEN_HAVE_HG_TREEMANIFEST
 #ifndef EDEN_WIN_NO_RUST_DATAPACK
@@ -762,8 +881,11 @@ Future<unique_ptr<Blob>> HgBackingStore::getBlob(const Hash& id) {
                << hgInfo.revHash().toString() << " from mononoke";
     auto revHashCopy = hgInfo.revHash();
     return mononoke_->getBlob(revHashCopy)
-        .onError([this, id, path = hgInfo.path().copy(), revHash = revHashCopy](
-                     const folly::exception_wrapper& ex) {
+        .onError([this,
+                  id,
+                  priority,
+                  path = hgInfo.path().copy(),
+                  revHash = revHashCopy](const folly::exception_wrapper& ex) {
           XLOG(ERR) << "Error while fetching file contents of '" << path
                     << "', " << revHash.toString()
                     << " from mononoke: " << ex.what()
@@ -775,7 +897,7 @@ Future<unique_ptr<Blob>> HgBackingStore::getBlob(const Hash& id) {
                      })
               // Ensure that the control moves back to the main thread pool
               // to process the caller-attached .then routine.
-              .via(serverThreadPool_);
+              .via(serverThreadPool_, priority);
         });
   }
 #endif // EDEN_WIN_NOMONONOKE
@@ -786,24 +908,191 @@ Future<unique_ptr<Blob>> HgBackingStore::getBlob(const Hash& id) {
              [id] { return getThreadLocalImporter().importFileContents(id); })
       // Ensure that the control moves back to the main thread pool
       // to process the caller-attached .then routine.
-      .via(serverThreadPool_);
+      .via(serverThreadPool_, priority);
 }
 
 folly::Future<folly::Unit> HgBackingStore::prefetchBlobs(
     const std::vector<Hash>& ids) const {
+#if EDEN_HAVE_HG_TREEMANIFEST
+#ifndef EDEN_WIN_NOMONONOKE
+  if (useMononoke()) {
+    return prefetchBlobsFromMononoke(ids).via(
+        serverThreadPool_, UnboundedQueueExecutor::kBackgroundPriority);
+  }
+#endif // !EDEN_WIN_NOMONONOKE
+#endif // EDEN_HAVE_HG_TREEMANIFEST
+
   return HgProxyHash::getBatch(localStore_, ids)
       .via(importThreadPool_.get())
       .thenValue([](std::vector<std::pair<RelativePath, Hash>>&& hgPathHashes) {
         return getThreadLocalImporter().prefetchFiles(hgPathHashes);
       })
-      .via(serverThreadPool_);
+      .via(serverThreadPool_, UnboundedQueueExecutor::kBackgroundPriority);
+}
+
+folly::Future<folly::Unit> HgBackingStore::prefetchTrees(
+    const std::vector<Hash>& ids) const {
+#if EDEN_HAVE_HG_TREEMANIFEST
+#ifndef EDEN_WIN_NOMONONOKE
+  if (useMononoke()) {
+    return HgProxyHash::getBatch(localStore_, ids)
+        .thenValue([this, ids](
+                       std::vector<std::pair<RelativePath, Hash>>&& hgInfo) {
+          return prefetchTreesFromMononoke(ids, std::move(hgInfo));
+        })
+        .via(serverThreadPool_, UnboundedQueueExecutor::kBackgroundPriority);
+  }
+#endif // !EDEN_WIN_NOMONONOKE
+#endif // EDEN_HAVE_HG_TREEMANIFEST
+  return folly::unit;
+}
+
+#if EDEN_HAVE_HG_TREEMANIFEST
+#ifndef EDEN_WIN_NOMONONOKE
+folly::Future<folly::Unit> HgBackingStore::prefetchBlobsFromMononoke(
+    const std::vector<Hash>& ids) const {
+  // Skip blobs that are already in the LocalStore.  This has to check the
+  // blobs themselves: importing a tree records the metadata of every entry,
+  // so metadata is present for blobs that were never fetched or have since
+  // been evicted.
+  return localStore_->getMissing(KeySpace::BlobFamily, ids)
+      .thenValue([this](std::vector<Hash>&& missingIds) {
+        auto missing =
+            std::make_shared<std::vector<Hash>>(std::move(missingIds));
+        return HgProxyHash::getBatch(localStore_, *missing)
+            .thenValue([this, missing](
+                           std::vector<std::pair<RelativePath, Hash>>&&
+                               hgPathHashes) {
+              std::vector<Future<folly::Unit>> futures;
+              auto batchSize = getMononokeBatchSize();
+              for (size_t start = 0; start < missing->size();
+                   start += batchSize) {
+                auto end = std::min(missing->size(), start + batchSize);
+                futures.push_back(prefetchBlobBatchFromMononoke(
+                    std::vector<Hash>(
+                        missing->begin() + start, missing->begin() + end),
+                    std::vector<std::pair<RelativePath, Hash>>(
+                        std::make_move_iterator(hgPathHashes.begin() + start),
+                        std::make_move_iterator(hgPathHashes.begin() + end))));
+              }
+              return folly::collect(futures).unit();
+            });
+      });
+}
+
+folly::Future<folly::Unit> HgBackingStore::prefetchBlobBatchFromMononoke(
+    std::vector<Hash> ids,
+    std::vector<std::pair<RelativePath, Hash>> hgPathHashes) const {
+  // Several eden blobs may share the same mercurial revision hash, so
+  // request each revision once and store it under every eden ID.
+  auto edenIds =
+      std::make_shared<std::unordered_map<Hash, std::vector<Hash>>>();
+  std::vector<Hash> revHashes;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    auto& idsForRev = (*edenIds)[hgPathHashes[i].second];
+    if (idsForRev.empty()) {
+      revHashes.push_back(hgPathHashes[i].second);
+    }
+    idsForRev.push_back(ids[i]);
+  }
+
+  std::shared_ptr<LocalStore::WriteBatch> writeBatch(localStore_->beginWrite());
+  return mononoke_
+      ->getBlobBatch(
+          revHashes,
+          [edenIds, writeBatch](std::unique_ptr<Blob> blob) {
+            auto it = edenIds->find(blob->getHash());
+            if (it == edenIds->end()) {
+              XLOG(WARN) << "mononoke returned unrequested blob "
+                         << blob->getHash();
+              return;
+            }
+            for (const auto& id : it->second) {
+              Blob edenBlob{id, blob->getContents()};
+              writeBatch->putBlob(id, &edenBlob);
+            }
+          })
+      .thenTry([writeBatch](folly::Try<folly::Unit>&& result) {
+        // Keep whatever we received, even if the request failed part way.
+        writeBatch->flush();
+        return std::move(result);
+      })
+      .onError([this, hgPathHashes = std::move(hgPathHashes)](
+                   const folly::exception_wrapper& ex) mutable {
+        XLOG(WARN) << "error prefetching " << hgPathHashes.size()
+                   << " blobs from mononoke: " << ex.what()
+                   << ", falling back to import helper";
+        return folly::via(
+            importThreadPool_.get(),
+            [hgPathHashes = std::move(hgPathHashes)] {
+              return getThreadLocalImporter().prefetchFiles(hgPathHashes);
+            });
+      });
+}
+
+folly::Future<folly::Unit> HgBackingStore::prefetchTreesFromMononoke(
+    const std::vector<Hash>& ids,
+    std::vector<std::pair<RelativePath, Hash>> hgInfo) const {
+  std::vector<Future<folly::Unit>> futures;
+  auto batchSize = getMononokeBatchSize();
+  for (size_t start = 0; start < ids.size(); start += batchSize) {
+    auto end = std::min(ids.size(), start + batchSize);
+
+    // Map each manifest node to the eden trees that refer to it.
+    auto edenTrees = std::make_shared<
+        std::unordered_map<Hash, std::vector<std::pair<Hash, RelativePath>>>>();
+    std::vector<Hash> manifestNodes;
+    for (size_t i = start; i < end; ++i) {
+      auto& manifestNode = hgInfo[i].second;
+      if (manifestNode == kZeroHash) {
+        // The empty root tree is not stored anywhere; importTreeImpl()
+        // handles it.
+        continue;
+      }
+      auto& treesForNode = (*edenTrees)[manifestNode];
+      if (treesForNode.empty()) {
+        manifestNodes.push_back(manifestNode);
+      }
+      treesForNode.emplace_back(ids[i], std::move(hgInfo[i].first));
+    }
+
+    std::shared_ptr<LocalStore::WriteBatch> writeBatch(
+        localStore_->beginWrite());
+    futures.push_back(
+        mononoke_
+            ->getTreeBatch(
+                manifestNodes,
+                [edenTrees, writeBatch](std::unique_ptr<Tree> tree) {
+                  auto it = edenTrees->find(tree->getHash());
+                  if (it == edenTrees->end()) {
+                    XLOG(WARN) << "mononoke returned unrequested tree "
+                               << tree->getHash();
+                    return;
+                  }
+                  for (const auto& edenTree : it->second) {
+                    importMononokeTree(
+                        *tree,
+                        edenTree.first,
+                        edenTree.second,
+                        writeBatch.get());
+                  }
+                })
+            .thenTry([writeBatch](folly::Try<folly::Unit>&& result) {
+              writeBatch->flush();
+              return std::move(result);
+            }));
+  }
+  return folly::collect(futures).unit();
 }
+#endif // !EDEN_WIN_NOMONONOKE
+#endif // EDEN_HAVE_HG_TREEMANIFEST
 
 Future<unique_ptr<Tree>> HgBackingStore::getTreeForCommit(
     const Hash& commitID) {
   // Ensure that the control moves back to the main thread pool
   // to process the caller-attached .then routine.
-  return getTreeForCommitImpl(commitID).via(serverThreadPool_);
+  return getTreeForCommitImpl(commitID).via(
+      serverThreadPool_, UnboundedQueueExecutor::getCurrentPriority());
 }
 
 folly::Future<unique_ptr<Tree>> HgBackingStore::getTreeForCommitImpl(
@@ -868,7 +1157,7 @@ folly::Future<Hash> HgBackingStore::importFlatManifest(Hash commitId) {
                return getThreadLocalImporter().importFlatManifest(
                    commitId.toString());
              })
-      .via(serverThreadPool_);
+      .via(serverThreadPool_, UnboundedQueueExecutor::getCurrentPriority());
 }
 
 folly::Future<unique_ptr<Tree>> HgBackingStore::importTreeForCommit(
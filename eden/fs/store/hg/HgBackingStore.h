@@ -21,6 +21,8 @@
 #include <folly/Executor.h>
 #include <folly/Range.h>
 #include <folly/Synchronized.h>
+#include <folly/futures/Future.h>
+#include <deque>
 #include <optional>
 
 #if EDEN_HAVE_HG_TREEMANIFEST
@@ -72,6 +74,8 @@ class HgBackingStore : public BackingStore {
       const Hash& commitID) override;
   FOLLY_NODISCARD folly::Future<folly::Unit> prefetchBlobs(
       const std::vector<Hash>& ids) const override;
+  FOLLY_NODISCARD folly::Future<folly::Unit> prefetchTrees(
+      const std::vector<Hash>& ids) const override;
 
 #if EDEN_HAVE_HG_TREEMANIFEST
   /**
@@ -108,6 +112,28 @@ class HgBackingStore : public BackingStore {
   bool useMononoke() const;
 #endif
 
+#if EDEN_HAVE_HG_TREEMANIFEST
+#ifndef EDEN_WIN_NOMONONOKE
+  /**
+   * Fetch blobs from mononoke in batches of --mononoke_batch_size, writing
+   * them straight into the LocalStore.  Batches that fail are retried
+   * through the import helper.
+   */
+  folly::Future<folly::Unit> prefetchBlobsFromMononoke(
+      const std::vector<Hash>& ids) const;
+  folly::Future<folly::Unit> prefetchBlobBatchFromMononoke(
+      std::vector<Hash> ids,
+      std::vector<std::pair<RelativePath, Hash>> hgPathHashes) const;
+  /**
+   * Fetch trees from mononoke in batches of --mononoke_batch_size, writing
+   * them and their entries' proxy hashes into the LocalStore.
+   */
+  folly::Future<folly::Unit> prefetchTreesFromMononoke(
+      const std::vector<Hash>& ids,
+      std::vector<std::pair<RelativePath, Hash>> hgInfo) const;
+#endif // !EDEN_WIN_NOMONONOKE
+#endif // EDEN_HAVE_HG_TREEMANIFEST
+
   folly::Future<std::unique_ptr<Tree>> getTreeForCommitImpl(Hash commitID);
 
   // Import the Tree from Hg and cache it in the LocalStore before returning it.
@@ -130,6 +156,22 @@ class HgBackingStore : public BackingStore {
       Hash edenTreeID,
       RelativePath path,
       std::shared_ptr<LocalStore::WriteBatch> writeBatch);
+  /**
+   * Fetch up to --hg_fetch_tree_batch_size trees from pendingTreeFetches_
+   * with one request to the import helper, and record them in the
+   * LocalStore with one write batch.  Must run on an import thread.
+   */
+  void fetchPendingTrees();
+  /**
+   * Load a tree from the hg cache after the import helper fetched it, or
+   * translate the error from fetching it.
+   */
+  std::unique_ptr<Tree> processFetchedTree(
+      folly::Try<folly::Unit> fetched,
+      RelativePathPiece path,
+      const Hash& manifestNode,
+      const Hash& edenTreeID,
+      LocalStore::WriteBatch* writeBatch);
   std::unique_ptr<Tree> processTree(
       ConstantStringRef& content,
       const Hash& manifestNode,
@@ -150,7 +192,8 @@ class HgBackingStore : public BackingStore {
   // this pool to run their completion code to avoid clogging
   // the importer pool. Queuing in this pool can never block (which would risk
   // deadlock) or throw an exception when full (which would incorrectly fail the
-  // load).
+  // load).  Completions are queued at the priority of the code that asked
+  // for the import, or at background priority for prefetches.
   folly::Executor* serverThreadPool_;
 #if EDEN_HAVE_HG_TREEMANIFEST
   // These DatapackStore objects are never referenced once UnionDatapackStore
@@ -160,6 +203,16 @@ class HgBackingStore : public BackingStore {
   std::unique_ptr<folly::Synchronized<UnionDatapackStore>> unionStore_;
   bool useDatapackGetBlob_{false};
 
+  struct PendingTreeFetch {
+    RelativePath path;
+    Hash manifestNode;
+    Hash edenTreeID;
+    folly::Promise<std::unique_ptr<Tree>> promise;
+  };
+  // Trees missing from the hg cache that are waiting to be fetched from the
+  // server, oldest first.
+  folly::Synchronized<std::deque<PendingTreeFetch>> pendingTreeFetches_;
+
 #ifndef EDEN_WIN_NOMONONOKE
   std::unique_ptr<MononokeBackingStore> mononoke_;
 #endif // EDEN_WIN_NOMONONOKE
@@ -19,6 +19,7 @@
 #include <folly/futures/Future.h>
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
+#include <folly/io/async/Request.h>
 #include <folly/json.h>
 #include <folly/lang/Bits.h>
 #include <folly/logging/xlog.h>
@@ -38,9 +39,11 @@
 #include "eden/fs/model/Tree.h"
 #include "eden/fs/model/TreeEntry.h"
 #include "eden/fs/store/LocalStore.h"
+#include "eden/fs/store/StoreStats.h"
 #include "eden/fs/store/hg/HgImportPyError.h"
-#include "eden/fs/store/hg/HgManifestImporter.h"
+#include "eden/fs/store/hg/HgManifestImportPipeline.h"
 #include "eden/fs/store/hg/HgProxyHash.h"
+#include "eden/fs/tracing/Tracing.h"
 #include "eden/fs/utils/PathFuncs.h"
 #include "eden/fs/utils/TimeUtil.h"
 
@@ -83,6 +86,18 @@ DEFINE_int32(
     256 * 1024 * 1024, // 256MB
     "Buffer size for batching LocalStore writes during hg manifest imports");
 
+DEFINE_int32(
+    hgManifestImportThreads,
+    4,
+    "Number of threads used to parse hg manifest entries during manifest "
+    "imports (0 imports in the calling thread)");
+
+DEFINE_int32(
+    hgManifestImportMaxPendingChunks,
+    16,
+    "Maximum number of hg manifest chunks that may be parsed or waiting to "
+    "be built at once during manifest imports");
+
 namespace {
 using namespace facebook::eden;
 
@@ -181,6 +196,25 @@ AbsolutePath getImportHelperPath() {
   return helperPath;
 }
 
+/**
+ * A TraceBlock for one import, run in a RequestContext of its own.
+ *
+ * Importer threads do not run with a request's context, so without this
+ * every import would update the trace state on folly's shared default
+ * context, from many threads at once.
+ */
+class ImportTraceBlock {
+ public:
+  template <size_t size>
+  explicit ImportTraceBlock(const char (&name)[size]) : block_{name} {}
+
+ private:
+  // Declared first, so that the block is closed before the context is
+  // uninstalled.
+  folly::RequestContextScopeGuard requestContext_;
+  TraceBlock block_;
+};
+
 } // unnamed namespace
 
 namespace facebook {
@@ -309,6 +343,8 @@ ImporterOptions HgImporter::waitForHelperStart() {
     auto nameLength = cursor.readBE<uint32_t>();
     options.repoName = cursor.readFixedString(nameLength);
   }
+  options.fetchTreesSupported =
+      (flags & StartFlag::FETCH_TREES_SUPPORTED) != 0;
 
   return options;
 }
@@ -334,59 +370,48 @@ void HgImporter::stopHelperProcess() {
 }
 
 Hash HgImporter::importFlatManifest(StringPiece revName) {
+  ImportTraceBlock block{"HgImporter::importFlatManifest"};
+  LatencyRecorder latency{&StoreStats::hgImporterManifest};
   // Send the manifest request to the helper process
   auto requestID = sendManifestRequest(revName);
 
-  auto writeBatch = store_->beginWrite(FLAGS_hgManifestImportBufferSize);
-  HgManifestImporter importer(store_, writeBatch.get());
-  size_t numPaths = 0;
+  HgManifestImportPipeline pipeline(
+      store_,
+      FLAGS_hgManifestImportThreads,
+      FLAGS_hgManifestImportMaxPendingChunks,
+      FLAGS_hgManifestImportBufferSize);
 
   auto start = std::chrono::steady_clock::now();
-  IOBuf chunkData;
   while (true) {
     // Read the chunk header
     auto header = readChunkHeader(requestID, "CMD_MANIFEST");
 
-    // Allocate a larger chunk buffer if we need to,
-    // but prefer to re-use the old buffer if we can.
-    if (header.dataLength > chunkData.capacity()) {
-      chunkData = IOBuf(IOBuf::CREATE, header.dataLength);
-    } else {
-      chunkData.clear();
-    }
-
+    // Each chunk gets its own buffer, since earlier chunks may still be
+    // being parsed while we read this one.
+    auto chunkData = IOBuf::create(header.dataLength);
     readFromHelper(
-        chunkData.writableTail(),
+        chunkData->writableTail(),
         header.dataLength,
         "CMD_MANIFEST response body");
-    chunkData.append(header.dataLength);
-
-    // Now process the entries in the chunk
-    Cursor cursor(&chunkData);
-    while (!cursor.isAtEnd()) {
-      readManifestEntry(importer, cursor, writeBatch.get());
-      ++numPaths;
-    }
+    chunkData->append(header.dataLength);
+    pipeline.addChunk(std::move(chunkData));
 
     if ((header.flags & FLAG_MORE_CHUNKS) == 0) {
       break;
     }
   }
 
-  writeBatch->flush();
-
-  auto computeEnd = std::chrono::steady_clock::now();
-  XLOG(DBG2) << "computed trees for " << numPaths << " manifest paths in "
-             << durationStr(computeEnd - start);
-  auto rootHash = importer.finish();
-  auto recordEnd = std::chrono::steady_clock::now();
-  XLOG(DBG2) << "recorded trees for " << numPaths << " manifest paths in "
-             << durationStr(recordEnd - computeEnd);
+  auto rootHash = pipeline.finish();
+  auto end = std::chrono::steady_clock::now();
+  XLOG(DBG2) << "imported trees for " << pipeline.getNumPaths()
+             << " manifest paths in " << durationStr(end - start);
 
   return rootHash;
 }
 
 unique_ptr<Blob> HgImporter::importFileContents(Hash blobHash) {
+  ImportTraceBlock block{"HgImporter::importFileContents"};
+  LatencyRecorder latency{&StoreStats::hgImporterCatFile};
   // Look up the mercurial path and file revision hash,
   // which we need to import the data from mercurial
   HgProxyHash hgInfo(store_, blobHash, "importFileContents");
@@ -465,6 +490,8 @@ unique_ptr<Blob> HgImporter::importFileContents(Hash blobHash) {
 
 void HgImporter::prefetchFiles(
     const std::vector<std::pair<RelativePath, Hash>>& files) {
+  ImportTraceBlock block{"HgImporter::prefetchFiles"};
+  LatencyRecorder latency{&StoreStats::hgImporterPrefetchFiles};
   auto requestID = sendPrefetchFilesRequest(files);
 
   // Read the response; throws if there was any error.
@@ -473,6 +500,8 @@ void HgImporter::prefetchFiles(
 }
 
 void HgImporter::fetchTree(RelativePathPiece path, Hash pathManifestNode) {
+  ImportTraceBlock block{"HgImporter::fetchTree"};
+  LatencyRecorder latency{&StoreStats::hgImporterFetchTree};
   // Ask the hg_import_helper script to fetch data for this tree
   XLOG(DBG1) << "fetching data for tree \"" << path << "\" at manifest node "
              << pathManifestNode;
@@ -489,7 +518,65 @@ void HgImporter::fetchTree(RelativePathPiece path, Hash pathManifestNode) {
   }
 }
 
+std::vector<folly::Try<folly::Unit>> HgImporter::fetchTrees(
+    const std::vector<std::pair<RelativePath, Hash>>& trees) {
+  std::vector<folly::Try<folly::Unit>> results;
+  results.reserve(trees.size());
+  if (!options_.fetchTreesSupported) {
+    // This import helper predates CMD_FETCH_TREES, so fetch the trees one at
+    // a time.
+    for (const auto& tree : trees) {
+      try {
+        fetchTree(tree.first, tree.second);
+        results.emplace_back(folly::unit);
+      } catch (const HgImportPyError& ex) {
+        results.emplace_back(
+            folly::exception_wrapper{std::current_exception(), ex});
+      }
+    }
+    return results;
+  }
+
+  ImportTraceBlock block{"HgImporter::fetchTrees"};
+  LatencyRecorder latency{&StoreStats::hgImporterFetchTree};
+  XLOG(DBG1) << "fetching data for " << trees.size() << " trees";
+  auto requestID = sendFetchTreesRequest(trees);
+
+  auto header = readChunkHeader(requestID, "CMD_FETCH_TREES");
+  IOBuf buf(IOBuf::CREATE, header.dataLength);
+  readFromHelper(
+      buf.writableTail(), header.dataLength, "CMD_FETCH_TREES response body");
+  buf.append(header.dataLength);
+
+  Cursor cursor(&buf);
+  auto numResults = cursor.readBE<uint32_t>();
+  if (numResults != trees.size()) {
+    throw HgImporterError(
+        "got ",
+        numResults,
+        " results for a CMD_FETCH_TREES request for ",
+        trees.size(),
+        " trees");
+  }
+  for (const auto& tree : trees) {
+    auto errorType = cursor.readFixedString(cursor.readBE<uint32_t>());
+    auto message = cursor.readFixedString(cursor.readBE<uint32_t>());
+    if (errorType.empty()) {
+      results.emplace_back(folly::unit);
+    } else {
+      XLOG(DBG2) << "failed to fetch tree \"" << tree.first
+                 << "\" at manifest node " << tree.second << ": "
+                 << errorType << ": " << message;
+      results.emplace_back(
+          folly::make_exception_wrapper<HgImportPyError>(errorType, message));
+    }
+  }
+  return results;
+}
+
 Hash HgImporter::resolveManifestNode(folly::StringPiece revName) {
+  ImportTraceBlock block{"HgImporter::resolveManifestNode"};
+  LatencyRecorder latency{&StoreStats::hgImporterManifestNode};
   auto requestID = sendManifestNodeRequest(revName);
 
   auto header = readChunkHeader(requestID, "CMD_MANIFEST_NODE_FOR_COMMIT");
@@ -509,53 +596,6 @@ Hash HgImporter::resolveManifestNode(folly::StringPiece revName) {
   return Hash(buffer);
 }
 
-void HgImporter::readManifestEntry(
-    HgManifestImporter& importer,
-    folly::io::Cursor& cursor,
-    LocalStore::WriteBatch* writeBatch) {
-  Hash::Storage hashBuf;
-  cursor.pull(hashBuf.data(), hashBuf.size());
-  Hash fileRevHash(hashBuf);
-
-  auto sep = cursor.read<char>();
-  if (sep != '\t') {
-    throw std::runtime_error(folly::to<string>(
-        "unexpected separator char: ", static_cast<int>(sep)));
-  }
-  auto flag = cursor.read<char>();
-  if (flag == '\t') {
-    flag = ' ';
-  } else {
-    sep = cursor.read<char>();
-    if (sep != '\t') {
-      throw std::runtime_error(folly::to<string>(
-          "unexpected separator char: ", static_cast<int>(sep)));
-    }
-  }
-
-  auto pathStr = cursor.readTerminatedString();
-
-  TreeEntryType fileType;
-  if (flag == ' ') {
-    fileType = TreeEntryType::REGULAR_FILE;
-  } else if (flag == 'x') {
-    fileType = TreeEntryType::EXECUTABLE_FILE;
-  } else if (flag == 'l') {
-    fileType = TreeEntryType::SYMLINK;
-  } else {
-    throw std::runtime_error(folly::to<string>(
-        "unsupported file flags for ", pathStr, ": ", static_cast<int>(flag)));
-  }
-
-  RelativePathPiece path(pathStr);
-
-  // Generate a blob hash from the mercurial (path, fileRev) information
-  auto blobHash = HgProxyHash::store(path, fileRevHash, writeBatch);
-
-  auto entry = TreeEntry(blobHash, path.basename().value(), fileType);
-  importer.processEntry(path.dirname(), std::move(entry));
-}
-
 HgImporter::ChunkHeader HgImporter::readChunkHeader(
     TransactionID txnID,
     StringPiece cmdName) {
@@ -745,6 +785,46 @@ HgImporter::TransactionID HgImporter::sendFetchTreeRequest(
   return txnID;
 }
 
+HgImporter::TransactionID HgImporter::sendFetchTreesRequest(
+    const std::vector<std::pair<RelativePath, Hash>>& trees) {
+  auto txnID = nextRequestID_++;
+  ChunkHeader header;
+  header.command = Endian::big<uint32_t>(CMD_FETCH_TREES);
+  header.requestID = Endian::big<uint32_t>(txnID);
+  header.flags = 0;
+
+  size_t dataLength = sizeof(uint32_t);
+  for (const auto& tree : trees) {
+    dataLength +=
+        Hash::RAW_SIZE + sizeof(uint32_t) + tree.first.stringPiece().size();
+  }
+  if (dataLength > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error(
+        folly::to<string>("fetch trees request is too large: ", dataLength));
+  }
+  header.dataLength = Endian::big<uint32_t>(dataLength);
+
+  IOBuf buf(IOBuf::CREATE, dataLength);
+  Appender appender(&buf, 0);
+  appender.writeBE<uint32_t>(trees.size());
+  for (const auto& tree : trees) {
+    auto path = tree.first.stringPiece();
+    appender.push(tree.second.getBytes());
+    appender.writeBE<uint32_t>(path.size());
+    appender.push(path);
+  }
+  DCHECK_EQ(buf.length(), dataLength);
+
+  std::array<struct iovec, 2> iov;
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = const_cast<uint8_t*>(buf.data());
+  iov[1].iov_len = buf.length();
+  writeToHelper(iov, "CMD_FETCH_TREES");
+
+  return txnID;
+}
+
 void HgImporter::readFromHelper(void* buf, size_t size, StringPiece context) {
   size_t bytesRead;
 
@@ -897,6 +977,21 @@ void HgImporterManager::fetchTree(
   });
 }
 
+std::vector<folly::Try<folly::Unit>> HgImporterManager::fetchTrees(
+    const std::vector<std::pair<RelativePath, Hash>>& trees) {
+  auto results = retryOnError(
+      [&](HgImporter* importer) { return importer->fetchTrees(trees); });
+  for (size_t n = 0; n < trees.size(); ++n) {
+    if (results[n].hasException()) {
+      results[n] = folly::makeTryWith([&] {
+        fetchTree(trees[n].first, trees[n].second);
+        return folly::unit;
+      });
+    }
+  }
+  return results;
+}
+
 HgImporter* HgImporterManager::getImporter() {
   if (!importer_) {
     importer_ = make_unique<HgImporter>(repoPath_, store_, importHelperScript_);
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <folly/Try.h>
 #include <optional>
 #ifndef EDEN_WIN
 #include <folly/Subprocess.h>
@@ -22,12 +23,6 @@
 #include "eden/fs/store/LocalStore.h"
 #include "eden/fs/utils/PathFuncs.h"
 
-namespace folly {
-namespace io {
-class Cursor;
-}
-} // namespace folly
-
 #if EDEN_HAVE_HG_TREEMANIFEST
 /* forward declare support classes from mercurial */
 class DatapackStore;
@@ -39,7 +34,6 @@ namespace eden {
 
 class Blob;
 class Hash;
-class HgManifestImporter;
 class StoreResult;
 class Tree;
 
@@ -69,6 +63,11 @@ struct ImporterOptions {
    * The name of the repo
    */
   std::string repoName;
+
+  /**
+   * Whether the import helper accepts CMD_FETCH_TREES requests.
+   */
+  bool fetchTreesSupported{false};
 };
 
 class Importer {
@@ -109,6 +108,17 @@ class Importer {
    * Import tree and store it in the datapack
    */
   virtual void fetchTree(RelativePathPiece path, Hash pathManifestNode) = 0;
+
+  /**
+   * Import several trees, given as (path, manifestNode) pairs, with a single
+   * request to the import helper, and store them in the datapack.
+   *
+   * Returns one result per tree, in the same order, so that a tree that
+   * cannot be fetched does not fail the others.  Throws if the request as a
+   * whole fails.
+   */
+  virtual std::vector<folly::Try<folly::Unit>> fetchTrees(
+      const std::vector<std::pair<RelativePath, Hash>>& trees) = 0;
 };
 
 /**
@@ -150,6 +160,8 @@ class HgImporter : public Importer {
   void prefetchFiles(
       const std::vector<std::pair<RelativePath, Hash>>& files) override;
   void fetchTree(RelativePathPiece path, Hash pathManifestNode) override;
+  std::vector<folly::Try<folly::Unit>> fetchTrees(
+      const std::vector<std::pair<RelativePath, Hash>>& trees) override;
 
   const ImporterOptions& getOptions() const;
 
@@ -182,6 +194,7 @@ class HgImporter : public Importer {
   enum StartFlag : uint32_t {
     TREEMANIFEST_SUPPORTED = 0x01,
     MONONOKE_SUPPORTED = 0x02,
+    FETCH_TREES_SUPPORTED = 0x04,
   };
   /**
    * Command type values.
@@ -198,6 +211,7 @@ class HgImporter : public Importer {
     CMD_FETCH_TREE = 5,
     CMD_PREFETCH_FILES = 6,
     CMD_CAT_FILE = 7,
+    CMD_FETCH_TREES = 8,
   };
   using TransactionID = uint32_t;
   struct ChunkHeader {
@@ -219,18 +233,6 @@ class HgImporter : public Importer {
    */
   ImporterOptions waitForHelperStart();
 
-  /**
-   * Read a single manifest entry from a manifest response chunk,
-   * and give it to the HgManifestImporter for processing.
-   *
-   * The cursor argument points to the start of the manifest entry in the
-   * response chunk received from the helper process.  readManifestEntry() is
-   * responsible for updating the cursor to point to the next manifest entry.
-   */
-  static void readManifestEntry(
-      HgManifestImporter& importer,
-      folly::io::Cursor& cursor,
-      LocalStore::WriteBatch* writeBatch);
   /**
    * Read a response chunk header from the helper process
    *
@@ -281,6 +283,8 @@ class HgImporter : public Importer {
   TransactionID sendFetchTreeRequest(
       RelativePathPiece path,
       Hash pathManifestNode);
+  TransactionID sendFetchTreesRequest(
+      const std::vector<std::pair<RelativePath, Hash>>& trees);
 
   // Note: intentional RelativePath rather than RelativePathPiece here because
   // HgProxyHash is not movable and it was less work to make a copy here than
@@ -343,6 +347,15 @@ class HgImporterManager : public Importer {
       const std::vector<std::pair<RelativePath, Hash>>& files) override;
   void fetchTree(RelativePathPiece path, Hash pathManifestNode) override;
 
+  /**
+   * Like HgImporter::fetchTrees(), but a tree that the batched request
+   * failed to fetch is retried on its own with fetchTree(), which restarts
+   * the import helper if necessary.  Trees that were fetched successfully
+   * are not fetched again.
+   */
+  std::vector<folly::Try<folly::Unit>> fetchTrees(
+      const std::vector<std::pair<RelativePath, Hash>>& trees) override;
+
  private:
   template <typename Fn>
   auto retryOnError(Fn&& fn);
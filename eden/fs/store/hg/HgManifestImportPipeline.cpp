@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/hg/HgManifestImportPipeline.h"
+
+#include <folly/Conv.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <algorithm>
+
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/store/hg/HgProxyHash.h"
+
+using folly::IOBuf;
+using folly::io::Cursor;
+using std::string;
+
+namespace facebook {
+namespace eden {
+
+HgManifestImportPipeline::HgManifestImportPipeline(
+    LocalStore* store,
+    size_t parseThreads,
+    size_t maxPendingChunks,
+    size_t writeBufferSize)
+    : store_{store},
+      maxPendingChunks_{std::max<size_t>(maxPendingChunks, 1)},
+      writeBatch_{store->beginWrite(writeBufferSize)},
+      importer_{store, writeBatch_.get()} {
+  if (parseThreads > 0) {
+    parsePool_ = std::make_unique<folly::CPUThreadPoolExecutor>(
+        parseThreads,
+        std::make_shared<folly::NamedThreadFactory>("HgManifestParse"));
+    buildThread_ = std::make_unique<folly::CPUThreadPoolExecutor>(
+        1, std::make_shared<folly::NamedThreadFactory>("HgManifestBuild"));
+  }
+}
+
+HgManifestImportPipeline::~HgManifestImportPipeline() {
+  // If finish() was not called, stop building trees that will never be
+  // recorded.  The executors are joined by their destructors.
+  failed_ = true;
+}
+
+void HgManifestImportPipeline::addChunk(std::unique_ptr<IOBuf> chunk) {
+  if (!parsePool_) {
+    buildChunk(parseChunk(*chunk, writeBatch_.get()));
+    return;
+  }
+
+  // Wait for the oldest chunk to be built if too many are in flight.  This
+  // also surfaces any error from earlier chunks.
+  while (pending_.size() >= maxPendingChunks_) {
+    auto built = std::move(pending_.front());
+    pending_.pop_front();
+    std::move(built).get();
+  }
+
+  auto parsed =
+      folly::via(parsePool_.get(), [this, chunk = std::move(chunk)] {
+        // A chunk is small, so write it in one unbuffered batch rather than
+        // reserving writeBufferSize for every chunk.
+        auto writeBatch = store_->beginWrite();
+        auto entries = parseChunk(*chunk, writeBatch.get());
+        writeBatch->flush();
+        return entries;
+      });
+  // The build thread runs these in the order they were queued, which is
+  // the manifest order that HgManifestImporter requires.
+  pending_.push_back(folly::via(
+      buildThread_.get(), [this, parsed = std::move(parsed)]() mutable {
+        try {
+          auto entries = std::move(parsed).get();
+          if (!failed_) {
+            buildChunk(std::move(entries));
+          }
+        } catch (...) {
+          failed_ = true;
+          throw;
+        }
+      }));
+}
+
+Hash HgManifestImportPipeline::finish() {
+  while (!pending_.empty()) {
+    auto built = std::move(pending_.front());
+    pending_.pop_front();
+    std::move(built).get();
+  }
+  writeBatch_->flush();
+  return importer_.finish();
+}
+
+std::vector<HgManifestImportPipeline::ManifestEntry>
+HgManifestImportPipeline::parseChunk(
+    const IOBuf& chunk,
+    LocalStore::WriteBatch* writeBatch) {
+  std::vector<ManifestEntry> entries;
+  Cursor cursor(&chunk);
+  while (!cursor.isAtEnd()) {
+    entries.push_back(parseManifestEntry(cursor, writeBatch));
+  }
+  return entries;
+}
+
+void HgManifestImportPipeline::buildChunk(
+    std::vector<ManifestEntry>&& entries) {
+  for (auto& entry : entries) {
+    importer_.processEntry(entry.path.dirname(), std::move(entry.entry));
+  }
+  numPaths_.fetch_add(entries.size(), std::memory_order_relaxed);
+}
+
+HgManifestImportPipeline::ManifestEntry
+HgManifestImportPipeline::parseManifestEntry(
+    Cursor& cursor,
+    LocalStore::WriteBatch* writeBatch) {
+  Hash::Storage hashBuf;
+  cursor.pull(hashBuf.data(), hashBuf.size());
+  Hash fileRevHash(hashBuf);
+
+  auto sep = cursor.read<char>();
+  if (sep != '\t') {
+    throw std::runtime_error(folly::to<string>(
+        "unexpected separator char: ", static_cast<int>(sep)));
+  }
+  auto flag = cursor.read<char>();
+  if (flag == '\t') {
+    flag = ' ';
+  } else {
+    sep = cursor.read<char>();
+    if (sep != '\t') {
+      throw std::runtime_error(folly::to<string>(
+          "unexpected separator char: ", static_cast<int>(sep)));
+    }
+  }
+
+  auto pathStr = cursor.readTerminatedString();
+
+  TreeEntryType fileType;
+  if (flag == ' ') {
+    fileType = TreeEntryType::REGULAR_FILE;
+  } else if (flag == 'x') {
+    fileType = TreeEntryType::EXECUTABLE_FILE;
+  } else if (flag == 'l') {
+    fileType = TreeEntryType::SYMLINK;
+  } else {
+    throw std::runtime_error(folly::to<string>(
+        "unsupported file flags for ", pathStr, ": ", static_cast<int>(flag)));
+  }
+
+  RelativePath path(std::move(pathStr));
+
+  // Generate a blob hash from the mercurial (path, fileRev) information
+  auto blobHash = HgProxyHash::store(path, fileRevHash, writeBatch);
+
+  auto entry = TreeEntry(blobHash, path.basename().value(), fileType);
+  return ManifestEntry{std::move(path), std::move(entry)};
+}
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,135 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/futures/Future.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "eden/fs/model/TreeEntry.h"
+#include "eden/fs/store/LocalStore.h"
+#include "eden/fs/store/hg/HgManifestImporter.h"
+#include "eden/fs/utils/PathFuncs.h"
+
+namespace folly {
+class Executor;
+class IOBuf;
+namespace io {
+class Cursor;
+}
+} // namespace folly
+
+namespace facebook {
+namespace eden {
+
+class Hash;
+
+/**
+ * HgManifestImportPipeline turns the CMD_MANIFEST response chunks sent by
+ * the hg_import_helper.py process into Tree objects in the LocalStore.
+ *
+ * The work is split into stages so that a large manifest keeps several
+ * threads busy:
+ * - The caller reads chunks from the helper and passes them to addChunk().
+ * - A pool of parse threads parses the entries of each chunk, computes their
+ *   HgProxyHashes, and writes those to the LocalStore in one batch per chunk.
+ * - A single build thread feeds the parsed entries, in manifest order, to an
+ *   HgManifestImporter, which serializes and hashes each directory as soon
+ *   as it is complete.
+ *
+ * At most maxPendingChunks chunks are parsed or waiting to be built at once;
+ * addChunk() blocks until an earlier chunk is built rather than buffering
+ * the whole manifest in memory.
+ *
+ * With parseThreads set to 0 every stage runs in the calling thread.
+ */
+class HgManifestImportPipeline {
+ public:
+  /**
+   * Trees, and the proxy hashes of entries parsed in the calling thread, are
+   * written in batches of up to writeBufferSize bytes (0 for one batch).
+   */
+  HgManifestImportPipeline(
+      LocalStore* store,
+      size_t parseThreads,
+      size_t maxPendingChunks,
+      size_t writeBufferSize);
+  ~HgManifestImportPipeline();
+
+  /**
+   * Queue a manifest response chunk.
+   *
+   * This rethrows the error from an earlier chunk if one could not be
+   * imported.
+   */
+  void addChunk(std::unique_ptr<folly::IOBuf> chunk);
+
+  /**
+   * Wait for every chunk to be built, then record the trees in the
+   * LocalStore.
+   *
+   * Returns the hash of the root Tree.
+   */
+  Hash finish();
+
+  /** Returns the number of manifest entries built so far. */
+  size_t getNumPaths() const {
+    return numPaths_.load(std::memory_order_relaxed);
+  }
+
+  struct ManifestEntry {
+    RelativePath path;
+    TreeEntry entry;
+  };
+
+  /**
+   * Parse a single manifest entry from a manifest response chunk, and store
+   * its HgProxyHash in writeBatch.
+   *
+   * The cursor argument points to the start of the manifest entry.
+   * parseManifestEntry() updates the cursor to point to the next one.
+   */
+  static ManifestEntry parseManifestEntry(
+      folly::io::Cursor& cursor,
+      LocalStore::WriteBatch* writeBatch);
+
+ private:
+  HgManifestImportPipeline(const HgManifestImportPipeline&) = delete;
+  HgManifestImportPipeline& operator=(const HgManifestImportPipeline&) =
+      delete;
+
+  std::vector<ManifestEntry> parseChunk(
+      const folly::IOBuf& chunk,
+      LocalStore::WriteBatch* writeBatch);
+  void buildChunk(std::vector<ManifestEntry>&& entries);
+
+  LocalStore* const store_;
+  const size_t maxPendingChunks_;
+
+  // Used for the proxy hashes when parsing in the calling thread, and for the
+  // trees.
+  std::unique_ptr<LocalStore::WriteBatch> writeBatch_;
+  HgManifestImporter importer_;
+  std::atomic<size_t> numPaths_{0};
+  std::atomic<bool> failed_{false};
+
+  // Completion of the build stage for each pending chunk, oldest first.
+  std::deque<folly::Future<folly::Unit>> pending_;
+
+  // Declared last so that they are joined before anything their tasks use is
+  // destroyed.
+  std::unique_ptr<folly::Executor> parsePool_;
+  std::unique_ptr<folly::Executor> buildThread_;
+};
+
+} // namespace eden
+} // namespace facebook
@@ -16,6 +16,8 @@
 
 #include "eden/fs/store/LocalStore.h"
 #include "eden/fs/store/StoreResult.h"
+#include "eden/fs/store/StoreStats.h"
+#include "eden/fs/store/hg/HgProxyHashCache.h"
 
 using folly::ByteRange;
 using folly::Endian;
@@ -32,6 +34,14 @@ HgProxyHash::HgProxyHash(
     LocalStore* store,
     Hash edenBlobHash,
     StringPiece context) {
+  auto& cache = HgProxyHashCache::get();
+  if (cache.lookup(edenBlobHash, value_)) {
+    getStoreStats()->hgProxyHashCacheHit.incrementValue();
+    parseValue(edenBlobHash);
+    return;
+  }
+  getStoreStats()->hgProxyHashCacheMiss.incrementValue();
+
   // Read the path name and file rev hash
   auto infoResult = store->get(KeySpace::HgProxyHashFamily, edenBlobHash);
   if (!infoResult.isValid()) {
@@ -42,28 +52,61 @@ HgProxyHash::HgProxyHash(
 
   value_ = infoResult.extractValue();
   parseValue(edenBlobHash);
+  cache.insert(edenBlobHash, StringPiece{value_});
 }
 
 folly::Future<std::vector<std::pair<RelativePath, Hash>>> HgProxyHash::getBatch(
     LocalStore* store,
     const std::vector<Hash>& blobHashes) {
-  auto hashCopies = std::make_shared<std::vector<Hash>>(blobHashes);
+  auto& cache = HgProxyHashCache::get();
+  auto results = std::make_shared<std::vector<std::pair<RelativePath, Hash>>>(
+      blobHashes.size());
+
+  // Resolve whatever is cached, and only read the rest from the LocalStore.
+  auto missIndexes = std::make_shared<std::vector<size_t>>();
   std::vector<folly::ByteRange> byteRanges;
-  for (auto& hash : *hashCopies) {
-    byteRanges.push_back(hash.getBytes());
+  std::string value;
+  for (size_t i = 0; i < blobHashes.size(); ++i) {
+    const auto& hash = blobHashes[i];
+    if (cache.lookup(hash, value)) {
+      HgProxyHash hgInfo(hash, std::move(value));
+      (*results)[i] = {hgInfo.path().copy(), hgInfo.revHash()};
+    } else {
+      missIndexes->push_back(i);
+      byteRanges.push_back(hash.getBytes());
+    }
   }
-  return store->getBatch(KeySpace::HgProxyHashFamily, byteRanges)
-      .thenValue([blobHashes = hashCopies](std::vector<StoreResult>&& data) {
-        std::vector<std::pair<RelativePath, Hash>> results;
-
-        for (size_t i = 0; i < blobHashes->size(); ++i) {
-          HgProxyHash hgInfo(
-              blobHashes->at(i), data[i], "prefetchFiles getBatch");
 
-          results.emplace_back(hgInfo.path().copy(), hgInfo.revHash());
+  auto& stats = getStoreStats();
+  stats->hgProxyHashCacheHit.incrementValue(
+      blobHashes.size() - missIndexes->size());
+  if (missIndexes->empty()) {
+    return folly::makeFuture(std::move(*results));
+  }
+  stats->hgProxyHashCacheMiss.incrementValue(missIndexes->size());
+
+  // byteRanges points into blobHashes, which the caller keeps alive only
+  // until we return, so copy the hashes we still need.
+  auto missHashes = std::make_shared<std::vector<Hash>>();
+  missHashes->reserve(missIndexes->size());
+  byteRanges.clear();
+  for (auto i : *missIndexes) {
+    missHashes->push_back(blobHashes[i]);
+    byteRanges.push_back(missHashes->back().getBytes());
+  }
+  return store->getBatch(KeySpace::HgProxyHashFamily, byteRanges)
+      .thenValue([results, missIndexes, missHashes](
+                     std::vector<StoreResult>&& data) {
+        auto& cache = HgProxyHashCache::get();
+        for (size_t i = 0; i < missHashes->size(); ++i) {
+          const auto& hash = missHashes->at(i);
+          HgProxyHash hgInfo(hash, data[i], "prefetchFiles getBatch");
+          cache.insert(hash, StringPiece{hgInfo.value_});
+          (*results)[missIndexes->at(i)] = {hgInfo.path().copy(),
+                                            hgInfo.revHash()};
         }
 
-        return results;
+        return std::move(*results);
       });
 }
 
@@ -92,12 +135,17 @@ std::pair<Hash, IOBuf> HgProxyHash::prepareToStore(
 void HgProxyHash::store(
     const std::pair<Hash, IOBuf>& computedPair,
     LocalStore::WriteBatch* writeBatch) {
-  writeBatch->put(
-      KeySpace::HgProxyHashFamily,
-      computedPair.first,
-      // Note that this depends on prepareToStore() having called
-      // buf.coalesce()!
-      ByteRange(computedPair.second.data(), computedPair.second.length()));
+  // Note that this depends on prepareToStore() having called
+  // buf.coalesce()!
+  ByteRange value(computedPair.second.data(), computedPair.second.length());
+  writeBatch->put(KeySpace::HgProxyHashFamily, computedPair.first, value);
+  // Tree and manifest imports store a proxy hash for every file, so this is
+  // what fills the cache before the files are read.  Only cache it once it is
+  // in the LocalStore, so the cache never knows a hash the store does not.
+  writeBatch->afterFlush(
+      [hash = computedPair.first, value = StringPiece{value}.str()] {
+        HgProxyHashCache::get().insert(hash, StringPiece{value});
+      });
 }
 
 HgProxyHash::HgProxyHash(
@@ -114,6 +162,11 @@ HgProxyHash::HgProxyHash(
   parseValue(edenBlobHash);
 }
 
+HgProxyHash::HgProxyHash(Hash edenBlobHash, std::string value)
+    : value_{std::move(value)} {
+  parseValue(edenBlobHash);
+}
+
 IOBuf HgProxyHash::serialize(RelativePathPiece path, Hash hgRevHash) {
   // We serialize the data as <hash_bytes><path_length><path>
   //
@@ -40,7 +40,8 @@ namespace eden {
 class HgProxyHash {
  public:
   /**
-   * Load HgProxyHash data for the given eden blob hash from the LocalStore.
+   * Load HgProxyHash data for the given eden blob hash from the
+   * HgProxyHashCache, or from the LocalStore if it is not cached.
    */
   HgProxyHash(LocalStore* store, Hash edenBlobHash, folly::StringPiece context);
 
@@ -54,12 +55,18 @@ class HgProxyHash {
     return revHash_;
   }
 
+  /**
+   * Load the HgProxyHash data for several eden blob hashes.  Only the hashes
+   * missing from the HgProxyHashCache are read from the LocalStore, in a
+   * single batch.
+   */
   static folly::Future<std::vector<std::pair<RelativePath, Hash>>> getBatch(
       LocalStore* store,
       const std::vector<Hash>& blobHashes);
 
   /**
-   * Store HgProxyHash data in the LocalStore.
+   * Store HgProxyHash data in the LocalStore, and add it to the
+   * HgProxyHashCache once writeBatch has been flushed.
    *
    * Returns an eden blob hash that can be used to retrieve the data later
    * (using the HgProxyHash constructor defined above).
@@ -105,6 +112,11 @@ class HgProxyHash {
       StoreResult& infoResult,
       folly::StringPiece context);
 
+  /**
+   * Parse serialized data from the HgProxyHashCache.
+   */
+  HgProxyHash(Hash edenBlobHash, std::string value);
+
   /**
    * Serialize the (path, hgRevHash) data into a buffer that will be stored in
    * the LocalStore.
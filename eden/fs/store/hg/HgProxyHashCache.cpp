@@ -0,0 +1,174 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/hg/HgProxyHashCache.h"
+
+#include <folly/Indestructible.h>
+#include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+#include <cstring>
+#include <limits>
+
+DEFINE_uint64(
+    hg_proxy_hash_cache_size,
+    64 * 1024 * 1024,
+    "Approximate number of bytes of memory used to cache mercurial proxy "
+    "hashes (0 disables the cache)");
+
+namespace facebook {
+namespace eden {
+
+namespace {
+/**
+ * Every entry in a ring starts with its key and the length of its value.
+ */
+constexpr size_t kHeaderSize = Hash::RAW_SIZE + sizeof(uint32_t);
+
+Hash readKey(const uint8_t* entry) {
+  Hash::Storage bytes;
+  memcpy(bytes.data(), entry, Hash::RAW_SIZE);
+  return Hash{bytes};
+}
+
+uint32_t readLength(const uint8_t* entry) {
+  uint32_t length;
+  memcpy(&length, entry + Hash::RAW_SIZE, sizeof(length));
+  return length;
+}
+} // namespace
+
+HgProxyHashCache::HgProxyHashCache(size_t maxBytes)
+    : maxBytesPerShard_{static_cast<uint32_t>(std::min<size_t>(
+          maxBytes / kNumShards,
+          std::numeric_limits<uint32_t>::max()))} {}
+
+HgProxyHashCache& HgProxyHashCache::get() {
+  static folly::Indestructible<HgProxyHashCache> cache{
+      FLAGS_hg_proxy_hash_cache_size};
+  return *cache;
+}
+
+folly::Synchronized<HgProxyHashCache::Shard>& HgProxyHashCache::getShard(
+    const Hash& hash) {
+  // The hash is a SHA-1, so any of its bytes is well distributed.
+  return shards_[hash.getBytes()[0] % kNumShards];
+}
+
+bool HgProxyHashCache::fits(const Shard& shard, size_t size) const {
+  if (shard.wrapped) {
+    return shard.begin - shard.end >= size;
+  }
+  // Either after the newest entry, or by wrapping around to the start.
+  return maxBytesPerShard_ - shard.end >= size || shard.begin >= size;
+}
+
+uint32_t HgProxyHashCache::allocate(Shard& shard, size_t size) const {
+  XDCHECK(fits(shard, size));
+  if (!shard.wrapped && maxBytesPerShard_ - shard.end < size) {
+    shard.wrapEnd = shard.end;
+    shard.end = 0;
+    shard.wrapped = true;
+  }
+  auto offset = shard.end;
+  shard.end += size;
+  return offset;
+}
+
+void HgProxyHashCache::popOldest(Shard& shard) const {
+  shard.begin += kHeaderSize + readLength(shard.ring.get() + shard.begin);
+  if (shard.wrapped && shard.begin == shard.wrapEnd) {
+    shard.begin = 0;
+    shard.wrapped = false;
+  }
+  if (!shard.wrapped && shard.begin == shard.end) {
+    shard.begin = 0;
+    shard.end = 0;
+  }
+}
+
+void HgProxyHashCache::makeRoom(Shard& shard, size_t size) const {
+  while (!fits(shard, size)) {
+    auto offset = shard.begin;
+    const auto* entry = shard.ring.get() + offset;
+    auto it = shard.index.find(readKey(entry));
+    XDCHECK(it != shard.index.end());
+    if (!it->second.referenced) {
+      shard.index.erase(it);
+      popOldest(shard);
+      continue;
+    }
+
+    // Move the entry to the newest end of the ring.  Popping it always
+    // frees enough contiguous space to rewrite it, though the copy may
+    // overlap its old location.
+    auto entrySize = kHeaderSize + readLength(entry);
+    popOldest(shard);
+    auto newOffset = allocate(shard, entrySize);
+    memmove(shard.ring.get() + newOffset, entry, entrySize);
+    it->second = Slot{newOffset, false};
+  }
+}
+
+void HgProxyHashCache::insert(
+    const Hash& edenBlobHash,
+    folly::ByteRange value) {
+  auto entrySize = kHeaderSize + value.size();
+  if (entrySize > maxBytesPerShard_) {
+    return;
+  }
+
+  auto shard = getShard(edenBlobHash).wlock();
+  if (shard->index.find(edenBlobHash) != shard->index.end()) {
+    return;
+  }
+  if (!shard->ring) {
+    // Left uninitialized, so untouched pages are never faulted in.
+    shard->ring.reset(new uint8_t[maxBytesPerShard_]);
+  }
+  makeRoom(*shard, entrySize);
+
+  auto offset = allocate(*shard, entrySize);
+  auto* entry = shard->ring.get() + offset;
+  auto length = static_cast<uint32_t>(value.size());
+  memcpy(entry, edenBlobHash.getBytes().data(), Hash::RAW_SIZE);
+  memcpy(entry + Hash::RAW_SIZE, &length, sizeof(length));
+  memcpy(entry + kHeaderSize, value.data(), value.size());
+  shard->index.emplace(edenBlobHash, Slot{offset, false});
+}
+
+bool HgProxyHashCache::lookup(const Hash& edenBlobHash, std::string& value) {
+  // A write lock, since a hit marks the entry as referenced.
+  auto shard = getShard(edenBlobHash).wlock();
+  auto it = shard->index.find(edenBlobHash);
+  if (it == shard->index.end()) {
+    return false;
+  }
+  it->second.referenced = true;
+  const auto* entry = shard->ring.get() + it->second.offset;
+  value.assign(
+      reinterpret_cast<const char*>(entry + kHeaderSize), readLength(entry));
+  return true;
+}
+
+size_t HgProxyHashCache::size() const {
+  size_t count = 0;
+  for (const auto& shard : shards_) {
+    count += shard.rlock()->index.size();
+  }
+  return count;
+}
+
+void HgProxyHashCache::clear() {
+  for (auto& shard : shards_) {
+    *shard.wlock() = Shard{};
+  }
+}
+
+} // namespace eden
+} // namespace facebook
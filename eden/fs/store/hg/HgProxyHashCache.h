@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <folly/container/F14Map.h>
+#include <array>
+#include <memory>
+#include <string>
+#include "eden/fs/model/Hash.h"
+
+namespace facebook {
+namespace eden {
+
+/**
+ * An in-memory cache of the HgProxyHashFamily data in the LocalStore, so
+ * that resolving an eden blob hash to its (path, hgRevHash) usually does not
+ * need a LocalStore read.
+ *
+ * Proxy hashes are the hash of the data they map to, so one process-wide
+ * cache is correct for every LocalStore.  Entries are added once proxy
+ * hashes have been flushed to the LocalStore, which happens in bulk as trees
+ * and manifests are imported, and whenever they have to be read from the
+ * LocalStore.
+ *
+ * Each shard packs its entries end to end in a fixed size ring buffer, with
+ * a flat hash table mapping each key to its offset.  When a shard is full,
+ * entries are evicted from the oldest end of the ring one at a time using the
+ * CLOCK algorithm: an entry that was looked up since it was written gets a
+ * second chance and is moved to the newest end instead.
+ */
+class HgProxyHashCache {
+ public:
+  /**
+   * Create a cache whose entries use at most about maxBytes of memory, plus
+   * roughly 40 bytes of hash table per entry.  A maxBytes of 0 disables the
+   * cache.
+   */
+  explicit HgProxyHashCache(size_t maxBytes);
+
+  /**
+   * Returns the process-wide cache, sized by --hg_proxy_hash_cache_size.
+   */
+  static HgProxyHashCache& get();
+
+  /**
+   * Record the serialized HgProxyHash value for edenBlobHash.
+   */
+  void insert(const Hash& edenBlobHash, folly::ByteRange value);
+
+  /**
+   * Copy the serialized value for edenBlobHash into value.  Returns false,
+   * leaving value unchanged, if it is not cached.
+   */
+  bool lookup(const Hash& edenBlobHash, std::string& value);
+
+  /** Returns the number of cached entries. */
+  size_t size() const;
+
+  /** Drop every entry. */
+  void clear();
+
+ private:
+  static constexpr size_t kNumShards = 16;
+
+  struct Slot {
+    // Offset of the entry in the shard's ring
+    uint32_t offset;
+    // Set by lookup(), cleared when the entry is given a second chance
+    bool referenced;
+  };
+
+  /**
+   * The ring holds entries from begin to end, oldest first.  Once it has
+   * wrapped around, the entries before the wrap end at wrapEnd, and the rest
+   * start at offset 0.
+   */
+  struct Shard {
+    folly::F14ValueMap<Hash, Slot> index;
+    std::unique_ptr<uint8_t[]> ring;
+    uint32_t begin{0};
+    uint32_t end{0};
+    uint32_t wrapEnd{0};
+    bool wrapped{false};
+  };
+
+  folly::Synchronized<Shard>& getShard(const Hash& hash);
+
+  bool fits(const Shard& shard, size_t size) const;
+  uint32_t allocate(Shard& shard, size_t size) const;
+  void popOldest(Shard& shard) const;
+  void makeRoom(Shard& shard, size_t size) const;
+
+  uint32_t maxBytesPerShard_;
+  std::array<folly::Synchronized<Shard>, kNumShards> shards_;
+};
+
+} // namespace eden
+} // namespace facebook
@@ -101,6 +101,7 @@ PROTOCOL_VERSION = 1
 
 START_FLAGS_TREEMANIFEST_SUPPORTED = 0x01
 START_FLAGS_MONONOKE_SUPPORTED = 0x02
+START_FLAGS_FETCH_TREES_SUPPORTED = 0x04
 
 #
 # Message types.
@@ -116,6 +117,7 @@ CMD_MANIFEST_NODE_FOR_COMMIT = 4
 CMD_FETCH_TREE = 5
 CMD_PREFETCH_FILES = 6
 CMD_CAT_FILE = 7
+CMD_FETCH_TREES = 8
 
 #
 # Flag values.
@@ -316,7 +318,7 @@ class HgServer(object):
         use_treemanifest = (self.treemanifest is not None) and bool(repo_name)
         use_mononoke = use_treemanifest and self._is_mononoke_supported(repo_name)
 
-        flags = 0
+        flags = START_FLAGS_FETCH_TREES_SUPPORTED
         treemanifest_paths = []
         if use_treemanifest:
             flags |= START_FLAGS_TREEMANIFEST_SUPPORTED
@@ -534,13 +536,70 @@ class HgServer(object):
         self.fetch_tree(path, manifest_node)
         self.send_chunk(request, b"")
 
-    def fetch_tree(self, path, manifest_node):
-        if self.treemanifest is None:
-            raise Exception("treemanifest not enabled in this repository")
+    @cmd(CMD_FETCH_TREES)
+    def cmd_fetch_trees(self, request):
+        """
+        Handler for CMD_FETCH_TREES requests.
 
-        try:
-            self._fetch_tree_impl(path, manifest_node)
-        except Exception as ex:
+        Fetch several trees from the server, as CMD_FETCH_TREE does for one.
+        Only sent if START_FLAGS_FETCH_TREES_SUPPORTED was set in the
+        CMD_STARTED response.
+
+        Request body format:
+        - Number of trees (uint32)
+        - For each tree:
+          - Manifest node (20 bytes)
+          - Path length (uint32)
+          - Path
+
+        Response body format:
+        - Number of trees (uint32)
+        - For each tree, in request order:
+          - Error type length (uint32)
+          - Error type
+          - Error message length (uint32)
+          - Error message
+
+        A tree whose error type is empty was fetched successfully.  A failure
+        to fetch one directory does not fail the other trees; the request as
+        a whole only fails if the fetched data could not be committed.
+        """
+        body = request.body
+        [num_trees] = struct.unpack_from(b">I", body, 0)
+        offset = 4
+        paths = []
+        nodes_by_path = collections.OrderedDict()
+        for _ in range(num_trees):
+            manifest_node, path_length = struct.unpack_from(b">20sI", body, offset)
+            offset += SHA1_NUM_BYTES + 4
+            path = body[offset : offset + path_length]
+            if len(path) != path_length:
+                raise Exception(
+                    "fetch_trees request data too short: len=%d" % len(body)
+                )
+            offset += path_length
+            paths.append(path)
+            nodes_by_path.setdefault(path, set()).add(manifest_node)
+
+        self.debug(
+            "fetching %d trees in %d directories", num_trees, len(nodes_by_path)
+        )
+        errors = self.fetch_trees(nodes_by_path)
+
+        parts = [struct.pack(b">I", num_trees)]
+        for path in paths:
+            ex = errors.get(path)
+            error_type = type(ex).__name__ if ex is not None else b""
+            message = str(ex) if ex is not None else b""
+            parts.append(struct.pack(b">I", len(error_type)))
+            parts.append(error_type)
+            parts.append(struct.pack(b">I", len(message)))
+            parts.append(message)
+        self.send_chunk(request, *parts)
+
+    def fetch_tree(self, path, manifest_node):
+        errors = self.fetch_trees({path: set([manifest_node])})
+        if errors:
             # Ugh.  Mercurial sometimes throws spurious KeyErrors
             # if this tree was created since we first initialized our
             # connection to the server.
@@ -548,11 +607,37 @@ class HgServer(object):
             # These errors come from the server-side; there doesn't seem to be
             # a good way to force the server to re-read the data other than
             # recreating our repo object.
+            raise ResetRepoError(errors[path])
+
+    def fetch_trees(self, nodes_by_path):
+        """
+        Fetch the given manifest nodes for each path, and commit the fetched
+        data to the pack files once for all of them.
+
+        Returns a dictionary mapping each path that could not be fetched to
+        the exception that fetching it raised.
+        """
+        if self.treemanifest is None:
+            raise Exception("treemanifest not enabled in this repository")
+
+        errors = {}
+        for path, mfnodes in nodes_by_path.items():
+            try:
+                self._fetch_trees_impl(path, mfnodes)
+            except Exception as ex:
+                logging.warning("error fetching trees for %r: %s", path, ex)
+                errors[path] = ex
+
+        try:
+            self._commit_fetched_trees()
+        except Exception as ex:
             raise ResetRepoError(ex)
+        return errors
 
-    def _fetch_tree_impl(self, path, manifest_node):
-        mfnodes = set([manifest_node])
+    def _commit_fetched_trees(self):
+        self.repo.manifestlog.commitpending()
 
+    def _fetch_trees_impl(self, path, mfnodes):
         # It would be nice to initially only fetch the one tree that we need
         # immediately, and fetch the rest of the subtree later, in the
         # background.  Unfortunately the wire protocol API does not support a
@@ -563,12 +648,10 @@ class HgServer(object):
             # We have to call repo._prefetchtrees() directly if we have a path.
             # We cannot compute the set of base nodes in this case.
             self.repo._prefetchtrees(path, mfnodes, [], [])
-            self.repo.manifestlog.commitpending()
         else:
             # When querying the top-level node use repo.prefetchtrees()
             # It will compute a reasonable set of base nodes to send in the query.
             self.repo.prefetchtrees(mfnodes)
-            self.repo.manifestlog.commitpending()
 
     def send_chunk(self, request, *data, **kwargs):
         is_last = kwargs.pop("is_last", True)
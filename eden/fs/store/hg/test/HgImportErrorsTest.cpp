@@ -26,6 +26,7 @@
 #include "eden/fs/store/MemoryLocalStore.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/fs/store/hg/HgBackingStore.h"
+#include "eden/fs/store/hg/HgImportPyError.h"
 #include "eden/fs/store/hg/HgImporter.h"
 #include "eden/fs/testharness/TestUtil.h"
 
@@ -133,6 +134,27 @@ class HgImportErrorTest : public ::testing::Test {
   void triggerManifestError(Hash rev, StringPiece error) {
     triggerError(folly::to<string>("error.manifest.", rev.toString()), error);
   }
+  void triggerTreeError(
+      StringPiece path,
+      Hash manifestNode,
+      StringPiece error) {
+    auto key = folly::to<string>(
+        "error.tree.", path, ":", manifestNode.toString());
+    for (char& c : key) {
+      if (c == '/') {
+        c = '_';
+      }
+    }
+    triggerError(key, error);
+  }
+
+  std::vector<folly::Try<folly::Unit>> fetchTestTrees() {
+    return importer_->fetchTrees({
+        {RelativePath{"foo/good"}, makeTestHash("1")},
+        {RelativePath{"foo/bad"}, makeTestHash("2")},
+        {RelativePath{"foo/good"}, makeTestHash("3")},
+    });
+  }
 
   AbsolutePath findFakeImportHelperPath();
 
@@ -320,3 +342,46 @@ TEST_F(HgImportErrorTest, testBlobImportManagerPersistentCrash) {
   testBlobError<HgImporterManager>(
       "bad_txn", "received unexpected transaction ID"_sp);
 }
+
+TEST_F(HgImportErrorTest, fetchTreesFailsOnlyTheBadTree) {
+  createStore<HgImporter>();
+  triggerTreeError("foo/bad", makeTestHash("2"), "key_error");
+
+  // HgImporter reports the error from the import helper for the one tree
+  // that it could not fetch, and does not retry it.
+  auto results = fetchTestTrees();
+  ASSERT_EQ(3, results.size());
+  EXPECT_TRUE(results[0].hasValue());
+  ASSERT_TRUE(results[1].hasException());
+  auto* error = results[1].exception().get_exception<HgImportPyError>();
+  ASSERT_TRUE(error);
+  EXPECT_EQ("KeyError", error->errorType());
+  EXPECT_TRUE(results[2].hasValue());
+}
+
+TEST_F(HgImportErrorTest, fetchTreesManagerRetriesTheBadTree) {
+  // The batched request consumes the error, so fetching the bad tree on its
+  // own succeeds.
+  createStore<HgImporterManager>();
+  triggerTreeError("foo/bad", makeTestHash("2"), "key_error_once");
+  auto results = fetchTestTrees();
+  ASSERT_EQ(3, results.size());
+  for (const auto& result : results) {
+    EXPECT_TRUE(result.hasValue());
+  }
+}
+
+TEST_F(HgImportErrorTest, fetchTreesManagerPersistentError) {
+  // A tree that still cannot be fetched on its own fails with the error from
+  // its last attempt, while the other trees still succeed.
+  createStore<HgImporterManager>();
+  triggerTreeError("foo/bad", makeTestHash("2"), "key_error");
+  auto results = fetchTestTrees();
+  ASSERT_EQ(3, results.size());
+  EXPECT_TRUE(results[0].hasValue());
+  ASSERT_TRUE(results[1].hasException());
+  auto* error = results[1].exception().get_exception<HgImportPyError>();
+  ASSERT_TRUE(error);
+  EXPECT_EQ("ResetRepoError", error->errorType());
+  EXPECT_TRUE(results[2].hasValue());
+}
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Conv.h>
+#include <folly/init/Init.h>
+#include <folly/io/IOBuf.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/store/MemoryLocalStore.h"
+#include "eden/fs/store/hg/HgManifestImportPipeline.h"
+
+using namespace facebook::eden;
+
+DEFINE_uint64(directories, 10000, "Number of directories in the manifest");
+DEFINE_uint64(files_per_directory, 100, "Number of files in each directory");
+DEFINE_uint64(chunk_entries, 10000, "Manifest entries per response chunk");
+DEFINE_uint64(max_threads, 8, "Largest parse thread count to time");
+DEFINE_uint64(max_pending_chunks, 16, "Chunks in flight at once");
+
+namespace {
+
+/** Zero-pad numbers so that the generated paths are in sorted order. */
+std::string padded(uint64_t n) {
+  auto str = folly::to<std::string>(n);
+  return std::string(str.size() < 8 ? 8 - str.size() : 0, '0') + str;
+}
+
+/**
+ * Build manifest response chunks in the format sent by hg_import_helper.py:
+ * <20-byte file rev hash>\t<flag>\t<path>\0, with the flag omitted for
+ * regular files.
+ */
+std::vector<std::string> makeManifest() {
+  std::vector<std::string> chunks;
+  std::string chunk;
+  uint64_t entries = 0;
+  for (uint64_t dir = 0; dir < FLAGS_directories; ++dir) {
+    auto dirName =
+        folly::to<std::string>("top", padded(dir / 100), "/dir", padded(dir));
+    for (uint64_t file = 0; file < FLAGS_files_per_directory; ++file) {
+      auto revHash = Hash::sha1(folly::to<std::string>(dir, ":", file));
+      auto bytes = revHash.getBytes();
+      chunk.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+      chunk.append(file % 10 == 0 ? "\tx\t" : "\t\t");
+      chunk.append(folly::to<std::string>(dirName, "/file", padded(file)));
+      chunk.push_back('\0');
+      if (++entries % FLAGS_chunk_entries == 0) {
+        chunks.push_back(std::move(chunk));
+        chunk.clear();
+      }
+    }
+  }
+  if (!chunk.empty()) {
+    chunks.push_back(std::move(chunk));
+  }
+  return chunks;
+}
+
+void timeImport(const std::vector<std::string>& chunks, size_t threads) {
+  MemoryLocalStore store;
+  folly::stop_watch<> timer;
+  HgManifestImportPipeline pipeline(
+      &store, threads, FLAGS_max_pending_chunks, 0);
+  for (const auto& chunk : chunks) {
+    pipeline.addChunk(folly::IOBuf::copyBuffer(chunk));
+  }
+  auto rootHash = pipeline.finish();
+  printf(
+      "%2zu parse threads: %8.1f ms (root %s)\n",
+      threads,
+      std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+          timer.elapsed())
+          .count(),
+      rootHash.toString().c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  auto chunks = makeManifest();
+  printf(
+      "Manifest has %" PRIu64 " files in %zu chunks\n",
+      FLAGS_directories * FLAGS_files_per_directory,
+      chunks.size());
+  for (size_t threads = 0; threads <= FLAGS_max_threads;
+       threads = threads ? threads * 2 : 1) {
+    timeImport(chunks, threads);
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/hg/HgManifestImportPipeline.h"
+
+#include <folly/Conv.h>
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/model/Tree.h"
+#include "eden/fs/store/MemoryLocalStore.h"
+
+using namespace facebook::eden;
+using folly::StringPiece;
+
+namespace {
+std::string manifestEntry(StringPiece path, StringPiece flag = "") {
+  auto revHash = Hash::sha1(path);
+  auto bytes = revHash.getBytes();
+  return folly::to<std::string>(
+      StringPiece{bytes}, "\t", flag, flag.empty() ? "" : "\t", path, '\0');
+}
+
+const std::vector<std::string> kManifest = {
+    manifestEntry("README"),
+    manifestEntry("src/a.cpp"),
+    manifestEntry("src/b.cpp"),
+    manifestEntry("src/deep/dir/c.cpp"),
+    manifestEntry("src/deep/run.sh", "x"),
+    manifestEntry("src/link", "l"),
+    manifestEntry("tests/a_test.cpp"),
+    manifestEntry("zzz"),
+};
+
+Hash import(
+    LocalStore* store,
+    size_t parseThreads,
+    size_t entriesPerChunk,
+    const std::vector<std::string>& manifest = kManifest) {
+  HgManifestImportPipeline pipeline(store, parseThreads, 2, 0);
+  std::string chunk;
+  for (size_t i = 0; i < manifest.size(); ++i) {
+    chunk += manifest[i];
+    if ((i + 1) % entriesPerChunk == 0 || i + 1 == manifest.size()) {
+      pipeline.addChunk(folly::IOBuf::copyBuffer(chunk));
+      chunk.clear();
+    }
+  }
+  auto rootHash = pipeline.finish();
+  EXPECT_EQ(manifest.size(), pipeline.getNumPaths());
+  return rootHash;
+}
+} // namespace
+
+TEST(HgManifestImportPipeline, parallelImportMatchesSerialImport) {
+  MemoryLocalStore serialStore;
+  auto serialRoot = import(&serialStore, 0, 100);
+
+  MemoryLocalStore parallelStore;
+  EXPECT_EQ(serialRoot, import(&parallelStore, 4, 1));
+  EXPECT_EQ(serialRoot, import(&parallelStore, 2, 3));
+
+  auto root = parallelStore.getTree(serialRoot).get();
+  ASSERT_TRUE(root);
+  ASSERT_EQ(4, root->getTreeEntries().size());
+  EXPECT_EQ("README", root->getTreeEntries()[0].getName().stringPiece());
+  EXPECT_EQ("src", root->getTreeEntries()[1].getName().stringPiece());
+  EXPECT_EQ(TreeEntryType::TREE, root->getTreeEntries()[1].getType());
+  auto src = parallelStore.getTree(root->getTreeEntries()[1].getHash()).get();
+  ASSERT_TRUE(src);
+  EXPECT_EQ(4, src->getTreeEntries().size());
+}
+
+TEST(HgManifestImportPipeline, parseErrorIsReported) {
+  auto manifest = kManifest;
+  manifest[3] = manifestEntry("src/deep/dir/c.cpp", "q");
+  for (size_t threads : {0, 4}) {
+    MemoryLocalStore store;
+    EXPECT_THROW(import(&store, threads, 1, manifest), std::runtime_error)
+        << threads << " parse threads";
+  }
+}
@@ -0,0 +1,172 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/hg/HgProxyHash.h"
+
+#include <folly/futures/Future.h>
+#include <gtest/gtest.h>
+
+#include "eden/fs/store/MemoryLocalStore.h"
+#include "eden/fs/store/hg/HgProxyHashCache.h"
+
+using namespace facebook::eden;
+using folly::StringPiece;
+
+namespace {
+Hash makeHash(uint8_t firstByte, uint8_t lastByte) {
+  Hash::Storage bytes{};
+  bytes.front() = firstByte;
+  bytes.back() = lastByte;
+  return Hash{bytes};
+}
+
+std::string lookup(HgProxyHashCache& cache, const Hash& hash) {
+  std::string value;
+  EXPECT_TRUE(cache.lookup(hash, value));
+  return value;
+}
+
+struct HgProxyHashTest : ::testing::Test {
+  void SetUp() override {
+    HgProxyHashCache::get().clear();
+  }
+  void TearDown() override {
+    HgProxyHashCache::get().clear();
+  }
+
+  Hash store(RelativePathPiece path, Hash revHash) {
+    auto batch = localStore.beginWrite();
+    auto hash = HgProxyHash::store(path, revHash, batch.get());
+    batch->flush();
+    return hash;
+  }
+
+  MemoryLocalStore localStore;
+};
+} // namespace
+
+TEST(HgProxyHashCache, insertAndLookup) {
+  HgProxyHashCache cache{1024 * 1024};
+  auto a = makeHash(1, 1);
+  auto b = makeHash(2, 2);
+  cache.insert(a, StringPiece{"aaaa"});
+  cache.insert(b, StringPiece{"b"});
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ("aaaa", lookup(cache, a));
+  EXPECT_EQ("b", lookup(cache, b));
+
+  std::string value{"unchanged"};
+  EXPECT_FALSE(cache.lookup(makeHash(3, 3), value));
+  EXPECT_EQ("unchanged", value);
+}
+
+TEST(HgProxyHashCache, fullShardEvictsOldestEntry) {
+  // 16 shards of 256 bytes each; the entries below all land in shard 0, and
+  // two of them fit in it.
+  HgProxyHashCache cache{16 * 256};
+  std::string value(100, 'x');
+  cache.insert(makeHash(0, 1), StringPiece{value});
+  cache.insert(makeHash(0, 2), StringPiece{value});
+  EXPECT_EQ(2, cache.size());
+  cache.insert(makeHash(0, 3), StringPiece{value});
+  EXPECT_EQ(2, cache.size());
+
+  std::string unused;
+  EXPECT_FALSE(cache.lookup(makeHash(0, 1), unused));
+  EXPECT_EQ(value, lookup(cache, makeHash(0, 2)));
+  EXPECT_EQ(value, lookup(cache, makeHash(0, 3)));
+
+  // Values that could never fit are not cached at all.
+  cache.insert(makeHash(0, 4), StringPiece{std::string(300, 'y')});
+  EXPECT_EQ(2, cache.size());
+}
+
+TEST(HgProxyHashCache, lookedUpEntriesGetASecondChance) {
+  HgProxyHashCache cache{16 * 256};
+  std::string a(100, 'a');
+  std::string b(100, 'b');
+  std::string c(100, 'c');
+  std::string d(100, 'd');
+  cache.insert(makeHash(0, 1), StringPiece{a});
+  cache.insert(makeHash(0, 2), StringPiece{b});
+  EXPECT_EQ(a, lookup(cache, makeHash(0, 1)));
+
+  // a is older, but it was used since it was inserted, so b goes first.
+  cache.insert(makeHash(0, 3), StringPiece{c});
+  std::string unused;
+  EXPECT_FALSE(cache.lookup(makeHash(0, 2), unused));
+  EXPECT_EQ(a, lookup(cache, makeHash(0, 1)));
+  EXPECT_EQ(c, lookup(cache, makeHash(0, 3)));
+
+  // Both are now referenced, so each gets its second chance and then the
+  // oldest of them is evicted.
+  cache.insert(makeHash(0, 4), StringPiece{d});
+  EXPECT_EQ(2, cache.size());
+  EXPECT_FALSE(cache.lookup(makeHash(0, 1), unused));
+  EXPECT_EQ(c, lookup(cache, makeHash(0, 3)));
+  EXPECT_EQ(d, lookup(cache, makeHash(0, 4)));
+}
+
+TEST(HgProxyHashCache, zeroSizeDisablesCache) {
+  HgProxyHashCache cache{0};
+  cache.insert(makeHash(1, 1), StringPiece{"a"});
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST_F(HgProxyHashTest, storePopulatesCache) {
+  auto revHash = makeHash(7, 7);
+  auto hash = store(RelativePathPiece{"foo/bar.txt"}, revHash);
+  EXPECT_EQ(1, HgProxyHashCache::get().size());
+
+  HgProxyHash proxyHash{&localStore, hash, "test"};
+  EXPECT_EQ(RelativePathPiece{"foo/bar.txt"}, proxyHash.path());
+  EXPECT_EQ(revHash, proxyHash.revHash());
+}
+
+TEST_F(HgProxyHashTest, storeCachesOnlyAfterFlush) {
+  auto batch = localStore.beginWrite();
+  auto hash =
+      HgProxyHash::store(RelativePathPiece{"foo"}, makeHash(7, 7), batch.get());
+  EXPECT_EQ(0, HgProxyHashCache::get().size());
+
+  batch->flush();
+  EXPECT_EQ(1, HgProxyHashCache::get().size());
+  EXPECT_TRUE(localStore.hasKey(LocalStore::HgProxyHashFamily, hash));
+}
+
+TEST_F(HgProxyHashTest, lookupFallsBackToLocalStore) {
+  auto revHash = makeHash(7, 7);
+  auto hash = store(RelativePathPiece{"foo/bar.txt"}, revHash);
+  HgProxyHashCache::get().clear();
+
+  HgProxyHash proxyHash{&localStore, hash, "test"};
+  EXPECT_EQ(RelativePathPiece{"foo/bar.txt"}, proxyHash.path());
+  EXPECT_EQ(revHash, proxyHash.revHash());
+  EXPECT_EQ(1, HgProxyHashCache::get().size());
+}
+
+TEST_F(HgProxyHashTest, getBatchMixesCachedAndStoredEntries) {
+  auto hashA = store(RelativePathPiece{"a"}, makeHash(1, 1));
+  HgProxyHashCache::get().clear();
+  auto hashB = store(RelativePathPiece{"b"}, makeHash(2, 2));
+
+  auto results =
+      HgProxyHash::getBatch(&localStore, {hashB, hashA, hashB}).get();
+  ASSERT_EQ(3, results.size());
+  EXPECT_EQ(RelativePath{"b"}, results[0].first);
+  EXPECT_EQ(makeHash(2, 2), results[0].second);
+  EXPECT_EQ(RelativePath{"a"}, results[1].first);
+  EXPECT_EQ(makeHash(1, 1), results[1].second);
+  EXPECT_EQ(RelativePath{"b"}, results[2].first);
+  EXPECT_EQ(2, HgProxyHashCache::get().size());
+}
+
+TEST_F(HgProxyHashTest, unknownHashThrows) {
+  EXPECT_ANY_THROW(HgProxyHash(&localStore, makeHash(9, 9), "test"));
+}
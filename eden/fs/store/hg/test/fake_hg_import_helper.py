@@ -37,6 +37,9 @@ class FakeHgServer(hg_import_helper.HgServer):
         # self.repo_path simply points to a directory with some test data for us to
         # load.
         self.repo = FakeRepo()
+        # Trees are "fetched" by _fetch_trees_impl() below rather than by the
+        # treemanifest extension.
+        self.treemanifest = object()
 
         data_path = os.path.join(self.repo_path, "data.json")
         with open(data_path, "r") as f:
@@ -54,8 +57,8 @@ class FakeHgServer(hg_import_helper.HgServer):
     def _gen_options(self):
         # We do not claim to support treemanifest, since treemanifest data
         # will be read directly by the C++ code rather than using our import helper
-        # script.
-        flags = 0
+        # script.  CMD_FETCH_TREES is answered by _fetch_trees_impl() below.
+        flags = hg_import_helper.START_FLAGS_FETCH_TREES_SUPPORTED
         treemanifest_paths = []
 
         # Options format:
@@ -78,9 +81,13 @@ class FakeHgServer(hg_import_helper.HgServer):
 
         return "".join(parts)
 
-    def fetch_tree(self, path, manifest_node):
-        # This should not be called since we disable treemanifest support
-        raise Exception("TODO")
+    def _fetch_trees_impl(self, path, mfnodes):
+        # Every tree can be fetched unless an error was triggered for it.
+        for node in sorted(mfnodes):
+            self._do_error("tree", "%s:%s" % (path, binascii.hexlify(node)))
+
+    def _commit_fetched_trees(self):
+        pass
 
     def dump_manifest(self, rev, request):
         """
@@ -140,6 +147,8 @@ class FakeHgServer(hg_import_helper.HgServer):
         if error_type == "exit":
             logging.error("triggering abnormal exit for test")
             os._exit(1)
+        elif error_type == "key_error":
+            raise KeyError("triggered error for %s" % (key,))
         elif error_type == "bad_txn":
             txn_id = 12345678
             self._send_chunk(
@@ -14,11 +14,16 @@
 #include <eden/fs/model/Tree.h>
 #include <folly/futures/Future.h>
 #include <folly/futures/Promise.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/io/async/EventBaseManager.h>
 #include <folly/io/async/SSLOptions.h>
 #include <folly/json.h>
+#include <gflags/gflags.h>
+#include <proxygen/lib/http/HTTPCommonHeaders.h>
 #include <proxygen/lib/http/HTTPConnector.h>
+#include <proxygen/lib/http/codec/HTTP2Constants.h>
 #include <proxygen/lib/http/session/HTTPUpstreamSession.h>
 #include <proxygen/lib/utils/URL.h>
 #include <servicerouter/client/cpp2/ServiceRouter.h>
@@ -35,36 +40,124 @@ using proxygen::HTTPTransaction;
 using proxygen::UpgradeProtocol;
 using proxygen::URL;
 
+DEFINE_bool(
+    mononoke_connection_pool,
+    true,
+    "Reuse persistent HTTP sessions for mononoke requests rather than "
+    "opening a new connection for each request");
+DEFINE_uint64(
+    mononoke_max_sessions_per_thread,
+    2,
+    "Maximum number of pooled mononoke sessions for each IO thread");
+DEFINE_uint64(
+    mononoke_max_requests_per_session,
+    100,
+    "Maximum number of concurrent requests on one HTTP/2 mononoke session");
+DEFINE_int32(
+    mononoke_session_idle_timeout_ms,
+    60000,
+    "Close pooled mononoke sessions that have been idle for this long");
+DEFINE_bool(
+    mononoke_http2,
+    true,
+    "Offer HTTP/2 when negotiating TLS connections to mononoke");
+DEFINE_bool(
+    mononoke_plaintext_http2,
+    false,
+    "Use HTTP/2 with prior knowledge on connections without TLS.  "
+    "Only intended for testing.");
+
 namespace facebook {
 namespace eden {
 namespace {
 
 using IOBufPromise = folly::Promise<std::unique_ptr<folly::IOBuf>>;
 
-// Callback that processes response for getblob request.
+// Batch requests POST a JSON array of hex hashes to /<repo>/blobs or
+// /<repo>/trees.  The response streams back each object that was found,
+// framed by its 20-byte binary hash and its length as a 64-bit big-endian
+// integer.
+constexpr size_t kBatchFrameHeaderSize = Hash::RAW_SIZE + sizeof(uint64_t);
+
+} // namespace
+
+// Base class for the handlers of a single request to mononoke.
 // Note: because this callback deletes itself, it must be allocated on the heap!
-class MononokeCallback : public proxygen::HTTPConnector::Callback,
-                         public proxygen::HTTPTransaction::Handler {
+class MononokeRequest : public proxygen::HTTPConnector::Callback,
+                        public proxygen::HTTPTransaction::Handler {
  public:
-  MononokeCallback(const proxygen::URL& url, IOBufPromise&& promise)
-      : promise_(std::move(promise)), url_(url) {}
+  /**
+   * Sends a GET request for url, or a POST request if requestBody is
+   * non-null.
+   */
+  MononokeRequest(
+      const proxygen::URL& url,
+      std::chrono::milliseconds timeout,
+      std::unique_ptr<folly::IOBuf> requestBody = nullptr)
+      : url_(url), timeout_(timeout), requestBody_(std::move(requestBody)) {}
+
+  ~MononokeRequest() override {
+    finished_.setValue();
+  }
 
-  virtual void connectSuccess(proxygen::HTTPUpstreamSession* session) override {
+  /**
+   * Returns a future that completes when this handler is destroyed and will
+   * no longer use the connection it was given.
+   */
+  folly::Future<folly::Unit> getFinishedFuture() {
+    return finished_.getFuture();
+  }
+
+  /**
+   * Send the request on session.  If the session cannot start a new
+   * transaction the request is failed and this callback is deleted.
+   */
+  bool startTransaction(proxygen::HTTPUpstreamSession* session) {
     auto txn = session->newTransaction(this);
+    if (!txn) {
+      fail(make_exception_wrapper<std::runtime_error>(folly::to<std::string>(
+          "mononoke request ",
+          url_.getUrl(),
+          " failed: unable to start transaction")));
+      return false;
+    }
+    txn->setIdleTimeout(timeout_);
     HTTPMessage message;
-    message.setMethod(proxygen::HTTPMethod::GET);
+    message.setMethod(
+        requestBody_ ? proxygen::HTTPMethod::POST : proxygen::HTTPMethod::GET);
     message.setURL(url_.makeRelativeURL());
     message.getHeaders().add("Host", url_.getHost());
-    txn->sendHeaders(message);
+    if (requestBody_) {
+      message.getHeaders().add(
+          proxygen::HTTP_HEADER_CONTENT_LENGTH,
+          folly::to<std::string>(requestBody_->computeChainDataLength()));
+      txn->sendHeaders(message);
+      txn->sendBody(std::move(requestBody_));
+    } else {
+      txn->sendHeaders(message);
+    }
     txn->sendEOM();
+    return true;
+  }
+
+  /**
+   * Fail the request before a transaction was started, and delete this
+   * callback.
+   */
+  void fail(folly::exception_wrapper ew) {
+    onFailure(std::move(ew));
+    delete this;
+  }
+
+  virtual void connectSuccess(proxygen::HTTPUpstreamSession* session) override {
+    startTransaction(session);
     session->closeWhenIdle();
   }
 
   void connectError(const folly::AsyncSocketException& ex) override {
     // handler won't be used anymore, should be safe to delete
-    promise_.setException(make_exception_wrapper<std::runtime_error>(
+    fail(make_exception_wrapper<std::runtime_error>(
         folly::to<std::string>("mononoke connection error: ", ex.what())));
-    delete this;
   }
 
   // We don't send anything back, so ignore this callback
@@ -72,28 +165,20 @@ class MononokeCallback : public proxygen::HTTPConnector::Callback,
 
   void detachTransaction() noexcept override {
     if (error_) {
-      promise_.setException(error_);
+      onFailure(error_);
+    } else if (isSuccessfulStatusCode()) {
+      onSuccess();
     } else {
-      if (body_ == nullptr) {
-        // Make sure we return empty buffer and not nullptr to the caller.
-        // It can happen if blob is empty.
-        body_ = folly::IOBuf::create(0);
-      }
-      if (isSuccessfulStatusCode()) {
-        promise_.setValue(std::move(body_));
-      } else {
-        auto error_msg = folly::to<std::string>(
-            "mononoke request ",
-            url_.getUrl(),
-            " failed: ",
-            status_code_->getStatusCode(),
-            " ",
-            status_code_->getStatusMessage(),
-            ". body size: ",
-            body_ ? body_->computeChainDataLength() : 0);
-        promise_.setException(
-            make_exception_wrapper<std::runtime_error>(error_msg));
-      }
+      auto error_msg = folly::to<std::string>(
+          "mononoke request ",
+          url_.getUrl(),
+          " failed: ",
+          status_code_->getStatusCode(),
+          " ",
+          status_code_->getStatusMessage(),
+          ". body size: ",
+          body_.chainLength());
+      onFailure(make_exception_wrapper<std::runtime_error>(error_msg));
     }
 
     /*
@@ -112,12 +197,9 @@ class MononokeCallback : public proxygen::HTTPConnector::Callback,
   }
 
   void onBody(std::unique_ptr<folly::IOBuf> chain) noexcept override {
-    if (!body_) {
-      body_.swap(chain);
-      last_ = body_->next();
-    } else {
-      last_->appendChain(std::move(chain));
-      last_ = last_->next();
+    body_.append(std::move(chain));
+    if (!error_ && isSuccessfulStatusCode()) {
+      onBodyAvailable();
     }
   }
 
@@ -146,23 +228,154 @@ class MononokeCallback : public proxygen::HTTPConnector::Callback,
 
   void onGoaway(ErrorCode /* code */) noexcept override {}
 
+ protected:
+  /** Called when the whole response has been received successfully. */
+  virtual void onSuccess() = 0;
+  virtual void onFailure(folly::exception_wrapper ew) = 0;
+  /**
+   * Called as successful response data arrives in body_.  Subclasses that
+   * process the response incrementally consume data from body_ here.
+   */
+  virtual void onBodyAvailable() {}
+
+  proxygen::URL url_;
+  folly::IOBufQueue body_{folly::IOBufQueue::cacheChainLength()};
+  folly::exception_wrapper error_{nullptr};
+
  private:
   bool isSuccessfulStatusCode() {
     // 2xx are successful status codes
-    return (status_code_->getStatusCode() / 100) == 2;
+    return status_code_ && (status_code_->getStatusCode() / 100) == 2;
   }
 
-  IOBufPromise promise_;
-  proxygen::URL url_;
-  Hash hash_;
-  std::string repo_;
+  std::chrono::milliseconds timeout_;
+  std::unique_ptr<folly::IOBuf> requestBody_;
   std::unique_ptr<HTTPMessage> status_code_;
-  std::unique_ptr<folly::IOBuf> body_{nullptr};
-  // Pointer to the last IOBuf in a chain
-  folly::IOBuf* last_{nullptr};
-  folly::exception_wrapper error_{nullptr};
+  folly::Promise<folly::Unit> finished_;
+};
+
+namespace {
+
+// Callback that processes the response for a single blob, tree or changeset.
+class MononokeCallback : public MononokeRequest {
+ public:
+  MononokeCallback(
+      const proxygen::URL& url,
+      std::chrono::milliseconds timeout,
+      IOBufPromise&& promise)
+      : MononokeRequest(url, timeout), promise_(std::move(promise)) {}
+
+ private:
+  void onSuccess() override {
+    // Make sure we return empty buffer and not nullptr to the caller.
+    // It can happen if blob is empty.
+    auto body = body_.empty() ? folly::IOBuf::create(0) : body_.move();
+    promise_.setValue(std::move(body));
+  }
+
+  void onFailure(folly::exception_wrapper ew) override {
+    promise_.setException(std::move(ew));
+  }
+
+  IOBufPromise promise_;
+};
+
+// Callback that splits a batch response into objects as they arrive.
+class MononokeBatchCallback : public MononokeRequest {
+ public:
+  using ObjectCallback =
+      folly::Function<void(const Hash&, std::unique_ptr<folly::IOBuf>)>;
+
+  MononokeBatchCallback(
+      const proxygen::URL& url,
+      std::chrono::milliseconds timeout,
+      std::unique_ptr<folly::IOBuf> requestBody,
+      ObjectCallback&& callback,
+      folly::Promise<folly::Unit>&& promise)
+      : MononokeRequest(url, timeout, std::move(requestBody)),
+        callback_(std::move(callback)),
+        promise_(std::move(promise)) {}
+
+ private:
+  void onBodyAvailable() override {
+    while (body_.chainLength() >= kBatchFrameHeaderSize) {
+      folly::io::Cursor cursor(body_.front());
+      Hash::Storage hashBytes;
+      cursor.pull(hashBytes.data(), hashBytes.size());
+      auto length = cursor.readBE<uint64_t>();
+      if (body_.chainLength() - kBatchFrameHeaderSize < length) {
+        // Wait for the rest of this object.
+        return;
+      }
+      body_.trimStart(kBatchFrameHeaderSize);
+      auto data = body_.split(length);
+      try {
+        callback_(Hash{hashBytes}, std::move(data));
+      } catch (const std::exception& ex) {
+        // Stop processing the response; the error is reported once the
+        // transaction completes.
+        error_ = folly::exception_wrapper{std::current_exception(), ex};
+        return;
+      }
+    }
+  }
+
+  void onSuccess() override {
+    if (!body_.empty()) {
+      promise_.setException(make_exception_wrapper<std::runtime_error>(
+          folly::to<std::string>(
+              "mononoke request ",
+              url_.getUrl(),
+              " returned a truncated object: ",
+              body_.chainLength(),
+              " trailing bytes")));
+      return;
+    }
+    promise_.setValue();
+  }
+
+  void onFailure(folly::exception_wrapper ew) override {
+    promise_.setException(std::move(ew));
+  }
+
+  ObjectCallback callback_;
+  folly::Promise<folly::Unit> promise_;
 };
 
+std::unique_ptr<folly::IOBuf> makeBatchRequestBody(
+    const std::vector<Hash>& ids) {
+  folly::dynamic hashes = folly::dynamic::array;
+  for (const auto& id : ids) {
+    hashes.push_back(id.toString());
+  }
+  return folly::IOBuf::copyBuffer(folly::toJson(hashes));
+}
+
+std::optional<MononokeSessionPool::Options> getPoolOptions(
+    std::chrono::milliseconds timeout) {
+  if (!FLAGS_mononoke_connection_pool) {
+    return std::nullopt;
+  }
+  MononokeSessionPool::Options options;
+  options.maxSessions = std::max<uint64_t>(
+      FLAGS_mononoke_max_sessions_per_thread, 1);
+  options.maxRequestsPerSession = std::max<uint64_t>(
+      FLAGS_mononoke_max_requests_per_session, 1);
+  options.connectTimeout = timeout;
+  options.idleTimeout =
+      std::chrono::milliseconds(FLAGS_mononoke_session_idle_timeout_ms);
+  if (FLAGS_mononoke_plaintext_http2) {
+    options.plaintextProtocol = proxygen::http2::kProtocolCleartextString;
+  }
+  return options;
+}
+
+void advertiseHttp2(const std::shared_ptr<folly::SSLContext>& sslContext) {
+  if (sslContext && FLAGS_mononoke_http2) {
+    sslContext->setAdvertisedNextProtocols({"h2", "http/1.1"});
+  }
+}
+
 std::unique_ptr<Tree> convertBufToTree(
     std::unique_ptr<folly::IOBuf>&& buf,
     const Hash& id) {
@@ -223,7 +436,10 @@ MononokeBackingStore::MononokeBackingStore(
       repo_(repo),
       timeout_(timeout),
       executor_(executor),
-      sslContext_(sslContext) {}
+      sslContext_(sslContext),
+      poolOptions_(getPoolOptions(timeout)) {
+  advertiseHttp2(sslContext_);
+}
 
 MononokeBackingStore::MononokeBackingStore(
     folly::StringPiece tierName,
@@ -237,10 +453,26 @@ MononokeBackingStore::MononokeBackingStore(
       repo_(repo),
       timeout_(timeout),
       executor_(executor),
-      sslContext_(sslContext) {}
+      sslContext_(sslContext),
+      poolOptions_(getPoolOptions(timeout)) {
+  advertiseHttp2(sslContext_);
+}
 
 MononokeBackingStore::~MononokeBackingStore() {}
 
+MononokeSessionPool& MononokeBackingStore::getSessionPool(
+    folly::EventBase* eventBase) {
+  DCHECK(eventBase->isInEventBaseThread());
+  auto* pool = sessionPools_.get(*eventBase);
+  if (!pool) {
+    // The pool copies everything it needs from this store, since it may be
+    // destroyed after the store is.
+    pool = &sessionPools_.emplace(
+        *eventBase, eventBase, hostName_, sslContext_, poolOptions_.value());
+  }
+  return *pool;
+}
+
 folly::Future<std::unique_ptr<Tree>> MononokeBackingStore::getTree(
     const Hash& id) {
   return folly::via(executor_)
@@ -273,6 +505,36 @@ folly::Future<std::unique_ptr<Tree>> MononokeBackingStore::getTreeForCommit(
       });
 }
 
+folly::Future<folly::Unit> MononokeBackingStore::getBlobBatch(
+    const std::vector<Hash>& ids,
+    BlobCallback callback) {
+  return folly::via(executor_).thenValue(
+      [this, ids, callback = std::move(callback)](auto&&) mutable {
+        return sendBatchRequest(
+            "blobs",
+            ids,
+            [callback = std::move(callback)](
+                const Hash& id, std::unique_ptr<folly::IOBuf> buf) mutable {
+              callback(std::make_unique<Blob>(id, std::move(*buf)));
+            });
+      });
+}
+
+folly::Future<folly::Unit> MononokeBackingStore::getTreeBatch(
+    const std::vector<Hash>& ids,
+    TreeCallback callback) {
+  return folly::via(executor_).thenValue(
+      [this, ids, callback = std::move(callback)](auto&&) mutable {
+        return sendBatchRequest(
+            "trees",
+            ids,
+            [callback = std::move(callback)](
+                const Hash& id, std::unique_ptr<folly::IOBuf> buf) mutable {
+              callback(convertBufToTree(std::move(buf), id));
+            });
+      });
+}
+
 folly::Future<folly::SocketAddress> MononokeBackingStore::getAddress(
     folly::EventBase* eventBase) {
   if (socketAddress_.has_value()) {
@@ -324,19 +586,67 @@ folly::Future<std::unique_ptr<IOBuf>> MononokeBackingStore::sendRequestImpl(
     folly::SocketAddress addr,
     folly::StringPiece endpoint,
     const Hash& id) {
-  URL url(folly::sformat(
-      "https://{}:{}/{}/{}/{}",
-      hostName_,
-      addr.getPort(),
-      repo_,
-      endpoint,
-      id.toString()));
-
-  auto eventBase = folly::EventBaseManager::get()->getEventBase();
+  auto url =
+      makeURL(addr, folly::to<std::string>(endpoint, "/", id.toString()));
   IOBufPromise promise;
   auto future = promise.getFuture();
   // MononokeCallback deletes itself - see detachTransaction() method
-  MononokeCallback* callback = new MononokeCallback(url, std::move(promise));
+  startRequest(addr, new MononokeCallback(url, timeout_, std::move(promise)));
+  return future;
+}
+
+folly::Future<folly::Unit> MononokeBackingStore::sendBatchRequest(
+    folly::StringPiece endpoint,
+    const std::vector<Hash>& ids,
+    ObjectCallback callback) {
+  if (ids.empty()) {
+    return folly::unit;
+  }
+  auto eventBase = folly::EventBaseManager::get()->getEventBase();
+
+  return getAddress(eventBase).thenValue(
+      [this,
+       endpoint = endpoint.str(),
+       body = makeBatchRequestBody(ids),
+       callback = std::move(callback)](folly::SocketAddress addr) mutable {
+        folly::Promise<folly::Unit> promise;
+        auto future = promise.getFuture();
+        // MononokeBatchCallback deletes itself - see detachTransaction()
+        startRequest(
+            addr,
+            new MononokeBatchCallback(
+                makeURL(addr, endpoint),
+                timeout_,
+                std::move(body),
+                std::move(callback),
+                std::move(promise)));
+        return future;
+      });
+}
+
+proxygen::URL MononokeBackingStore::makeURL(
+    const folly::SocketAddress& addr,
+    folly::StringPiece path) const {
+  return URL(folly::sformat(
+      "https://{}:{}/{}/{}", hostName_, addr.getPort(), repo_, path));
+}
+
+void MononokeBackingStore::startRequest(
+    const folly::SocketAddress& addr,
+    MononokeRequest* request) {
+  auto eventBase = folly::EventBaseManager::get()->getEventBase();
+  if (poolOptions_.has_value()) {
+    getSessionPool(eventBase).getSession(
+        addr, [request](folly::Try<proxygen::HTTPUpstreamSession*> session) {
+          if (session.hasException()) {
+            request->fail(std::move(session.exception()));
+          } else {
+            request->startTransaction(session.value());
+          }
+        });
+    return;
+  }
+
   // It is moved into the .then() lambda below and destroyed there
   folly::HHWheelTimer::UniquePtr timer{folly::HHWheelTimer::newTimer(
       eventBase,
@@ -346,7 +656,7 @@ folly::Future<std::unique_ptr<IOBuf>> MononokeBackingStore::sendRequestImpl(
 
   // It is moved into the .then() lambda below and deleted there
   auto connector =
-      std::make_unique<proxygen::HTTPConnector>(callback, timer.get());
+      std::make_unique<proxygen::HTTPConnector>(request, timer.get());
 
   const folly::AsyncSocket::OptionMap opts{{{SOL_SOCKET, SO_REUSEADDR}, 1}};
 
@@ -366,9 +676,8 @@ folly::Future<std::unique_ptr<IOBuf>> MononokeBackingStore::sendRequestImpl(
 
   /* capture `connector` to make sure it stays alive for the duration of the
      connection */
-  return std::move(future).thenValue(
-      [connector = std::move(connector), timer = std::move(timer)](
-          std::unique_ptr<folly::IOBuf>&& buf) { return std::move(buf); });
+  (void)request->getFinishedFuture().thenValue(
+      [connector = std::move(connector), timer = std::move(timer)](auto&&) {});
 }
 
 } // namespace eden
@@ -12,12 +12,16 @@
 #include "eden/fs/store/BackingStore.h"
 
 #include <folly/Range.h>
+#include <folly/Function.h>
 #include <folly/SocketAddress.h>
-#include <folly/Synchronized.h>
 #include <folly/futures/Future.h>
 #include <folly/io/async/EventBase.h>
+#include <folly/io/async/EventBaseLocal.h>
 #include <folly/io/async/SSLOptions.h>
 #include <optional>
+#include <vector>
+
+#include "eden/fs/store/mononoke/MononokeSessionPool.h"
 
 namespace folly {
 class IOBuf;
@@ -33,6 +37,7 @@ namespace eden {
 
 class Blob;
 class Hash;
+class MononokeRequest;
 class Tree;
 
 /**
@@ -64,6 +69,31 @@ class MononokeBackingStore : public BackingStore {
   virtual folly::Future<std::unique_ptr<Tree>> getTreeForCommit(
       const Hash& commitID) override;
 
+  using BlobCallback = folly::Function<void(std::unique_ptr<Blob>)>;
+  using TreeCallback = folly::Function<void(std::unique_ptr<Tree>)>;
+
+  /**
+   * Fetch several blobs with a single request.
+   *
+   * The server streams the blobs back, and callback is invoked with each one
+   * as soon as it has been received.  Calls to callback are made one at a
+   * time on an IO thread.  IDs that the server does not know about are left
+   * out of the response, so callback may be invoked fewer than ids.size()
+   * times.  The returned future completes once the whole response has been
+   * received, or with an error if the request failed or callback threw.
+   */
+  folly::Future<folly::Unit> getBlobBatch(
+      const std::vector<Hash>& ids,
+      BlobCallback callback);
+
+  /**
+   * Fetch several trees with a single request.  This behaves like
+   * getBlobBatch().
+   */
+  folly::Future<folly::Unit> getTreeBatch(
+      const std::vector<Hash>& ids,
+      TreeCallback callback);
+
  private:
   // Forbidden copy constructor and assignment operator
   MononokeBackingStore(MononokeBackingStore const&) = delete;
@@ -78,6 +108,35 @@ class MononokeBackingStore : public BackingStore {
       folly::StringPiece endpoint,
       const Hash& id);
 
+  using ObjectCallback =
+      folly::Function<void(const Hash&, std::unique_ptr<folly::IOBuf>)>;
+
+  /**
+   * POST ids to endpoint, and call callback with each object in the
+   * streamed response.
+   */
+  folly::Future<folly::Unit> sendBatchRequest(
+      folly::StringPiece endpoint,
+      const std::vector<Hash>& ids,
+      ObjectCallback callback);
+
+  proxygen::URL makeURL(
+      const folly::SocketAddress& addr,
+      folly::StringPiece path) const;
+
+  /**
+   * Send request to addr on the current thread's EventBase, using a pooled
+   * session if pooling is enabled.  request deletes itself once the request
+   * is complete.
+   */
+  void startRequest(const folly::SocketAddress& addr, MononokeRequest* request);
+
+  /**
+   * Get the session pool for eventBase, which must be the current thread's
+   * EventBase.
+   */
+  MononokeSessionPool& getSessionPool(folly::EventBase* eventBase);
+
   std::optional<folly::SocketAddress> socketAddress_;
   std::string hostName_;
   std::string tierName_;
@@ -85,6 +144,18 @@ class MononokeBackingStore : public BackingStore {
   std::chrono::milliseconds timeout_;
   folly::Executor* executor_;
   std::shared_ptr<folly::SSLContext> sslContext_ = nullptr;
+
+  /**
+   * Persistent sessions to the server, with one pool for each EventBase
+   * that has sent requests.  If poolOptions_ is unset every request opens
+   * its own connection instead.
+   *
+   * Each pool lives in its EventBase's local storage, so it is destroyed on
+   * that EventBase's thread when either the EventBase or this store goes
+   * away, and a new EventBase never sees a pool left behind by an old one.
+   */
+  std::optional<MononokeSessionPool::Options> poolOptions_;
+  folly::EventBaseLocal<MononokeSessionPool> sessionPools_;
 };
 } // namespace eden
 } // namespace facebook
@@ -0,0 +1,248 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/mononoke/MononokeSessionPool.h"
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/SSLContext.h>
+#include <folly/logging/xlog.h>
+#include <proxygen/lib/http/HTTPConnector.h>
+#include <proxygen/lib/http/session/HTTPUpstreamSession.h>
+#include <algorithm>
+
+using folly::make_exception_wrapper;
+using proxygen::HTTPSessionBase;
+using proxygen::HTTPUpstreamSession;
+
+namespace facebook {
+namespace eden {
+
+class MononokeSessionPool::Connector
+    : public proxygen::HTTPConnector::Callback {
+ public:
+  Connector(MononokeSessionPool* pool, folly::HHWheelTimer* timer)
+      : pool_{pool}, connector_{this, timer} {}
+
+  void connect(const folly::SocketAddress& addr) {
+    const folly::AsyncSocket::OptionMap opts{{{SOL_SOCKET, SO_REUSEADDR}, 1}};
+    if (pool_->sslContext_ != nullptr) {
+      connector_.connectSSL(
+          pool_->eventBase_,
+          addr,
+          pool_->sslContext_,
+          nullptr,
+          pool_->options_.connectTimeout,
+          opts,
+          folly::AsyncSocket::anyAddress(),
+          pool_->hostName_);
+    } else {
+      if (!pool_->options_.plaintextProtocol.empty()) {
+        connector_.setPlaintextProtocol(pool_->options_.plaintextProtocol);
+      }
+      connector_.connect(
+          pool_->eventBase_, addr, pool_->options_.connectTimeout, opts);
+    }
+  }
+
+  void connectSuccess(HTTPUpstreamSession* session) override {
+    pool_->onConnected(this, session);
+  }
+
+  void connectError(const folly::AsyncSocketException& ex) override {
+    pool_->onConnectError(this, ex);
+  }
+
+ private:
+  MononokeSessionPool* pool_;
+  proxygen::HTTPConnector connector_;
+};
+
+MononokeSessionPool::MononokeSessionPool(
+    folly::EventBase* eventBase,
+    std::string hostName,
+    std::shared_ptr<folly::SSLContext> sslContext,
+    Options options)
+    : eventBase_{eventBase},
+      hostName_{std::move(hostName)},
+      sslContext_{std::move(sslContext)},
+      options_{std::move(options)},
+      timer_{folly::HHWheelTimer::newTimer(
+          eventBase_,
+          std::chrono::milliseconds(folly::HHWheelTimer::DEFAULT_TICK_INTERVAL),
+          folly::AsyncTimeout::InternalEnum::NORMAL,
+          options_.idleTimeout)} {}
+
+MononokeSessionPool::~MononokeSessionPool() {
+  DCHECK(eventBase_->isInEventBaseThread());
+  // Every session uses timer_ for its timeouts, so none of them may outlive
+  // the pool.  Drop them now, failing any requests still in flight, rather
+  // than waiting for them to become idle.
+  auto sessions = std::move(sessions_);
+  sessions_.clear();
+  sessions.insert(sessions.end(), draining_.begin(), draining_.end());
+  draining_.clear();
+  for (auto* session : sessions) {
+    session->setInfoCallback(nullptr);
+    session->dropConnection();
+  }
+  for (auto& waiter : waiters_) {
+    waiter(folly::Try<HTTPUpstreamSession*>(
+        make_exception_wrapper<std::runtime_error>(
+            "mononoke session pool destroyed")));
+  }
+}
+
+void MononokeSessionPool::getSession(
+    const folly::SocketAddress& addr,
+    SessionCallback callback) {
+  DCHECK(eventBase_->isInEventBaseThread());
+  lastAddress_ = addr;
+  if (waiters_.empty()) {
+    if (auto* session = findAvailableSession()) {
+      callback(folly::Try<HTTPUpstreamSession*>(session));
+      return;
+    }
+  }
+  waiters_.push_back(std::move(callback));
+  serviceWaiters();
+}
+
+HTTPUpstreamSession* MononokeSessionPool::findAvailableSession() const {
+  // Prefer the least loaded session, so that a slow request on one session
+  // does not hold up new requests.
+  HTTPUpstreamSession* best = nullptr;
+  for (auto* session : sessions_) {
+    if (!session->isReusable() || !session->supportsMoreTransactions() ||
+        session->getNumOutgoingStreams() >= options_.maxRequestsPerSession) {
+      continue;
+    }
+    if (!best ||
+        session->getNumOutgoingStreams() < best->getNumOutgoingStreams()) {
+      best = session;
+    }
+  }
+  return best;
+}
+
+void MononokeSessionPool::serviceWaiters() {
+  while (!waiters_.empty()) {
+    auto* session = findAvailableSession();
+    if (!session) {
+      break;
+    }
+    auto callback = std::move(waiters_.front());
+    waiters_.pop_front();
+    callback(folly::Try<HTTPUpstreamSession*>(session));
+  }
+
+  // Open another connection if callers are still waiting.  A single new
+  // connection can serve many waiters if it negotiates HTTP/2.
+  if (!waiters_.empty() && connecting_.empty() &&
+      sessions_.size() < options_.maxSessions) {
+    connect(lastAddress_);
+  }
+}
+
+void MononokeSessionPool::connect(const folly::SocketAddress& addr) {
+  XLOG(DBG3) << "opening new mononoke session to " << addr.describe();
+  connecting_.push_back(std::make_unique<Connector>(this, timer_.get()));
+  connecting_.back()->connect(addr);
+}
+
+std::unique_ptr<MononokeSessionPool::Connector>
+MononokeSessionPool::releaseConnector(Connector* connector) {
+  auto it = std::find_if(
+      connecting_.begin(), connecting_.end(), [connector](const auto& c) {
+        return c.get() == connector;
+      });
+  CHECK(it != connecting_.end());
+  auto result = std::move(*it);
+  connecting_.erase(it);
+  return result;
+}
+
+void MononokeSessionPool::onConnected(
+    Connector* connector,
+    HTTPUpstreamSession* session) {
+  // We are still inside the connector's callback, so destroy it once the
+  // callback has returned.
+  eventBase_->runInLoop(
+      [c = releaseConnector(connector)]() mutable { c.reset(); });
+
+  session->setInfoCallback(this);
+  sessions_.push_back(session);
+  serviceWaiters();
+}
+
+void MononokeSessionPool::onConnectError(
+    Connector* connector,
+    const folly::AsyncSocketException& ex) {
+  eventBase_->runInLoop(
+      [c = releaseConnector(connector)]() mutable { c.reset(); });
+
+  XLOG(DBG2) << "error connecting to mononoke: " << ex.what();
+  if (!sessions_.empty()) {
+    // The existing sessions will pick up the waiting requests as they free
+    // up.
+    return;
+  }
+  auto waiters = std::move(waiters_);
+  waiters_.clear();
+  for (auto& waiter : waiters) {
+    waiter(folly::Try<HTTPUpstreamSession*>(
+        make_exception_wrapper<std::runtime_error>(folly::to<std::string>(
+            "mononoke connection error: ", ex.what()))));
+  }
+}
+
+HTTPUpstreamSession* MononokeSessionPool::removeSession(
+    const HTTPSessionBase& session) {
+  auto it = std::find_if(
+      sessions_.begin(), sessions_.end(), [&session](const auto* s) {
+        return s == &session;
+      });
+  if (it == sessions_.end()) {
+    return nullptr;
+  }
+  auto* upstream = *it;
+  sessions_.erase(it);
+  return upstream;
+}
+
+void MononokeSessionPool::onIngressError(
+    const HTTPSessionBase& session,
+    proxygen::ProxygenError error) {
+  auto* upstream = removeSession(session);
+  if (!upstream) {
+    return;
+  }
+  XLOG(DBG2) << "dropping unhealthy mononoke session: "
+             << proxygen::getErrorString(error);
+  // Keep our InfoCallback, so that onDestroy() tells us when it is gone.
+  draining_.push_back(upstream);
+  upstream->closeWhenIdle();
+  serviceWaiters();
+}
+
+void MononokeSessionPool::onTransactionDetached(
+    const HTTPSessionBase& /* session */) {
+  serviceWaiters();
+}
+
+void MononokeSessionPool::onDestroy(const HTTPSessionBase& session) {
+  if (!removeSession(session)) {
+    draining_.erase(
+        std::remove(draining_.begin(), draining_.end(), &session),
+        draining_.end());
+  }
+  serviceWaiters();
+}
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,150 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/SocketAddress.h>
+#include <folly/Try.h>
+#include <folly/io/async/HHWheelTimer.h>
+#include <proxygen/lib/http/session/HTTPSessionBase.h>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace folly {
+class AsyncSocketException;
+class EventBase;
+class SSLContext;
+} // namespace folly
+
+namespace proxygen {
+class HTTPUpstreamSession;
+} // namespace proxygen
+
+namespace facebook {
+namespace eden {
+
+/**
+ * A pool of persistent HTTP sessions to Mononoke, used from a single
+ * EventBase thread.
+ *
+ * Requests are spread over at most maxSessions sessions.  An HTTP/2 session
+ * multiplexes up to maxRequestsPerSession concurrent requests, while an
+ * HTTP/1.1 session carries one request at a time.  When every session is at
+ * its limit, callers wait for a request to finish rather than opening more
+ * connections.
+ *
+ * A session leaves the pool when it is closed by either side, receives a
+ * GOAWAY, or reports an ingress error such as a read timeout; unhealthy
+ * sessions are closed once their outstanding requests finish.  proxygen
+ * closes sessions that have been idle for longer than idleTimeout.
+ * Destroying the pool drops all of its sessions, including unhealthy ones
+ * that are still finishing requests.
+ *
+ * All methods, including the destructor, must be called on the pool's
+ * EventBase thread.
+ */
+class MononokeSessionPool : private proxygen::HTTPSessionBase::InfoCallback {
+ public:
+  struct Options {
+    size_t maxSessions{2};
+    size_t maxRequestsPerSession{100};
+    std::chrono::milliseconds connectTimeout{2000};
+    std::chrono::milliseconds idleTimeout{60000};
+    /**
+     * The protocol to use for connections without TLS, such as "h2c" for
+     * HTTP/2 with prior knowledge.  The default is HTTP/1.1.  TLS
+     * connections negotiate their protocol with ALPN.
+     */
+    std::string plaintextProtocol;
+  };
+
+  /**
+   * Called with a session that can accept another transaction, or with the
+   * error that prevented connecting.  The callback runs on the pool's
+   * EventBase thread and must start its transaction before returning.
+   */
+  using SessionCallback =
+      folly::Function<void(folly::Try<proxygen::HTTPUpstreamSession*>)>;
+
+  MononokeSessionPool(
+      folly::EventBase* eventBase,
+      std::string hostName,
+      std::shared_ptr<folly::SSLContext> sslContext,
+      Options options);
+  ~MononokeSessionPool() override;
+
+  MononokeSessionPool(const MononokeSessionPool&) = delete;
+  MononokeSessionPool& operator=(const MononokeSessionPool&) = delete;
+
+  /**
+   * Call callback with a session from the pool, connecting to addr if a new
+   * session is needed.
+   */
+  void getSession(const folly::SocketAddress& addr, SessionCallback callback);
+
+  /** Returns the number of sessions currently in the pool. */
+  size_t getSessionCount() const {
+    return sessions_.size();
+  }
+
+ private:
+  class Connector;
+
+  proxygen::HTTPUpstreamSession* findAvailableSession() const;
+  void connect(const folly::SocketAddress& addr);
+  void onConnected(
+      Connector* connector,
+      proxygen::HTTPUpstreamSession* session);
+  void onConnectError(
+      Connector* connector,
+      const folly::AsyncSocketException& ex);
+  std::unique_ptr<Connector> releaseConnector(Connector* connector);
+
+  /** Hand available sessions to waiting callers, connecting if needed. */
+  void serviceWaiters();
+
+  /**
+   * Remove session from the pool.  Returns it, or nullptr if it was not in
+   * the pool.
+   */
+  proxygen::HTTPUpstreamSession* removeSession(
+      const proxygen::HTTPSessionBase& session);
+
+  // proxygen::HTTPSessionBase::InfoCallback
+  void onIngressError(
+      const proxygen::HTTPSessionBase& session,
+      proxygen::ProxygenError error) override;
+  void onTransactionDetached(const proxygen::HTTPSessionBase& session) override;
+  void onDestroy(const proxygen::HTTPSessionBase& session) override;
+
+  folly::EventBase* const eventBase_;
+  const std::string hostName_;
+  const std::shared_ptr<folly::SSLContext> sslContext_;
+  const Options options_;
+  /** Used by sessions for their idle timeout. */
+  folly::HHWheelTimer::UniquePtr timer_;
+
+  /** The address of the most recent connection attempt. */
+  folly::SocketAddress lastAddress_;
+  std::vector<proxygen::HTTPUpstreamSession*> sessions_;
+  /**
+   * Unhealthy sessions removed from sessions_ that are closing once their
+   * outstanding requests finish.
+   */
+  std::vector<proxygen::HTTPUpstreamSession*> draining_;
+  std::vector<std::unique_ptr<Connector>> connecting_;
+  std::deque<SessionCallback> waiters_;
+};
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,157 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/futures/Future.h>
+#include <folly/init/Init.h>
+#include <folly/io/async/EventBaseThread.h>
+#include <folly/stop_watch.h>
+#include <folly/synchronization/Baton.h>
+#include <gflags/gflags.h>
+#include <proxygen/httpserver/HTTPServer.h>
+#include <proxygen/httpserver/RequestHandler.h>
+#include <proxygen/httpserver/ResponseBuilder.h>
+#include <algorithm>
+
+#include "eden/fs/model/Blob.h"
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/store/mononoke/MononokeBackingStore.h"
+
+using namespace facebook::eden;
+using namespace proxygen;
+
+DECLARE_bool(mononoke_connection_pool);
+DECLARE_bool(mononoke_plaintext_http2);
+
+DEFINE_uint64(requests, 10000, "Number of blobs to fetch");
+DEFINE_uint64(concurrency, 64, "Number of requests in flight at once");
+DEFINE_uint64(blob_size, 4096, "Size of each blob returned by the server");
+DEFINE_bool(http2, true, "Serve HTTP/2 when the connection pool is used");
+
+namespace {
+
+/**
+ * Answers every request with a blob of FLAGS_blob_size bytes, standing in
+ * for a Mononoke server.
+ */
+class BlobHandler : public RequestHandler {
+ public:
+  void onRequest(std::unique_ptr<HTTPMessage> /* headers */) noexcept
+      override {}
+  void onBody(std::unique_ptr<folly::IOBuf> /* body */) noexcept override {}
+  void onEOM() noexcept override {
+    ResponseBuilder(downstream_)
+        .status(200, "OK")
+        .body(std::string(FLAGS_blob_size, 'x'))
+        .sendWithEOM();
+  }
+  void onUpgrade(UpgradeProtocol /* proto */) noexcept override {}
+  void requestComplete() noexcept override {
+    delete this;
+  }
+  void onError(ProxygenError /* err */) noexcept override {
+    delete this;
+  }
+};
+
+class BlobHandlerFactory : public RequestHandlerFactory {
+ public:
+  void onServerStart(folly::EventBase* /* evb */) noexcept override {}
+  void onServerStop() noexcept override {}
+  RequestHandler* onRequest(RequestHandler*, HTTPMessage*) noexcept override {
+    return new BlobHandler();
+  }
+};
+
+double toMillis(std::chrono::nanoseconds duration) {
+  return std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(
+             duration)
+      .count();
+}
+
+void fetchBlobs(
+    const char* name,
+    bool usePool,
+    const folly::SocketAddress& addr,
+    folly::EventBase* eventBase) {
+  FLAGS_mononoke_connection_pool = usePool;
+  FLAGS_mononoke_plaintext_http2 = usePool && FLAGS_http2;
+  MononokeBackingStore store(
+      "localhost",
+      addr,
+      "repo",
+      std::chrono::milliseconds(10000),
+      eventBase,
+      nullptr);
+
+  std::vector<std::chrono::nanoseconds> latencies;
+  latencies.reserve(FLAGS_requests);
+  folly::stop_watch<> total;
+  for (uint64_t start = 0; start < FLAGS_requests;
+       start += FLAGS_concurrency) {
+    auto count = std::min(FLAGS_concurrency, FLAGS_requests - start);
+    std::vector<folly::Future<std::chrono::nanoseconds>> futures;
+    futures.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+      folly::stop_watch<> timer;
+      futures.push_back(store.getBlob(kZeroHash).thenValue(
+          [timer](std::unique_ptr<Blob>&&) { return timer.elapsed(); }));
+    }
+    for (auto& latency : folly::collectAll(futures).get()) {
+      latencies.push_back(latency.value());
+    }
+  }
+  auto elapsed = total.elapsed();
+
+  std::sort(latencies.begin(), latencies.end());
+  printf(
+      "%-10s %10.0f requests/sec  p50 %.3f ms  p99 %.3f ms\n",
+      name,
+      latencies.size() / std::chrono::duration<double>(elapsed).count(),
+      toMillis(latencies[latencies.size() / 2]),
+      toMillis(latencies[latencies.size() * 99 / 100]));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  if (FLAGS_requests == 0 || FLAGS_concurrency == 0) {
+    fprintf(stderr, "--requests and --concurrency must be positive\n");
+    return 1;
+  }
+
+  HTTPServerOptions options;
+  options.threads = 1;
+  options.h2cEnabled = true;
+  options.handlerFactories =
+      RequestHandlerChain().addThen<BlobHandlerFactory>().build();
+  HTTPServer server{std::move(options)};
+  server.bind({
+      {folly::SocketAddress("::1", 0), HTTPServer::Protocol::HTTP},
+      {folly::SocketAddress("::1", 0), HTTPServer::Protocol::HTTP2},
+  });
+  folly::Baton<> started;
+  std::thread serverThread{
+      [&server, &started] { server.start([&started] { started.post(); }); }};
+  started.wait();
+  auto addresses = server.addresses();
+
+  folly::EventBaseThread clientThread;
+  fetchBlobs(
+      "per-request", false, addresses[0].address, clientThread.getEventBase());
+  fetchBlobs(
+      "pooled",
+      true,
+      addresses[FLAGS_http2 ? 1 : 0].address,
+      clientThread.getEventBase());
+
+  server.stop();
+  serverThread.join();
+  return 0;
+}
@@ -9,16 +9,22 @@
  */
 
 #include <boost/regex.hpp>
+#include <folly/Synchronized.h>
 #include <folly/experimental/TestUtil.h>
+#include <folly/io/IOBufQueue.h>
+#include <folly/json.h>
+#include <folly/lang/Bits.h>
 #include <folly/logging/Init.h>
 #include <folly/logging/xlog.h>
 #include <folly/test/TestUtils.h>
+#include <gflags/gflags.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <proxygen/httpserver/HTTPServer.h>
 #include <proxygen/httpserver/RequestHandler.h>
 #include <proxygen/httpserver/ResponseBuilder.h>
 #include <proxygen/lib/http/HTTPCommonHeaders.h>
+#include <set>
 
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Hash.h"
@@ -30,26 +36,33 @@ using namespace facebook::eden;
 using namespace proxygen;
 using folly::SocketAddress;
 
+DECLARE_bool(mononoke_connection_pool);
+
 using BlobContents = std::map<std::string, std::string>;
+using ClientAddresses = folly::Synchronized<std::set<SocketAddress>>;
 
 class Handler : public proxygen::RequestHandler {
  public:
-  explicit Handler(const BlobContents& blobs)
+  Handler(const BlobContents& blobs, ClientAddresses* clientAddresses)
       : regex_(
             "^(/repo/blob/(.*)|"
             "/repo/tree/(.*)|"
             "/repo/changeset/(.*))$"),
         path_(),
-        blobs_(blobs) {}
+        blobs_(blobs),
+        clientAddresses_(clientAddresses) {}
 
   ~Handler() {}
 
   void onRequest(
       std::unique_ptr<proxygen::HTTPMessage> headers) noexcept override {
     headers_ = std::move(headers);
+    clientAddresses_->wlock()->insert(headers_->getClientAddress());
   }
 
-  void onBody(std::unique_ptr<folly::IOBuf> /* body */) noexcept override {}
+  void onBody(std::unique_ptr<folly::IOBuf> body) noexcept override {
+    body_.append(std::move(body));
+  }
 
   void onEOM() noexcept override {
     if (headers_->getHeaders()
@@ -61,6 +74,12 @@ class Handler : public proxygen::RequestHandler {
           .sendWithEOM();
       return;
     }
+    if (headers_->getMethod() == proxygen::HTTPMethod::POST &&
+        (headers_->getPath() == "/repo/blobs" ||
+         headers_->getPath() == "/repo/trees")) {
+      sendBatch();
+      return;
+    }
     boost::cmatch m;
     auto match = boost::regex_match(headers_->getPath().c_str(), m, regex_);
     if (match) {
@@ -105,26 +124,54 @@ class Handler : public proxygen::RequestHandler {
   void onError(proxygen::ProxygenError /* err */) noexcept override {}
 
  private:
+  void sendBatch() {
+    auto request = body_.move();
+    auto hashes = folly::parseJson(request->moveToFbString());
+    ResponseBuilder(downstream_).status(200, "OK").send();
+    for (const auto& hash : hashes) {
+      auto it = blobs_.find(hash.asString());
+      if (it == blobs_.end()) {
+        continue;
+      }
+      std::string frame;
+      auto bytes = Hash(it->first).getBytes();
+      frame.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+      uint64_t length = folly::Endian::big<uint64_t>(it->second.size());
+      frame.append(reinterpret_cast<const char*>(&length), sizeof(length));
+      frame.append(it->second);
+      // Send the frame in small pieces so that objects are split across
+      // several onBody() callbacks on the client.
+      for (size_t i = 0; i < frame.size(); i += 3) {
+        ResponseBuilder(downstream_).body(frame.substr(i, 3)).send();
+      }
+    }
+    ResponseBuilder(downstream_).sendWithEOM();
+  }
+
   boost::regex regex_;
   std::string path_;
   BlobContents blobs_;
+  ClientAddresses* clientAddresses_;
   std::unique_ptr<HTTPMessage> headers_;
+  folly::IOBufQueue body_{folly::IOBufQueue::cacheChainLength()};
 };
 
 class HandlerFactory : public RequestHandlerFactory {
  public:
-  explicit HandlerFactory(const BlobContents& blobs) : blobs_(blobs) {}
+  HandlerFactory(const BlobContents& blobs, ClientAddresses* clientAddresses)
+      : blobs_(blobs), clientAddresses_(clientAddresses) {}
 
   void onServerStart(folly::EventBase* /*evb*/) noexcept override {}
 
   void onServerStop() noexcept override {}
 
   RequestHandler* onRequest(RequestHandler*, HTTPMessage*) noexcept override {
-    return new Handler(blobs_);
+    return new Handler(blobs_, clientAddresses_);
   }
 
  private:
   BlobContents blobs_;
+  ClientAddresses* clientAddresses_;
 };
 
 class MononokeBackingStoreTest : public ::testing::Test {
@@ -140,7 +187,9 @@ class MononokeBackingStoreTest : public ::testing::Test {
     HTTPServerOptions options;
     options.threads = 1;
     options.handlerFactories =
-        RequestHandlerChain().addThen<HandlerFactory>(blobs).build();
+        RequestHandlerChain()
+            .addThen<HandlerFactory>(blobs, &clientAddresses)
+            .build();
     auto server = folly::make_unique<HTTPServer>(std::move(options));
     server->bind(IPs);
 
@@ -186,6 +235,8 @@ class MononokeBackingStoreTest : public ::testing::Test {
   Hash malformedhash{"9999999999999999999999999999999999999999"};
   folly::EventBase mainEventBase;
   std::unique_ptr<std::thread> mainEventBaseThread;
+  /** The client address of every request received by the server. */
+  ClientAddresses clientAddresses;
 };
 
 TEST_F(MononokeBackingStoreTest, testGetBlob) {
@@ -352,3 +403,125 @@ TEST_F(MononokeBackingStoreTest, testGetTreeForCommit) {
     server->stop();
   });
 }
+
+TEST_F(MononokeBackingStoreTest, testRequestsReuseConnection) {
+  auto server = createServer();
+  auto blobs = getBlobs();
+  server->start([&server, &blobs, this]() {
+    MononokeBackingStore store(
+        "localhost",
+        server->addresses()[0].address,
+        "repo",
+        std::chrono::milliseconds(300),
+        &mainEventBase,
+        nullptr);
+    for (int i = 0; i < 5; ++i) {
+      auto blob = store.getBlob(kZeroHash).get();
+      EXPECT_EQ(
+          blobs[kZeroHash.toString()], blob->getContents().moveToFbString());
+    }
+    // Every request was sent over the same connection.
+    EXPECT_EQ(1, clientAddresses.rlock()->size());
+    server->stop();
+  });
+}
+
+TEST_F(MononokeBackingStoreTest, testConnectionPoolDisabled) {
+  gflags::FlagSaver flagSaver;
+  FLAGS_mononoke_connection_pool = false;
+  auto server = createServer();
+  server->start([&server, this]() {
+    MononokeBackingStore store(
+        "localhost",
+        server->addresses()[0].address,
+        "repo",
+        std::chrono::milliseconds(300),
+        &mainEventBase,
+        nullptr);
+    for (int i = 0; i < 5; ++i) {
+      store.getBlob(kZeroHash).get();
+    }
+    EXPECT_EQ(5, clientAddresses.rlock()->size());
+    server->stop();
+  });
+}
+
+TEST_F(MononokeBackingStoreTest, testGetBlobBatch) {
+  auto server = createServer();
+  auto blobs = getBlobs();
+  auto emptyhash = this->emptyhash;
+  server->start([&server, &blobs, emptyhash, this]() {
+    MononokeBackingStore store(
+        "localhost",
+        server->addresses()[0].address,
+        "repo",
+        std::chrono::milliseconds(300),
+        &mainEventBase,
+        nullptr);
+    std::map<Hash, std::string> received;
+    Hash unknownhash{"8888888888888888888888888888888888888888"};
+    store
+        .getBlobBatch(
+            {kZeroHash, unknownhash, emptyhash},
+            [&received](std::unique_ptr<Blob> blob) {
+              auto contents = blob->getContents();
+              received[blob->getHash()] =
+                  contents.moveToFbString().toStdString();
+            })
+        .get();
+    // The unknown hash is left out of the response.
+    ASSERT_EQ(2, received.size());
+    EXPECT_EQ(blobs[kZeroHash.toString()], received[kZeroHash]);
+    EXPECT_EQ("", received[emptyhash]);
+    server->stop();
+  });
+}
+
+TEST_F(MononokeBackingStoreTest, testGetTreeBatch) {
+  auto server = createServer();
+  auto treehash = this->treehash;
+  server->start([&server, treehash, this]() {
+    MononokeBackingStore store(
+        "localhost",
+        server->addresses()[0].address,
+        "repo",
+        std::chrono::milliseconds(300),
+        &mainEventBase,
+        nullptr);
+    std::vector<std::unique_ptr<Tree>> trees;
+    store
+        .getTreeBatch(
+            {treehash},
+            [&trees](std::unique_ptr<Tree> tree) {
+              trees.push_back(std::move(tree));
+            })
+        .get();
+    ASSERT_EQ(1, trees.size());
+    EXPECT_EQ(treehash, trees[0]->getHash());
+    EXPECT_EQ(5, trees[0]->getTreeEntries().size());
+    server->stop();
+  });
+}
+
+TEST_F(MononokeBackingStoreTest, testBatchCallbackErrorFailsRequest) {
+  auto server = createServer();
+  server->start([&server, this]() {
+    MononokeBackingStore store(
+        "localhost",
+        server->addresses()[0].address,
+        "repo",
+        std::chrono::milliseconds(300),
+        &mainEventBase,
+        nullptr);
+    EXPECT_THROW(
+        store
+            .getBlobBatch(
+                {kZeroHash},
+                [](std::unique_ptr<Blob>) {
+                  throw std::runtime_error("write failed");
+                })
+            .get(),
+        std::runtime_error);
+    server->stop();
+  });
+}
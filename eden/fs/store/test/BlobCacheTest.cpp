@@ -8,8 +8,10 @@
  *
  */
 #include "eden/fs/store/BlobCache.h"
+#include <folly/ThreadLocal.h>
 #include <gtest/gtest.h>
 #include "eden/fs/model/Blob.h"
+#include "eden/fs/store/StoreStats.h"
 
 using namespace folly::literals;
 using namespace facebook::eden;
@@ -29,6 +31,16 @@ const auto blob4 = std::make_shared<Blob>(hash4, "4444"_sp);
 const auto blob5 = std::make_shared<Blob>(hash5, "55555"_sp);
 const auto blob6 = std::make_shared<Blob>(hash6, "666666"_sp);
 const auto blob9 = std::make_shared<Blob>(hash9, "999999999"_sp);
+
+std::pair<int64_t, int64_t> getHitsAndMisses() {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  for (auto& stats : getStoreStats().accessAllThreads()) {
+    hits += stats.blobCacheHit.value();
+    misses += stats.blobCacheMiss.value();
+  }
+  return {hits, misses};
+}
 } // namespace
 
 TEST(BlobCache, evicts_oldest_on_insertion) {
@@ -230,3 +242,82 @@ TEST(BlobCache, interest_handle_can_return_blob_even_if_it_was_evicted) {
   EXPECT_EQ(blob4, handle4.getBlob());
   EXPECT_EQ(blob5, handle5.getBlob());
 }
+
+TEST(BlobCache, records_hits_and_misses) {
+  auto before = getHitsAndMisses();
+  auto cache = BlobCache::create(10, 0);
+  cache->insert(blob3);
+  EXPECT_EQ(blob3, cache->get(hash3).blob);
+  EXPECT_EQ(blob3, cache->get(hash3).blob);
+  EXPECT_EQ(nullptr, cache->get(hash4).blob);
+
+  auto after = getHitsAndMisses();
+  EXPECT_EQ(2, after.first - before.first);
+  EXPECT_EQ(1, after.second - before.second);
+}
+
+TEST(BlobCache, snapshot_lists_blobs_least_recently_used_first) {
+  auto cache = BlobCache::create(100, 0);
+  cache->insert(blob3);
+  cache->insert(blob4);
+  cache->insert(blob5);
+  cache->get(hash3);
+  auto snapshot = cache->getSnapshot();
+  ASSERT_EQ(3, snapshot.size());
+  EXPECT_EQ(blob4, snapshot[0]);
+  EXPECT_EQ(blob5, snapshot[1]);
+  EXPECT_EQ(blob3, snapshot[2]);
+}
+
+TEST(BlobCache, interest_handle_survives_move) {
+  auto cache = BlobCache::create(10, 0);
+  auto handle = cache->insert(blob3, BlobCache::Interest::WantHandle);
+  BlobInterestHandle moved{std::move(handle)};
+  EXPECT_EQ(blob3, moved.getBlob());
+  EXPECT_EQ(blob3, moved.getBlobNoWait());
+
+  BlobInterestHandle assigned;
+  assigned = std::move(moved);
+  EXPECT_EQ(blob3, assigned.getBlobNoWait());
+}
+
+TEST(BlobCache, get_blob_no_wait_moves_to_back_of_eviction_queue) {
+  auto cache = BlobCache::create(10, 0);
+  auto handle3 = cache->insert(
+      std::make_shared<Blob>(hash3, "333"_sp), BlobCache::Interest::WantHandle);
+  auto handle4 = cache->insert(
+      std::make_shared<Blob>(hash4, "444"_sp), BlobCache::Interest::WantHandle);
+
+  EXPECT_TRUE(handle3.getBlobNoWait());
+  cache->insert(blob5);
+  EXPECT_TRUE(handle3.getBlobNoWait());
+  EXPECT_EQ(nullptr, handle4.getBlobNoWait());
+}
+
+TEST(BlobCache, demoting_last_interest_keeps_blob_but_evicts_it_first) {
+  auto cache = BlobCache::create(10, 0);
+  auto handle3 = cache->insert(blob3, BlobCache::Interest::WantHandle);
+  auto handle4 = cache->insert(blob4, BlobCache::Interest::WantHandle);
+
+  handle4.demote();
+  EXPECT_FALSE(handle4.isValid());
+  EXPECT_EQ(7, cache->getTotalSize());
+  EXPECT_EQ(blob4, handle4.getBlobNoWait());
+
+  // blob4 was inserted last, but is now the first to be evicted.
+  cache->insert(blob5);
+  EXPECT_EQ(nullptr, cache->get(hash4).blob);
+  EXPECT_EQ(blob3, cache->get(hash3).blob);
+}
+
+TEST(BlobCache, demoting_one_of_several_interests_does_not_move_blob) {
+  auto cache = BlobCache::create(10, 0);
+  auto handle3 = cache->insert(blob3, BlobCache::Interest::WantHandle);
+  auto first = cache->insert(blob4, BlobCache::Interest::WantHandle);
+  auto second = cache->get(hash4, BlobCache::Interest::WantHandle);
+
+  first.demote();
+  cache->insert(blob5);
+  EXPECT_EQ(nullptr, cache->get(hash3).blob);
+  EXPECT_EQ(blob4, cache->get(hash4).blob);
+}
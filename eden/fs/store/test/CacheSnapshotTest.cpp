@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/CacheSnapshot.h"
+#include <folly/FileUtil.h>
+#include <folly/test/TestUtils.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include "eden/fs/model/Blob.h"
+
+using namespace folly::literals;
+using namespace facebook::eden;
+
+namespace {
+const auto hash1 = Hash{"0000000000000000000000000000000000000001"_sp};
+const auto hash2 = Hash{"0000000000000000000000000000000000000002"_sp};
+const auto sha1 = Hash{"1111111111111111111111111111111111111111"_sp};
+const auto sha2 = Hash{"2222222222222222222222222222222222222222"_sp};
+} // namespace
+
+TEST(CacheSnapshot, roundTrip) {
+  CacheSnapshot snapshot;
+  snapshot.blobs.push_back(std::make_shared<Blob>(hash1, "contents"_sp));
+  // Large enough to bypass the writer's buffer.
+  snapshot.blobs.push_back(
+      std::make_shared<Blob>(hash2, std::string(100000, 'x')));
+  snapshot.metadata["/mnt/one"] = {{hash1, BlobMetadata{sha1, 8}},
+                                   {hash2, BlobMetadata{sha2, 100000}}};
+  snapshot.metadata["/mnt/empty"] = {};
+
+  auto file = snapshot.write();
+  auto result = CacheSnapshot::read(file);
+
+  ASSERT_EQ(2, result.blobs.size());
+  EXPECT_EQ(hash1, result.blobs[0]->getHash());
+  EXPECT_EQ(
+      "contents",
+      result.blobs[0]->getContents().cloneAsValue().moveToFbString());
+  EXPECT_EQ(hash2, result.blobs[1]->getHash());
+  EXPECT_EQ(100000, result.blobs[1]->getSize());
+
+  ASSERT_EQ(2, result.metadata.size());
+  EXPECT_EQ(0, result.metadata["/mnt/empty"].size());
+  const auto& entries = result.metadata["/mnt/one"];
+  ASSERT_EQ(2, entries.size());
+  EXPECT_EQ(hash1, entries[0].first);
+  EXPECT_EQ(sha1, entries[0].second.sha1);
+  EXPECT_EQ(8, entries[0].second.size);
+  EXPECT_EQ(hash2, entries[1].first);
+  EXPECT_EQ(sha2, entries[1].second.sha1);
+  EXPECT_EQ(100000, entries[1].second.size);
+}
+
+TEST(CacheSnapshot, blobsOwnTheirContents) {
+  std::shared_ptr<const Blob> blob;
+  {
+    CacheSnapshot snapshot;
+    snapshot.blobs.push_back(std::make_shared<Blob>(hash1, "first"_sp));
+    snapshot.blobs.push_back(std::make_shared<Blob>(hash2, "second"_sp));
+    auto file = snapshot.write();
+    auto result = CacheSnapshot::read(file);
+    ASSERT_EQ(2, result.blobs.size());
+    blob = result.blobs[1];
+  }
+
+  // The contents are copied out rather than referring to the snapshot.
+  EXPECT_FALSE(blob->getContents().isShared());
+  EXPECT_EQ("second", blob->getContents().cloneAsValue().moveToFbString());
+}
+
+TEST(CacheSnapshot, rejectsTruncatedSnapshot) {
+  CacheSnapshot snapshot;
+  snapshot.blobs.push_back(std::make_shared<Blob>(hash1, "contents"_sp));
+  auto file = snapshot.write();
+  struct stat st;
+  ASSERT_EQ(0, fstat(file.fd(), &st));
+  ASSERT_EQ(0, folly::ftruncateNoInt(file.fd(), st.st_size - 1));
+  EXPECT_THROW(CacheSnapshot::read(file), std::out_of_range);
+}
+
+TEST(CacheSnapshot, rejectsOtherFiles) {
+  auto file = CacheSnapshot{}.write();
+  std::string garbage(64, 'x');
+  ASSERT_EQ(
+      static_cast<ssize_t>(garbage.size()),
+      folly::pwriteFull(file.fd(), garbage.data(), garbage.size(), 0));
+  EXPECT_THROW_RE(
+      CacheSnapshot::read(file), std::runtime_error, "not a cache snapshot");
+}
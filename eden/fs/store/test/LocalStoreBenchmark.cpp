@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/Random.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/init/Init.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <algorithm>
+
+#include "eden/fs/config/ReloadableConfig.h"
+#include "eden/fs/model/Blob.h"
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/store/RocksDbLocalStore.h"
+
+using namespace facebook::eden;
+using folly::StringPiece;
+
+DEFINE_uint64(blobs, 20000, "Number of blobs to write");
+DEFINE_uint64(blob_size, 64 * 1024, "Size of each blob in bytes");
+DEFINE_uint64(reads, 10000, "Number of random blob reads to time");
+
+namespace {
+
+class FixedConfig : public ReloadableConfig {
+ public:
+  explicit FixedConfig(std::shared_ptr<const EdenConfig> config)
+      : config_{std::move(config)} {}
+
+  std::shared_ptr<const EdenConfig> getEdenConfig(bool) override {
+    return config_;
+  }
+
+ private:
+  std::shared_ptr<const EdenConfig> config_;
+};
+
+/**
+ * Returns the number of bytes this process has caused to be written to
+ * storage, including by RocksDB's background flush and compaction threads.
+ */
+uint64_t getProcessWriteBytes() {
+  std::string io;
+  if (!folly::readFile("/proc/self/io", io)) {
+    return 0;
+  }
+  constexpr StringPiece kWriteBytes{"\nwrite_bytes: "};
+  auto pos = io.find(kWriteBytes.data());
+  if (pos == std::string::npos) {
+    return 0;
+  }
+  return folly::to<uint64_t>(
+      StringPiece{io}.subpiece(pos + kWriteBytes.size()).split_step('\n'));
+}
+
+double toMicros(std::chrono::nanoseconds duration) {
+  return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(
+             duration)
+      .count();
+}
+
+void benchmarkProfile(const char* name, bool blobFiles) {
+  folly::test::TemporaryDirectory testDir{"eden_local_store_benchmark"};
+  AbsolutePath testPath{testDir.path().string()};
+  auto edenConfig = std::make_shared<EdenConfig>(
+      /*userName=*/StringPiece{"bench"},
+      /*userHomePath=*/testPath,
+      /*userConfigPath=*/testPath + ".edenrc"_pc,
+      /*systemConfigDir=*/testPath,
+      /*systemConfigPath=*/testPath + "edenfs.rc"_pc);
+  edenConfig->setRocksDbBlobFiles(blobFiles, COMMAND_LINE);
+  RocksDbLocalStore store{testPath + "rocks"_pc,
+                          std::make_shared<FixedConfig>(edenConfig)};
+
+  // Interleave the blobs with small records in other key spaces, as an
+  // import does.
+  std::vector<Hash> hashes;
+  hashes.reserve(FLAGS_blobs);
+  std::string contents(FLAGS_blob_size, 'x');
+  uint64_t logicalBytes = 0;
+  auto writeBytesBefore = getProcessWriteBytes();
+  folly::stop_watch<> writeTimer;
+  auto batch = store.beginWrite(64 * 1024 * 1024);
+  for (uint64_t i = 0; i < FLAGS_blobs; ++i) {
+    auto hash = Hash::sha1(folly::to<std::string>(i));
+    // Vary the contents so that compression has some work to do.
+    auto suffix = folly::to<std::string>(i);
+    std::copy(suffix.begin(), suffix.end(), contents.begin());
+    Blob blob{hash, StringPiece{contents}};
+    batch->putBlob(hash, &blob);
+    batch->put(
+        LocalStore::KeySpace::HgProxyHashFamily,
+        Hash::sha1(hash.getBytes()),
+        hash.getBytes());
+    logicalBytes += contents.size() + 2 * Hash::RAW_SIZE;
+    hashes.push_back(hash);
+  }
+  batch->flush();
+  store.compactStorage();
+  auto writeElapsed = writeTimer.elapsed();
+  auto writeBytes = getProcessWriteBytes() - writeBytesBefore;
+
+  std::vector<std::chrono::nanoseconds> latencies;
+  latencies.reserve(FLAGS_reads);
+  for (uint64_t i = 0; i < FLAGS_reads && !hashes.empty(); ++i) {
+    const auto& hash = hashes[folly::Random::rand64(hashes.size())];
+    folly::stop_watch<> readTimer;
+    store.getBlob(hash).get();
+    latencies.push_back(readTimer.elapsed());
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  printf(
+      "%-12s write %8.1f ms, write amplification %.2f, "
+      "read p50 %.1f us, p99 %.1f us\n",
+      name,
+      toMicros(writeElapsed) / 1000,
+      logicalBytes ? static_cast<double>(writeBytes) / logicalBytes : 0.0,
+      latencies.empty() ? 0.0 : toMicros(latencies[latencies.size() / 2]),
+      latencies.empty() ? 0.0
+                        : toMicros(latencies[latencies.size() * 99 / 100]));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  printf(
+      "Writing %" PRIu64 " blobs of %" PRIu64 " bytes\n",
+      FLAGS_blobs,
+      FLAGS_blob_size);
+  benchmarkProfile("lsm-only", false);
+  benchmarkProfile("blob-files", true);
+  return 0;
+}
@@ -14,6 +14,7 @@
 #include <folly/io/IOBuf.h>
 #include <gtest/gtest.h>
 #include <stdexcept>
+#include <thread>
 #include "eden/fs/model/Blob.h"
 #include "eden/fs/model/Hash.h"
 #include "eden/fs/model/Tree.h"
@@ -214,6 +215,72 @@ TEST_P(LocalStoreTest, testMultipleBlobWriters) {
   EXPECT_EQ("hello world1_4", result1_4.piece());
 }
 
+TEST_P(LocalStoreTest, testGetBatch) {
+  auto batch = store_->beginWrite();
+  batch->put(KeySpace::BlobFamily, "key1"_sp, "blob1"_sp);
+  batch->put(KeySpace::BlobFamily, "key3"_sp, "blob3"_sp);
+  batch->put(KeySpace::TreeFamily, "key2"_sp, "tree2"_sp);
+  batch->flush();
+
+  std::vector<folly::ByteRange> keys{
+      "key1"_sp, "key2"_sp, "key3"_sp, "key1"_sp};
+  auto results = store_->getBatch(KeySpace::BlobFamily, keys).get(10s);
+  ASSERT_EQ(4, results.size());
+  EXPECT_EQ("blob1", results[0].piece());
+  EXPECT_FALSE(results[1].isValid());
+  EXPECT_EQ("blob3", results[2].piece());
+  EXPECT_EQ("blob1", results[3].piece());
+}
+
+TEST_P(LocalStoreTest, getMissingChecksTheRequestedKeySpace) {
+  Hash stored("1111111111111111111111111111111111111111");
+  Hash metadataOnly("2222222222222222222222222222222222222222");
+  Hash absent("3333333333333333333333333333333333333333");
+
+  StringPiece contents("contents\n");
+  auto blob =
+      Blob{stored, IOBuf{IOBuf::WRAP_BUFFER, folly::ByteRange{contents}}};
+  store_->putBlob(stored, &blob);
+  // Importing a tree records metadata for blobs that have not been fetched.
+  store_->put(
+      KeySpace::BlobMetaDataFamily,
+      metadataOnly,
+      store_->get(KeySpace::BlobMetaDataFamily, stored).bytes());
+
+  EXPECT_EQ(
+      (std::vector<Hash>{metadataOnly, absent}),
+      store_->getMissing(KeySpace::BlobFamily, {stored, metadataOnly, absent})
+          .get(10s));
+  EXPECT_EQ(
+      std::vector<Hash>{absent},
+      store_
+          ->getMissing(
+              KeySpace::BlobMetaDataFamily, {stored, metadataOnly, absent})
+          .get(10s));
+}
+
+TEST_P(LocalStoreTest, testReadsFromManyThreads) {
+  store_->put(KeySpace::BlobFamily, "key"_sp, "blob"_sp);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 100; ++j) {
+        EXPECT_EQ("blob", store_->get(KeySpace::BlobFamily, "key"_sp).piece());
+        EXPECT_FALSE(store_->hasKey(KeySpace::BlobFamily, "missing"_sp));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Writes made after a thread first read are visible to it.
+  EXPECT_FALSE(store_->hasKey(KeySpace::BlobFamily, "key2"_sp));
+  store_->put(KeySpace::BlobFamily, "key2"_sp, "blob2"_sp);
+  EXPECT_EQ("blob2", store_->get(KeySpace::BlobFamily, "key2"_sp).piece());
+}
+
 TEST_P(LocalStoreTest, testClearKeySpace) {
   store_->put(KeySpace::BlobFamily, "key1"_sp, "blob1"_sp);
   store_->put(KeySpace::BlobFamily, "key2"_sp, "blob2"_sp);
@@ -224,6 +291,46 @@ TEST_P(LocalStoreTest, testClearKeySpace) {
   EXPECT_TRUE(store_->hasKey(KeySpace::TreeFamily, "tree"_sp));
 }
 
+TEST(MemoryLocalStore, evictsOldestValuesOverBudget) {
+  // Every entry uses the same key, so they all land in the same shard, which
+  // gets a 20 byte share of the budget.
+  MemoryLocalStore store{nullptr, 32 * 20};
+  auto key = "key1"_sp;
+  store.put(KeySpace::BlobFamily, key, "blob1"_sp);
+  store.put(KeySpace::HgProxyHashFamily, key, "proxy1"_sp);
+  EXPECT_EQ(19, store.getTotalSize());
+  // Overwriting a value does not count its key twice.
+  store.put(KeySpace::BlobFamily, key, "blob1"_sp);
+  EXPECT_EQ(19, store.getTotalSize());
+
+  store.put(KeySpace::TreeFamily, key, "tree1"_sp);
+  EXPECT_FALSE(store.hasKey(KeySpace::BlobFamily, key));
+  EXPECT_TRUE(store.hasKey(KeySpace::TreeFamily, key));
+  EXPECT_EQ(19, store.getTotalSize());
+
+  // Proxy hashes cannot be refetched, so they are never evicted.
+  store.put(KeySpace::BlobFamily, key, "a much larger blob"_sp);
+  EXPECT_FALSE(store.hasKey(KeySpace::TreeFamily, key));
+  EXPECT_FALSE(store.hasKey(KeySpace::BlobFamily, key));
+  EXPECT_EQ("proxy1", store.get(KeySpace::HgProxyHashFamily, key).piece());
+  EXPECT_EQ(10, store.getTotalSize());
+}
+
+TEST(MemoryLocalStore, getSharesStoredValue) {
+  MemoryLocalStore store;
+  store.put(KeySpace::BlobFamily, "key"_sp, "blob"_sp);
+  auto result1 = store.get(KeySpace::BlobFamily, "key"_sp);
+  auto result2 = store.get(KeySpace::BlobFamily, "key"_sp);
+  EXPECT_EQ(result1.piece().data(), result2.piece().data());
+
+  auto buf = result1.extractIOBuf();
+  EXPECT_EQ(result2.piece().data(), reinterpret_cast<const char*>(buf.data()));
+  EXPECT_TRUE(buf.isShared());
+  buf.unshare();
+  EXPECT_NE(result2.piece().data(), reinterpret_cast<const char*>(buf.data()));
+  EXPECT_EQ("blob", result2.extractValue());
+}
+
 INSTANTIATE_TEST_CASE_P(
     Memory,
     LocalStoreTest,
@@ -0,0 +1,84 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/store/ObjectStore.h"
+
+#include <gtest/gtest.h>
+
+#include "eden/fs/model/Blob.h"
+#include "eden/fs/model/Tree.h"
+#include "eden/fs/store/MemoryLocalStore.h"
+#include "eden/fs/testharness/FakeBackingStore.h"
+#include "eden/fs/testharness/TestUtil.h"
+
+using namespace facebook::eden;
+using namespace std::chrono_literals;
+
+namespace {
+class ObjectStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    localStore_ = std::make_shared<MemoryLocalStore>();
+    backingStore_ = std::make_shared<FakeBackingStore>(localStore_);
+    objectStore_ = ObjectStore::create(localStore_, backingStore_);
+  }
+
+  std::shared_ptr<LocalStore> localStore_;
+  std::shared_ptr<FakeBackingStore> backingStore_;
+  std::shared_ptr<ObjectStore> objectStore_;
+};
+} // namespace
+
+TEST_F(ObjectStoreTest, getTreesCompletesEachTreeIndependently) {
+  auto* blob = backingStore_->putBlob("contents");
+  blob->setReady();
+
+  Tree localTree{std::vector<TreeEntry>{TreeEntry{
+      blob->get().getHash(), "local", TreeEntryType::REGULAR_FILE}}};
+  auto localHash = localStore_->putTree(&localTree);
+
+  auto remoteHash = makeTestHash("2");
+  auto* remoteTree = backingStore_->putTree(remoteHash, {{"remote", blob}});
+
+  auto missingHash = makeTestHash("3");
+
+  auto trees = objectStore_->getTrees({localHash, remoteHash, missingHash});
+  ASSERT_EQ(3, trees.size());
+
+  // The tree in the LocalStore does not wait for the BackingStore.
+  ASSERT_TRUE(trees[0].isReady());
+  EXPECT_EQ(localHash, std::move(trees[0]).get(0ms)->getHash());
+  EXPECT_FALSE(trees[1].isReady());
+
+  // A tree that cannot be found fails without affecting the others.
+  ASSERT_TRUE(trees[2].isReady());
+  EXPECT_THROW(std::move(trees[2]).get(0ms), std::domain_error);
+
+  remoteTree->setReady();
+  ASSERT_TRUE(trees[1].isReady());
+  EXPECT_EQ(remoteHash, std::move(trees[1]).get(0ms)->getHash());
+}
+
+TEST_F(ObjectStoreTest, prefetchBlobMetadataDoesNotFetchBlobContents) {
+  Blob localBlob{makeTestHash("4"), folly::StringPiece{"local"}};
+  localStore_->putBlob(localBlob.getHash(), &localBlob);
+
+  // This blob is never made ready, so fetching it would never complete.
+  auto* remoteBlob = backingStore_->putBlob("remote");
+
+  auto prefetched = objectStore_->prefetchBlobMetadata(
+      {localBlob.getHash(), remoteBlob->get().getHash()});
+  ASSERT_TRUE(prefetched.isReady());
+  EXPECT_EQ(
+      std::vector<Hash>{localBlob.getHash()}, std::move(prefetched).get(0ms));
+
+  auto snapshot = objectStore_->getMetadataCacheSnapshot();
+  ASSERT_EQ(1, snapshot.size());
+  EXPECT_EQ(localBlob.getHash(), snapshot[0].first);
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/*
+ * Runs the same workload against SqliteLocalStore and RocksDbLocalStore:
+ * write a set of blobs in batches, then read them back with single gets from
+ * several threads at once and with getBatch().
+ */
+#include <folly/Conv.h>
+#include <folly/Random.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/init/Init.h>
+#include <folly/stop_watch.h>
+#include <gflags/gflags.h>
+#include <inttypes.h>
+#include <thread>
+#include <vector>
+
+#include "eden/fs/model/Hash.h"
+#include "eden/fs/store/RocksDbLocalStore.h"
+#include "eden/fs/store/SqliteLocalStore.h"
+#include "eden/fs/store/StoreResult.h"
+
+using namespace facebook::eden;
+using folly::ByteRange;
+using folly::StringPiece;
+
+DEFINE_uint64(keys, 20000, "Number of values to write");
+DEFINE_uint64(value_size, 4096, "Size of each value in bytes");
+DEFINE_uint64(write_batch_size, 1024 * 1024, "bufSize passed to beginWrite()");
+DEFINE_uint64(reads_per_thread, 20000, "Number of gets each thread makes");
+DEFINE_uint64(threads, 4, "Number of threads reading at once");
+DEFINE_uint64(batch_size, 256, "Number of keys in each getBatch() call");
+
+namespace {
+
+double perSecond(uint64_t count, std::chrono::nanoseconds elapsed) {
+  return count / std::chrono::duration<double>(elapsed).count();
+}
+
+void benchmarkStore(const char* name, LocalStore& store) {
+  std::vector<Hash> hashes;
+  hashes.reserve(FLAGS_keys);
+  std::string value(FLAGS_value_size, 'x');
+
+  folly::stop_watch<> writeTimer;
+  auto batch = store.beginWrite(FLAGS_write_batch_size);
+  for (uint64_t i = 0; i < FLAGS_keys; ++i) {
+    auto hash = Hash::sha1(folly::to<std::string>(i));
+    batch->put(LocalStore::KeySpace::BlobFamily, hash, StringPiece{value});
+    hashes.push_back(hash);
+  }
+  batch->flush();
+  auto writeElapsed = writeTimer.elapsed();
+  if (hashes.empty()) {
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  folly::stop_watch<> readTimer;
+  for (uint64_t t = 0; t < FLAGS_threads; ++t) {
+    threads.emplace_back([&] {
+      for (uint64_t i = 0; i < FLAGS_reads_per_thread; ++i) {
+        const auto& hash = hashes[folly::Random::rand64(hashes.size())];
+        store.get(LocalStore::KeySpace::BlobFamily, hash.getBytes());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto readElapsed = readTimer.elapsed();
+
+  std::vector<ByteRange> keys;
+  keys.reserve(FLAGS_batch_size);
+  for (uint64_t i = 0; i < FLAGS_batch_size; ++i) {
+    keys.push_back(hashes[folly::Random::rand64(hashes.size())].getBytes());
+  }
+  auto numBatches = std::max<uint64_t>(FLAGS_reads_per_thread / keys.size(), 1);
+  folly::stop_watch<> batchTimer;
+  for (uint64_t i = 0; i < numBatches; ++i) {
+    store.getBatch(LocalStore::KeySpace::BlobFamily, keys).get();
+  }
+  auto batchElapsed = batchTimer.elapsed();
+
+  printf(
+      "%-8s write %10.0f keys/s, get %10.0f keys/s, getBatch %10.0f keys/s\n",
+      name,
+      perSecond(hashes.size(), writeElapsed),
+      perSecond(FLAGS_threads * FLAGS_reads_per_thread, readElapsed),
+      perSecond(numBatches * keys.size(), batchElapsed));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv);
+  printf(
+      "%" PRIu64 " values of %" PRIu64 " bytes, %" PRIu64 " reader threads\n",
+      FLAGS_keys,
+      FLAGS_value_size,
+      FLAGS_threads);
+
+  folly::test::TemporaryDirectory testDir{"eden_sqlite_store_benchmark"};
+  AbsolutePath testPath{testDir.path().string()};
+  {
+    SqliteLocalStore store{testPath + "sqlite"_pc};
+    benchmarkStore("sqlite", store);
+  }
+  {
+    RocksDbLocalStore store{testPath + "rocks"_pc};
+    benchmarkStore("rocksdb", store);
+  }
+  return 0;
+}
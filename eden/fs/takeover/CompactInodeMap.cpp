@@ -0,0 +1,208 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/takeover/CompactInodeMap.h"
+
+#include <folly/Conv.h>
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using folly::StringPiece;
+
+namespace facebook {
+namespace eden {
+
+namespace {
+constexpr StringPiece kMagic{"EDENINOD"};
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kHashSize = 20;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  /** Guards against a peer built with a different record layout. */
+  uint32_t recordSize;
+  uint64_t count;
+};
+} // namespace
+
+struct CompactInodeMap::Record {
+  uint64_t inodeNumber;
+  uint64_t parentInode;
+  int64_t numFuseReferences;
+  uint64_t nameOffset;
+  uint32_t nameLength;
+  uint32_t mode;
+  uint8_t isUnlinked;
+  uint8_t hasHash;
+  uint8_t padding[2];
+  uint8_t hash[kHashSize];
+};
+
+folly::File CompactInodeMap::write(std::vector<Entry> entries) {
+  static_assert(sizeof(Record) == 64, "unexpected inode map record size");
+  static_assert(
+      sizeof(Header) % alignof(Record) == 0,
+      "records must be aligned after the header");
+
+  std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return a.inodeNumber < b.inodeNumber;
+  });
+
+  Header header;
+  memcpy(header.magic, kMagic.data(), sizeof(header.magic));
+  header.version = kFormatVersion;
+  header.recordSize = sizeof(Record);
+  header.count = entries.size();
+
+  std::vector<Record> records(entries.size());
+  std::string names;
+  for (size_t n = 0; n < entries.size(); ++n) {
+    const auto& entry = entries[n];
+    CHECK_GE(entry.numFuseReferences, 0);
+    CHECK(entry.hash.empty() || entry.hash.size() == kHashSize);
+    auto& record = records[n];
+    memset(&record, 0, sizeof(record));
+    record.inodeNumber = entry.inodeNumber;
+    record.parentInode = entry.parentInode;
+    record.numFuseReferences = entry.numFuseReferences;
+    record.nameOffset = names.size();
+    record.nameLength = entry.name.size();
+    record.mode = entry.mode;
+    record.isUnlinked = entry.isUnlinked;
+    record.hasHash = !entry.hash.empty();
+    std::copy(entry.hash.begin(), entry.hash.end(), record.hash);
+    names.append(entry.name.data(), entry.name.size());
+  }
+
+  auto fd = memfd_create("eden_inode_map", MFD_CLOEXEC);
+  folly::checkUnixError(fd, "failed to create inode map memfd");
+  folly::File file{fd, /*ownsFd=*/true};
+  iovec iov[3];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = records.data();
+  iov[1].iov_len = records.size() * sizeof(Record);
+  iov[2].iov_base = names.data();
+  iov[2].iov_len = names.size();
+  folly::checkUnixError(
+      folly::writevFull(file.fd(), iov, 3), "error writing inode map");
+  return file;
+}
+
+CompactInodeMap::CompactInodeMap(const folly::File& file) {
+  struct stat st;
+  folly::checkUnixError(fstat(file.fd(), &st), "failed to stat inode map");
+  mapSize_ = static_cast<size_t>(st.st_size);
+  if (mapSize_ < sizeof(Header)) {
+    throw std::runtime_error("inode map is truncated");
+  }
+
+  map_ = mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, file.fd(), 0);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    folly::throwSystemError("failed to map inode map");
+  }
+
+  try {
+    const auto* header = static_cast<const Header*>(map_);
+    if (StringPiece{header->magic, sizeof(header->magic)} != kMagic) {
+      throw std::runtime_error("not an inode map");
+    }
+    if (header->version != kFormatVersion ||
+        header->recordSize != sizeof(Record)) {
+      throw std::runtime_error(folly::to<std::string>(
+          "unsupported inode map version ",
+          header->version,
+          " with record size ",
+          header->recordSize));
+    }
+    auto available = (mapSize_ - sizeof(Header)) / sizeof(Record);
+    if (header->count > available) {
+      throw std::runtime_error("inode map is truncated");
+    }
+    count_ = header->count;
+    records_ = reinterpret_cast<const Record*>(header + 1);
+    const auto* namesStart = reinterpret_cast<const char*>(records_ + count_);
+    names_ = StringPiece{namesStart, static_cast<const char*>(map_) + mapSize_};
+  } catch (...) {
+    munmap(map_, mapSize_);
+    throw;
+  }
+}
+
+CompactInodeMap::~CompactInodeMap() {
+  if (map_) {
+    munmap(map_, mapSize_);
+  }
+}
+
+CompactInodeMap::Entry CompactInodeMap::getEntry(size_t index) const {
+  CHECK_LT(index, count_);
+  const auto& record = records_[index];
+  if (record.nameOffset > names_.size() ||
+      record.nameLength > names_.size() - record.nameOffset) {
+    throw std::runtime_error(folly::to<std::string>(
+        "inode map entry for inode ",
+        record.inodeNumber,
+        " has an out of range name"));
+  }
+
+  Entry entry;
+  entry.inodeNumber = record.inodeNumber;
+  entry.parentInode = record.parentInode;
+  entry.name = names_.subpiece(record.nameOffset, record.nameLength);
+  entry.isUnlinked = record.isUnlinked;
+  entry.numFuseReferences = record.numFuseReferences;
+  if (record.hasHash) {
+    entry.hash = folly::ByteRange{record.hash, kHashSize};
+  }
+  entry.mode = record.mode;
+  return entry;
+}
+
+size_t CompactInodeMap::find(uint64_t inodeNumber) const {
+  const auto* end = records_ + count_;
+  const auto* it = std::lower_bound(
+      records_, end, inodeNumber, [](const Record& record, uint64_t number) {
+        return record.inodeNumber < number;
+      });
+  if (it == end || it->inodeNumber != inodeNumber) {
+    return count_;
+  }
+  return it - records_;
+}
+
+SerializedInodeMap CompactInodeMap::toThrift() const {
+  SerializedInodeMap result;
+  result.unloadedInodes.reserve(count_);
+  for (size_t n = 0; n < count_; ++n) {
+    auto entry = getEntry(n);
+    SerializedInodeMapEntry serializedEntry;
+    serializedEntry.inodeNumber = entry.inodeNumber;
+    serializedEntry.parentInode = entry.parentInode;
+    serializedEntry.name = entry.name.str();
+    serializedEntry.isUnlinked = entry.isUnlinked;
+    serializedEntry.numFuseReferences = entry.numFuseReferences;
+    serializedEntry.hash = StringPiece{entry.hash}.str();
+    serializedEntry.mode = entry.mode;
+    result.unloadedInodes.emplace_back(std::move(serializedEntry));
+  }
+  return result;
+}
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/File.h>
+#include <folly/Range.h>
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "eden/fs/takeover/gen-cpp2/takeover_types.h"
+
+namespace facebook {
+namespace eden {
+
+/**
+ * A compact encoding of the inodes a mount must remember, used to hand them
+ * to the next edenfs process during graceful takeover.  The old process
+ * records loaded inodes here directly rather than by unloading them first.
+ *
+ * It holds the same information as SerializedInodeMap::unloadedInodes, but
+ * as an array of fixed-size records sorted by inode number, followed by the
+ * entry names.  The data is written to a memfd that is passed over the
+ * takeover socket.  The receiving process maps it and looks entries up with
+ * a binary search, so it does not need to decode every entry before it can
+ * start serving FUSE requests.
+ *
+ * Takeover is always between processes on the same machine, so the records
+ * use the host byte order.
+ */
+class CompactInodeMap {
+ public:
+  struct Entry {
+    uint64_t inodeNumber{0};
+    uint64_t parentInode{0};
+    folly::StringPiece name;
+    bool isUnlinked{false};
+    int64_t numFuseReferences{0};
+    /** The 20-byte source control hash, or empty if materialized. */
+    folly::ByteRange hash;
+    mode_t mode{0};
+  };
+
+  /**
+   * Write entries to a new memfd.  The entries do not need to be sorted, but
+   * their inode numbers must be unique.
+   */
+  static folly::File write(std::vector<Entry> entries);
+
+  /**
+   * Map a file created by write().  Throws std::runtime_error if the file is
+   * not a valid CompactInodeMap.
+   */
+  explicit CompactInodeMap(const folly::File& file);
+  ~CompactInodeMap();
+
+  CompactInodeMap(const CompactInodeMap&) = delete;
+  CompactInodeMap& operator=(const CompactInodeMap&) = delete;
+
+  size_t size() const {
+    return count_;
+  }
+
+  /**
+   * Returns the entry at the given index.  Entries are sorted by inode
+   * number.  The entry's name and hash point into this CompactInodeMap.
+   */
+  Entry getEntry(size_t index) const;
+
+  /**
+   * Returns the index of the entry for inodeNumber, or size() if there is
+   * none.
+   */
+  size_t find(uint64_t inodeNumber) const;
+
+  /**
+   * Convert to the thrift encoding, for peers that do not support
+   * CompactInodeMap.
+   */
+  SerializedInodeMap toThrift() const;
+
+ private:
+  struct Record;
+
+  void* map_{nullptr};
+  size_t mapSize_{0};
+  const Record* records_{nullptr};
+  size_t count_{0};
+  folly::StringPiece names_;
+};
+
+} // namespace eden
+} // namespace facebook
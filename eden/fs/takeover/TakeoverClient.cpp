@@ -74,9 +74,23 @@ TakeoverData takeoverMounts(
   }
   auto& message = expectedMessage.value();
 
+  auto protocolVersion = TakeoverData::getProtocolVersion(&message.data);
   auto data = TakeoverData::deserialize(&message.data);
-  // Add 2 here for the lock file and the thrift socket
-  if (data.mountPoints.size() + 2 != message.files.size()) {
+  // Add 2 here for the lock file and the thrift socket, and one for each
+  // CompactInodeMap.
+  size_t inodeTableCount = 0;
+  for (const auto& mountInfo : data.mountPoints) {
+    if (mountInfo.inodeMap.hasCompactInodeMap) {
+      ++inodeTableCount;
+    }
+  }
+  auto expectedFiles = data.mountPoints.size() + inodeTableCount + 2;
+  // Only a server using kTakeoverProtocolVersionFour or later may also send
+  // a cache snapshot at the end.
+  auto hasCacheSnapshot =
+      protocolVersion >= TakeoverData::kTakeoverProtocolVersionFour &&
+      message.files.size() == expectedFiles + 1;
+  if (message.files.size() != expectedFiles && !hasCacheSnapshot) {
     throw std::runtime_error(folly::to<string>(
         "received ",
         data.mountPoints.size(),
@@ -90,6 +104,15 @@ TakeoverData takeoverMounts(
     auto& mountInfo = data.mountPoints[n];
     mountInfo.fuseFD = std::move(message.files[n + 2]);
   }
+  auto nextFile = data.mountPoints.size() + 2;
+  for (auto& mountInfo : data.mountPoints) {
+    if (mountInfo.inodeMap.hasCompactInodeMap) {
+      mountInfo.inodeTable = std::move(message.files[nextFile++]);
+    }
+  }
+  if (hasCacheSnapshot) {
+    data.cacheSnapshot = std::move(message.files.back());
+  }
 
   return data;
 }
@@ -14,6 +14,7 @@
 #include <folly/io/IOBuf.h>
 #include <thrift/lib/cpp2/protocol/Serializer.h>
 
+#include "eden/fs/takeover/CompactInodeMap.h"
 #include "eden/fs/utils/Bug.h"
 
 using apache::thrift::CompactSerializer;
@@ -25,7 +26,9 @@ namespace eden {
 
 const std::set<int32_t> kSupportedTakeoverVersions{
     TakeoverData::kTakeoverProtocolVersionOne,
-    TakeoverData::kTakeoverProtocolVersionThree};
+    TakeoverData::kTakeoverProtocolVersionThree,
+    TakeoverData::kTakeoverProtocolVersionFour,
+    TakeoverData::kTakeoverProtocolVersionFive};
 
 std::optional<int32_t> TakeoverData::computeCompatibleVersion(
     const std::set<int32_t>& versions,
@@ -46,12 +49,28 @@ std::optional<int32_t> TakeoverData::computeCompatibleVersion(
   return best;
 }
 
+void TakeoverData::MountInfo::convertInodeTableToThrift() {
+  if (!inodeTable) {
+    return;
+  }
+  inodeMap = CompactInodeMap{inodeTable}.toThrift();
+  inodeTable.close();
+}
+
 IOBuf TakeoverData::serialize(int32_t protocolVersion) {
+  if (protocolVersion < kTakeoverProtocolVersionFive) {
+    for (auto& mount : mountPoints) {
+      mount.convertInodeTableToThrift();
+    }
+  }
+
   switch (protocolVersion) {
     case kTakeoverProtocolVersionOne:
       return serializeVersion1();
     case kTakeoverProtocolVersionThree:
-      return serializeVersion3();
+    case kTakeoverProtocolVersionFour:
+    case kTakeoverProtocolVersionFive:
+      return serializeVersion3(protocolVersion);
     default: {
       auto bug = EDEN_BUG()
           << "only kTakeoverProtocolVersionOne is supported, but somehow "
@@ -72,6 +91,8 @@ folly::IOBuf TakeoverData::serializeError(
     case kTakeoverProtocolVersionOne:
       return serializeErrorVersion1(ew);
     case kTakeoverProtocolVersionThree:
+    case kTakeoverProtocolVersionFour:
+    case kTakeoverProtocolVersionFive:
       return serializeErrorVersion3(ew);
     default: {
       auto bug = EDEN_BUG()
@@ -82,6 +103,20 @@ folly::IOBuf TakeoverData::serializeError(
   }
 }
 
+int32_t TakeoverData::getProtocolVersion(const IOBuf* buf) {
+  folly::io::Cursor cursor(buf);
+  auto messageType = cursor.readBE<uint32_t>();
+  switch (messageType) {
+    case MessageType::ERROR:
+    case MessageType::MOUNTS:
+      // Version 1 responses start with their message type rather than a
+      // version number.
+      return kTakeoverProtocolVersionOne;
+    default:
+      return messageType;
+  }
+}
+
 TakeoverData TakeoverData::deserialize(IOBuf* buf) {
   // We need to probe the data to see which version we have
   folly::io::Cursor cursor(buf);
@@ -94,6 +129,8 @@ TakeoverData TakeoverData::deserialize(IOBuf* buf) {
       // because it the messageType is needed to decode the response.
       return deserializeVersion1(buf);
     case kTakeoverProtocolVersionThree:
+    case kTakeoverProtocolVersionFour:
+    case kTakeoverProtocolVersionFive:
       // Version 3 (there was no 2 because of how Version 1 used word values
       // 1 and 2) doesn't care about this version byte, so we skip past it
       // and let the underlying code decode the data
@@ -274,14 +311,14 @@ TakeoverData TakeoverData::deserializeVersion1(IOBuf* buf) {
   return data;
 }
 
-IOBuf TakeoverData::serializeVersion3() {
+IOBuf TakeoverData::serializeVersion3(int32_t protocolVersion) {
   SerializedTakeoverData serialized;
 
   folly::IOBufQueue bufQ;
   folly::io::QueueAppender app(&bufQ, 0);
 
   // First word is the protocol version
-  app.writeBE<uint32_t>(kTakeoverProtocolVersionThree);
+  app.writeBE<uint32_t>(protocolVersion);
 
   std::vector<SerializedMountInfo> serializedMounts;
   for (const auto& mount : mountPoints) {
@@ -304,6 +341,8 @@ IOBuf TakeoverData::serializeVersion3() {
 
     serializedMount.fileHandleMap = mount.fileHandleMap;
     serializedMount.inodeMap = mount.inodeMap;
+    serializedMount.inodeMap.hasCompactInodeMap =
+        static_cast<bool>(mount.inodeTable);
 
     serializedMounts.emplace_back(std::move(serializedMount));
   }
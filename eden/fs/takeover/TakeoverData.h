@@ -63,6 +63,17 @@ class TakeoverData {
     // like too much of a headache, so we simply skip over using
     // version 2 to describe this next one.
     kTakeoverProtocolVersionThree = 3,
+
+    // This version uses the same encoding as version 3, but the sender may
+    // append a memfd holding a CacheSnapshot after the FUSE device
+    // descriptors, so that the new process starts with warm caches.
+    kTakeoverProtocolVersionFour = 4,
+
+    // This version can send each mount's unloaded inodes as a
+    // CompactInodeMap memfd rather than as a thrift list.  The memfds follow
+    // the FUSE device descriptors, in mount order, for the mounts whose
+    // SerializedInodeMap has hasCompactInodeMap set.
+    kTakeoverProtocolVersionFive = 5,
   };
 
   // Given a set of versions provided by a client, find the largest
@@ -89,6 +100,12 @@ class TakeoverData {
           fileHandleMap{std::move(fileHandleMap)},
           inodeMap{std::move(inodeMap)} {}
 
+    /**
+     * Convert inodeTable to the thrift list in inodeMap, for peers older
+     * than kTakeoverProtocolVersionFive.
+     */
+    void convertInodeTableToThrift();
+
     AbsolutePath mountPath;
     AbsolutePath stateDirectory;
     std::vector<AbsolutePath> bindMounts;
@@ -96,6 +113,11 @@ class TakeoverData {
     fuse_init_out connInfo;
     SerializedFileHandleMap fileHandleMap;
     SerializedInodeMap inodeMap;
+    /**
+     * A memfd holding a CompactInodeMap of the mount's unloaded inodes.  When
+     * this is set, inodeMap.unloadedInodes is empty.
+     */
+    folly::File inodeTable;
   };
 
   /**
@@ -103,7 +125,8 @@ class TakeoverData {
    * process.
    *
    * This includes all data except for file descriptors.  The file descriptors
-   * must be sent separately.
+   * must be sent separately.  For protocol versions that predate
+   * CompactInodeMap, each mount's inodeTable is first converted to thrift.
    */
   folly::IOBuf serialize(int32_t protocolVersion);
 
@@ -119,6 +142,12 @@ class TakeoverData {
    */
   static TakeoverData deserialize(folly::IOBuf* buf);
 
+  /**
+   * Return the protocol version a serialized TakeoverData was encoded with,
+   * without consuming any of it.
+   */
+  static int32_t getProtocolVersion(const folly::IOBuf* buf);
+
   /**
    * The main eden lock file that prevents two edenfs processes from running at
    * the same time.
@@ -135,6 +164,12 @@ class TakeoverData {
    */
   std::vector<MountInfo> mountPoints;
 
+  /**
+   * An optional memfd containing a CacheSnapshot of the sender's in-memory
+   * object caches.  Only sent with kTakeoverProtocolVersionFour or later.
+   */
+  folly::File cacheSnapshot;
+
   /**
    * The takeoverComplete promise will be fulfilled by the TakeoverServer code
    * once the TakeoverData has been sent to the remote process.
@@ -160,9 +195,10 @@ class TakeoverData {
   static TakeoverData deserializeVersion1(folly::IOBuf* buf);
 
   /**
-   * Serialize data using version 2 of the takeover protocol.
+   * Serialize data using version 2 of the takeover protocol.  Version 4
+   * uses the same encoding, so protocolVersion is written as the first word.
    */
-  folly::IOBuf serializeVersion3();
+  folly::IOBuf serializeVersion3(int32_t protocolVersion);
 
   /**
    * Serialize an exception using version 2 of the takeover protocol.
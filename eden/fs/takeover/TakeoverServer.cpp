@@ -177,6 +177,17 @@ Future<Unit> TakeoverServer::ConnHandler::sendTakeoverData(
     for (auto& mount : data.mountPoints) {
       msg.files.push_back(std::move(mount.fuseFD));
     }
+    // serialize() has dropped the inode tables if the client cannot use them.
+    for (auto& mount : data.mountPoints) {
+      if (mount.inodeTable) {
+        msg.files.push_back(std::move(mount.inodeTable));
+      }
+    }
+    // Older clients would reject the extra descriptor.
+    if (protocolVersion_ >= TakeoverData::kTakeoverProtocolVersionFour &&
+        data.cacheSnapshot) {
+      msg.files.push_back(std::move(data.cacheSnapshot));
+    }
   } catch (const std::exception& ex) {
     auto ew = folly::exception_wrapper{std::current_exception(), ex};
     data.takeoverComplete.setException(ew);
@@ -19,6 +19,9 @@ struct SerializedInodeMapEntry {
 
 struct SerializedInodeMap {
   2: list<SerializedInodeMapEntry> unloadedInodes,
+  // If set, the unloaded inodes are instead sent as a CompactInodeMap memfd
+  // following the FUSE device descriptors, and unloadedInodes is empty.
+  3: bool hasCompactInodeMap,
 }
 
 struct SerializedMountInfo {
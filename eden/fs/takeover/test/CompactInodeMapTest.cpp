@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/takeover/CompactInodeMap.h"
+
+#include <folly/FileUtil.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace facebook::eden;
+using folly::ByteRange;
+using folly::StringPiece;
+
+namespace {
+constexpr StringPiece kHash{"0123456789abcdefghij"};
+
+std::vector<CompactInodeMap::Entry> makeEntries() {
+  std::vector<CompactInodeMap::Entry> entries(3);
+  // Deliberately out of order; write() sorts them.
+  entries[0].inodeNumber = 12;
+  entries[0].parentInode = 5;
+  entries[0].name = "file.txt";
+  entries[0].numFuseReferences = 2;
+  entries[0].hash = ByteRange{kHash};
+  entries[0].mode = S_IFREG | 0644;
+
+  entries[1].inodeNumber = 5;
+  entries[1].parentInode = 1;
+  entries[1].name = "dir";
+  entries[1].mode = S_IFDIR | 0755;
+
+  entries[2].inodeNumber = 9;
+  entries[2].parentInode = 5;
+  entries[2].name = "deleted";
+  entries[2].isUnlinked = true;
+  entries[2].numFuseReferences = 1;
+  entries[2].mode = S_IFREG | 0600;
+  return entries;
+}
+} // namespace
+
+TEST(CompactInodeMap, roundTrip) {
+  auto file = CompactInodeMap::write(makeEntries());
+  CompactInodeMap map{file};
+  ASSERT_EQ(3, map.size());
+  EXPECT_EQ(5, map.getEntry(0).inodeNumber);
+  EXPECT_EQ(9, map.getEntry(1).inodeNumber);
+  EXPECT_EQ(12, map.getEntry(2).inodeNumber);
+
+  auto index = map.find(12);
+  ASSERT_EQ(2, index);
+  auto entry = map.getEntry(index);
+  EXPECT_EQ(5, entry.parentInode);
+  EXPECT_EQ("file.txt", entry.name);
+  EXPECT_FALSE(entry.isUnlinked);
+  EXPECT_EQ(2, entry.numFuseReferences);
+  EXPECT_EQ(kHash, StringPiece{entry.hash});
+  EXPECT_EQ(S_IFREG | 0644, entry.mode);
+
+  entry = map.getEntry(map.find(9));
+  EXPECT_EQ("deleted", entry.name);
+  EXPECT_TRUE(entry.isUnlinked);
+  EXPECT_TRUE(entry.hash.empty());
+
+  EXPECT_EQ(map.size(), map.find(1));
+  EXPECT_EQ(map.size(), map.find(7));
+  EXPECT_EQ(map.size(), map.find(100));
+}
+
+TEST(CompactInodeMap, empty) {
+  auto file = CompactInodeMap::write({});
+  CompactInodeMap map{file};
+  EXPECT_EQ(0, map.size());
+  EXPECT_EQ(0, map.find(1));
+  EXPECT_EQ(0, map.toThrift().unloadedInodes.size());
+}
+
+TEST(CompactInodeMap, toThrift) {
+  auto file = CompactInodeMap::write(makeEntries());
+  auto thrift = CompactInodeMap{file}.toThrift();
+  ASSERT_EQ(3, thrift.unloadedInodes.size());
+  const auto& entry = thrift.unloadedInodes[2];
+  EXPECT_EQ(12, entry.inodeNumber);
+  EXPECT_EQ(5, entry.parentInode);
+  EXPECT_EQ("file.txt", entry.name);
+  EXPECT_EQ(2, entry.numFuseReferences);
+  EXPECT_EQ(kHash.str(), entry.hash);
+  EXPECT_EQ(S_IFREG | 0644, entry.mode);
+  EXPECT_EQ("", thrift.unloadedInodes[0].hash);
+  EXPECT_TRUE(thrift.unloadedInodes[1].isUnlinked);
+}
+
+TEST(CompactInodeMap, rejectsTruncatedMap) {
+  auto file = CompactInodeMap::write(makeEntries());
+  // Drop the last record and the names.
+  ASSERT_EQ(0, ftruncate(file.fd(), 24 + 2 * 64));
+  EXPECT_THROW(CompactInodeMap{file}, std::runtime_error);
+}
+
+TEST(CompactInodeMap, rejectsOtherFiles) {
+  auto fd = memfd_create("not_an_inode_map", MFD_CLOEXEC);
+  ASSERT_GE(fd, 0);
+  folly::File file{fd, /*ownsFd=*/true};
+  StringPiece contents{"this is not an inode map, just some text"};
+  ASSERT_EQ(
+      static_cast<ssize_t>(contents.size()),
+      folly::writeFull(file.fd(), contents.data(), contents.size()));
+  EXPECT_THROW(CompactInodeMap{file}, std::runtime_error);
+}
@@ -7,6 +7,7 @@
  *  of patent rights can be found in the PATENTS file in the same directory.
  *
  */
+#include <folly/Conv.h>
 #include <folly/Exception.h>
 #include <folly/experimental/TestUtil.h>
 #include <folly/futures/Future.h>
@@ -15,6 +16,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "eden/fs/takeover/CompactInodeMap.h"
 #include "eden/fs/takeover/TakeoverClient.h"
 #include "eden/fs/takeover/TakeoverData.h"
 #include "eden/fs/takeover/TakeoverHandler.h"
@@ -391,6 +393,18 @@ TEST(Takeover, computeCompatibleVersion) {
       4);
 }
 
+TEST(Takeover, getProtocolVersion) {
+  for (auto version : {TakeoverData::kTakeoverProtocolVersionOne,
+                       TakeoverData::kTakeoverProtocolVersionThree,
+                       TakeoverData::kTakeoverProtocolVersionFour}) {
+    TakeoverData data;
+    auto buf = data.serialize(version);
+    EXPECT_EQ(version, TakeoverData::getProtocolVersion(&buf));
+    // Probing the version must leave the buffer intact for deserialize().
+    EXPECT_EQ(0, TakeoverData::deserialize(&buf).mountPoints.size());
+  }
+}
+
 TEST(Takeover, errorVersionMismatch) {
   TemporaryDirectory tmpDir("eden_takeover_test");
   ErrorHandler handler;
@@ -438,3 +452,185 @@ TEST(Takeover, oneToTwo) {
   // Make sure the received mount information is empty
   EXPECT_EQ(0, clientData.mountPoints.size());
 }
+
+TEST(Takeover, cacheSnapshot) {
+  TemporaryDirectory tmpDir("eden_takeover_test");
+  AbsolutePathPiece tmpDirPath{tmpDir.path().string()};
+
+  TakeoverData serverData;
+  auto lockFilePath = tmpDirPath + "lock"_pc;
+  serverData.lockFile =
+      folly::File{lockFilePath.stringPiece(), O_RDWR | O_CREAT};
+  auto thriftSocketPath = tmpDirPath + "thrift"_pc;
+  serverData.thriftSocket =
+      folly::File{thriftSocketPath.stringPiece(), O_RDWR | O_CREAT};
+
+  auto mountPath = tmpDirPath + "mount1"_pc;
+  auto clientPath = tmpDirPath + "client1"_pc;
+  auto mountFusePath = tmpDirPath + "fuse1"_pc;
+  serverData.mountPoints.emplace_back(
+      mountPath,
+      clientPath,
+      std::vector<AbsolutePath>{},
+      folly::File{mountFusePath.stringPiece(), O_RDWR | O_CREAT},
+      fuse_init_out{},
+      SerializedFileHandleMap{},
+      SerializedInodeMap{});
+
+  auto snapshotPath = tmpDirPath + "snapshot"_pc;
+  serverData.cacheSnapshot =
+      folly::File{snapshotPath.stringPiece(), O_RDWR | O_CREAT};
+
+  auto serverSendFuture = serverData.takeoverComplete.getFuture();
+  TestHandler handler{std::move(serverData)};
+  auto result = runTakeover(
+      tmpDir,
+      &handler,
+      std::set<int32_t>{TakeoverData::kTakeoverProtocolVersionFour});
+  ASSERT_TRUE(serverSendFuture.hasValue());
+  ASSERT_TRUE(result.hasValue());
+  const auto& clientData = result.value();
+
+  // The snapshot follows the FUSE device, which must still be matched up
+  // with its mount.
+  ASSERT_EQ(1, clientData.mountPoints.size());
+  checkExpectedFile(clientData.mountPoints.at(0).fuseFD.fd(), mountFusePath);
+  ASSERT_TRUE(clientData.cacheSnapshot);
+  checkExpectedFile(clientData.cacheSnapshot.fd(), snapshotPath);
+}
+
+TEST(Takeover, cacheSnapshotNotSentToVersionThree) {
+  TemporaryDirectory tmpDir("eden_takeover_test");
+  AbsolutePathPiece tmpDirPath{tmpDir.path().string()};
+
+  TakeoverData serverData;
+  auto lockFilePath = tmpDirPath + "lock"_pc;
+  serverData.lockFile =
+      folly::File{lockFilePath.stringPiece(), O_RDWR | O_CREAT};
+  auto thriftSocketPath = tmpDirPath + "thrift"_pc;
+  serverData.thriftSocket =
+      folly::File{thriftSocketPath.stringPiece(), O_RDWR | O_CREAT};
+  auto snapshotPath = tmpDirPath + "snapshot"_pc;
+  serverData.cacheSnapshot =
+      folly::File{snapshotPath.stringPiece(), O_RDWR | O_CREAT};
+
+  // A client that predates version 4 does not expect the extra descriptor.
+  auto serverSendFuture = serverData.takeoverComplete.getFuture();
+  TestHandler handler{std::move(serverData)};
+  auto result = runTakeover(
+      tmpDir,
+      &handler,
+      std::set<int32_t>{TakeoverData::kTakeoverProtocolVersionThree});
+  ASSERT_TRUE(serverSendFuture.hasValue());
+  ASSERT_TRUE(result.hasValue());
+  const auto& clientData = result.value();
+
+  checkExpectedFile(clientData.lockFile.fd(), lockFilePath);
+  checkExpectedFile(clientData.thriftSocket.fd(), thriftSocketPath);
+  EXPECT_FALSE(clientData.cacheSnapshot);
+}
+
+TEST(Takeover, compactInodeMap) {
+  TemporaryDirectory tmpDir("eden_takeover_test");
+  AbsolutePathPiece tmpDirPath{tmpDir.path().string()};
+
+  TakeoverData serverData;
+  auto lockFilePath = tmpDirPath + "lock"_pc;
+  serverData.lockFile =
+      folly::File{lockFilePath.stringPiece(), O_RDWR | O_CREAT};
+  auto thriftSocketPath = tmpDirPath + "thrift"_pc;
+  serverData.thriftSocket =
+      folly::File{thriftSocketPath.stringPiece(), O_RDWR | O_CREAT};
+
+  // Only the second of the three mounts has an inode table.
+  std::vector<AbsolutePath> fusePaths;
+  for (size_t n = 1; n <= 3; ++n) {
+    fusePaths.push_back(
+        tmpDirPath + PathComponent{folly::to<string>("fuse", n)});
+    serverData.mountPoints.emplace_back(
+        tmpDirPath + PathComponent{folly::to<string>("mount", n)},
+        tmpDirPath + PathComponent{folly::to<string>("client", n)},
+        std::vector<AbsolutePath>{},
+        folly::File{fusePaths.back().stringPiece(), O_RDWR | O_CREAT},
+        fuse_init_out{},
+        SerializedFileHandleMap{},
+        SerializedInodeMap{});
+  }
+  auto inodeTablePath = tmpDirPath + "inodes"_pc;
+  serverData.mountPoints.at(1).inodeTable =
+      folly::File{inodeTablePath.stringPiece(), O_RDWR | O_CREAT};
+  auto snapshotPath = tmpDirPath + "snapshot"_pc;
+  serverData.cacheSnapshot =
+      folly::File{snapshotPath.stringPiece(), O_RDWR | O_CREAT};
+
+  auto serverSendFuture = serverData.takeoverComplete.getFuture();
+  TestHandler handler{std::move(serverData)};
+  auto result = runTakeover(tmpDir, &handler);
+  ASSERT_TRUE(serverSendFuture.hasValue());
+  ASSERT_TRUE(result.hasValue());
+  const auto& clientData = result.value();
+
+  ASSERT_EQ(3, clientData.mountPoints.size());
+  for (size_t n = 0; n < 3; ++n) {
+    const auto& mount = clientData.mountPoints.at(n);
+    checkExpectedFile(mount.fuseFD.fd(), fusePaths[n]);
+    EXPECT_EQ(n == 1, mount.inodeMap.hasCompactInodeMap);
+    EXPECT_EQ(n == 1, static_cast<bool>(mount.inodeTable));
+  }
+  checkExpectedFile(
+      clientData.mountPoints.at(1).inodeTable.fd(), inodeTablePath);
+  ASSERT_TRUE(clientData.cacheSnapshot);
+  checkExpectedFile(clientData.cacheSnapshot.fd(), snapshotPath);
+}
+
+TEST(Takeover, compactInodeMapConvertedForVersionFour) {
+  TemporaryDirectory tmpDir("eden_takeover_test");
+  AbsolutePathPiece tmpDirPath{tmpDir.path().string()};
+
+  TakeoverData serverData;
+  auto lockFilePath = tmpDirPath + "lock"_pc;
+  serverData.lockFile =
+      folly::File{lockFilePath.stringPiece(), O_RDWR | O_CREAT};
+  auto thriftSocketPath = tmpDirPath + "thrift"_pc;
+  serverData.thriftSocket =
+      folly::File{thriftSocketPath.stringPiece(), O_RDWR | O_CREAT};
+
+  auto mountFusePath = tmpDirPath + "fuse1"_pc;
+  serverData.mountPoints.emplace_back(
+      tmpDirPath + "mount1"_pc,
+      tmpDirPath + "client1"_pc,
+      std::vector<AbsolutePath>{},
+      folly::File{mountFusePath.stringPiece(), O_RDWR | O_CREAT},
+      fuse_init_out{},
+      SerializedFileHandleMap{},
+      SerializedInodeMap{});
+  CompactInodeMap::Entry entry;
+  entry.inodeNumber = 7;
+  entry.parentInode = 1;
+  entry.name = "foo";
+  entry.numFuseReferences = 3;
+  entry.mode = S_IFREG | 0644;
+  serverData.mountPoints.at(0).inodeTable = CompactInodeMap::write({entry});
+
+  // A version 4 client cannot read the inode table, so the server must send
+  // its contents in the thrift data instead.
+  auto serverSendFuture = serverData.takeoverComplete.getFuture();
+  TestHandler handler{std::move(serverData)};
+  auto result = runTakeover(
+      tmpDir,
+      &handler,
+      std::set<int32_t>{TakeoverData::kTakeoverProtocolVersionFour});
+  ASSERT_TRUE(serverSendFuture.hasValue());
+  ASSERT_TRUE(result.hasValue());
+  const auto& clientData = result.value();
+
+  ASSERT_EQ(1, clientData.mountPoints.size());
+  const auto& mount = clientData.mountPoints.at(0);
+  checkExpectedFile(mount.fuseFD.fd(), mountFusePath);
+  EXPECT_FALSE(mount.inodeMap.hasCompactInodeMap);
+  EXPECT_FALSE(mount.inodeTable);
+  ASSERT_EQ(1, mount.inodeMap.unloadedInodes.size());
+  EXPECT_EQ(7, mount.inodeMap.unloadedInodes[0].inodeNumber);
+  EXPECT_EQ("foo", mount.inodeMap.unloadedInodes[0].name);
+  EXPECT_EQ(3, mount.inodeMap.unloadedInodes[0].numFuseReferences);
+}
@@ -36,6 +36,7 @@
 #include "eden/fs/store/MemoryLocalStore.h"
 #include "eden/fs/store/ObjectStore.h"
 #include "eden/fs/store/hg/HgManifestImporter.h"
+#include "eden/fs/takeover/CompactInodeMap.h"
 #include "eden/fs/testharness/FakeBackingStore.h"
 #include "eden/fs/testharness/FakeClock.h"
 #include "eden/fs/testharness/FakeFuse.h"
@@ -262,13 +263,16 @@ void TestMount::remountGracefully() {
       << "All references to EdenMount should be released before calling "
          "remountGracefully()";
 
+  auto& inodeTable = std::get<2>(takeoverData);
   XLOG(DBG1) << "number of unloaded inodes transferred on graceful remount: "
-             << std::get<1>(takeoverData).unloadedInodes.size();
+             << (inodeTable ? CompactInodeMap{inodeTable}.size()
+                            : std::get<1>(takeoverData).unloadedInodes.size());
 
   // Create a new EdenMount object.
   edenMount_ = EdenMount::create(
       std::move(config), std::move(objectStore), blobCache_, serverState_);
-  edenMount_->initialize(std::get<1>(takeoverData)).get();
+  edenMount_->initialize(std::get<1>(takeoverData), std::move(inodeTable))
+      .get();
 }
 
 void TestMount::resetCommit(FakeTreeBuilder& builder, bool setReady) {
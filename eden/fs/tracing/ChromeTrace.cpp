@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/tracing/ChromeTrace.h"
+
+#include <folly/Exception.h>
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/json.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace facebook {
+namespace eden {
+
+namespace {
+
+/** Flush buffered output once it reaches this many bytes. */
+constexpr size_t kChunkSize = 64 * 1024;
+
+class ChunkedWriter {
+ public:
+  explicit ChunkedWriter(int fd) : fd_{fd} {
+    buffer_.reserve(kChunkSize + 1024);
+  }
+
+  template <typename... Args>
+  void append(Args&&... args) {
+    folly::toAppend(std::forward<Args>(args)..., &buffer_);
+    if (buffer_.size() >= kChunkSize) {
+      flush();
+    }
+  }
+
+  void appendEvent(folly::StringPiece event) {
+    if (!first_) {
+      buffer_.push_back(',');
+    }
+    first_ = false;
+    append("\n", event);
+  }
+
+  void flush() {
+    auto written = folly::writeFull(fd_, buffer_.data(), buffer_.size());
+    folly::checkUnixError(written, "error writing chrome trace");
+    buffer_.clear();
+  }
+
+ private:
+  int fd_;
+  bool first_{true};
+  std::string buffer_;
+};
+
+/** Chrome trace timestamps are floating point microseconds. */
+double toMicros(std::chrono::nanoseconds ns) {
+  return ns.count() / 1000.0;
+}
+
+std::string quoteName(const char* name) {
+  std::string result;
+  folly::json::escapeString(
+      name ? folly::StringPiece{name} : folly::StringPiece{"<unknown>"},
+      result,
+      folly::json::serialization_opts{});
+  return result;
+}
+
+} // namespace
+
+void writeChromeTrace(const std::vector<CompactTracePoint>& points, int fd) {
+  // Index the start and stop point for every block.  The ring buffer may have
+  // discarded one half of a block, so either may be missing.
+  std::unordered_map<uint64_t, const CompactTracePoint*> starts;
+  std::unordered_map<uint64_t, const CompactTracePoint*> stops;
+  for (const auto& point : points) {
+    if (point.start) {
+      starts.emplace(point.blockId, &point);
+    } else if (point.stop) {
+      stops.emplace(point.blockId, &point);
+    }
+  }
+  auto lastTimestamp =
+      points.empty() ? std::chrono::nanoseconds{0} : points.back().timestamp;
+  auto pid = getpid();
+
+  ChunkedWriter out{fd};
+  out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (const auto& point : points) {
+    if (!point.start) {
+      continue;
+    }
+
+    auto stopIter = stops.find(point.blockId);
+    bool incomplete = stopIter == stops.end();
+    auto args = folly::sformat(
+        "{{\"traceId\":\"{:x}\",\"blockId\":\"{:x}\","
+        "\"parentBlockId\":\"{:x}\"{}}}",
+        point.traceId,
+        point.blockId,
+        point.parentBlockId,
+        incomplete ? ",\"incomplete\":true" : "");
+    if (!incomplete && stopIter->second->async) {
+      // Asynchronous blocks overlap other work on the threads they start and
+      // stop on, so they cannot be complete events.  Emit them as a pair of
+      // async events that the viewer matches up by id instead.
+      const auto* stop = stopIter->second;
+      out.appendEvent(folly::sformat(
+          "{{\"name\":{},\"cat\":\"eden\",\"ph\":\"b\",\"id\":\"{:x}\","
+          "\"ts\":{:.3f},\"pid\":{},\"tid\":{},\"args\":{}}}",
+          quoteName(point.name),
+          point.blockId,
+          toMicros(point.timestamp),
+          pid,
+          point.threadId,
+          args));
+      out.appendEvent(folly::sformat(
+          "{{\"name\":{},\"cat\":\"eden\",\"ph\":\"e\",\"id\":\"{:x}\","
+          "\"ts\":{:.3f},\"pid\":{},\"tid\":{}}}",
+          quoteName(point.name),
+          point.blockId,
+          toMicros(stop->timestamp),
+          pid,
+          stop->threadId));
+    } else {
+      auto end = incomplete ? lastTimestamp : stopIter->second->timestamp;
+      out.appendEvent(folly::sformat(
+          "{{\"name\":{},\"cat\":\"eden\",\"ph\":\"X\",\"ts\":{:.3f},"
+          "\"dur\":{:.3f},\"pid\":{},\"tid\":{},\"args\":{}}}",
+          quoteName(point.name),
+          toMicros(point.timestamp),
+          toMicros(end - point.timestamp),
+          pid,
+          point.threadId,
+          args));
+    }
+
+    // Connect the child to its parent with a flow arrow.  The flow starts in
+    // the parent's slice at the moment the child was created, and binds to
+    // the enclosing (child) slice at its destination.
+    if (point.parentBlockId == 0) {
+      continue;
+    }
+    auto parentIter = starts.find(point.parentBlockId);
+    if (parentIter == starts.end()) {
+      continue;
+    }
+    const auto* parent = parentIter->second;
+    out.appendEvent(folly::sformat(
+        "{{\"name\":{},\"cat\":\"eden.flow\",\"ph\":\"s\",\"id\":\"{:x}\","
+        "\"ts\":{:.3f},\"pid\":{},\"tid\":{}}}",
+        quoteName(point.name),
+        point.blockId,
+        toMicros(point.timestamp),
+        pid,
+        parent->threadId));
+    out.appendEvent(folly::sformat(
+        "{{\"name\":{},\"cat\":\"eden.flow\",\"ph\":\"f\",\"bp\":\"e\","
+        "\"id\":\"{:x}\",\"ts\":{:.3f},\"pid\":{},\"tid\":{}}}",
+        quoteName(point.name),
+        point.blockId,
+        toMicros(point.timestamp),
+        pid,
+        point.threadId));
+  }
+  out.append("\n]}\n");
+  out.flush();
+}
+
+size_t exportChromeTrace(folly::StringPiece path) {
+  auto points = getAllTracepoints();
+
+  auto tmpPath = folly::to<std::string>(path, ".tmp");
+  {
+    folly::File file{tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644};
+    writeChromeTrace(points, file.fd());
+    folly::checkUnixError(fsync(file.fd()), "error syncing ", tmpPath);
+  }
+  folly::checkUnixError(
+      rename(tmpPath.c_str(), path.str().c_str()),
+      "error renaming ",
+      tmpPath,
+      " to ",
+      path);
+  return points.size();
+}
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <vector>
+
+#include "eden/fs/tracing/Tracing.h"
+
+namespace facebook {
+namespace eden {
+
+/**
+ * Write tracepoints to fd in the Chrome trace event JSON format, which can be
+ * loaded by chrome://tracing and by the Perfetto UI.
+ *
+ * The points must be sorted by timestamp, as returned by
+ * getAllTracepoints().  Each block becomes a complete ("X") event on
+ * the thread that started it, except for blocks that were moved into
+ * asynchronous work, which become async begin/end ("b"/"e") events keyed by
+ * their block id.  Each parent/child relationship becomes a
+ * flow event so that work handed off to other threads stays connected to
+ * the request that caused it.  Blocks that have not finished are extended to
+ * the last recorded timestamp and flagged with an "incomplete" argument.
+ *
+ * The output is written incrementally in fixed size chunks rather than being
+ * built up in memory first.  Throws std::system_error on write failures.
+ */
+void writeChromeTrace(const std::vector<CompactTracePoint>& points, int fd);
+
+/**
+ * Write the currently buffered tracepoints to the file at path.
+ *
+ * Like getAllTracepoints() this consumes the tracepoints, so repeated exports
+ * of continuous tracing do not overlap.  A block that is still running is
+ * exported as incomplete, and its stop tracepoint is dropped by the next
+ * export.
+ *
+ * The data is written to a temporary file next to path and renamed into
+ * place, so readers never observe a partially written trace.  Returns the
+ * number of tracepoints written.
+ */
+size_t exportChromeTrace(folly::StringPiece path);
+
+} // namespace eden
+} // namespace facebook
@@ -9,6 +9,8 @@
  */
 #include "Tracing.h"
 
+#include <algorithm>
+
 namespace facebook {
 namespace eden {
 namespace detail {
@@ -18,24 +20,48 @@ void ThreadLocalTracePoints::flush() {
   auto points = globalTracer.tracepoints_.wlock();
   auto state = state_.lock();
   size_t npoints = std::min(kBufferPoints, state->currNum_);
-  points->insert(
-      points->end(),
-      state->tracePoints_.begin(),
-      state->tracePoints_.begin() + npoints);
+  // Once the ring has wrapped, the oldest point is the next one that
+  // would be overwritten.
+  size_t first =
+      state->currNum_ > kBufferPoints ? state->currNum_ % kBufferPoints : 0;
+  auto oldSize = points->size();
+  points->reserve(oldSize + npoints);
+  for (size_t i = 0; i < npoints; ++i) {
+    points->push_back(state->tracePoints_[(first + i) % kBufferPoints]);
+  }
   state->currNum_ = 0;
+
+  // A thread records its points in timestamp order, so merging them in
+  // keeps tracepoints_ sorted without re-sorting it on every flush.
+  std::inplace_merge(
+      points->begin(),
+      points->begin() + oldSize,
+      points->end(),
+      [](const auto& a, const auto& b) { return a.timestamp < b.timestamp; });
+  globalTracer.trimLocked(*points);
 }
 
 folly::RequestToken tracingToken("eden_tracing");
 
-std::vector<CompactTracePoint> Tracer::getAllTracepoints() {
+folly::Synchronized<std::vector<CompactTracePoint>>::LockedPtr
+Tracer::flushAllThreads() {
   for (auto& tltp : tltp_.accessAllThreads()) {
     tltp.flush();
   }
-  auto points = tracepoints_.wlock();
-  std::sort(points->begin(), points->end(), [](const auto& a, const auto& b) {
-    return a.timestamp < b.timestamp;
-  });
-  return std::move(*points);
+  return tracepoints_.wlock();
+}
+
+void Tracer::trimLocked(std::vector<CompactTracePoint>& points) {
+  auto maxPoints = getMaxBufferedTracepoints();
+  if (maxPoints == 0 || points.size() <= maxPoints) {
+    return;
+  }
+  // flush() keeps points in timestamp order, so the oldest are at the front.
+  points.erase(points.begin(), points.end() - maxPoints);
+}
+
+std::vector<CompactTracePoint> Tracer::getAllTracepoints() {
+  return std::move(*flushAllThreads());
 }
 } // namespace detail
 } // namespace eden
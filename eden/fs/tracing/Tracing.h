@@ -18,6 +18,7 @@
 #include <folly/ThreadLocal.h>
 #include <folly/io/async/Request.h>
 #include <folly/logging/xlog.h>
+#include <folly/system/ThreadId.h>
 
 #include "eden/fs/utils/IDGen.h"
 
@@ -43,6 +44,11 @@ struct CompactTracePoint {
   // Flags indicating whether this block is starting, stopping, or neither
   uint8_t start : 1;
   uint8_t stop : 1;
+  // Set on the stop tracepoint of a block that was handed off to
+  // asynchronous work, and so may overlap other blocks on its threads
+  uint8_t async : 1;
+  // The OS thread id of the thread that recorded this tracepoint
+  uint32_t threadId;
 };
 
 // It's nice for each tracepoint to fit inside a single cache line
@@ -55,7 +61,8 @@ class ThreadLocalTracePoints {
   static constexpr size_t kBufferPoints = 16 * 1024;
 
  public:
-  ThreadLocalTracePoints() = default;
+  ThreadLocalTracePoints()
+      : threadId_{static_cast<uint32_t>(folly::getOSThreadID())} {}
   ~ThreadLocalTracePoints() {
     flush();
   }
@@ -68,7 +75,8 @@ class ThreadLocalTracePoints {
       uint64_t parentBlockId,
       const char* name,
       bool start,
-      bool stop) {
+      bool stop,
+      bool async = false) {
     auto state = state_.lock();
     auto& tp = state->tracePoints_[state->currNum_++ % kBufferPoints];
     tp.traceId = traceId;
@@ -77,6 +85,8 @@ class ThreadLocalTracePoints {
     tp.name = name;
     tp.start = start;
     tp.stop = stop;
+    tp.async = async;
+    tp.threadId = threadId_;
     tp.timestamp = std::chrono::nanoseconds(
         folly::chrono::clock_gettime_ns(CLOCK_MONOTONIC));
   }
@@ -87,6 +97,7 @@ class ThreadLocalTracePoints {
     std::array<CompactTracePoint, kBufferPoints> tracePoints_;
   };
 
+  const uint32_t threadId_;
   folly::Synchronized<State, folly::SpinLock> state_;
 };
 
@@ -123,6 +134,14 @@ class Tracer {
 
   std::vector<CompactTracePoint> getAllTracepoints();
 
+  size_t getMaxBufferedTracepoints() const noexcept {
+    return maxBufferedPoints_.load(std::memory_order_relaxed);
+  }
+
+  void setMaxBufferedTracepoints(size_t maxPoints) noexcept {
+    maxBufferedPoints_.store(maxPoints, std::memory_order_relaxed);
+  }
+
   bool isEnabled() noexcept {
     return enabled_->load(std::memory_order_acquire);
   }
@@ -139,13 +158,29 @@ class Tracer {
   friend class ThreadLocalTracePoints;
   struct Tag {};
 
+  /**
+   * Flush every thread's buffer into tracepoints_ and return it locked.
+   */
+  folly::Synchronized<std::vector<CompactTracePoint>>::LockedPtr
+  flushAllThreads();
+
+  /**
+   * Drop the oldest tracepoints from tracepoints_ if it has grown past
+   * maxBufferedPoints_.  Called with the tracepoints_ lock held.
+   */
+  void trimLocked(std::vector<CompactTracePoint>& points);
+
   folly::CachelinePadded<std::atomic<bool>> enabled_{false};
+  // The maximum number of flushed tracepoints to retain, or 0 for no limit
+  std::atomic<size_t> maxBufferedPoints_{0};
   folly::ThreadLocal<ThreadLocalTracePoints, Tag, folly::AccessModeStrict>
       tltp_;
   // This is written to only when a thread dies and when
   // getAllTracepoints is invoked, though the latter will leave it
-  // empty. As long as threads aren't continuously being created and
-  // destroyed while tracing is on, this shouldn't grow large
+  // empty. As long as threads aren't continuously
+  // being created and destroyed while tracing is on, this shouldn't grow
+  // large. When maxBufferedPoints_ is set it acts as a ring buffer and
+  // the oldest points are discarded. Kept in timestamp order.
   folly::Synchronized<std::vector<CompactTracePoint>> tracepoints_;
 };
 
@@ -175,6 +210,18 @@ inline std::vector<CompactTracePoint> getAllTracepoints() {
   return detail::globalTracer.getAllTracepoints();
 }
 
+/*
+ * Bound the number of tracepoints retained between calls to
+ * getAllTracepoints(). Once the limit is reached the oldest
+ * tracepoints are discarded, which makes it safe to leave tracing
+ * enabled indefinitely. A limit of 0 disables the bound. Note that
+ * each thread additionally buffers a fixed number of recent
+ * tracepoints before they are counted against this limit.
+ */
+inline void setMaxBufferedTracepoints(size_t maxPoints) {
+  detail::globalTracer.setMaxBufferedTracepoints(maxPoints);
+}
+
 /*
  * TraceBlocks demark sections of eden's execution so we can analyze
  * the behavior of a request in a fine-grained fashion.
@@ -189,6 +236,12 @@ inline std::vector<CompactTracePoint> getAllTracepoints() {
  * TraceBlocks can be nested by creating multiple TraceBlocks before
  * destroying or close()ing one.
  *
+ * Moving a TraceBlock, typically into a future callback, makes it
+ * asynchronous: it stops being the request's current block right away,
+ * so blocks created afterwards are not nested inside it, and closing it
+ * later on whatever thread completes the future only records its stop
+ * tracepoint.
+ *
  * Creating the first TraceBlock of a * request (FUSE, thrift, or
  * otherwise) will allocate a traceId which will be used to
  * associate all the future TraceBlocks of the request.
@@ -201,37 +254,26 @@ class TraceBlock {
    */
   template <size_t size>
   explicit TraceBlock(const char (&name)[size]) {
-    if (detail::globalTracer.isEnabled()) {
-      blockId_ = generateUniqueID();
-      auto& reqData = detail::Tracer::getRequestData();
-      if (!reqData.traceId) {
-        reqData.traceId = generateUniqueID();
-      }
+    start(name);
+  }
 
-      parentBlockId_ = reqData.blockId;
-      detail::globalTracer.getThreadLocalTracePoints().trace(
-          reqData.traceId,
-          blockId_,
-          parentBlockId_,
-          name,
-          /* start = */ true,
-          /* stop = */ false);
-      reqData.blockId = blockId_;
-    }
+  /**
+   * Construct a TraceBlock whose name is only known at runtime, such as
+   * one chosen from a table of string literals. The caller must ensure
+   * that name points to a statically allocated cstring.
+   */
+  static TraceBlock withStaticName(const char* name) {
+    return TraceBlock{name, StaticName{}};
   }
 
   TraceBlock(const TraceBlock&) = delete;
   TraceBlock& operator=(const TraceBlock&) = delete;
   TraceBlock(TraceBlock&& other) noexcept {
-    blockId_ = other.blockId_;
-    parentBlockId_ = other.parentBlockId_;
-    other.blockId_ = 0;
+    takeFrom(other);
   }
   TraceBlock& operator=(TraceBlock&& other) {
     close();
-    blockId_ = other.blockId_;
-    parentBlockId_ = other.parentBlockId_;
-    other.blockId_ = 0;
+    takeFrom(other);
     return *this;
   }
 
@@ -244,22 +286,80 @@ class TraceBlock {
    */
   void close() {
     if (blockId_) {
-      auto& reqData = detail::Tracer::getRequestData();
       detail::globalTracer.getThreadLocalTracePoints().trace(
-          reqData.traceId,
+          traceId_,
           blockId_,
           parentBlockId_,
           nullptr,
           /* start = */ false,
-          /* stop = */ true);
-      reqData.blockId = parentBlockId_;
+          /* stop = */ true,
+          async_);
+      if (!async_) {
+        popCurrentBlock();
+      }
       blockId_ = 0;
     }
   }
 
  private:
+  struct StaticName {};
+
+  TraceBlock(const char* name, StaticName) {
+    start(name);
+  }
+
+  void start(const char* name) {
+    if (detail::globalTracer.isEnabled()) {
+      blockId_ = generateUniqueID();
+      auto& reqData = detail::Tracer::getRequestData();
+      if (!reqData.traceId) {
+        reqData.traceId = generateUniqueID();
+      }
+
+      traceId_ = reqData.traceId;
+      parentBlockId_ = reqData.blockId;
+      detail::globalTracer.getThreadLocalTracePoints().trace(
+          traceId_,
+          blockId_,
+          parentBlockId_,
+          name,
+          /* start = */ true,
+          /* stop = */ false);
+      reqData.blockId = blockId_;
+    }
+  }
+
+  /**
+   * Called from the move operations, while still in the scope that
+   * created the block.
+   */
+  void takeFrom(TraceBlock& other) noexcept {
+    traceId_ = other.traceId_;
+    blockId_ = other.blockId_;
+    parentBlockId_ = other.parentBlockId_;
+    async_ = true;
+    if (blockId_ && !other.async_) {
+      popCurrentBlock();
+    }
+    other.blockId_ = 0;
+  }
+
+  /**
+   * Make this block's parent the request's current block again, unless
+   * a block started since then has not been closed yet.
+   */
+  void popCurrentBlock() noexcept {
+    auto& reqData = detail::Tracer::getRequestData();
+    if (reqData.blockId == blockId_) {
+      reqData.blockId = parentBlockId_;
+    }
+  }
+
+  uint64_t traceId_{0};
   uint64_t blockId_{0};
   uint64_t parentBlockId_{0};
+  // Set once the block has been moved out of the scope that started it
+  bool async_{false};
 };
 
 } // namespace eden
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/tracing/ChromeTrace.h"
+
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/json.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::eden;
+
+namespace {
+folly::dynamic exportAndParse() {
+  folly::test::TemporaryDirectory dir;
+  auto path = (dir.path() / "trace.json").string();
+  exportChromeTrace(path);
+
+  std::string contents;
+  EXPECT_TRUE(folly::readFile(path.c_str(), contents));
+  return folly::parseJson(contents);
+}
+
+std::vector<folly::dynamic> eventsWithPhase(
+    const folly::dynamic& trace,
+    folly::StringPiece phase) {
+  std::vector<folly::dynamic> result;
+  for (const auto& event : trace["traceEvents"]) {
+    if (event["ph"].asString() == phase) {
+      result.push_back(event);
+    }
+  }
+  return result;
+}
+} // namespace
+
+TEST(ChromeTrace, exports_nested_blocks_with_flow) {
+  enableTracing();
+  getAllTracepoints();
+  {
+    TraceBlock outer{"outer"};
+    TraceBlock inner{"inner"};
+  }
+
+  auto trace = exportAndParse();
+  auto complete = eventsWithPhase(trace, "X");
+  ASSERT_EQ(2, complete.size());
+  EXPECT_EQ("outer", complete[0]["name"].asString());
+  EXPECT_EQ("inner", complete[1]["name"].asString());
+  EXPECT_GE(complete[0]["dur"].asDouble(), complete[1]["dur"].asDouble());
+  EXPECT_EQ(
+      complete[1]["args"]["parentBlockId"], complete[0]["args"]["blockId"]);
+
+  auto flowStarts = eventsWithPhase(trace, "s");
+  auto flowEnds = eventsWithPhase(trace, "f");
+  ASSERT_EQ(1, flowStarts.size());
+  ASSERT_EQ(1, flowEnds.size());
+  EXPECT_EQ(flowStarts[0]["id"], flowEnds[0]["id"]);
+  EXPECT_EQ(complete[1]["args"]["blockId"], flowStarts[0]["id"]);
+
+  // Exporting consumes the buffered points.
+  EXPECT_EQ(0, getAllTracepoints().size());
+}
+
+TEST(ChromeTrace, marks_unfinished_blocks_incomplete) {
+  enableTracing();
+  getAllTracepoints();
+  TraceBlock open{"still_running"};
+  { TraceBlock done{"done"}; }
+
+  auto trace = exportAndParse();
+  auto complete = eventsWithPhase(trace, "X");
+  ASSERT_EQ(2, complete.size());
+  EXPECT_EQ("still_running", complete[0]["name"].asString());
+  EXPECT_TRUE(complete[0]["args"].getDefault("incomplete", false).asBool());
+  EXPECT_FALSE(complete[1]["args"].getDefault("incomplete", false).asBool());
+}
+
+TEST(ChromeTrace, exports_moved_blocks_as_async_events) {
+  enableTracing();
+  getAllTracepoints();
+  {
+    TraceBlock block{"async"};
+    auto moved = std::move(block);
+    TraceBlock sync{"sync"};
+  }
+
+  auto trace = exportAndParse();
+  auto complete = eventsWithPhase(trace, "X");
+  ASSERT_EQ(1, complete.size());
+  EXPECT_EQ("sync", complete[0]["name"].asString());
+
+  auto begins = eventsWithPhase(trace, "b");
+  auto ends = eventsWithPhase(trace, "e");
+  ASSERT_EQ(1, begins.size());
+  ASSERT_EQ(1, ends.size());
+  EXPECT_EQ("async", begins[0]["name"].asString());
+  EXPECT_EQ(begins[0]["args"]["blockId"], begins[0]["id"]);
+  EXPECT_EQ(begins[0]["id"], ends[0]["id"]);
+  EXPECT_GE(ends[0]["ts"].asDouble(), begins[0]["ts"].asDouble());
+}
@@ -9,8 +9,13 @@
  */
 #include <gtest/gtest.h>
 
+#include <folly/Optional.h>
 #include <folly/executors/ThreadedExecutor.h>
 #include <folly/futures/Future.h>
+#include <folly/io/async/Request.h>
+#include <folly/system/ThreadId.h>
+#include <algorithm>
+#include <thread>
 
 #include "eden/fs/tracing/Tracing.h"
 
@@ -129,3 +134,91 @@ TEST(Tracing, does_not_record_if_disabled) {
   auto points = getAllTracepoints();
   ASSERT_EQ(points.size(), 0);
 }
+
+TEST(Tracing, ring_buffer_discards_oldest_points) {
+  enableTracing();
+  setMaxBufferedTracepoints(4);
+  { TraceBlock block{"first"}; }
+  { TraceBlock block{"second"}; }
+  { TraceBlock block{"third"}; }
+
+  auto points = getAllTracepoints();
+  setMaxBufferedTracepoints(0);
+  ensureValidTracePoints(points, 4);
+  EXPECT_STREQ(points[0].name, "second");
+  EXPECT_STREQ(points[2].name, "third");
+}
+
+TEST(Tracing, records_thread_id) {
+  enableTracing();
+  uint32_t otherThreadId = 0;
+  std::thread thread{[&] {
+    otherThreadId = static_cast<uint32_t>(folly::getOSThreadID());
+    TraceBlock block{"my_block"};
+  }};
+  thread.join();
+
+  auto points = getAllTracepoints();
+  ensureValidTracePoints(points, 2);
+  EXPECT_EQ(otherThreadId, points[0].threadId);
+  EXPECT_EQ(otherThreadId, points[1].threadId);
+}
+
+TEST(Tracing, moved_block_is_no_longer_the_parent) {
+  enableTracing();
+  folly::RequestContextScopeGuard requestScope;
+  TraceBlock outer{"outer"};
+  auto moved = std::move(outer);
+  { TraceBlock sibling{"sibling"}; }
+  moved.close();
+
+  auto points = getAllTracepoints();
+  ensureValidTracePoints(points, 4);
+  EXPECT_STREQ(points[1].name, "sibling");
+  EXPECT_EQ(points[0].parentBlockId, points[1].parentBlockId);
+  EXPECT_FALSE(points[2].async);
+  EXPECT_TRUE(points[3].async);
+}
+
+TEST(Tracing, async_close_leaves_other_requests_alone) {
+  enableTracing();
+  folly::Optional<TraceBlock> async;
+  {
+    folly::RequestContextScopeGuard requestScope;
+    TraceBlock block{"async"};
+    async = std::move(block);
+  }
+
+  std::thread thread{[&] {
+    folly::RequestContextScopeGuard requestScope;
+    TraceBlock current{"current"};
+    async->close();
+    TraceBlock child{"child"};
+  }};
+  thread.join();
+
+  auto points = getAllTracepoints();
+  ensureValidTracePoints(points, 6);
+  EXPECT_STREQ(points[1].name, "current");
+  EXPECT_STREQ(points[3].name, "child");
+  EXPECT_EQ(points[1].blockId, points[3].parentBlockId);
+  EXPECT_NE(points[0].traceId, points[1].traceId);
+  EXPECT_EQ(points[0].traceId, points[2].traceId);
+}
+
+TEST(Tracing, merges_threads_in_timestamp_order) {
+  enableTracing();
+  getAllTracepoints();
+  for (int i = 0; i < 3; ++i) {
+    std::thread thread{[] { TraceBlock block{"my_block"}; }};
+    thread.join();
+    TraceBlock block{"my_block"};
+  }
+
+  auto points = getAllTracepoints();
+  ensureValidTracePoints(points, 12);
+  EXPECT_TRUE(std::is_sorted(
+      points.begin(), points.end(), [](const auto& a, const auto& b) {
+        return a.timestamp < b.timestamp;
+      }));
+}
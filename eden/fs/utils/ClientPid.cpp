@@ -0,0 +1,33 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/utils/ClientPid.h"
+
+namespace facebook {
+namespace eden {
+
+namespace {
+folly::RequestToken clientPidToken{"eden_client_pid"};
+} // namespace
+
+void ClientPidRequestData::set(pid_t pid) {
+  folly::RequestContext::get()->setContextData(
+      clientPidToken, std::make_unique<ClientPidRequestData>(pid));
+}
+
+std::optional<pid_t> ClientPidRequestData::get() {
+  auto* data = folly::RequestContext::get()->getContextData(clientPidToken);
+  if (!data) {
+    return std::nullopt;
+  }
+  return static_cast<ClientPidRequestData*>(data)->getPid();
+}
+
+} // namespace eden
+} // namespace facebook
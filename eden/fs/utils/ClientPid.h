@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/io/async/Request.h>
+#include <sys/types.h>
+#include <optional>
+
+namespace facebook {
+namespace eden {
+
+/**
+ * Records, in the folly::RequestContext, the pid of the client process on
+ * whose behalf the current request runs.
+ *
+ * The RequestContext follows the request through its future chain, so the
+ * layers below the one that received the request, such as the ObjectStore,
+ * can attribute the work they do to the process that caused it.
+ */
+class ClientPidRequestData : public folly::RequestData {
+ public:
+  explicit ClientPidRequestData(pid_t pid) : pid_{pid} {}
+
+  bool hasCallback() override {
+    return false;
+  }
+
+  pid_t getPid() const {
+    return pid_;
+  }
+
+  /**
+   * Set the client pid of the current RequestContext.
+   */
+  static void set(pid_t pid);
+
+  /**
+   * Returns the client pid of the current RequestContext, or std::nullopt
+   * if the current work was not started by a client request.
+   */
+  static std::optional<pid_t> get();
+
+ private:
+  const pid_t pid_;
+};
+
+} // namespace eden
+} // namespace facebook
@@ -0,0 +1,209 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/utils/IoUring.h"
+
+#ifdef EDEN_HAVE_IO_URING
+
+#include <folly/Exception.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace facebook {
+namespace eden {
+
+namespace {
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(
+    int fd,
+    unsigned toSubmit,
+    unsigned minComplete,
+    unsigned flags) {
+  return static_cast<int>(syscall(
+      __NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+void* mapRing(int fd, size_t size, off_t offset) {
+  auto* ptr = mmap(
+      nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+      offset);
+  if (ptr == MAP_FAILED) {
+    folly::throwSystemError("failed to map io_uring ring");
+  }
+  return ptr;
+}
+
+template <typename T>
+T* ringField(void* ring, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+} // namespace
+
+IoUring::IoUring(unsigned entries) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  auto fd = ioUringSetup(entries, &params);
+  folly::checkUnixError(fd, "io_uring_setup failed");
+  ringFd_ = folly::File{fd, /*ownsFd=*/true};
+
+  // prepareReadv() and prepareWritev() pass an offset of -1 to use the
+  // current file position, which older kernels reject.
+  const auto required = IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_RW_CUR_POS;
+  if ((params.features & required) != required) {
+    throw std::system_error(
+        ENOSYS, std::generic_category(), "io_uring is too old");
+  }
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+
+  // Release whatever we managed to map if a later step fails.
+  try {
+    sqRing_ = mapRing(fd, sqRingSize_, IORING_OFF_SQ_RING);
+    cqRing_ = mapRing(fd, cqRingSize_, IORING_OFF_CQ_RING);
+    sqes_ = static_cast<io_uring_sqe*>(mapRing(fd, sqesSize_, IORING_OFF_SQES));
+  } catch (...) {
+    if (sqRing_) {
+      munmap(sqRing_, sqRingSize_);
+    }
+    if (cqRing_) {
+      munmap(cqRing_, cqRingSize_);
+    }
+    throw;
+  }
+
+  sqHead_ = ringField<unsigned>(sqRing_, params.sq_off.head);
+  sqTail_ = ringField<unsigned>(sqRing_, params.sq_off.tail);
+  sqRingMask_ = ringField<unsigned>(sqRing_, params.sq_off.ring_mask);
+  sqRingEntries_ = ringField<unsigned>(sqRing_, params.sq_off.ring_entries);
+  sqArray_ = ringField<unsigned>(sqRing_, params.sq_off.array);
+
+  cqHead_ = ringField<unsigned>(cqRing_, params.cq_off.head);
+  cqTail_ = ringField<unsigned>(cqRing_, params.cq_off.tail);
+  cqRingMask_ = ringField<unsigned>(cqRing_, params.cq_off.ring_mask);
+  cqes_ = ringField<io_uring_cqe>(cqRing_, params.cq_off.cqes);
+
+  localSqTail_ = submittedSqTail_ = *sqTail_;
+}
+
+IoUring::~IoUring() {
+  munmap(sqes_, sqesSize_);
+  munmap(cqRing_, cqRingSize_);
+  munmap(sqRing_, sqRingSize_);
+  // ringFd_ is closed after this, which cancels any requests that are still
+  // in progress.
+}
+
+bool IoUring::isSupported() {
+  try {
+    IoUring ring{1};
+    return true;
+  } catch (const std::system_error&) {
+    return false;
+  }
+}
+
+io_uring_sqe* IoUring::getSqe() {
+  auto head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  if (localSqTail_ - head >= *sqRingEntries_) {
+    return nullptr;
+  }
+  auto index = localSqTail_ & *sqRingMask_;
+  ++localSqTail_;
+  sqArray_[index] = index;
+  auto* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+bool IoUring::prepareReadv(
+    int fd,
+    const iovec* iov,
+    unsigned count,
+    uint64_t userData) {
+  auto* sqe = getSqe();
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(iov);
+  sqe->len = count;
+  // An offset of -1 reads from the current file position, which is what
+  // read() does for devices and sockets.
+  sqe->off = static_cast<uint64_t>(-1);
+  sqe->user_data = userData;
+  return true;
+}
+
+bool IoUring::prepareWritev(
+    int fd,
+    const iovec* iov,
+    unsigned count,
+    uint64_t userData) {
+  auto* sqe = getSqe();
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(iov);
+  sqe->len = count;
+  sqe->off = static_cast<uint64_t>(-1);
+  sqe->user_data = userData;
+  return true;
+}
+
+bool IoUring::prepareCancel(uint64_t targetUserData, uint64_t userData) {
+  auto* sqe = getSqe();
+  if (!sqe) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = targetUserData;
+  sqe->user_data = userData;
+  return true;
+}
+
+void IoUring::submitAndWait(unsigned minComplete) {
+  __atomic_store_n(sqTail_, localSqTail_, __ATOMIC_RELEASE);
+  auto toSubmit = localSqTail_ - submittedSqTail_;
+  auto flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    auto res = ioUringEnter(ringFd_.fd(), toSubmit, minComplete, flags);
+    if (res >= 0) {
+      // With IORING_FEAT_SUBMIT_STABLE the kernel consumes every entry we
+      // hand it unless it returns an error.
+      submittedSqTail_ += static_cast<unsigned>(res);
+      toSubmit -= static_cast<unsigned>(res);
+      if (toSubmit == 0 || minComplete > 0) {
+        return;
+      }
+    } else if (errno != EINTR) {
+      folly::throwSystemError("io_uring_enter failed");
+    } else if (minComplete > 0) {
+      // Interrupted while waiting; the caller will check for completions
+      // and call us again.
+      return;
+    }
+  }
+}
+
+} // namespace eden
+} // namespace facebook
+
+#endif // EDEN_HAVE_IO_URING
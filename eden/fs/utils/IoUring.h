@@ -0,0 +1,150 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/File.h>
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+
+// Require a kernel header new enough to have IORING_OP_ASYNC_CANCEL, which
+// arrived in the same release as IORING_FEAT_SUBMIT_STABLE, and
+// IORING_FEAT_RW_CUR_POS, which followed it.
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_FEAT_SUBMIT_STABLE) && defined(IORING_FEAT_RW_CUR_POS)
+#define EDEN_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace facebook {
+namespace eden {
+
+#ifdef EDEN_HAVE_IO_URING
+
+/**
+ * A minimal wrapper around a Linux io_uring submission/completion queue pair.
+ *
+ * Requests are queued with the prepare*() methods, handed to the kernel with
+ * submitAndWait(), and their results are collected with reapCompletions().
+ * Each request carries a caller-chosen 64-bit tag that is returned with its
+ * completion.
+ *
+ * IoUring is not thread-safe: each instance is intended to be owned and used
+ * by a single thread.  Any memory referenced by a queued request must remain
+ * valid until that request's completion has been reaped, or until the IoUring
+ * has been destroyed.
+ */
+class IoUring {
+ public:
+  /**
+   * Create a ring with room for at least the given number of queued
+   * requests.  Throws std::system_error if the kernel does not support
+   * io_uring.
+   */
+  explicit IoUring(unsigned entries);
+  ~IoUring();
+
+  /**
+   * Returns true if the running kernel supports io_uring with all of the
+   * features used by this class.
+   */
+  static bool isSupported();
+
+  /**
+   * Queue a readv() or writev() request.
+   *
+   * Returns false without queueing anything if the submission queue is full.
+   * Callers may call submitAndWait(0) to make room and then retry.
+   */
+  bool prepareReadv(
+      int fd,
+      const iovec* iov,
+      unsigned count,
+      uint64_t userData);
+  bool prepareWritev(
+      int fd,
+      const iovec* iov,
+      unsigned count,
+      uint64_t userData);
+
+  /**
+   * Queue a request to cancel the queued or in-progress request with the
+   * given tag.  The cancelled request still produces a completion, normally
+   * with a -ECANCELED or -EINTR result.
+   */
+  bool prepareCancel(uint64_t targetUserData, uint64_t userData);
+
+  /**
+   * Hand all queued requests to the kernel, and then block until at least
+   * minComplete completions are available to reap.
+   */
+  void submitAndWait(unsigned minComplete);
+
+  /**
+   * Invoke fn(userData, result) for each available completion, where result
+   * is the return value of the equivalent syscall or a negated errno value.
+   *
+   * Returns the number of completions processed.
+   */
+  template <typename Fn>
+  size_t reapCompletions(Fn&& fn) {
+    size_t count = 0;
+    auto head = *cqHead_;
+    while (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+      const auto& cqe = cqes_[head & *cqRingMask_];
+      auto userData = cqe.user_data;
+      auto res = cqe.res;
+      ++head;
+      // Release the slot before invoking the callback, since the callback
+      // may queue and submit more requests.
+      __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+      fn(userData, res);
+      ++count;
+    }
+    return count;
+  }
+
+ private:
+  IoUring(IoUring const&) = delete;
+  IoUring& operator=(IoUring const&) = delete;
+
+  io_uring_sqe* getSqe();
+
+  folly::File ringFd_;
+
+  void* sqRing_{nullptr};
+  size_t sqRingSize_{0};
+  void* cqRing_{nullptr};
+  size_t cqRingSize_{0};
+  io_uring_sqe* sqes_{nullptr};
+  size_t sqesSize_{0};
+
+  unsigned* sqHead_{nullptr};
+  unsigned* sqTail_{nullptr};
+  unsigned* sqRingMask_{nullptr};
+  unsigned* sqRingEntries_{nullptr};
+  unsigned* sqArray_{nullptr};
+
+  unsigned* cqHead_{nullptr};
+  unsigned* cqTail_{nullptr};
+  unsigned* cqRingMask_{nullptr};
+  io_uring_cqe* cqes_{nullptr};
+
+  /** Requests are queued locally up to here before being submitted. */
+  unsigned localSqTail_{0};
+  /** The value of *sqTail_ as of the last submission. */
+  unsigned submittedSqTail_{0};
+};
+
+#endif // EDEN_HAVE_IO_URING
+
+} // namespace eden
+} // namespace facebook
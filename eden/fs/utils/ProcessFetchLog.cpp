@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/utils/ProcessFetchLog.h"
+
+#include "eden/fs/utils/ClientPid.h"
+
+namespace facebook {
+namespace eden {
+
+namespace {
+void mergeCounts(
+    std::unordered_map<pid_t, ProcessFetchLog::Counts>& into,
+    const std::unordered_map<pid_t, ProcessFetchLog::Counts>& from) {
+  for (const auto& [pid, counts] : from) {
+    into[pid].merge(counts);
+  }
+}
+} // namespace
+
+void ProcessFetchLog::Counts::merge(const Counts& other) {
+  blobFetches += other.blobFetches;
+  treeFetches += other.treeFetches;
+  fetchedBytes += other.fetchedBytes;
+  fetchTime += other.fetchTime;
+  materializations += other.materializations;
+}
+
+ProcessFetchLog::ThreadBucket::~ThreadBucket() {
+  // This thread is going away, so keep its counts in the owner.
+  auto exited = owner->exitedThreads_.lock();
+  mergeCounts(*exited, *counts.lock());
+}
+
+ProcessFetchLog::ProcessFetchLog()
+    : buckets_{[this] { return new ThreadBucket{this}; }} {}
+
+ProcessFetchLog::~ProcessFetchLog() {}
+
+template <typename Fn>
+void ProcessFetchLog::record(Fn&& fn) {
+  auto pid = ClientPidRequestData::get();
+  if (!pid) {
+    return;
+  }
+  fn((*buckets_->counts.lock())[*pid]);
+}
+
+void ProcessFetchLog::recordBlobFetch(
+    size_t bytes,
+    std::chrono::microseconds elapsed) {
+  record([&](Counts& counts) {
+    ++counts.blobFetches;
+    counts.fetchedBytes += bytes;
+    counts.fetchTime += elapsed;
+  });
+}
+
+void ProcessFetchLog::recordTreeFetch(std::chrono::microseconds elapsed) {
+  record([&](Counts& counts) {
+    ++counts.treeFetches;
+    counts.fetchTime += elapsed;
+  });
+}
+
+void ProcessFetchLog::recordMaterialization() {
+  record([](Counts& counts) { ++counts.materializations; });
+}
+
+std::unordered_map<pid_t, ProcessFetchLog::Counts>
+ProcessFetchLog::getAllCounts() {
+  // No thread can exit, and move its counts to exitedThreads_, while we hold
+  // the accessor, so every thread's counts are seen exactly once.
+  auto accessor = buckets_.accessAllThreads();
+  CountsByPid result = *exitedThreads_.lock();
+  for (auto& bucket : accessor) {
+    mergeCounts(result, *bucket.counts.lock());
+  }
+  return result;
+}
+
+ProcessFetchLog& getProcessFetchLog() {
+  // Leaked so that work done during static destruction can still be
+  // recorded.
+  static auto* processFetchLog = new ProcessFetchLog;
+  return *processFetchLog;
+}
+
+} // namespace eden
+} // namespace facebook
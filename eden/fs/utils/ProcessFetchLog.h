@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
+#include <sys/types.h>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace facebook {
+namespace eden {
+
+/**
+ * Attributes expensive work, such as fetches from the BackingStore and file
+ * materializations, to the client processes that caused it.
+ *
+ * The pid is taken from the ClientPidRequestData of the current request; work
+ * done outside of a client request is not recorded.
+ *
+ * Unlike ProcessAccessLog, which keeps a few seconds of recent accesses,
+ * ProcessFetchLog keeps totals since the process started, so that it can
+ * answer which process was responsible for a large download after the fact.
+ * Recording only touches a bucket owned by the calling thread; the buckets
+ * are summed when the log is read.
+ */
+class ProcessFetchLog {
+ public:
+  struct Counts {
+    uint64_t blobFetches{0};
+    uint64_t treeFetches{0};
+    uint64_t fetchedBytes{0};
+    // The time spent waiting on the BackingStore for these fetches.
+    std::chrono::microseconds fetchTime{0};
+    uint64_t materializations{0};
+
+    void merge(const Counts& other);
+  };
+
+  ProcessFetchLog();
+  ~ProcessFetchLog();
+
+  void recordBlobFetch(size_t bytes, std::chrono::microseconds elapsed);
+  void recordTreeFetch(std::chrono::microseconds elapsed);
+  void recordMaterialization();
+
+  /**
+   * Returns the totals recorded for each pid.
+   */
+  std::unordered_map<pid_t, Counts> getAllCounts();
+
+ private:
+  using CountsByPid = std::unordered_map<pid_t, Counts>;
+
+  struct ThreadBucket {
+    explicit ThreadBucket(ProcessFetchLog* owner) : owner{owner} {}
+    ~ThreadBucket();
+
+    ProcessFetchLog* const owner;
+    folly::Synchronized<CountsByPid, std::mutex> counts;
+  };
+  struct ThreadBucketTag;
+
+  /**
+   * Apply fn to the current request's pid's Counts in this thread's bucket.
+   * Does nothing if there is no current request.
+   */
+  template <typename Fn>
+  void record(Fn&& fn);
+
+  // Counts from threads that have exited.  This is declared before buckets_
+  // so that it outlives them.
+  folly::Synchronized<CountsByPid, std::mutex> exitedThreads_;
+  // AccessModeStrict keeps threads from exiting while getAllCounts() visits
+  // their buckets.
+  folly::ThreadLocal<ThreadBucket, ThreadBucketTag, folly::AccessModeStrict>
+      buckets_;
+};
+
+/**
+ * Get the process-wide ProcessFetchLog.
+ */
+ProcessFetchLog& getProcessFetchLog();
+
+} // namespace eden
+} // namespace facebook
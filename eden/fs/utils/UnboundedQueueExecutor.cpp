@@ -9,18 +9,76 @@
  */
 #include "eden/fs/utils/UnboundedQueueExecutor.h"
 
+#include <folly/ScopeGuard.h>
+#include <folly/Synchronized.h>
 #include <folly/executors/CPUThreadPoolExecutor.h>
 #include <folly/executors/ManualExecutor.h>
 #include <folly/executors/task_queue/UnboundedBlockingQueue.h>
 #include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <array>
+#include <deque>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
 
 namespace facebook {
 namespace eden {
 
+namespace {
+// Indexes into State::classes, in the order they are considered.
+constexpr size_t kInteractive = 0;
+constexpr size_t kNormal = 1;
+constexpr size_t kBackground = 2;
+constexpr size_t kNumClasses = 3;
+
+size_t classIndex(int8_t priority) {
+  if (priority > 0) {
+    return kInteractive;
+  } else if (priority < 0) {
+    return kBackground;
+  }
+  return kNormal;
+}
+
+constexpr std::array<int8_t, kNumClasses> kClassPriority{
+    UnboundedQueueExecutor::kInteractivePriority,
+    UnboundedQueueExecutor::kNormalPriority,
+    UnboundedQueueExecutor::kBackgroundPriority,
+};
+
+thread_local int8_t currentPriority = UnboundedQueueExecutor::kNormalPriority;
+} // namespace
+
+struct UnboundedQueueExecutor::Queues {
+  struct Task {
+    folly::Func func;
+    steady_clock::time_point enqueued;
+  };
+
+  struct Class {
+    std::deque<Task> queue;
+    size_t running{0};
+    size_t limit{0};
+    uint64_t started{0};
+    microseconds totalWait{0};
+  };
+
+  struct State {
+    std::array<Class, kNumClasses> classes;
+    // runNext() calls that returned without starting anything because every
+    // class with queued work was at its concurrency limit.
+    size_t missedRuns{0};
+  };
+
+  folly::Synchronized<State> state;
+};
+
 UnboundedQueueExecutor::UnboundedQueueExecutor(
     size_t threadCount,
     folly::StringPiece threadNamePrefix)
-    : executor_{std::make_unique<folly::CPUThreadPoolExecutor>(
+    : queues_{std::make_shared<Queues>()},
+      executor_{std::make_unique<folly::CPUThreadPoolExecutor>(
           threadCount,
           std::make_unique<folly::UnboundedBlockingQueue<
               folly::CPUThreadPoolExecutor::CPUTask>>(),
@@ -28,7 +86,105 @@ UnboundedQueueExecutor::UnboundedQueueExecutor(
 
 UnboundedQueueExecutor::UnboundedQueueExecutor(
     std::shared_ptr<folly::ManualExecutor> executor)
-    : executor_{std::move(executor)} {}
+    : queues_{std::make_shared<Queues>()}, executor_{std::move(executor)} {}
+
+UnboundedQueueExecutor::~UnboundedQueueExecutor() {}
+
+void UnboundedQueueExecutor::add(folly::Func func) {
+  addWithPriority(std::move(func), currentPriority);
+}
+
+void UnboundedQueueExecutor::addWithPriority(
+    folly::Func func,
+    int8_t priority) {
+  queues_->state.wlock()->classes.at(classIndex(priority)).queue.push_back(
+      Queues::Task{std::move(func), steady_clock::now()});
+  // Each queued function gets one call to runNext(), but that call starts
+  // whichever function has the highest priority at the time it runs.
+  executor_->add([queues = queues_, executor = executor_.get()] {
+    runNext(queues, executor);
+  });
+}
+
+void UnboundedQueueExecutor::runNext(
+    const std::shared_ptr<Queues>& queues,
+    folly::Executor* executor) {
+  folly::Func func;
+  size_t index = 0;
+  {
+    auto state = queues->state.wlock();
+    for (; index < kNumClasses; ++index) {
+      auto& cls = state->classes[index];
+      if (!cls.queue.empty() && (cls.limit == 0 || cls.running < cls.limit)) {
+        break;
+      }
+    }
+    if (index == kNumClasses) {
+      // Everything queued is at its concurrency limit, so each of those
+      // classes has running work.  The next one to finish makes up for this
+      // call.
+      ++state->missedRuns;
+      return;
+    }
+    auto& cls = state->classes[index];
+    auto& task = cls.queue.front();
+    func = std::move(task.func);
+    cls.totalWait +=
+        duration_cast<microseconds>(steady_clock::now() - task.enqueued);
+    cls.queue.pop_front();
+    ++cls.running;
+    ++cls.started;
+  }
+
+  auto savedPriority = currentPriority;
+  currentPriority = kClassPriority[index];
+  SCOPE_EXIT {
+    currentPriority = savedPriority;
+    bool runAgain = false;
+    {
+      auto state = queues->state.wlock();
+      --state->classes[index].running;
+      if (state->missedRuns > 0) {
+        --state->missedRuns;
+        runAgain = true;
+      }
+    }
+    if (runAgain) {
+      executor->add([queues, executor] { runNext(queues, executor); });
+    }
+  };
+  func();
+}
+
+void UnboundedQueueExecutor::setConcurrencyLimit(
+    int8_t priority,
+    size_t limit) {
+  queues_->state.wlock()->classes.at(classIndex(priority)).limit = limit;
+}
+
+UnboundedQueueExecutor::PriorityStats UnboundedQueueExecutor::getStats(
+    int8_t priority) const {
+  PriorityStats stats;
+  auto state = queues_->state.rlock();
+  const auto& cls = state->classes.at(classIndex(priority));
+  stats.queued = cls.queue.size();
+  stats.running = cls.running;
+  stats.started = cls.started;
+  stats.totalWait = cls.totalWait;
+  if (!cls.queue.empty()) {
+    stats.oldestWait = duration_cast<microseconds>(
+        steady_clock::now() - cls.queue.front().enqueued);
+  }
+  return stats;
+}
+
+int8_t UnboundedQueueExecutor::getCurrentPriority() {
+  return currentPriority;
+}
+
+void UnboundedQueueExecutor::setCurrentPriority(int8_t priority) {
+  currentPriority = kClassPriority[classIndex(priority)];
+}
 
 } // namespace eden
 } // namespace facebook
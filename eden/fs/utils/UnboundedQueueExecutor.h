@@ -11,6 +11,9 @@
 
 #include <folly/Executor.h>
 #include <folly/Range.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 
 namespace folly {
 class ManualExecutor;
@@ -25,9 +28,37 @@ namespace eden {
  *
  * Parts of Eden rely on queuing a function to be non-blocking for deadlock
  * safety.
+ *
+ * Work is queued in one of three priority classes: interactive (work a user
+ * is waiting on, such as FUSE requests), normal, and background (prefetching,
+ * periodic inode unloading).  Whenever a thread becomes free it starts the
+ * oldest queued function of the highest priority class that is below its
+ * concurrency limit.  Running work is never preempted, so limiting the
+ * background class is what keeps threads free for interactive work.
  */
 class UnboundedQueueExecutor : public folly::Executor {
  public:
+  /**
+   * Priorities accepted by addWithPriority() and folly::via().  Other
+   * values are mapped to the class with the same sign.
+   */
+  static constexpr int8_t kInteractivePriority = folly::Executor::HI_PRI;
+  static constexpr int8_t kNormalPriority = folly::Executor::MID_PRI;
+  static constexpr int8_t kBackgroundPriority = folly::Executor::LO_PRI;
+
+  struct PriorityStats {
+    /** Functions waiting to start. */
+    size_t queued{0};
+    /** Functions currently running. */
+    size_t running{0};
+    /** Functions started since the executor was created. */
+    uint64_t started{0};
+    /** Total time started functions spent queued. */
+    std::chrono::microseconds totalWait{0};
+    /** How long the oldest queued function has been waiting. */
+    std::chrono::microseconds oldestWait{0};
+  };
+
   /**
    * Instantiates with a folly::CPUThreadPoolExecutor with the given threadCount
    * and threadNamePrefix but with an unlimited queue.
@@ -44,16 +75,56 @@ class UnboundedQueueExecutor : public folly::Executor {
   explicit UnboundedQueueExecutor(
       std::shared_ptr<folly::ManualExecutor> executor);
 
+  ~UnboundedQueueExecutor() override;
+
   UnboundedQueueExecutor(const UnboundedQueueExecutor&) = delete;
   UnboundedQueueExecutor& operator=(const UnboundedQueueExecutor&) = delete;
   UnboundedQueueExecutor(UnboundedQueueExecutor&&) = delete;
   UnboundedQueueExecutor& operator=(UnboundedQueueExecutor&&) = delete;
 
-  void add(folly::Func func) override {
-    executor_->add(std::move(func));
+  /**
+   * Queue func at getCurrentPriority(), so work queued by interactive work
+   * stays interactive.
+   */
+  void add(folly::Func func) override;
+
+  void addWithPriority(folly::Func func, int8_t priority) override;
+
+  uint8_t getNumPriorities() const override {
+    return 3;
   }
 
+  /**
+   * Allow at most limit functions of the given priority to run at once.  A
+   * limit of 0, the default, means no limit beyond the thread count.
+   */
+  void setConcurrencyLimit(int8_t priority, size_t limit);
+
+  PriorityStats getStats(int8_t priority) const;
+
+  /**
+   * Returns the priority of the function running on this thread, or the value
+   * set by setCurrentPriority() on threads that do not belong to an
+   * UnboundedQueueExecutor.  Defaults to kNormalPriority.
+   */
+  static int8_t getCurrentPriority();
+
+  /**
+   * Set the priority reported by getCurrentPriority() on this thread.  Used
+   * by threads such as the FUSE workers, whose work is all interactive.
+   */
+  static void setCurrentPriority(int8_t priority);
+
  private:
+  struct Queues;
+
+  static void runNext(
+      const std::shared_ptr<Queues>& queues,
+      folly::Executor* executor);
+
+  // Queued functions are held here.  The underlying executor only holds
+  // calls to runNext(), which keep queues_ alive.
+  std::shared_ptr<Queues> queues_;
   std::shared_ptr<folly::Executor> executor_;
 };
 
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/utils/ProcessFetchLog.h"
+#include <folly/io/async/Request.h>
+#include <gtest/gtest.h>
+#include <thread>
+#include "eden/fs/utils/ClientPid.h"
+
+using namespace std::literals;
+using namespace facebook::eden;
+
+TEST(ProcessFetchLog, workOutsideOfRequestsIsNotRecorded) {
+  ProcessFetchLog log;
+  log.recordBlobFetch(100, 5us);
+  log.recordMaterialization();
+  EXPECT_EQ(0, log.getAllCounts().size());
+}
+
+TEST(ProcessFetchLog, recordsAgainstClientPid) {
+  ProcessFetchLog log;
+  {
+    folly::RequestContextScopeGuard guard;
+    ClientPidRequestData::set(10);
+    EXPECT_EQ(10, ClientPidRequestData::get());
+    log.recordBlobFetch(100, 5us);
+    log.recordBlobFetch(50, 5us);
+    log.recordTreeFetch(2us);
+  }
+  {
+    folly::RequestContextScopeGuard guard;
+    ClientPidRequestData::set(20);
+    log.recordMaterialization();
+  }
+  EXPECT_EQ(std::nullopt, ClientPidRequestData::get());
+
+  auto counts = log.getAllCounts();
+  ASSERT_EQ(2, counts.size());
+  EXPECT_EQ(2, counts[10].blobFetches);
+  EXPECT_EQ(1, counts[10].treeFetches);
+  EXPECT_EQ(150, counts[10].fetchedBytes);
+  EXPECT_EQ(12us, counts[10].fetchTime);
+  EXPECT_EQ(0, counts[10].materializations);
+  EXPECT_EQ(1, counts[20].materializations);
+}
+
+TEST(ProcessFetchLog, keepsCountsFromExitedThreads) {
+  ProcessFetchLog log;
+  std::thread{[&] {
+    folly::RequestContextScopeGuard guard;
+    ClientPidRequestData::set(10);
+    log.recordBlobFetch(100, 5us);
+  }}.join();
+
+  folly::RequestContextScopeGuard guard;
+  ClientPidRequestData::set(10);
+  log.recordBlobFetch(100, 5us);
+
+  auto counts = log.getAllCounts();
+  EXPECT_EQ(2, counts[10].blobFetches);
+  EXPECT_EQ(200, counts[10].fetchedBytes);
+}
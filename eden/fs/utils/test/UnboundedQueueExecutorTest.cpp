@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2019-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "eden/fs/utils/UnboundedQueueExecutor.h"
+
+#include <folly/executors/ManualExecutor.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace facebook::eden;
+using ::testing::ElementsAre;
+
+namespace {
+constexpr auto kInteractive = UnboundedQueueExecutor::kInteractivePriority;
+constexpr auto kNormal = UnboundedQueueExecutor::kNormalPriority;
+constexpr auto kBackground = UnboundedQueueExecutor::kBackgroundPriority;
+
+struct UnboundedQueueExecutorTest : ::testing::Test {
+  std::shared_ptr<folly::ManualExecutor> manual =
+      std::make_shared<folly::ManualExecutor>();
+  UnboundedQueueExecutor executor{manual};
+  std::vector<std::string> ran;
+
+  void add(std::string name, int8_t priority) {
+    executor.addWithPriority([this, name] { ran.push_back(name); }, priority);
+  }
+};
+} // namespace
+
+TEST_F(UnboundedQueueExecutorTest, runsHigherPrioritiesFirst) {
+  add("background1", kBackground);
+  add("normal1", kNormal);
+  add("background2", kBackground);
+  add("interactive1", kInteractive);
+  add("normal2", kNormal);
+  manual->drain();
+  EXPECT_THAT(
+      ran,
+      ElementsAre(
+          "interactive1", "normal1", "normal2", "background1", "background2"));
+}
+
+TEST_F(UnboundedQueueExecutorTest, concurrencyLimit) {
+  executor.setConcurrencyLimit(kBackground, 1);
+
+  // The first background function runs the executor while it is still
+  // running, so the second must wait even though a thread is free.
+  executor.addWithPriority(
+      [this] {
+        ran.push_back("background1");
+        add("normal", kNormal);
+        manual->run();
+        ran.push_back("background1 done");
+      },
+      kBackground);
+  add("background2", kBackground);
+  manual->drain();
+  EXPECT_THAT(
+      ran,
+      ElementsAre("background1", "normal", "background1 done", "background2"));
+
+  auto stats = executor.getStats(kBackground);
+  EXPECT_EQ(0, stats.queued);
+  EXPECT_EQ(0, stats.running);
+  EXPECT_EQ(2, stats.started);
+}
+
+TEST_F(UnboundedQueueExecutorTest, addInheritsCurrentPriority) {
+  executor.addWithPriority(
+      [this] {
+        EXPECT_EQ(kBackground, UnboundedQueueExecutor::getCurrentPriority());
+        executor.add([this] { ran.push_back("from background"); });
+      },
+      kBackground);
+  executor.addWithPriority(
+      [this] {
+        executor.add([this] { ran.push_back("from interactive"); });
+      },
+      kInteractive);
+  add("normal", kNormal);
+  manual->drain();
+  EXPECT_THAT(
+      ran, ElementsAre("from interactive", "normal", "from background"));
+  EXPECT_EQ(kNormal, UnboundedQueueExecutor::getCurrentPriority());
+}
+
+TEST_F(UnboundedQueueExecutorTest, stats) {
+  add("a", kInteractive);
+  add("b", kInteractive);
+  auto stats = executor.getStats(kInteractive);
+  EXPECT_EQ(2, stats.queued);
+  EXPECT_EQ(0, stats.started);
+  EXPECT_EQ(0, executor.getStats(kNormal).queued);
+
+  manual->drain();
+  stats = executor.getStats(kInteractive);
+  EXPECT_EQ(0, stats.queued);
+  EXPECT_EQ(2, stats.started);
+  EXPECT_EQ(0, stats.oldestWait.count());
+}